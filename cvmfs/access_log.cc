@@ -0,0 +1,328 @@
+/**
+ * This file is part of the CernVM File System.
+ *
+ * The access log records which content-addressed objects (catalogs, files,
+ * chunks) are needed by the clients of a mount point, in the order they are
+ * needed.  Other than the tracer, it writes fixed-size binary records, so
+ * that recording is cheap and the log can be replayed later in order to
+ * pre-load a cache (see swissknife replay).
+ *
+ * The file consists of a header (magic number, version) followed by Record
+ * structs.  Records are appended, so that a log can span several sessions.
+ *
+ * Every thread collects its records in a buffer of its own.  A full buffer is
+ * written in one go by the thread that filled it, Flush() and Fini() write
+ * the buffers of all threads.  Thus the records of different threads are
+ * not in timestamp order in the file; ReadLog() sorts them.
+ */
+
+#include "cvmfs_config.h"
+#include "access_log.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "logging.h"
+#include "platform.h"
+#include "smalloc.h"
+
+using namespace std;  // NOLINT
+
+namespace access_log {
+
+namespace {
+
+struct Header {
+  uint32_t magic_number;
+  uint32_t version;
+};
+
+/**
+ * Records of a single thread.  The lock is only contended while another
+ * thread flushes the buffer.
+ */
+struct ThreadBuffer {
+  static const unsigned kCapacity = 128;
+
+  pthread_mutex_t lock;
+  unsigned size;
+  Record records[kCapacity];
+  ThreadBuffer *prev;
+  ThreadBuffer *next;
+};
+
+FILE *log_file_ = NULL;
+pthread_mutex_t lock_log_file_ = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t thread_buffer_key_;
+/**
+ * List of all thread buffers, protects creation and removal of buffers.
+ */
+ThreadBuffer *thread_buffers_ = NULL;
+pthread_mutex_t lock_thread_buffers_ = PTHREAD_MUTEX_INITIALIZER;
+
+
+bool TimestampLess(const Record &a, const Record &b) {
+  return a.timestamp < b.timestamp;
+}
+
+
+/**
+ * Writes the records of a buffer to the log file, the caller holds the lock
+ * of the buffer.
+ */
+void WriteBuffer(ThreadBuffer *buffer) {
+  if (buffer->size == 0)
+    return;
+  pthread_mutex_lock(&lock_log_file_);
+  size_t written =
+    fwrite(buffer->records, sizeof(Record), buffer->size, log_file_);
+  pthread_mutex_unlock(&lock_log_file_);
+  if (written != buffer->size) {
+    LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogWarn,
+             "failed to write access log records (%"PRIu64" out of %u written)",
+             static_cast<uint64_t>(written), buffer->size);
+  }
+  buffer->size = 0;
+}
+
+
+/**
+ * Unlinks and frees a buffer, the caller holds lock_thread_buffers_.
+ */
+void RemoveBuffer(ThreadBuffer *buffer) {
+  if (buffer->prev != NULL)
+    buffer->prev->next = buffer->next;
+  else
+    thread_buffers_ = buffer->next;
+  if (buffer->next != NULL)
+    buffer->next->prev = buffer->prev;
+  pthread_mutex_destroy(&buffer->lock);
+  free(buffer);
+}
+
+
+/**
+ * Called when a thread terminates, its pending records are written out.
+ */
+void DestroyThreadBuffer(void *data) {
+  ThreadBuffer *buffer = reinterpret_cast<ThreadBuffer *>(data);
+  pthread_mutex_lock(&lock_thread_buffers_);
+  // Fini() might have freed the buffer in the meantime
+  ThreadBuffer *b = thread_buffers_;
+  while ((b != NULL) && (b != buffer))
+    b = b->next;
+  if (b == NULL) {
+    pthread_mutex_unlock(&lock_thread_buffers_);
+    return;
+  }
+  pthread_mutex_lock(&buffer->lock);
+  WriteBuffer(buffer);
+  pthread_mutex_unlock(&buffer->lock);
+  RemoveBuffer(buffer);
+  pthread_mutex_unlock(&lock_thread_buffers_);
+}
+
+
+ThreadBuffer *GetThreadBuffer() {
+  ThreadBuffer *buffer =
+    reinterpret_cast<ThreadBuffer *>(pthread_getspecific(thread_buffer_key_));
+  if (buffer != NULL)
+    return buffer;
+
+  buffer = reinterpret_cast<ThreadBuffer *>(smalloc(sizeof(ThreadBuffer)));
+  int retval = pthread_mutex_init(&buffer->lock, NULL);
+  assert(retval == 0);
+  buffer->size = 0;
+  buffer->prev = NULL;
+  pthread_mutex_lock(&lock_thread_buffers_);
+  buffer->next = thread_buffers_;
+  if (thread_buffers_) thread_buffers_->prev = buffer;
+  thread_buffers_ = buffer;
+  pthread_mutex_unlock(&lock_thread_buffers_);
+  retval = pthread_setspecific(thread_buffer_key_, buffer);
+  assert(retval == 0);
+  return buffer;
+}
+
+}  // anonymous namespace
+
+bool active_ = false;
+
+
+Record::Record(
+  const RecordType type,
+  const shash::Md5 &path_hash,
+  const shash::Any &hash,
+  const uint64_t offset,
+  const uint64_t size)
+{
+  // Zero the padding, the struct is written as is
+  memset(this, 0, sizeof(Record));
+  timeval now;
+  gettimeofday(&now, NULL);
+  this->timestamp = static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_usec;
+  this->offset = offset;
+  this->size = size;
+  this->type = type;
+  this->algorithm = hash.algorithm;
+  this->suffix = hash.suffix;
+  memcpy(path_md5, path_hash.digest, sizeof(path_md5));
+  memcpy(digest, hash.digest, hash.GetDigestSize());
+}
+
+
+/**
+ * Opens the log file for appending and activates recording.  A new file
+ * starts with the header, an existing file needs to have a matching header.
+ */
+bool Init(const string &path) {
+  assert(log_file_ == NULL);
+  FILE *f = fopen(path.c_str(), "a+");
+  if (f == NULL) {
+    LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogErr,
+             "failed to open access log %s (%d)", path.c_str(), errno);
+    return false;
+  }
+
+  Header header;
+  platform_stat64 info;
+  int retval = platform_fstat(fileno(f), &info);
+  assert(retval == 0);
+  if (info.st_size == 0) {
+    header.magic_number = kMagicNumber;
+    header.version = kVersion;
+    if (fwrite(&header, sizeof(header), 1, f) != 1) {
+      fclose(f);
+      return false;
+    }
+  } else {
+    if ((fread(&header, sizeof(header), 1, f) != 1) ||
+        (header.magic_number != kMagicNumber) || (header.version != kVersion))
+    {
+      LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogErr,
+               "%s is not a compatible access log", path.c_str());
+      fclose(f);
+      return false;
+    }
+  }
+
+  retval = pthread_key_create(&thread_buffer_key_, DestroyThreadBuffer);
+  assert(retval == 0);
+  log_file_ = f;
+  active_ = true;
+  return true;
+}
+
+
+/**
+ * Turns the access log off.
+ */
+void InitNull() {
+  active_ = false;
+}
+
+
+/**
+ * Writes all pending records and closes the log file.  All calls to Log()
+ * must have returned.
+ */
+void Fini() {
+  if (!active_) return;
+  active_ = false;
+  pthread_mutex_lock(&lock_thread_buffers_);
+  while (thread_buffers_ != NULL) {
+    WriteBuffer(thread_buffers_);
+    RemoveBuffer(thread_buffers_);
+  }
+  // Buffers of running threads are gone, their destructor must not run
+  pthread_key_delete(thread_buffer_key_);
+  pthread_mutex_unlock(&lock_thread_buffers_);
+  pthread_mutex_lock(&lock_log_file_);
+  fclose(log_file_);
+  log_file_ = NULL;
+  pthread_mutex_unlock(&lock_log_file_);
+}
+
+
+/**
+ * Writes the pending records of all threads to the file.
+ */
+void Flush() {
+  if (!active_) return;
+  pthread_mutex_lock(&lock_thread_buffers_);
+  for (ThreadBuffer *b = thread_buffers_; b != NULL; b = b->next) {
+    pthread_mutex_lock(&b->lock);
+    WriteBuffer(b);
+    pthread_mutex_unlock(&b->lock);
+  }
+  pthread_mutex_unlock(&lock_thread_buffers_);
+  pthread_mutex_lock(&lock_log_file_);
+  fflush(log_file_);
+  pthread_mutex_unlock(&lock_log_file_);
+}
+
+
+/**
+ * Appends a record to the buffer of the calling thread.  Only a full buffer
+ * touches the log file.
+ */
+void LogInternal(
+  const RecordType type,
+  const shash::Md5 &path_hash,
+  const shash::Any &hash,
+  const uint64_t offset,
+  const uint64_t size)
+{
+  ThreadBuffer *buffer = GetThreadBuffer();
+  pthread_mutex_lock(&buffer->lock);
+  buffer->records[buffer->size++] =
+    Record(type, path_hash, hash, offset, size);
+  if (buffer->size == ThreadBuffer::kCapacity)
+    WriteBuffer(buffer);
+  pthread_mutex_unlock(&buffer->lock);
+}
+
+
+/**
+ * Reads all records of an access log file in the order of their timestamps.
+ */
+bool ReadLog(const string &path, vector<Record> *records) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (f == NULL)
+    return false;
+
+  Header header;
+  if ((fread(&header, sizeof(header), 1, f) != 1) ||
+      (header.magic_number != kMagicNumber) || (header.version != kVersion))
+  {
+    fclose(f);
+    return false;
+  }
+
+  records->clear();
+  Record record;
+  size_t nbytes;
+  while ((nbytes = fread(&record, 1, sizeof(record), f)) == sizeof(record)) {
+    if ((record.type < kRecordCatalog) || (record.type > kRecordChunk) ||
+        (record.algorithm >= shash::kAny))
+    {
+      fclose(f);
+      return false;
+    }
+    records->push_back(record);
+  }
+  // A truncated record at the end of the file is an error
+  const bool result = (nbytes == 0) && !ferror(f);
+  fclose(f);
+  stable_sort(records->begin(), records->end(), TimestampLess);
+  return result;
+}
+
+}  // namespace access_log
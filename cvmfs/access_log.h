@@ -0,0 +1,86 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_ACCESS_LOG_H_
+#define CVMFS_ACCESS_LOG_H_
+
+#include <stdint.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "hash.h"
+
+namespace access_log {
+
+extern bool active_;
+
+/**
+ * Magic number and version at the beginning of an access log file.
+ */
+const uint32_t kMagicNumber = 0x434c4f47;  // "CLOG"
+const uint32_t kVersion = 1;
+
+enum RecordType {
+  kRecordCatalog = 1,
+  kRecordObject,  /**< A complete, non-chunked file */
+  kRecordChunk,   /**< A part of a chunked file */
+};
+
+/**
+ * Fixed-size, binary record of an access to a content-addressed object.
+ * Catalogs are recorded when they are loaded, regular files when they are
+ * opened and the chunks of a chunked file when its chunk list is loaded on
+ * open.  The offset and size give the byte range of the object within the
+ * file.  The path is recorded by the MD5 hash of the path, which callers
+ * compute once per open and pass in.
+ */
+struct Record {
+  Record() { memset(this, 0, sizeof(Record)); }
+  Record(const RecordType type, const shash::Md5 &path_hash,
+         const shash::Any &hash, const uint64_t offset, const uint64_t size);
+
+  shash::Any GetHash() const {
+    return shash::Any(static_cast<shash::Algorithms>(algorithm), digest,
+                      shash::kDigestSizes[algorithm], suffix);
+  }
+  shash::Md5 GetPathHash() const {
+    shash::Md5 result;
+    memcpy(result.digest, path_md5, sizeof(path_md5));
+    return result;
+  }
+
+  uint64_t timestamp;  /**< Microseconds since the epoch */
+  uint64_t offset;
+  uint64_t size;
+  uint8_t type;
+  uint8_t algorithm;
+  char suffix;
+  uint8_t padding[5];
+  unsigned char path_md5[16];
+  unsigned char digest[shash::kMaxDigestSize];
+};
+
+
+bool Init(const std::string &path);
+void InitNull();
+void Fini();
+void Flush();
+
+void LogInternal(const RecordType type, const shash::Md5 &path_hash,
+                 const shash::Any &hash, const uint64_t offset,
+                 const uint64_t size);
+inline void Log(const RecordType type, const shash::Md5 &path_hash,
+                const shash::Any &hash, const uint64_t offset,
+                const uint64_t size)
+{
+  if (active_) LogInternal(type, path_hash, hash, offset, size);
+}
+
+bool ReadLog(const std::string &path, std::vector<Record> *records);
+
+}  // namespace access_log
+
+#endif  // CVMFS_ACCESS_LOG_H_
@@ -0,0 +1,136 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include "cvmfs_config.h"
+#include "access_log_replay.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <set>
+
+#include "download.h"
+#include "logging.h"
+#include "util.h"
+
+using namespace std;  // NOLINT
+
+namespace access_log {
+
+Replayer::Replayer(
+  download::DownloadManager *download_manager,
+  const string &repository_url,
+  const string &cache_dir)
+  : download_manager_(download_manager)
+  , repository_url_(repository_url)
+  , cache_dir_(cache_dir)
+  , objects_(NULL)
+{
+  atomic_init64(&next_object_);
+  atomic_init64(&num_new_);
+  atomic_init64(&num_failed_);
+}
+
+
+/**
+ * Every object once, in the order of first access.  The records need to be
+ * sorted by timestamp, as returned by ReadLog().
+ */
+void Replayer::ListObjects(
+  const vector<Record> &records,
+  vector<shash::Any> *objects)
+{
+  objects->clear();
+  set<shash::Any> seen;
+  for (unsigned i = 0; i < records.size(); ++i) {
+    const shash::Any hash = records[i].GetHash();
+    if (seen.insert(hash).second)
+      objects->push_back(hash);
+  }
+}
+
+
+/**
+ * Fetches all objects that are not yet in the cache directory.  The download
+ * manager needs to be spawned with at least num_threads parallel connections.
+ * Returns true if no download failed.
+ */
+bool Replayer::Run(const vector<shash::Any> &objects,
+                   const unsigned num_threads)
+{
+  assert(num_threads > 0);
+  if (!MakeCacheDirectories(cache_dir_, 0770)) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to create cache directory %s",
+             cache_dir_.c_str());
+    return false;
+  }
+
+  objects_ = &objects;
+  atomic_init64(&next_object_);
+  vector<pthread_t> workers(num_threads);
+  for (unsigned i = 0; i < num_threads; ++i) {
+    int retval = pthread_create(&workers[i], NULL, MainWorker, this);
+    assert(retval == 0);
+  }
+  for (unsigned i = 0; i < num_threads; ++i) {
+    int retval = pthread_join(workers[i], NULL);
+    assert(retval == 0);
+  }
+  objects_ = NULL;
+  return atomic_read64(&num_failed_) == 0;
+}
+
+
+void *Replayer::MainWorker(void *data) {
+  Replayer *replayer = reinterpret_cast<Replayer *>(data);
+  while (true) {
+    const int64_t idx = atomic_xadd64(&replayer->next_object_, 1);
+    if (idx >= static_cast<int64_t>(replayer->objects_->size()))
+      break;
+    if (!replayer->Fetch((*replayer->objects_)[idx]))
+      atomic_inc64(&replayer->num_failed_);
+  }
+  return NULL;
+}
+
+
+bool Replayer::Fetch(const shash::Any &hash) {
+  const string dest_path = cache_dir_ + "/" + hash.MakePathWithoutSuffix();
+  if (FileExists(dest_path))
+    return true;
+
+  string tmp_path;
+  FILE *ftmp = CreateTempFile(cache_dir_ + "/txn/replay", 0660, "w",
+                              &tmp_path);
+  if (ftmp == NULL) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to create temporary file in %s",
+             cache_dir_.c_str());
+    return false;
+  }
+  const string url = repository_url_ + "/data/" + hash.MakePath();
+  download::JobInfo download_object(&url, true, false, ftmp, &hash);
+  download::Failures retval = download_manager_->Fetch(&download_object);
+  fclose(ftmp);
+  if (retval != download::kFailOk) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to download %s (%d - %s)",
+             url.c_str(), retval, download::Code2Ascii(retval));
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  if (rename(tmp_path.c_str(), dest_path.c_str()) != 0) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to move %s into the cache",
+             hash.ToString().c_str());
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  if (atomic_xadd64(&num_new_, 1) % 1000 == 0)
+    LogCvmfs(kLogCvmfs, kLogStdout | kLogNoLinebreak, ".");
+  return true;
+}
+
+}  // namespace access_log
@@ -0,0 +1,57 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_ACCESS_LOG_REPLAY_H_
+#define CVMFS_ACCESS_LOG_REPLAY_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "access_log.h"
+#include "atomic.h"
+#include "hash.h"
+
+namespace download {
+class DownloadManager;
+}
+
+namespace access_log {
+
+/**
+ * Preloads a cache directory with the objects recorded in an access log.
+ * Objects are fetched in parallel, in the order they were first needed.
+ * Content-addressed objects are verified by their hash, so no manifest or
+ * signature is required.
+ */
+class Replayer {
+ public:
+  Replayer(download::DownloadManager *download_manager,
+           const std::string &repository_url,
+           const std::string &cache_dir);
+
+  static void ListObjects(const std::vector<Record> &records,
+                          std::vector<shash::Any> *objects);
+  bool Run(const std::vector<shash::Any> &objects, const unsigned num_threads);
+
+  int64_t num_new() { return atomic_read64(&num_new_); }
+  int64_t num_failed() { return atomic_read64(&num_failed_); }
+
+ private:
+  static void *MainWorker(void *data);
+  bool Fetch(const shash::Any &hash);
+
+  download::DownloadManager *download_manager_;
+  std::string repository_url_;
+  std::string cache_dir_;
+  const std::vector<shash::Any> *objects_;
+  atomic_int64 next_object_;
+  atomic_int64 num_new_;
+  atomic_int64 num_failed_;
+};
+
+}  // namespace access_log
+
+#endif  // CVMFS_ACCESS_LOG_REPLAY_H_
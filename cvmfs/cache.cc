@@ -34,6 +34,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #ifndef __APPLE__
@@ -310,6 +311,9 @@ int PosixCacheManager::CommitTxn(void *txn) {
            transaction->final_path.c_str(), transaction->tmp_path.c_str());
 
   result = Flush(transaction);
+  // Small objects, which never filled a write-back window, stay cached
+  if ((result == 0) && drop_written_pages_ && (transaction->writeback_pos > 0))
+    platform_evict_written(transaction->fd, 0, 0);
   close(transaction->fd);
   if (result < 0) {
     unlink(transaction->tmp_path.c_str());
@@ -444,20 +448,25 @@ int PosixCacheManager::Dup(int fd) {
 int PosixCacheManager::Flush(Transaction *transaction) {
   if (transaction->buf_pos == 0)
     return 0;
-  int written =
-    write(transaction->fd, transaction->buffer, transaction->buf_pos);
-  if (written < 0)
-    return -errno;
-  if (static_cast<unsigned>(written) != transaction->buf_pos) {
-    transaction->buf_pos -= written;
-    return -EIO;
-  }
+  int retval =
+    WriteToFile(transaction->buffer, transaction->buf_pos, transaction);
+  if (retval < 0)
+    return retval;
   transaction->buf_pos = 0;
   return 0;
 }
 
 
-inline string PosixCacheManager::GetPathInCache(const shash::Any &id) {
+/**
+ * Lock files of running downloads are kept in the transaction directory,
+ * which is shared by all the processes using an alien cache.
+ */
+string PosixCacheManager::GetDownloadLockPath(const shash::Any &id) {
+  return cache_path_ + "/txn/" + id.ToString() + ".lock";
+}
+
+
+string PosixCacheManager::GetPathInCache(const shash::Any &id) {
   return cache_path_ + "/" + id.MakePathWithoutSuffix();
 }
 
@@ -471,6 +480,67 @@ int64_t PosixCacheManager::GetSize(int fd) {
 }
 
 
+/**
+ * Takes an flock() on the lock file of the object.  While another process
+ * holds the lock, waits with increasing intervals up to
+ * download_lock_timeout_ms_.  Errors, e.g. file systems without support for
+ * flock(), fall back to uncoordinated downloads.
+ */
+int PosixCacheManager::LockDownload(const shash::Any &id) {
+  if (!alien_cache_ || !cooperative_downloads_ ||
+      (cache_mode_ == kCacheReadOnly))
+  {
+    return -1;
+  }
+
+  const string lock_path = GetDownloadLockPath(id);
+  unsigned waited_ms = 0;
+  unsigned backoff_ms = 1;
+  while (true) {
+    const int fd_lock = open(lock_path.c_str(), O_RDONLY | O_CREAT, 0660);
+    if (fd_lock < 0) {
+      LogCvmfs(kLogCache, kLogDebug, "failed to open %s (%d)",
+               lock_path.c_str(), errno);
+      return -1;
+    }
+    if (flock(fd_lock, LOCK_EX | LOCK_NB) == 0) {
+      // The previous owner might have removed the lock file before releasing
+      // the lock, in which case the lock is on a stale file
+      platform_stat64 info_fd;
+      platform_stat64 info_path;
+      if ((platform_fstat(fd_lock, &info_fd) == 0) &&
+          (platform_stat(lock_path.c_str(), &info_path) == 0) &&
+          (info_fd.st_dev == info_path.st_dev) &&
+          (info_fd.st_ino == info_path.st_ino))
+      {
+        return fd_lock;
+      }
+      close(fd_lock);
+      continue;
+    }
+    const int flock_errno = errno;
+    close(fd_lock);
+    if (flock_errno != EWOULDBLOCK) {
+      LogCvmfs(kLogCache, kLogDebug, "failed to lock %s (%d)",
+               lock_path.c_str(), flock_errno);
+      return -1;
+    }
+
+    if (waited_ms >= download_lock_timeout_ms_) {
+      LogCvmfs(kLogCache, kLogDebug | kLogSyslogWarn,
+               "gave up waiting for concurrent download of %s",
+               id.ToString().c_str());
+      return -1;
+    }
+    LogCvmfs(kLogCache, kLogDebug, "waiting for concurrent download of %s",
+             id.ToString().c_str());
+    SafeSleepMs(backoff_ms);
+    waited_ms += backoff_ms;
+    backoff_ms = std::min(2 * backoff_ms, 100U);
+  }
+}
+
+
 int PosixCacheManager::Open(const shash::Any &id) {
   const string path = GetPathInCache(id);
   int result = open(path.c_str(), O_RDONLY);
@@ -558,12 +628,20 @@ int PosixCacheManager::Reset(void *txn) {
   Transaction *transaction = reinterpret_cast<Transaction *>(txn);
   transaction->buf_pos = 0;
   transaction->size = 0;
+  transaction->file_pos = 0;
+  transaction->writeback_pos = 0;
   int retval = lseek(transaction->fd, 0, SEEK_SET);
   if (retval < 0)
     return -errno;
   retval = ftruncate(transaction->fd, 0);
   if (retval < 0)
     return -errno;
+  // Truncation releases the preallocated space
+  if ((transaction->expected_size != kSizeUnknown) &&
+      (transaction->expected_size > 0))
+  {
+    platform_preallocate(transaction->fd, transaction->expected_size);
+  }
   return 0;
 }
 
@@ -612,6 +690,8 @@ int PosixCacheManager::StartTxn(
            template_path, transaction->fd);
   transaction->tmp_path = template_path;
   transaction->expected_size = size;
+  if ((size != kSizeUnknown) && (size > 0))
+    platform_preallocate(transaction->fd, size);
   return transaction->fd;
 }
 
@@ -632,6 +712,35 @@ void PosixCacheManager::TearDown2ReadOnly() {
 }
 
 
+/**
+ * The lock file is removed while it is still locked.  Processes that wait for
+ * the lock notice the removal and retry with a fresh lock file.
+ */
+void PosixCacheManager::UnlockDownload(const shash::Any &id, const int lock) {
+  if (lock < 0)
+    return;
+  unlink(GetDownloadLockPath(id).c_str());
+  flock(lock, LOCK_UN);
+  close(lock);
+}
+
+
+/**
+ * With drop_written_pages_, the write-back of every completed window of the
+ * file is started right away.  This runs in the download I/O thread, so it
+ * must not wait for the disk.  The pages are dropped on commit.
+ */
+void PosixCacheManager::WriteBehind(Transaction *transaction) {
+  while (transaction->file_pos >=
+         transaction->writeback_pos + kWritebackWindow)
+  {
+    platform_writeback(transaction->fd, transaction->writeback_pos,
+                       kWritebackWindow);
+    transaction->writeback_pos += kWritebackWindow;
+  }
+}
+
+
 int64_t PosixCacheManager::Write(const void *buf, uint64_t size, void *txn) {
   Transaction *transaction = reinterpret_cast<Transaction *>(txn);
 
@@ -640,6 +749,18 @@ int64_t PosixCacheManager::Write(const void *buf, uint64_t size, void *txn) {
       return -ENOSPC;
   }
 
+  // Large writes, e.g. the output of the decompression during downloads, go
+  // directly to the file without the copy into the buffer
+  if (size >= sizeof(transaction->buffer)) {
+    int retval = Flush(transaction);
+    if (retval == 0)
+      retval = WriteToFile(buf, size, transaction);
+    if (retval != 0)
+      return retval;
+    transaction->size += size;
+    return size;
+  }
+
   uint64_t written = 0;
   const unsigned char *read_pos = reinterpret_cast<const unsigned char *>(buf);
   while (written < size) {
@@ -663,4 +784,33 @@ int64_t PosixCacheManager::Write(const void *buf, uint64_t size, void *txn) {
   return written;
 }
 
+
+/**
+ * Writes the complete buffer to the file of the transaction.
+ */
+int PosixCacheManager::WriteToFile(
+  const void *buf,
+  const uint64_t size,
+  Transaction *transaction)
+{
+  const unsigned char *pos = reinterpret_cast<const unsigned char *>(buf);
+  uint64_t remaining = size;
+  while (remaining > 0) {
+    const ssize_t written = write(transaction->fd, pos, remaining);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    if (written == 0)
+      return -EIO;
+    pos += written;
+    remaining -= written;
+    transaction->file_pos += written;
+  }
+  if (drop_written_pages_)
+    WriteBehind(transaction);
+  return 0;
+}
+
 }  // namespace cache
@@ -122,6 +122,16 @@ class CacheManager : SingleCopy {
   virtual int OpenFromTxn(void *txn) = 0;
   virtual int CommitTxn(void *txn) = 0;
 
+  /**
+   * Coordinates the downloads of an object among several processes that share
+   * the cache.  Blocks while another process downloads the same object.  Once
+   * the lock is acquired, the object might have been committed by the other
+   * process.  The default implementation does not coordinate downloads.
+   * @return  a lock handle >= 0 or -1 if the download is not coordinated
+   */
+  virtual int LockDownload(const shash::Any &id) { return -1; }
+  virtual void UnlockDownload(const shash::Any &id, const int lock) { }
+
   int OpenPinned(const shash::Any &id,
                  const std::string &description,
                  bool is_catalog);
@@ -197,16 +207,38 @@ class PosixCacheManager : public CacheManager {
   virtual int AbortTxn(void *txn);
   virtual int CommitTxn(void *txn);
 
+  virtual int LockDownload(const shash::Any &id);
+  virtual void UnlockDownload(const shash::Any &id, const int lock);
+
   void TearDown2ReadOnly();
   CacheModes cache_mode() { return cache_mode_; }
   bool alien_cache() { return alien_cache_; }
   std::string cache_path() { return cache_path_; }
+  std::string GetPathInCache(const shash::Any &id);
+  /**
+   * Processes that share an alien cache download every object only once
+   */
+  void set_cooperative_downloads(const bool value) {
+    cooperative_downloads_ = value;
+  }
+  void set_download_lock_timeout_ms(const unsigned value) {
+    download_lock_timeout_ms_ = value;
+  }
+  /**
+   * Keeps newly written large objects out of the page cache as far as their
+   * write-back is complete when the object is committed
+   */
+  void set_drop_written_pages(const bool value) {
+    drop_written_pages_ = value;
+  }
 
  private:
   struct Transaction {
     Transaction(const shash::Any &id, const std::string &final_path)
       : buf_pos(0)
       , size(0)
+      , file_pos(0)
+      , writeback_pos(0)
       , expected_size(kSizeUnknown)
       , fd(-1)
       , type(kTypeRegular)
@@ -215,9 +247,20 @@ class PosixCacheManager : public CacheManager {
       , id(id)
     { }
 
+    /**
+     * Small writes are collected in the buffer, larger writes bypass it
+     */
     unsigned char buffer[4096];
     unsigned buf_pos;
     uint64_t size;
+    /**
+     * Number of bytes written to the file, excluding the buffer
+     */
+    uint64_t file_pos;
+    /**
+     * Write-back is started for the file up to this offset
+     */
+    uint64_t writeback_pos;
     uint64_t expected_size;
     int fd;
     ObjectType type;
@@ -232,20 +275,39 @@ class PosixCacheManager : public CacheManager {
     , txn_template_path_(cache_path_ + "/txn/fetchXXXXXX")
     , alien_cache_(alien_cache)
     , alien_cache_on_nfs_(false)
+    , cooperative_downloads_(false)
+    , download_lock_timeout_ms_(kDownloadLockTimeoutMs)
+    , drop_written_pages_(false)
     , cache_mode_(kCacheReadWrite)
     , reports_correct_filesize_(true)
   {
     atomic_init32(&no_inflight_txns_);
   }
 
-  std::string GetPathInCache(const shash::Any &id);
+  /**
+   * After this time, a process stops to wait for another process downloading
+   * the same object and downloads the object itself.
+   */
+  static const unsigned kDownloadLockTimeoutMs = 60000;
+  /**
+   * Granularity of the write-back of dropped pages
+   */
+  static const unsigned kWritebackWindow = 4 * 1024 * 1024;
+
+  std::string GetDownloadLockPath(const shash::Any &id);
   int Rename(const char *oldpath, const char *newpath);
   int Flush(Transaction *transaction);
+  int WriteToFile(const void *buf, const uint64_t size,
+                  Transaction *transaction);
+  void WriteBehind(Transaction *transaction);
 
   std::string cache_path_;
   std::string txn_template_path_;
   bool alien_cache_;
   bool alien_cache_on_nfs_;
+  bool cooperative_downloads_;
+  unsigned download_lock_timeout_ms_;
+  bool drop_written_pages_;
   CacheModes cache_mode_;
 
   /**
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <cassert>
 
+#include "catalog_compiled.h"
 #include "catalog_mgr.h"
 #include "logging.h"
 #include "platform.h"
@@ -74,6 +75,7 @@ Catalog::Catalog(const PathString &path,
   sql_all_chunks_ = NULL;
   sql_chunks_listing_ = NULL;
   sql_lookup_xattrs_ = NULL;
+  compiled_ = NULL;
 }
 
 
@@ -81,6 +83,7 @@ Catalog::~Catalog() {
   pthread_mutex_destroy(lock_);
   free(lock_);
   FinalizePreparedStatements();
+  delete compiled_;
   delete database_;
 }
 
@@ -255,6 +258,16 @@ bool Catalog::LookupEntry(const shash::Md5 &md5path, const bool expand_symlink,
   assert(IsInitialized());
 
   pthread_mutex_lock(lock_);
+  if (compiled_ != NULL) {
+    const CompiledCatalog::Record *record = compiled_->Find(md5path);
+    if ((record != NULL) && (dirent != NULL)) {
+      *dirent = compiled_->GetDirent(*record, this, expand_symlink);
+      FixTransitionPoint(md5path, dirent);
+    }
+    pthread_mutex_unlock(lock_);
+    return record != NULL;
+  }
+
   sql_lookup_md5path_->BindPathHash(md5path);
   bool found = sql_lookup_md5path_->FetchRow();
   if (found && (dirent != NULL)) {
@@ -327,6 +340,21 @@ bool Catalog::ListingMd5PathStat(const shash::Md5 &md5path,
   StatEntry entry;
 
   pthread_mutex_lock(lock_);
+  if (compiled_ != NULL) {
+    const uint32_t *begin;
+    const uint32_t *end;
+    compiled_->FindListing(md5path, &begin, &end);
+    for (; begin != end; ++begin) {
+      dirent = compiled_->GetDirent(compiled_->record(*begin), this, true);
+      FixTransitionPoint(md5path, &dirent);
+      entry.name = dirent.name();
+      entry.info = dirent.GetStatStructure();
+      listing->PushBack(entry);
+    }
+    pthread_mutex_unlock(lock_);
+    return true;
+  }
+
   sql_listing_->BindPathHash(md5path);
   while (sql_listing_->FetchRow()) {
     dirent = sql_listing_->GetDirent(this);
@@ -355,6 +383,20 @@ bool Catalog::ListingMd5Path(const shash::Md5 &md5path,
   assert(IsInitialized());
 
   pthread_mutex_lock(lock_);
+  if (compiled_ != NULL) {
+    const uint32_t *begin;
+    const uint32_t *end;
+    compiled_->FindListing(md5path, &begin, &end);
+    for (; begin != end; ++begin) {
+      DirectoryEntry dirent =
+        compiled_->GetDirent(compiled_->record(*begin), this, true);
+      FixTransitionPoint(md5path, &dirent);
+      listing->push_back(dirent);
+    }
+    pthread_mutex_unlock(lock_);
+    return true;
+  }
+
   sql_listing_->BindPathHash(md5path);
   while (sql_listing_->FetchRow()) {
     DirectoryEntry dirent = sql_listing_->GetDirent(this);
@@ -417,6 +459,13 @@ const Catalog::HashVector& Catalog::GetReferencedObjects() const {
     referenced_hashes_.push_back(list_content_hashes.GetHash());
   }
 
+  // The catalog delta shares the digest of the catalog
+  if (!GetDeltaBase().IsNull()) {
+    shash::Any delta_hash(catalog_hash_);
+    delta_hash.suffix = shash::kSuffixDelta;
+    referenced_hashes_.push_back(delta_hash);
+  }
+
   return referenced_hashes_;
 }
 
@@ -482,6 +531,36 @@ shash::Any Catalog::GetPreviousRevision() const {
 }
 
 
+/**
+ * Non-null if there is a catalog delta object for this catalog, see
+ * CatalogDelta.
+ */
+shash::Any Catalog::GetDeltaBase() const {
+  pthread_mutex_lock(lock_);
+  const std::string hash_string =
+    database().GetPropertyDefault<std::string>("delta_base", "");
+  pthread_mutex_unlock(lock_);
+  return (!hash_string.empty())
+    ? shash::MkFromHexPtr(shash::HexPtr(hash_string), shash::kSuffixCatalog)
+    : shash::Any();
+}
+
+
+/**
+ * The delta reference of a nested catalog, see CatalogDelta.  Empty if the
+ * nested catalog has no catalog delta.
+ */
+std::string Catalog::GetNestedDeltaReference(
+  const PathString &mountpoint) const
+{
+  pthread_mutex_lock(lock_);
+  const std::string reference = database().GetPropertyDefault<std::string>(
+    "nested_delta:" + mountpoint.ToString(), "");
+  pthread_mutex_unlock(lock_);
+  return reference;
+}
+
+
 /**
  * Determine the actual inode of a DirectoryEntry.
  * The first used entry from a hardlink group deterimines the inode of the
@@ -612,6 +691,28 @@ void Catalog::SetOwnerMaps(const OwnerMap *uid_map, const OwnerMap *gid_map) {
 }
 
 
+/**
+ * Writes the read-optimized copy of the directory entries to sink, see
+ * CompiledCatalog.
+ */
+bool Catalog::Compile(cvmfs::Sink *sink) const {
+  assert(IsInitialized());
+  return CompiledCatalog::Compile(database(), sink);
+}
+
+
+/**
+ * From now on, lookups and listings are served by compiled instead of the
+ * sqlite database.  Takes ownership of compiled.
+ */
+void Catalog::AttachCompiled(CompiledCatalog *compiled) {
+  pthread_mutex_lock(lock_);
+  delete compiled_;
+  compiled_ = compiled;
+  pthread_mutex_unlock(lock_);
+}
+
+
 /**
  * Add a Catalog as child to this Catalog.
  * @param child the Catalog to define as child
@@ -23,6 +23,10 @@
 #include "util.h"
 #include "xattr.h"
 
+namespace cvmfs {
+class Sink;
+}
+
 namespace swissknife {
 class CommandMigrate;
 }
@@ -31,6 +35,7 @@ namespace catalog {
 
 class AbstractCatalogManager;
 class Catalog;
+class CompiledCatalog;
 
 class Counters;
 
@@ -88,6 +93,7 @@ class InodeAnnotation {
 class Catalog : public SingleCopy {
   friend class AbstractCatalogManager;
   friend class SqlLookup;                   // for mangled inode and uid maps
+  friend class CompiledCatalog;             // for mangled inode and uid maps
   friend class swissknife::CommandMigrate;  // for catalog version migration
 
  public:
@@ -171,6 +177,8 @@ class Catalog : public SingleCopy {
   uint64_t GetLastModified() const;
   uint64_t GetNumEntries() const;
   shash::Any GetPreviousRevision() const;
+  shash::Any GetDeltaBase() const;
+  std::string GetNestedDeltaReference(const PathString &mountpoint) const;
   const Counters& GetCounters() const { return counters_; }
 
   inline float schema() const { return database().schema_version(); }
@@ -205,6 +213,10 @@ class Catalog : public SingleCopy {
   void SetInodeAnnotation(InodeAnnotation *new_annotation);
   void SetOwnerMaps(const OwnerMap *uid_map, const OwnerMap *gid_map);
 
+  bool Compile(cvmfs::Sink *sink) const;
+  void AttachCompiled(CompiledCatalog *compiled);
+  inline bool HasCompiled() const { return compiled_ != NULL; }
+
  protected:
   typedef std::map<uint64_t, inode_t> HardlinkGroupMap;
   mutable HardlinkGroupMap hardlink_groups_;
@@ -281,6 +293,11 @@ class Catalog : public SingleCopy {
   SqlAllChunks             *sql_all_chunks_;
   SqlChunksListing         *sql_chunks_listing_;
   SqlLookupXattrs          *sql_lookup_xattrs_;
+  /**
+   * Optional read-optimized copy of the directory entries, replaces the sqlite
+   * lookup and listing statements
+   */
+  CompiledCatalog          *compiled_;
 
   mutable HashVector        referenced_hashes_;
 };  // class Catalog
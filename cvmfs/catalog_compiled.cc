@@ -0,0 +1,382 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "catalog_compiled.h"
+
+#include <alloca.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catalog.h"
+#include "catalog_sql.h"
+#include "globals.h"
+#include "logging.h"
+#include "platform.h"
+#include "sink.h"
+
+using namespace std;  // NOLINT
+
+namespace catalog {
+
+namespace {
+
+typedef CompiledCatalog::Record Record;
+
+bool Md5Less(const unsigned char *a, const unsigned char *b) {
+  return memcmp(a, b, sizeof(Record().md5path)) < 0;
+}
+
+struct RecordLess {
+  bool operator() (const Record &a, const Record &b) const {
+    return Md5Less(a.md5path, b.md5path);
+  }
+  bool operator() (const Record &a, const unsigned char *md5path) const {
+    return Md5Less(a.md5path, md5path);
+  }
+};
+
+/**
+ * Orders record indexes by parent md5path and row id
+ */
+struct ListingLess {
+  explicit ListingLess(const Record *records) : records(records) { }
+  bool operator() (const uint32_t a, const uint32_t b) const {
+    const int cmp = memcmp(records[a].parent_md5path, records[b].parent_md5path,
+                           sizeof(Record().parent_md5path));
+    if (cmp != 0)
+      return cmp < 0;
+    return records[a].row_id < records[b].row_id;
+  }
+  bool operator() (const uint32_t a, const unsigned char *md5path) const {
+    return Md5Less(records[a].parent_md5path, md5path);
+  }
+  bool operator() (const unsigned char *md5path, const uint32_t b) const {
+    return Md5Less(md5path, records[b].parent_md5path);
+  }
+  const Record *records;
+};
+
+bool WriteAll(const void *buf, const uint64_t size, cvmfs::Sink *sink) {
+  return (size == 0) || (sink->Write(buf, size) == static_cast<int64_t>(size));
+}
+
+/**
+ * The hash context takes at most 4GB at once
+ */
+void UpdateChecksum(const void *buf, uint64_t size, shash::ContextPtr context) {
+  const unsigned kMaxChunk = 1U << 30;
+  const unsigned char *pos = static_cast<const unsigned char *>(buf);
+  while (size > 0) {
+    const unsigned nbytes = (size > kMaxChunk) ? kMaxChunk : size;
+    shash::Update(pos, nbytes, context);
+    pos += nbytes;
+    size -= nbytes;
+  }
+}
+
+}  // anonymous namespace
+
+
+/**
+ * Reads all directory entries from the sqlite catalog and writes the compiled
+ * catalog to sink.  Catalogs with a schema older than 2.1 are not compiled
+ * because their owner and hardlink information depends on the client.
+ */
+bool CompiledCatalog::Compile(
+  const CatalogDatabase &database,
+  cvmfs::Sink *sink)
+{
+  if (database.schema_version() < 2.1 - CatalogDatabase::kSchemaEpsilon) {
+    LogCvmfs(kLogCatalog, kLogDebug, "cannot compile catalog schema %f",
+             database.schema_version());
+    return false;
+  }
+
+  vector<Record> records;
+  string strings;
+  SqlAllDirents sql_all_dirents(database);
+  while (sql_all_dirents.FetchRow()) {
+    const DirectoryEntry dirent = sql_all_dirents.GetRawDirent();
+    const NameString name = dirent.name();
+    const LinkString symlink = dirent.symlink();
+    if ((strings.length() + name.GetLength() + symlink.GetLength() >
+         static_cast<uint32_t>(-1)) ||
+        (name.GetLength() > static_cast<uint16_t>(-1)) ||
+        (symlink.GetLength() > static_cast<uint16_t>(-1)))
+    {
+      LogCvmfs(kLogCatalog, kLogDebug, "catalog too large to be compiled");
+      return false;
+    }
+
+    Record record;
+    memset(&record, 0, sizeof(record));
+    const shash::Md5 md5path = sql_all_dirents.GetPathHash();
+    const shash::Md5 parent_md5path = sql_all_dirents.GetParentPathHash();
+    memcpy(record.md5path, md5path.digest, sizeof(record.md5path));
+    memcpy(record.parent_md5path, parent_md5path.digest,
+           sizeof(record.parent_md5path));
+    const shash::Any checksum = dirent.checksum();
+    memcpy(record.digest, checksum.digest, sizeof(record.digest));
+    record.hash_algorithm = checksum.algorithm;
+    record.row_id = sql_all_dirents.GetRowId();
+    record.size = dirent.size();
+    record.mtime = dirent.mtime();
+    record.linkcount = dirent.linkcount();
+    record.hardlink_group = dirent.hardlink_group();
+    record.mode = dirent.mode();
+    record.uid = dirent.uid();
+    record.gid = dirent.gid();
+    record.name_offset = strings.length();
+    record.name_length = name.GetLength();
+    strings.append(name.GetChars(), name.GetLength());
+    record.symlink_offset = strings.length();
+    record.symlink_length = symlink.GetLength();
+    strings.append(symlink.GetChars(), symlink.GetLength());
+    if (dirent.IsNestedCatalogRoot())
+      record.flags |= kFlagNestedRoot;
+    if (dirent.IsNestedCatalogMountpoint())
+      record.flags |= kFlagNestedMountpoint;
+    if (dirent.IsChunkedFile())
+      record.flags |= kFlagChunked;
+    if (dirent.HasXattrs())
+      record.flags |= kFlagXattrs;
+    records.push_back(record);
+  }
+  sort(records.begin(), records.end(), RecordLess());
+
+  vector<uint32_t> listing(records.size());
+  for (unsigned i = 0; i < listing.size(); ++i)
+    listing[i] = i;
+  if (!records.empty())
+    sort(listing.begin(), listing.end(), ListingLess(&records[0]));
+
+  shash::ContextPtr context(shash::kMd5);
+  context.buffer = alloca(context.size);
+  shash::Init(context);
+  UpdateChecksum(records.empty() ? NULL : &records[0],
+                 records.size() * sizeof(Record), context);
+  UpdateChecksum(listing.empty() ? NULL : &listing[0],
+                 listing.size() * sizeof(uint32_t), context);
+  UpdateChecksum(strings.data(), strings.length(), context);
+  shash::Any checksum(shash::kMd5);
+  shash::Final(context, &checksum);
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.record_size = sizeof(Record);
+  header.num_entries = records.size();
+  header.strings_size = strings.length();
+  memcpy(header.checksum, checksum.digest, sizeof(header.checksum));
+  return WriteAll(&header, sizeof(header), sink) &&
+    WriteAll(records.empty() ? NULL : &records[0],
+             records.size() * sizeof(Record), sink) &&
+    WriteAll(listing.empty() ? NULL : &listing[0],
+             listing.size() * sizeof(uint32_t), sink) &&
+    WriteAll(strings.data(), strings.length(), sink);
+}
+
+
+/**
+ * Maps a compiled catalog into memory.  The file descriptor can be closed
+ * afterwards.  The bounds of all records are checked in any case; the checksum
+ * over the entire file can be skipped for files verified before.
+ * @return  NULL if the file cannot be mapped or is not a valid compiled catalog
+ */
+CompiledCatalog *CompiledCatalog::Map(const int fd,
+                                      const bool verify_checksum)
+{
+  platform_stat64 info;
+  if ((platform_fstat(fd, &info) != 0) ||
+      (static_cast<uint64_t>(info.st_size) < sizeof(Header)))
+  {
+    return NULL;
+  }
+  void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    LogCvmfs(kLogCatalog, kLogDebug, "failed to map compiled catalog (%d)",
+             errno);
+    return NULL;
+  }
+
+  CompiledCatalog *compiled = new CompiledCatalog(mapping, info.st_size);
+  if (!compiled->Validate(verify_checksum)) {
+    LogCvmfs(kLogCatalog, kLogDebug, "invalid compiled catalog");
+    delete compiled;
+    return NULL;
+  }
+  return compiled;
+}
+
+
+CompiledCatalog::CompiledCatalog(void *mapping, const uint64_t size)
+  : mapping_(mapping)
+  , size_(size)
+  , num_entries_(0)
+  , records_(NULL)
+  , listing_(NULL)
+  , strings_(NULL)
+{ }
+
+
+CompiledCatalog::~CompiledCatalog() {
+  munmap(mapping_, size_);
+}
+
+
+/**
+ * Checks the header, the checksum, and all offsets, so that a corrupted file
+ * is not served and lookups cannot read beyond the mapped file.
+ */
+bool CompiledCatalog::Validate(const bool verify_checksum) {
+  const Header *header = static_cast<const Header *>(mapping_);
+  if ((header->magic != kMagic) || (header->version != kVersion) ||
+      (header->record_size != sizeof(Record)))
+  {
+    return false;
+  }
+  const uint64_t expected_size = sizeof(Header) +
+    uint64_t(header->num_entries) * (sizeof(Record) + sizeof(uint32_t)) +
+    header->strings_size;
+  if (expected_size != size_)
+    return false;
+
+  if (verify_checksum) {
+    shash::ContextPtr context(shash::kMd5);
+    context.buffer = alloca(context.size);
+    shash::Init(context);
+    UpdateChecksum(static_cast<const char *>(mapping_) + sizeof(Header),
+                   size_ - sizeof(Header), context);
+    shash::Any checksum(shash::kMd5);
+    shash::Final(context, &checksum);
+    if (memcmp(header->checksum, checksum.digest, sizeof(header->checksum)))
+      return false;
+  }
+
+  num_entries_ = header->num_entries;
+  const char *pos = static_cast<const char *>(mapping_) + sizeof(Header);
+  records_ = reinterpret_cast<const Record *>(pos);
+  pos += num_entries_ * sizeof(Record);
+  listing_ = reinterpret_cast<const uint32_t *>(pos);
+  pos += num_entries_ * sizeof(uint32_t);
+  strings_ = pos;
+
+  for (uint32_t i = 0; i < num_entries_; ++i) {
+    const Record &record = records_[i];
+    if ((record.hash_algorithm >= shash::kAny) ||
+        (uint64_t(record.name_offset) + record.name_length >
+         header->strings_size) ||
+        (uint64_t(record.symlink_offset) + record.symlink_length >
+         header->strings_size) ||
+        (listing_[i] >= num_entries_))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/**
+ * Binary search in the records sorted by md5path.
+ * @return  NULL if there is no entry for md5path
+ */
+const Record *CompiledCatalog::Find(const shash::Md5 &md5path) const {
+  const Record *end = records_ + num_entries_;
+  const Record *record =
+    lower_bound(records_, end, md5path.digest, RecordLess());
+  if ((record == end) ||
+      (memcmp(record->md5path, md5path.digest, sizeof(record->md5path)) != 0))
+  {
+    return NULL;
+  }
+  return record;
+}
+
+
+/**
+ * Sets [begin, end) to the indexes of the records whose parent is md5path.
+ */
+void CompiledCatalog::FindListing(
+  const shash::Md5 &md5path,
+  const uint32_t **begin,
+  const uint32_t **end) const
+{
+  pair<const uint32_t *, const uint32_t *> range =
+    equal_range(listing_, listing_ + num_entries_, md5path.digest,
+                ListingLess(records_));
+  *begin = range.first;
+  *end = range.second;
+}
+
+
+/**
+ * Analogous to SqlLookup::GetDirent().  This method is a friend of
+ * DirectoryEntry and of Catalog.
+ */
+DirectoryEntry CompiledCatalog::GetDirent(
+  const Record &record,
+  const Catalog *catalog,
+  const bool expand_symlink) const
+{
+  DirectoryEntry result;
+
+  result.is_nested_catalog_root_ = (record.flags & kFlagNestedRoot);
+  result.is_nested_catalog_mountpoint_ =
+    (record.flags & kFlagNestedMountpoint);
+
+  // Must be set later by a second catalog lookup
+  result.parent_inode_ = DirectoryEntry::kInvalidInode;
+
+  result.linkcount_       = record.linkcount;
+  result.hardlink_group_  = record.hardlink_group;
+  result.inode_           = catalog->GetMangledInode(record.row_id,
+                                                     record.hardlink_group);
+  result.is_chunked_file_ = (record.flags & kFlagChunked);
+  result.has_xattrs_      = (record.flags & kFlagXattrs);
+  const shash::Algorithms algorithm =
+    static_cast<shash::Algorithms>(record.hash_algorithm);
+  result.checksum_ =
+    shash::Any(algorithm, record.digest, shash::kDigestSizes[algorithm]);
+
+  if (g_claim_ownership) {
+    result.uid_ = g_uid;
+    result.gid_ = g_gid;
+  } else {
+    result.uid_ = record.uid;
+    result.gid_ = record.gid;
+    if (catalog->uid_map_) {
+      OwnerMap::const_iterator i = catalog->uid_map_->find(result.uid_);
+      if (i != catalog->uid_map_->end())
+        result.uid_ = i->second;
+    }
+    if (catalog->gid_map_) {
+      OwnerMap::const_iterator i = catalog->gid_map_->find(result.gid_);
+      if (i != catalog->gid_map_->end())
+        result.gid_ = i->second;
+    }
+  }
+
+  result.mode_  = record.mode;
+  result.size_  = record.size;
+  result.mtime_ = record.mtime;
+  result.name_.Assign(strings_ + record.name_offset, record.name_length);
+  result.symlink_.Assign(strings_ + record.symlink_offset,
+                         record.symlink_length);
+  if (expand_symlink)
+    SqlDirent::ExpandSymlink(&result.symlink_);
+
+  return result;
+}
+
+}  // namespace catalog
@@ -0,0 +1,115 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_CATALOG_COMPILED_H_
+#define CVMFS_CATALOG_COMPILED_H_
+
+#include <inttypes.h>
+
+#include "directory_entry.h"
+#include "hash.h"
+#include "util.h"
+
+namespace cvmfs {
+class Sink;
+}
+
+namespace catalog {
+
+class Catalog;
+class CatalogDatabase;
+
+/**
+ * A read-optimized, immutable copy of the directory entries of a catalog.
+ * Client catalogs are never modified, so that lookups and listings do not need
+ * to go through sqlite.  The compiled catalog is a single memory mapped file:
+ *
+ *   Header | Record[num_entries] | uint32_t[num_entries] | string table
+ *
+ * The fixed-width records are sorted by md5path so that a lookup is a binary
+ * search.  The second array contains record indexes sorted by parent md5path
+ * and row id, which makes a directory listing a contiguous range.  Names and
+ * symlinks are stored in the string table.  The header contains an MD5
+ * checksum of the rest of the file that is verified when the file is mapped,
+ * unless the caller already verified this very file before.
+ *
+ * Nested catalog lists, chunks, and extended attributes are still taken from
+ * the sqlite catalog.  The compiled catalog does not contain inodes.  Like the
+ * sqlite rows, records are turned into directory entries in the context of
+ * the owning catalog.
+ */
+class CompiledCatalog : SingleCopy {
+ public:
+  static const uint32_t kVersion = 2;
+
+  struct Record {
+    unsigned char md5path[16];
+    unsigned char parent_md5path[16];
+    unsigned char digest[shash::kMaxDigestSize];
+    uint64_t row_id;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t linkcount;
+    uint32_t hardlink_group;
+    uint32_t mode;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t name_offset;
+    uint32_t symlink_offset;
+    uint16_t name_length;
+    uint16_t symlink_length;
+    uint8_t hash_algorithm;
+    uint8_t flags;
+    uint8_t padding[6];
+  };
+
+  static bool Compile(const CatalogDatabase &database, cvmfs::Sink *sink);
+  static CompiledCatalog *Map(const int fd, const bool verify_checksum = true);
+  ~CompiledCatalog();
+
+  const Record *Find(const shash::Md5 &md5path) const;
+  void FindListing(const shash::Md5 &md5path,
+                   const uint32_t **begin, const uint32_t **end) const;
+  DirectoryEntry GetDirent(const Record &record,
+                           const Catalog *catalog,
+                           const bool expand_symlink) const;
+
+  const Record &record(const uint32_t index) const { return records_[index]; }
+  uint32_t num_entries() const { return num_entries_; }
+  uint64_t size() const { return size_; }
+
+ private:
+  static const uint32_t kMagic = 0x4d435643;  // "CVCM"
+
+  static const uint8_t kFlagNestedRoot = 1;
+  static const uint8_t kFlagNestedMountpoint = 2;
+  static const uint8_t kFlagChunked = 4;
+  static const uint8_t kFlagXattrs = 8;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t num_entries;
+    uint64_t strings_size;
+    unsigned char checksum[16];  ///< MD5 of everything after the header
+  };
+
+  CompiledCatalog(void *mapping, const uint64_t size);
+  bool Validate(const bool verify_checksum);
+
+  void *mapping_;
+  uint64_t size_;
+  uint32_t num_entries_;
+  const Record *records_;
+  /**
+   * Record indexes sorted by parent md5path
+   */
+  const uint32_t *listing_;
+  const char *strings_;
+};
+
+}  // namespace catalog
+
+#endif  // CVMFS_CATALOG_COMPILED_H_
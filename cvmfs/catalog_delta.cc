@@ -0,0 +1,297 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "catalog_delta.h"
+
+#include <alloca.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "logging.h"
+#include "sink.h"
+
+using namespace std;  // NOLINT
+
+namespace catalog {
+
+namespace {
+
+/**
+ * Reads up to kBlockSize bytes and pads the remainder of the block with zeros.
+ * @return  the number of bytes read or -1 on I/O error
+ */
+int64_t ReadBlock(FILE *f, unsigned char *block) {
+  const size_t nbytes = fread(block, 1, CatalogDelta::kBlockSize, f);
+  if ((nbytes < CatalogDelta::kBlockSize) && ferror(f))
+    return -1;
+  memset(block + nbytes, 0, CatalogDelta::kBlockSize - nbytes);
+  return nbytes;
+}
+
+}  // anonymous namespace
+
+
+CatalogDelta::CatalogDelta()
+  : base_size_(0)
+  , target_size_(0)
+{ }
+
+
+/**
+ * Compares the catalog files block by block.  Blocks beyond the end of the
+ * base revision are always stored in the delta.
+ *
+ * @return  NULL if one of the files cannot be read
+ */
+CatalogDelta *CatalogDelta::Create(
+  const string &base_path,
+  const shash::Any &base_hash,
+  const string &target_path)
+{
+  assert(!base_hash.IsNull());
+  FILE *fbase = fopen(base_path.c_str(), "r");
+  if (fbase == NULL)
+    return NULL;
+  FILE *ftarget = fopen(target_path.c_str(), "r");
+  if (ftarget == NULL) {
+    fclose(fbase);
+    return NULL;
+  }
+
+  CatalogDelta *delta = new CatalogDelta();
+  delta->base_hash_ = base_hash;
+  unsigned char base_block[kBlockSize];
+  unsigned char target_block[kBlockSize];
+  bool base_eof = false;
+  for (uint32_t i = 0; ; ++i) {
+    const int64_t target_bytes = ReadBlock(ftarget, target_block);
+    int64_t base_bytes = 0;
+    if (!base_eof) {
+      base_bytes = ReadBlock(fbase, base_block);
+      base_eof = (base_bytes < static_cast<int64_t>(kBlockSize));
+    }
+    if ((target_bytes < 0) || (base_bytes < 0)) {
+      LogCvmfs(kLogCatalog, kLogStderr, "failed to read %s or %s",
+               base_path.c_str(), target_path.c_str());
+      fclose(fbase);
+      fclose(ftarget);
+      delete delta;
+      return NULL;
+    }
+    delta->base_size_ += base_bytes;
+    if (target_bytes == 0)
+      break;
+    delta->target_size_ += target_bytes;
+
+    if ((base_bytes == 0) || (memcmp(base_block, target_block, kBlockSize)))
+    {
+      delta->blocks_.push_back(i);
+      delta->data_.insert(delta->data_.end(),
+                          target_block, target_block + kBlockSize);
+    }
+    if (target_bytes < static_cast<int64_t>(kBlockSize))
+      break;
+  }
+
+  // Size of the rest of the base revision
+  while (!base_eof) {
+    const int64_t base_bytes = ReadBlock(fbase, base_block);
+    if (base_bytes < 0) {
+      fclose(fbase);
+      fclose(ftarget);
+      delete delta;
+      return NULL;
+    }
+    delta->base_size_ += base_bytes;
+    base_eof = (base_bytes < static_cast<int64_t>(kBlockSize));
+  }
+
+  fclose(fbase);
+  fclose(ftarget);
+  return delta;
+}
+
+
+CatalogDelta *CatalogDelta::CreatePlaceholder(const uint64_t target_size) {
+  CatalogDelta *delta = new CatalogDelta();
+  delta->target_size_ = target_size;
+  return delta;
+}
+
+
+/**
+ * @return  NULL if the buffer is not a valid delta
+ */
+CatalogDelta *CatalogDelta::Parse(
+  const unsigned char *buffer,
+  const uint64_t size)
+{
+  Header header;
+  if (size < sizeof(header))
+    return NULL;
+  memcpy(&header, buffer, sizeof(header));
+  if ((header.magic != kMagic) || (header.version != kVersion) ||
+      (header.block_size != kBlockSize) ||
+      (header.base_hash[kMaxHashStrSize - 1] != '\0'))
+  {
+    LogCvmfs(kLogCatalog, kLogDebug, "invalid catalog delta header");
+    return NULL;
+  }
+  const uint64_t expected_size = sizeof(header) +
+    uint64_t(header.num_blocks) * (sizeof(uint32_t) + kBlockSize);
+  if (size != expected_size) {
+    LogCvmfs(kLogCatalog, kLogDebug, "truncated catalog delta");
+    return NULL;
+  }
+
+  CatalogDelta *delta = new CatalogDelta();
+  const string hash_str(header.base_hash);
+  if (!hash_str.empty()) {
+    if (!shash::HexPtr(hash_str).IsValid()) {
+      delete delta;
+      return NULL;
+    }
+    delta->base_hash_ =
+      shash::MkFromHexPtr(shash::HexPtr(hash_str), shash::kSuffixCatalog);
+  }
+  delta->base_size_ = header.base_size;
+  delta->target_size_ = header.target_size;
+
+  const uint64_t num_target_blocks =
+    (header.target_size + kBlockSize - 1) / kBlockSize;
+  const unsigned char *pos = buffer + sizeof(header);
+  delta->blocks_.resize(header.num_blocks);
+  if (header.num_blocks > 0) {
+    memcpy(&delta->blocks_[0], pos, header.num_blocks * sizeof(uint32_t));
+    pos += header.num_blocks * sizeof(uint32_t);
+  }
+  for (unsigned i = 0; i < header.num_blocks; ++i) {
+    if ((delta->blocks_[i] >= num_target_blocks) ||
+        ((i > 0) && (delta->blocks_[i] <= delta->blocks_[i - 1])))
+    {
+      LogCvmfs(kLogCatalog, kLogDebug, "invalid block list in catalog delta");
+      delete delta;
+      return NULL;
+    }
+  }
+  delta->data_.assign(pos, buffer + size);
+  return delta;
+}
+
+
+/**
+ * Stores the uncompressed delta.
+ */
+bool CatalogDelta::Save(const string &path) const {
+  FILE *f = fopen(path.c_str(), "w");
+  if (f == NULL)
+    return false;
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.block_size = kBlockSize;
+  header.num_blocks = blocks_.size();
+  header.base_size = base_size_;
+  header.target_size = target_size_;
+  if (!base_hash_.IsNull()) {
+    const string hash_str = base_hash_.ToString();
+    assert(hash_str.length() < kMaxHashStrSize);
+    memcpy(header.base_hash, hash_str.data(), hash_str.length());
+  }
+  bool retval = (fwrite(&header, sizeof(header), 1, f) == 1);
+  if (retval && !blocks_.empty()) {
+    retval =
+      (fwrite(&blocks_[0], sizeof(uint32_t), blocks_.size(), f) ==
+       blocks_.size()) &&
+      (fwrite(&data_[0], 1, data_.size(), f) == data_.size());
+  }
+  retval = (fclose(f) == 0) && retval;
+  if (!retval)
+    unlink(path.c_str());
+  return retval;
+}
+
+
+/**
+ * Reconstructs the target revision from the base revision and writes it
+ * uncompressed to target.  On the fly, the uncompressed target revision is
+ * hashed into content_hash, which the caller verifies against the content
+ * hash of the delta reference.  The algorithm of content_hash has to be set.
+ */
+bool CatalogDelta::Apply(
+  BaseReader *base,
+  cvmfs::Sink *target,
+  shash::Any *content_hash) const
+{
+  assert(!IsPlaceholder());
+
+  shash::ContextPtr hash_context(content_hash->algorithm);
+  hash_context.buffer = alloca(hash_context.size);
+  shash::Init(hash_context);
+
+  unsigned char block[kBlockSize];
+  const uint64_t num_target_blocks = (target_size_ + kBlockSize - 1) /
+                                     kBlockSize;
+  unsigned next_literal = 0;
+  for (uint64_t i = 0; i < num_target_blocks; ++i) {
+    const unsigned char *data = block;
+    if ((next_literal < blocks_.size()) && (blocks_[next_literal] == i)) {
+      data = &data_[next_literal * kBlockSize];
+      next_literal++;
+    } else {
+      const int64_t nbytes = base->Pread(block, kBlockSize, i * kBlockSize);
+      if (nbytes < 0)
+        return false;
+      memset(block + nbytes, 0, kBlockSize - nbytes);
+    }
+
+    const uint64_t size = (i == num_target_blocks - 1)
+                          ? target_size_ - i * kBlockSize : kBlockSize;
+    if (target->Write(data, size) != static_cast<int64_t>(size))
+      return false;
+    shash::Update(data, size, hash_context);
+  }
+
+  shash::Final(hash_context, content_hash);
+  return true;
+}
+
+
+string CatalogDelta::MakeReference(
+  const shash::Any &base_hash,
+  const shash::Any &content_hash)
+{
+  return base_hash.ToString() + ":" + content_hash.ToString();
+}
+
+
+bool CatalogDelta::ParseReference(
+  const string &reference,
+  shash::Any *base_hash,
+  shash::Any *content_hash)
+{
+  const size_t separator = reference.find(':');
+  if (separator == string::npos)
+    return false;
+  const string base_str = reference.substr(0, separator);
+  const string content_str = reference.substr(separator + 1);
+  if (!shash::HexPtr(base_str).IsValid() ||
+      !shash::HexPtr(content_str).IsValid())
+  {
+    return false;
+  }
+  *base_hash =
+    shash::MkFromHexPtr(shash::HexPtr(base_str), shash::kSuffixCatalog);
+  *content_hash = shash::MkFromHexPtr(shash::HexPtr(content_str));
+  return !base_hash->IsNull() && !content_hash->IsNull();
+}
+
+}  // namespace catalog
@@ -0,0 +1,124 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_CATALOG_DELTA_H_
+#define CVMFS_CATALOG_DELTA_H_
+
+#include <inttypes.h>
+
+#include <string>
+#include <vector>
+
+#include "hash.h"
+#include "util.h"
+
+namespace cvmfs {
+class Sink;
+}
+
+namespace catalog {
+
+/**
+ * A catalog delta describes a catalog revision by the blocks of its
+ * (uncompressed) sqlite file that differ from a previous revision of the same
+ * catalog.  The block size matches the sqlite page size, so that a small change
+ * to a large catalog results in a small delta.
+ *
+ * The publisher stores the compressed delta next to the new catalog as
+ * data/<catalog hash>D and marks the new catalog with the "delta_base"
+ * property, so that the delta is garbage collected together with the catalog.
+ * Clients that have the base revision in their cache reconstruct the new
+ * revision from the delta.  The delta itself is not content-addressed.
+ * Instead, the reconstructed (uncompressed) catalog is verified against a
+ * content hash taken from a trusted delta reference: the "nested_delta:<path>"
+ * property of the parent catalog or, for the root catalog, the manifest.  The
+ * compressed catalog hash can't be used because it depends on the zlib version
+ * of the publisher.
+ *
+ * A delta with a null base hash is a placeholder for a catalog whose changes
+ * are too large to be worth a delta.
+ */
+class CatalogDelta : SingleCopy {
+ public:
+  static const unsigned kBlockSize = 4096;
+
+  /**
+   * Random access to the base revision, e.g. in the client cache
+   */
+  class BaseReader {
+   public:
+    virtual ~BaseReader() { }
+    virtual int64_t Pread(void *buf, uint64_t size, uint64_t offset) = 0;
+  };
+
+  static CatalogDelta *Create(const std::string &base_path,
+                              const shash::Any &base_hash,
+                              const std::string &target_path);
+  static CatalogDelta *CreatePlaceholder(const uint64_t target_size);
+  static CatalogDelta *Parse(const unsigned char *buffer, const uint64_t size);
+  bool Save(const std::string &path) const;
+
+  /**
+   * Writes the target revision to the sink and hashes the uncompressed
+   * target revision into content_hash, whose algorithm must be preset.
+   */
+  bool Apply(BaseReader *base, cvmfs::Sink *target,
+             shash::Any *content_hash) const;
+
+  /**
+   * A delta reference names the base revision and the content hash of the
+   * uncompressed target revision.  It is stored as "<base hash>:<content>".
+   */
+  static std::string MakeReference(const shash::Any &base_hash,
+                                   const shash::Any &content_hash);
+  static bool ParseReference(const std::string &reference,
+                             shash::Any *base_hash,
+                             shash::Any *content_hash);
+
+  bool IsPlaceholder() const { return base_hash_.IsNull(); }
+  shash::Any base_hash() const { return base_hash_; }
+  uint64_t base_size() const { return base_size_; }
+  uint64_t target_size() const { return target_size_; }
+  unsigned num_blocks() const { return blocks_.size(); }
+  /**
+   * Size of the serialized, uncompressed delta
+   */
+  uint64_t size() const {
+    return sizeof(Header) + blocks_.size() * (sizeof(uint32_t) + kBlockSize);
+  }
+
+ private:
+  static const uint32_t kMagic = 0x4c445643;  // "CVDL"
+  static const uint32_t kVersion = 1;
+  static const unsigned kMaxHashStrSize = 96;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t num_blocks;
+    uint64_t base_size;
+    uint64_t target_size;
+    char base_hash[kMaxHashStrSize];  ///< Null-terminated, empty if none
+  };
+
+  CatalogDelta();
+
+  shash::Any base_hash_;
+  uint64_t base_size_;
+  uint64_t target_size_;
+  /**
+   * Sorted indexes of the blocks that are not taken from the base revision
+   */
+  std::vector<uint32_t> blocks_;
+  /**
+   * Contents of the changed blocks, kBlockSize bytes each, the last block of
+   * the target revision is padded with zeros
+   */
+  std::vector<unsigned char> data_;
+};
+
+}  // namespace catalog
+
+#endif  // CVMFS_CATALOG_DELTA_H_
@@ -10,6 +10,7 @@
 #include <inttypes.h>
 
 #include <cassert>
+#include <vector>
 
 #include "logging.h"
 #include "shortstring.h"
@@ -172,6 +173,16 @@ void AbstractCatalogManager::DetachNested() {
 bool AbstractCatalogManager::LookupPath(const PathString &path,
                                         const LookupOptions options,
                                         DirectoryEntry *dirent)
+{
+  return LookupPath(path, shash::Md5(path.GetChars(), path.GetLength()),
+                    options, dirent);
+}
+
+
+bool AbstractCatalogManager::LookupPath(const PathString &path,
+                                        const shash::Md5 &md5path,
+                                        const LookupOptions options,
+                                        DirectoryEntry *dirent)
 {
   // initialize as non-negative
   assert(dirent);
@@ -190,7 +201,7 @@ bool AbstractCatalogManager::LookupPath(const PathString &path,
   perf::Inc(statistics_.n_lookup_path);
   LogCvmfs(kLogCatalog, kLogDebug, "looking up '%s' in catalog: '%s'",
            path.c_str(), best_fit->path().c_str());
-  bool found = best_fit->LookupPath(path, dirent);
+  bool found = best_fit->LookupMd5Path(md5path, dirent);
 
   // Possibly in a nested catalog
   if (!found && MountSubtree(path, best_fit, NULL)) {
@@ -202,7 +213,7 @@ bool AbstractCatalogManager::LookupPath(const PathString &path,
     best_fit = FindCatalog(path);
     assert(best_fit != NULL);
     perf::Inc(statistics_.n_lookup_path);
-    found = best_fit->LookupPath(path, dirent);
+    found = best_fit->LookupMd5Path(md5path, dirent);
 
     if (!found) {
       LogCvmfs(kLogCatalog, kLogDebug,
@@ -220,7 +231,7 @@ bool AbstractCatalogManager::LookupPath(const PathString &path,
 
       if (nested_catalog != best_fit) {
         perf::Inc(statistics_.n_lookup_path);
-        found = nested_catalog->LookupPath(path, dirent);
+        found = nested_catalog->LookupMd5Path(md5path, dirent);
         if (!found) {
           LogCvmfs(kLogCatalog, kLogDebug,
                    "nested catalogs loaded but entry '%s' was still not found",
@@ -433,6 +444,161 @@ bool AbstractCatalogManager::ListFileChunks(
 }
 
 
+/**
+ * State shared by the threads that warm a catalog subtree.  The queue grows
+ * while the workers discover nested catalogs in the catalogs they fetch.
+ */
+struct AbstractCatalogManager::WarmSubtreeContext {
+  AbstractCatalogManager *catalog_mgr;
+  bool pin;
+  Catalog::NestedCatalogList queue;
+  unsigned num_busy;  /**< workers currently processing a catalog */
+  unsigned num_warmed;
+  unsigned num_failed;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+
+/**
+ * Opens a fetched catalog standalone, outside the catalog tree, in order to
+ * find the next nesting level of a warmed subtree.
+ */
+bool AbstractCatalogManager::ListNestedCatalogsFreely(
+  const PathString &mountpoint,
+  const shash::Any &hash,
+  const string &catalog_path,
+  Catalog::NestedCatalogList *nested_catalogs)
+{
+  Catalog *catalog = Catalog::AttachFreely(mountpoint.ToString(), catalog_path,
+                                           hash, NULL, true);
+  if (catalog == NULL)
+    return false;
+  *nested_catalogs = catalog->ListNestedCatalogs();
+  delete catalog;
+  return true;
+}
+
+
+/**
+ * Takes nested catalogs from the queue until the queue is empty and no other
+ * worker can add more.
+ */
+void *AbstractCatalogManager::MainWarmSubtree(void *data) {
+  WarmSubtreeContext *ctx = reinterpret_cast<WarmSubtreeContext *>(data);
+  ctx->catalog_mgr->EnforceSqliteMemLimit();
+
+  pthread_mutex_lock(&ctx->lock);
+  while (true) {
+    while (ctx->queue.empty() && (ctx->num_busy > 0))
+      pthread_cond_wait(&ctx->cond, &ctx->lock);
+    if (ctx->queue.empty())
+      break;
+    const Catalog::NestedCatalog nested = ctx->queue.back();
+    ctx->queue.pop_back();
+    ctx->num_busy++;
+    pthread_mutex_unlock(&ctx->lock);
+
+    LogCvmfs(kLogCatalog, kLogDebug, "warming nested catalog at %s",
+             nested.path.c_str());
+    Catalog::NestedCatalogList next_level;
+    const bool success = ctx->catalog_mgr->WarmCatalog(
+      nested.path, nested.hash, ctx->pin, &next_level) == kLoadNew;
+    if (!success) {
+      LogCvmfs(kLogCatalog, kLogDebug | kLogSyslogWarn,
+               "failed to warm catalog at %s (%s)",
+               nested.path.c_str(), nested.hash.ToString().c_str());
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->num_busy--;
+    if (success) {
+      ctx->num_warmed++;
+      for (unsigned i = 0; i < next_level.size(); ++i) {
+        if (!next_level[i].hash.IsNull())
+          ctx->queue.push_back(next_level[i]);
+      }
+    } else {
+      ctx->num_failed++;
+    }
+    pthread_cond_broadcast(&ctx->cond);
+  }
+  pthread_mutex_unlock(&ctx->lock);
+  return NULL;
+}
+
+
+/**
+ * Fetches all nested catalogs below prefix concurrently, without mounting
+ * them.  The catalogs required to serve prefix itself are mounted.  The nested
+ * catalogs are found recursively from the nested catalog tables, so that a
+ * directory tree can be pre-loaded before it is traversed.
+ * @param prefix the root of the subtree to warm
+ * @param pin pin the fetched catalogs in the cache
+ * @param num_threads number of parallel fetches
+ * @param num_warmed number of successfully fetched catalogs
+ * @return false if the prefix cannot be served or if any catalog failed
+ */
+bool AbstractCatalogManager::WarmSubtree(
+  const PathString &prefix,
+  const bool pin,
+  const unsigned num_threads,
+  unsigned *num_warmed)
+{
+  assert(num_threads > 0);
+  EnforceSqliteMemLimit();
+  *num_warmed = 0;
+
+  WarmSubtreeContext ctx;
+  ctx.catalog_mgr = this;
+  ctx.pin = pin;
+  ctx.num_busy = 0;
+  ctx.num_warmed = 0;
+  ctx.num_failed = 0;
+
+  WriteLock();
+  Catalog *entry_point;
+  if (!MountSubtree(prefix, FindCatalog(prefix), &entry_point)) {
+    Unlock();
+    return false;
+  }
+  PathString prefix_slash(prefix);
+  prefix_slash.Append("/", 1);
+  perf::Inc(statistics_.n_nested_listing);
+  const Catalog::NestedCatalogList &nested_catalogs =
+    entry_point->ListNestedCatalogs();
+  for (Catalog::NestedCatalogList::const_iterator i = nested_catalogs.begin(),
+       iEnd = nested_catalogs.end(); i != iEnd; ++i)
+  {
+    PathString nested_path_slash(i->path);
+    nested_path_slash.Append("/", 1);
+    if (nested_path_slash.StartsWith(prefix_slash) && !i->hash.IsNull())
+      ctx.queue.push_back(*i);
+  }
+  Unlock();
+
+  int retval = pthread_mutex_init(&ctx.lock, NULL);
+  assert(retval == 0);
+  retval = pthread_cond_init(&ctx.cond, NULL);
+  assert(retval == 0);
+  vector<pthread_t> workers(num_threads);
+  for (unsigned i = 0; i < num_threads; ++i) {
+    retval = pthread_create(&workers[i], NULL, MainWarmSubtree, &ctx);
+    assert(retval == 0);
+  }
+  for (unsigned i = 0; i < num_threads; ++i)
+    pthread_join(workers[i], NULL);
+  pthread_cond_destroy(&ctx.cond);
+  pthread_mutex_destroy(&ctx.lock);
+
+  perf::Xadd(statistics_.n_warmed, ctx.num_warmed);
+  LogCvmfs(kLogCatalog, kLogDebug, "warmed %u catalogs below %s (%u failed)",
+           ctx.num_warmed, prefix.c_str(), ctx.num_failed);
+  *num_warmed = ctx.num_warmed;
+  return ctx.num_failed == 0;
+}
+
+
 
 uint64_t AbstractCatalogManager::GetRevision() const {
   ReadLock();
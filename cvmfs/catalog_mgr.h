@@ -72,6 +72,7 @@ struct Statistics {
   perf::Counter *n_lookup_xattrs;
   perf::Counter *n_listing;
   perf::Counter *n_nested_listing;
+  perf::Counter *n_warmed;
 
   explicit Statistics(perf::Statistics *statistics) {
     n_lookup_inode = statistics->Register("catalog_mgr.n_lookup_inode",
@@ -87,6 +88,8 @@ struct Statistics {
         "Number of listings");
     n_nested_listing = statistics->Register("catalog_mgr.n_nested_listing",
         "Number of listings of nested catalogs");
+    n_warmed = statistics->Register("catalog_mgr.n_warmed",
+        "Number of catalogs fetched by warming a subtree");
   }
 };
 
@@ -158,6 +161,11 @@ class AbstractCatalogManager : public SingleCopy {
   //                   DirectoryEntry *entry);
   bool LookupPath(const PathString &path, const LookupOptions options,
                   DirectoryEntry *entry);
+  /**
+   * For callers that have already computed the MD5 of the path
+   */
+  bool LookupPath(const PathString &path, const shash::Md5 &md5path,
+                  const LookupOptions options, DirectoryEntry *entry);
   bool LookupPath(const std::string &path, const LookupOptions options,
                   DirectoryEntry *entry)
   {
@@ -179,6 +187,9 @@ class AbstractCatalogManager : public SingleCopy {
                       const shash::Algorithms interpret_hashes_as,
                       FileChunkList *chunks);
 
+  bool WarmSubtree(const PathString &prefix, const bool pin,
+                   const unsigned num_threads, unsigned *num_warmed);
+
   void RegisterRemountListener(RemountListener *listener) {
     WriteLock();
     remount_listener_ = listener;
@@ -227,6 +238,24 @@ class AbstractCatalogManager : public SingleCopy {
                                 shash::Any   *catalog_hash) = 0;
   virtual void UnloadCatalog(const Catalog *catalog) { }
   virtual void ActivateCatalog(Catalog *catalog) { }
+  /**
+   * Fetch a catalog without mounting it and list its nested catalogs, used to
+   * warm a catalog subtree.  Must be thread-safe; it is called concurrently by
+   * the warming threads.  Catalog managers without a cache do not need to
+   * support it.
+   */
+  virtual LoadError WarmCatalog(const PathString &mountpoint,
+                                const shash::Any &hash,
+                                const bool pin,
+                                Catalog::NestedCatalogList *nested_catalogs)
+  {
+    return kLoadFail;
+  }
+  static bool ListNestedCatalogsFreely(
+    const PathString &mountpoint,
+    const shash::Any &hash,
+    const std::string &catalog_path,
+    Catalog::NestedCatalogList *nested_catalogs);
 
   /**
    * Create a new Catalog object.
@@ -271,6 +300,9 @@ class AbstractCatalogManager : public SingleCopy {
   virtual void EnforceSqliteMemLimit();
 
  private:
+  struct WarmSubtreeContext;
+  static void *MainWarmSubtree(void *data);
+
   void CheckInodeWatermark();
 
   /**
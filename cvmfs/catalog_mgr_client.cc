@@ -5,18 +5,69 @@
 #include "cvmfs_config.h"
 #include "catalog_mgr_client.h"
 
+#include <alloca.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "access_log.h"
 #include "cache.h"
+#include "catalog_compiled.h"
+#include "catalog_delta.h"
+#include "catalog_sql.h"
 #include "download.h"
 #include "fetch.h"
 #include "manifest.h"
 #include "quota.h"
 #include "signature.h"
+#include "sink.h"
+#include "smalloc.h"
 #include "statistics.h"
 
 using namespace std;  // NOLINT
 
 namespace catalog {
 
+namespace {
+
+/**
+ * Reads the base revision of a catalog delta from the cache
+ */
+class CacheBaseReader : public CatalogDelta::BaseReader {
+ public:
+  CacheBaseReader(cache::CacheManager *cache_mgr, int fd)
+    : cache_mgr_(cache_mgr)
+    , fd_(fd)
+  { }
+  virtual int64_t Pread(void *buf, uint64_t size, uint64_t offset) {
+    return cache_mgr_->Pread(fd_, buf, size, offset);
+  }
+
+ private:
+  cache::CacheManager *cache_mgr_;
+  int fd_;
+};
+
+class FileSink : public cvmfs::Sink {
+ public:
+  explicit FileSink(FILE *f) : f_(f) { }
+  virtual int64_t Write(const void *buf, uint64_t sz) {
+    return fwrite(buf, 1, sz, f_);
+  }
+  virtual int Reset() { return ftruncate(fileno(f_), 0); }
+
+ private:
+  FILE *f_;
+};
+
+}  // anonymous namespace
+
+
 /**
  * Triggered when the catalog is attached (db file opened)
  */
@@ -26,6 +77,8 @@ void ClientCatalogManager::ActivateCatalog(Catalog *catalog) {
     all_inodes_ = counters.GetAllEntries();
   }
   loaded_inodes_ += counters.GetSelfEntries();
+  if (compiled_catalogs_)
+    LoadCompiledCatalog(catalog);
 }
 
 
@@ -35,22 +88,65 @@ ClientCatalogManager::ClientCatalogManager(
   signature::SignatureManager *signature_mgr,
   perf::Statistics *statistics)
   : AbstractCatalogManager(statistics)
+  , warm_pinned_size_(0)
   , repo_name_(repo_name)
   , fetcher_(fetcher)
   , signature_mgr_(signature_mgr)
   , offline_mode_(false)
+  , catalog_deltas_(false)
+  , compiled_catalogs_(false)
+  , compile_queue_(NULL)
+  , spawned_(false)
+  , compiled_size_(0)
+  , compiled_limit_(0)
   , all_inodes_(0)
   , loaded_inodes_(0)
 {
+  lock_warm_pinned_ =
+    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  int retval = pthread_mutex_init(lock_warm_pinned_, NULL);
+  assert(retval == 0);
+  lock_compiled_ =
+    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  retval = pthread_mutex_init(lock_compiled_, NULL);
+  assert(retval == 0);
+
   LogCvmfs(kLogCatalog, kLogDebug, "constructing client catalog manager");
   n_certificate_hits_ = statistics->Register("cache.n_certificate_hits",
     "Number of certificate hits");
   n_certificate_misses_ = statistics->Register("cache.n_certificate_misses",
     "Number of certificate misses");
+  n_deltas_applied_ = statistics->Register("catalog_delta.n_applied",
+    "Number of catalogs reconstructed from catalog deltas");
+  n_delta_fallbacks_ = statistics->Register("catalog_delta.n_fallbacks",
+    "Number of catalog deltas that could not be applied");
+  sz_delta_bytes_ = statistics->Register("catalog_delta.sz_delta_bytes",
+    "Uncompressed size of the applied catalog deltas");
+  sz_delta_catalog_bytes_ = statistics->Register(
+    "catalog_delta.sz_catalog_bytes",
+    "Uncompressed size of the catalogs reconstructed from catalog deltas");
+  n_compiled_ = statistics->Register("catalog_compiled.n_compiled",
+    "Number of catalogs compiled into the cache");
+  n_compiled_mapped_ = statistics->Register("catalog_compiled.n_mapped",
+    "Number of catalogs served from compiled catalogs");
+  n_compiled_verified_ = statistics->Register("catalog_compiled.n_verified",
+    "Number of compiled catalogs whose checksum was verified");
+  n_compiled_removed_ = statistics->Register("catalog_compiled.n_removed",
+    "Number of compiled catalogs removed from the cache");
 }
 
 
 ClientCatalogManager::~ClientCatalogManager() {
+  if (spawned_) {
+    compile_queue_->Enqueue(NULL);
+    pthread_join(thread_compile_, NULL);
+  }
+  if (compile_queue_ != NULL) {
+    while (!compile_queue_->IsEmpty())
+      delete compile_queue_->Dequeue();
+    delete compile_queue_;
+  }
+
   LogCvmfs(kLogCache, kLogDebug, "unpinning / unloading all catalogs");
 
   for (map<PathString, shash::Any>::iterator i = mounted_catalogs_.begin(),
@@ -58,6 +154,15 @@ ClientCatalogManager::~ClientCatalogManager() {
   {
     fetcher_->cache_mgr()->quota_mgr()->Unpin(i->second);
   }
+  for (map<shash::Any, uint64_t>::const_iterator i = warm_pinned_.begin(),
+       iEnd = warm_pinned_.end(); i != iEnd; ++i)
+  {
+    fetcher_->cache_mgr()->quota_mgr()->Unpin(i->first);
+  }
+  pthread_mutex_destroy(lock_warm_pinned_);
+  free(lock_warm_pinned_);
+  pthread_mutex_destroy(lock_compiled_);
+  free(lock_compiled_);
 }
 
 
@@ -68,6 +173,11 @@ Catalog *ClientCatalogManager::CreateCatalog(
 ) {
   mounted_catalogs_[mountpoint] = loaded_catalogs_[mountpoint];
   loaded_catalogs_.erase(mountpoint);
+  if (access_log::active_) {
+    access_log::Log(access_log::kRecordCatalog,
+                    shash::Md5(mountpoint.GetChars(), mountpoint.GetLength()),
+                    catalog_hash, 0, 0);
+  }
   return new Catalog(mountpoint, catalog_hash, parent_catalog);
 }
 
@@ -118,7 +228,8 @@ LoadError ClientCatalogManager::LoadCatalog(
   // Load a particular catalog
   if (!hash.IsNull()) {
     cvmfs_path += " (" + hash.ToString() + ")";
-    LoadError load_error = LoadCatalogCas(hash, cvmfs_path, catalog_path);
+    LoadError load_error = LoadCatalogCas(
+      hash, cvmfs_path, GetDeltaReference(mountpoint, hash), catalog_path);
     if (load_error == catalog::kLoadNew)
       loaded_catalogs_[mountpoint] = hash;
     *catalog_hash = hash;
@@ -160,7 +271,8 @@ LoadError ClientCatalogManager::LoadCatalog(
              manifest_failure, manifest::Code2Ascii(manifest_failure));
 
     if (catalog_path) {
-      LoadError error = LoadCatalogCas(cache_hash, cvmfs_path, catalog_path);
+      LoadError error =
+        LoadCatalogCas(cache_hash, cvmfs_path, "", catalog_path);
       if (error != catalog::kLoadNew)
         return error;
     }
@@ -171,6 +283,8 @@ LoadError ClientCatalogManager::LoadCatalog(
   }
 
   offline_mode_ = false;
+  manifest_catalog_hash_ = ensemble.manifest->catalog_hash();
+  manifest_catalog_delta_ = ensemble.manifest->catalog_delta();
   cvmfs_path += " (" + ensemble.manifest->catalog_hash().ToString() + ")";
   LogCvmfs(kLogCache, kLogDebug, "remote checksum is %s",
            ensemble.manifest->catalog_hash().ToString().c_str());
@@ -178,7 +292,8 @@ LoadError ClientCatalogManager::LoadCatalog(
   // Short way out, use cached copy
   if (ensemble.manifest->catalog_hash() == cache_hash) {
     if (catalog_path) {
-      LoadError error = LoadCatalogCas(cache_hash, cvmfs_path, catalog_path);
+      LoadError error =
+        LoadCatalogCas(cache_hash, cvmfs_path, "", catalog_path);
       if (error == catalog::kLoadNew) {
         loaded_catalogs_[mountpoint] = cache_hash;
         *catalog_hash = cache_hash;
@@ -197,7 +312,8 @@ LoadError ClientCatalogManager::LoadCatalog(
 
   // Load new catalog
   catalog::LoadError load_retval =
-    LoadCatalogCas(ensemble.manifest->catalog_hash(), cvmfs_path, catalog_path);
+    LoadCatalogCas(ensemble.manifest->catalog_hash(), cvmfs_path,
+                   manifest_catalog_delta_, catalog_path);
   if (load_retval != catalog::kLoadNew)
     return load_retval;
   loaded_catalogs_[mountpoint] = ensemble.manifest->catalog_hash();
@@ -212,12 +328,42 @@ LoadError ClientCatalogManager::LoadCatalog(
 }
 
 
+/**
+ * Looks up the trusted delta reference of a catalog revision, see CatalogDelta.
+ * The reference of the root catalog is taken from the last fetched manifest,
+ * the reference of a nested catalog from its (mounted) parent catalog.
+ */
+string ClientCatalogManager::GetDeltaReference(
+  const PathString &mountpoint,
+  const shash::Any &hash)
+{
+  if (mountpoint.IsEmpty())
+    return (hash == manifest_catalog_hash_) ? manifest_catalog_delta_ : "";
+
+  if (mounted_catalogs_.empty())
+    return "";
+  Catalog *parent = FindCatalog(mountpoint);
+  shash::Any nested_hash;
+  uint64_t nested_size;
+  if ((parent->path() == mountpoint) ||
+      !parent->FindNested(mountpoint, &nested_hash, &nested_size) ||
+      (nested_hash != hash))
+  {
+    return "";
+  }
+  return parent->GetNestedDeltaReference(mountpoint);
+}
+
+
 LoadError ClientCatalogManager::LoadCatalogCas(
   const shash::Any &hash,
   const string &name,
+  const string &delta_reference,
   string *catalog_path)
 {
   assert(hash.suffix == shash::kSuffixCatalog);
+  if (catalog_deltas_ && !delta_reference.empty())
+    LoadCatalogDelta(hash, name, delta_reference);
   int fd = fetcher_->Fetch(hash, cache::CacheManager::kSizeUnknown, name,
                            cache::CacheManager::kTypeCatalog);
   if (fd >= 0) {
@@ -232,6 +378,439 @@ LoadError ClientCatalogManager::LoadCatalogCas(
 }
 
 
+/**
+ * Fetches a catalog into the cache without mounting it and lists its nested
+ * catalogs.  Pinned catalogs stay pinned until they are mounted and unloaded
+ * again or until the catalog manager is destructed.  Once the catalogs pinned
+ * by warming take up 1/kWarmPinFraction of the cache, further catalogs are
+ * fetched without pinning.
+ */
+LoadError ClientCatalogManager::WarmCatalog(
+  const PathString &mountpoint,
+  const shash::Any &hash,
+  const bool pin,
+  Catalog::NestedCatalogList *nested_catalogs)
+{
+  assert(hash.suffix == shash::kSuffixCatalog);
+  cache::CacheManager *cache_mgr = fetcher_->cache_mgr();
+  QuotaManager *quota_mgr = cache_mgr->quota_mgr();
+  bool do_pin = pin;
+  if (pin && quota_mgr->IsEnforcing()) {
+    pthread_mutex_lock(lock_warm_pinned_);
+    do_pin = (warm_pinned_.find(hash) != warm_pinned_.end()) ||
+      (warm_pinned_size_ < quota_mgr->GetCapacity() / kWarmPinFraction);
+    pthread_mutex_unlock(lock_warm_pinned_);
+  }
+
+  const string cvmfs_path = "file catalog at " + repo_name_ + ":" +
+    mountpoint.ToString() + " (" + hash.ToString() + ")";
+  int fd = fetcher_->Fetch(hash, cache::CacheManager::kSizeUnknown, cvmfs_path,
+                           do_pin ? cache::CacheManager::kTypeCatalog :
+                                    cache::CacheManager::kTypeRegular);
+  if (fd < 0)
+    return (fd == -ENOSPC) ? kLoadNoSpace : kLoadFail;
+
+  if (do_pin) {
+    const int64_t size = cache_mgr->GetSize(fd);
+    pthread_mutex_lock(lock_warm_pinned_);
+    if ((size > 0) && (warm_pinned_.find(hash) == warm_pinned_.end())) {
+      warm_pinned_[hash] = size;
+      warm_pinned_size_ += size;
+    }
+    pthread_mutex_unlock(lock_warm_pinned_);
+  }
+
+  // The SQlite vfs takes ownership of the file descriptor in the path, so the
+  // duplicate is handed over and the original is closed here on all paths
+  bool retval = false;
+  const int fd_sqlite = cache_mgr->Dup(fd);
+  if (fd_sqlite >= 0) {
+    retval = ListNestedCatalogsFreely(mountpoint, hash,
+                                      "@" + StringifyInt(fd_sqlite),
+                                      nested_catalogs);
+  }
+  cache_mgr->Close(fd);
+  return retval ? kLoadNew : kLoadFail;
+}
+
+
+/**
+ * Reconstructs a changed catalog in the cache from its catalog delta and the
+ * base revision named in the delta reference, if the base revision is in the
+ * cache.  The reconstructed catalog is verified against the content hash of
+ * the delta reference.  On any failure, the cache remains untouched and the
+ * catalog is downloaded in full by the fetcher.
+ */
+void ClientCatalogManager::LoadCatalogDelta(
+  const shash::Any &hash,
+  const string &name,
+  const string &delta_reference)
+{
+  shash::Any base_hash;
+  shash::Any content_hash;
+  if (!CatalogDelta::ParseReference(delta_reference, &base_hash,
+                                    &content_hash))
+  {
+    LogCvmfs(kLogCatalog, kLogDebug, "invalid delta reference for %s",
+             name.c_str());
+    return;
+  }
+
+  cache::CacheManager *cache_mgr = fetcher_->cache_mgr();
+  int fd = cache_mgr->Open(hash);
+  if (fd >= 0) {
+    cache_mgr->Close(fd);
+    return;
+  }
+  // Without the base revision, don't even try to download the delta
+  int fd_base = cache_mgr->Open(base_hash);
+  if (fd_base < 0) {
+    LogCvmfs(kLogCatalog, kLogDebug, "base revision %s of %s not in cache",
+             base_hash.ToString().c_str(), name.c_str());
+    perf::Inc(n_delta_fallbacks_);
+    return;
+  }
+
+  shash::Any delta_hash(hash);
+  delta_hash.suffix = shash::kSuffixDelta;
+  const string url = "/data/" + delta_hash.MakePath();
+  // The delta reference guarantees that the delta exists, so it is fetched
+  // like any other object from the host chain
+  download::JobInfo download_delta(&url, true, true, NULL);
+  download_delta.priority = download::kPriorityCatalog;
+  download::Failures dl_retval =
+    fetcher_->download_mgr()->Fetch(&download_delta);
+  if (dl_retval != download::kFailOk) {
+    LogCvmfs(kLogCatalog, kLogDebug, "no catalog delta for %s (%d - %s)",
+             name.c_str(), dl_retval, download::Code2Ascii(dl_retval));
+    cache_mgr->Close(fd_base);
+    perf::Inc(n_delta_fallbacks_);
+    return;
+  }
+  UniquePtr<CatalogDelta> delta(CatalogDelta::Parse(
+    reinterpret_cast<unsigned char *>(download_delta.destination_mem.data),
+    download_delta.destination_mem.size));
+  free(download_delta.destination_mem.data);
+  if (!delta.IsValid() || delta->IsPlaceholder() ||
+      (delta->base_hash() != base_hash) ||
+      (cache_mgr->GetSize(fd_base) != static_cast<int64_t>(delta->base_size())))
+  {
+    LogCvmfs(kLogCatalog, kLogDebug, "catalog delta for %s not applicable",
+             name.c_str());
+    cache_mgr->Close(fd_base);
+    perf::Inc(n_delta_fallbacks_);
+    return;
+  }
+
+  void *txn = alloca(cache_mgr->SizeOfTxn());
+  int retval = cache_mgr->StartTxn(hash, delta->target_size(), txn);
+  if (retval < 0) {
+    cache_mgr->Close(fd_base);
+    perf::Inc(n_delta_fallbacks_);
+    return;
+  }
+  cache_mgr->CtrlTxn(name, cache::CacheManager::kTypeCatalog, 0, txn);
+  CacheBaseReader base(cache_mgr, fd_base);
+  cvmfs::TransactionSink sink(cache_mgr, txn);
+  shash::Any reconstructed_hash(content_hash.algorithm);
+  const bool applied = delta->Apply(&base, &sink, &reconstructed_hash);
+  cache_mgr->Close(fd_base);
+  if (!applied || (reconstructed_hash != content_hash)) {
+    LogCvmfs(kLogCatalog, kLogDebug | kLogSyslogWarn,
+             "failed to reconstruct %s from catalog delta", name.c_str());
+    cache_mgr->AbortTxn(txn);
+    perf::Inc(n_delta_fallbacks_);
+    return;
+  }
+  retval = cache_mgr->CommitTxn(txn);
+  if (retval < 0) {
+    perf::Inc(n_delta_fallbacks_);
+    return;
+  }
+
+  LogCvmfs(kLogCatalog, kLogDebug, "reconstructed %s from catalog delta "
+           "(%u changed blocks)", name.c_str(), delta->num_blocks());
+  perf::Inc(n_deltas_applied_);
+  perf::Xadd(sz_delta_bytes_, delta->size());
+  perf::Xadd(sz_delta_catalog_bytes_, delta->target_size());
+}
+
+
+/**
+ * Serve lookups and listings from compiled catalogs.  Catalogs are compiled by
+ * a background thread (see Spawn()) into <cache directory>/compiled, which is
+ * not part of the content-addressed cache.  Instead of the quota manager, the
+ * catalog manager keeps compiled catalogs in check: they are removed along
+ * with their catalogs and they may use at most 1/kCompiledFraction of the
+ * cache, which the quota manager keeps free for them.  Requires the posix
+ * cache manager because compiled catalogs are memory mapped.
+ */
+void ClientCatalogManager::EnableCompiledCatalogs() {
+  cache::CacheManager *cache_mgr = fetcher_->cache_mgr();
+  if (compiled_catalogs_ || (cache_mgr->id() != cache::kPosixCacheManager))
+    return;
+
+  compiled_dir_ = reinterpret_cast<cache::PosixCacheManager *>(cache_mgr)->
+    cache_path() + "/compiled";
+  if (!MkdirDeep(compiled_dir_, 0700)) {
+    LogCvmfs(kLogCatalog, kLogDebug | kLogSyslogWarn,
+             "failed to create %s, not using compiled catalogs",
+             compiled_dir_.c_str());
+    return;
+  }
+  QuotaManager *quota_mgr = cache_mgr->quota_mgr();
+  if (quota_mgr->IsEnforcing())
+    compiled_limit_ = quota_mgr->GetCapacity() / kCompiledFraction;
+  SweepCompiled(shash::Any());
+  compile_queue_ = new FifoChannel<CompileJob *>(kCompileQueueLength,
+                                                 kCompileQueueLength);
+  compiled_catalogs_ = true;
+}
+
+
+/**
+ * Starts the thread that compiles catalogs.  Catalogs activated before are
+ * compiled once the thread runs.
+ */
+void ClientCatalogManager::Spawn() {
+  if (!compiled_catalogs_ || spawned_)
+    return;
+  int retval = pthread_create(&thread_compile_, NULL, MainCompile, this);
+  assert(retval == 0);
+  spawned_ = true;
+}
+
+
+void *ClientCatalogManager::MainCompile(void *data) {
+  ClientCatalogManager *catalog_mgr = static_cast<ClientCatalogManager *>(data);
+  LogCvmfs(kLogCatalog, kLogDebug, "starting catalog compiler thread");
+  while (true) {
+    CompileJob *job = catalog_mgr->compile_queue_->Dequeue();
+    if (job == NULL)
+      break;
+    catalog_mgr->CompileCatalog(*job);
+    delete job;
+  }
+  LogCvmfs(kLogCatalog, kLogDebug, "stopping catalog compiler thread");
+  return NULL;
+}
+
+
+/**
+ * Attaches the compiled catalog if there is a valid one.  Otherwise, the
+ * catalog is queued for the compiler thread and continues to use sqlite in the
+ * meantime.  Runs under the catalog lock, so nothing is compiled here.
+ */
+void ClientCatalogManager::LoadCompiledCatalog(Catalog *catalog) {
+  if (AttachCompiledCatalog(catalog))
+    return;
+  if (compile_queue_->GetItemCount() >= kCompileQueueLength)
+    return;
+  compile_queue_->Enqueue(new CompileJob(catalog->path(), catalog->hash(),
+                                         catalog->GetPreviousRevision()));
+}
+
+
+/**
+ * Maps the compiled catalog.  The checksum is verified only the first time
+ * the file is attached.  Invalid compiled catalogs are removed so that they
+ * get compiled again.
+ */
+bool ClientCatalogManager::AttachCompiledCatalog(Catalog *catalog) {
+  const string path = GetCompiledPath(catalog->hash());
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  platform_stat64 info;
+  if (platform_fstat(fd, &info) != 0) {
+    close(fd);
+    return false;
+  }
+  const CompiledStamp stamp(info);
+  pthread_mutex_lock(lock_compiled_);
+  map<shash::Any, CompiledStamp>::const_iterator iter =
+    compiled_verified_.find(catalog->hash());
+  const bool verified =
+    (iter != compiled_verified_.end()) && (iter->second == stamp);
+  pthread_mutex_unlock(lock_compiled_);
+
+  CompiledCatalog *compiled = CompiledCatalog::Map(fd, !verified);
+  close(fd);
+  if (compiled == NULL) {
+    LogCvmfs(kLogCatalog, kLogDebug | kLogSyslogWarn,
+             "removing invalid compiled catalog %s", path.c_str());
+    RemoveCompiled(catalog->hash());
+    return false;
+  }
+  if (!verified) {
+    pthread_mutex_lock(lock_compiled_);
+    compiled_verified_[catalog->hash()] = stamp;
+    pthread_mutex_unlock(lock_compiled_);
+    perf::Inc(n_compiled_verified_);
+  }
+  catalog->AttachCompiled(compiled);
+  perf::Inc(n_compiled_mapped_);
+  LogCvmfs(kLogCatalog, kLogDebug, "attached compiled catalog for %s "
+           "(%u entries)", catalog->path().c_str(), compiled->num_entries());
+  return true;
+}
+
+
+/**
+ * Compiles a catalog from its own read-only connection to the cached catalog
+ * and attaches the result if the catalog is still mounted.  The compiled
+ * previous revision of the catalog is removed.  The new file counts as
+ * verified, it is written from the cached catalog.
+ */
+void ClientCatalogManager::CompileCatalog(const CompileJob &job) {
+  const string path = GetCompiledPath(job.hash);
+  if (!FileExists(path)) {
+    cache::CacheManager *cache_mgr = fetcher_->cache_mgr();
+    const int fd = cache_mgr->Open(job.hash);
+    if (fd < 0)
+      return;
+    // The SQlite vfs takes ownership of the file descriptor
+    CatalogDatabase *database = CatalogDatabase::Open(
+      "@" + StringifyInt(fd), CatalogDatabase::kOpenReadOnly);
+    if (database == NULL)
+      return;
+    string tmp_path;
+    FILE *f = CreateTempFile(path + ".tmp", 0600, "w", &tmp_path);
+    if (f == NULL) {
+      delete database;
+      return;
+    }
+    FileSink sink(f);
+    bool retval = CompiledCatalog::Compile(*database, &sink);
+    delete database;
+    retval = (fclose(f) == 0) && retval;
+    if (!retval || (rename(tmp_path.c_str(), path.c_str()) != 0)) {
+      LogCvmfs(kLogCatalog, kLogDebug, "failed to compile catalog %s",
+               job.hash.ToString().c_str());
+      unlink(tmp_path.c_str());
+      return;
+    }
+    perf::Inc(n_compiled_);
+    platform_stat64 info;
+    if (platform_stat(path.c_str(), &info) == 0) {
+      pthread_mutex_lock(lock_compiled_);
+      compiled_size_ += info.st_size;
+      compiled_verified_[job.hash] = CompiledStamp(info);
+      pthread_mutex_unlock(lock_compiled_);
+    }
+    if (!job.previous_hash.IsNull())
+      RemoveCompiled(job.previous_hash);
+
+    if ((compiled_limit_ > 0) && (GetCompiledSize() > compiled_limit_))
+      SweepCompiled(job.hash);
+    // Compiled catalogs take their share from the cache
+    QuotaManager *quota_mgr = cache_mgr->quota_mgr();
+    if (quota_mgr->IsEnforcing()) {
+      const uint64_t capacity = quota_mgr->GetCapacity();
+      const uint64_t compiled_size = GetCompiledSize();
+      if ((compiled_size < capacity) &&
+          (quota_mgr->GetSize() > capacity - compiled_size))
+      {
+        quota_mgr->Cleanup(capacity - compiled_size);
+      }
+    }
+  }
+
+  // Detaching the catalog requires the write lock
+  ReadLock();
+  Catalog *catalog;
+  if (IsAttached(job.mountpoint, &catalog) && (catalog->hash() == job.hash) &&
+      !catalog->HasCompiled())
+  {
+    AttachCompiledCatalog(catalog);
+  }
+  Unlock();
+}
+
+
+/**
+ * Unlinks a compiled catalog.  A catalog that has it attached keeps using the
+ * mapping.
+ */
+void ClientCatalogManager::RemoveCompiled(const shash::Any &catalog_hash) {
+  const string path = GetCompiledPath(catalog_hash);
+  platform_stat64 info;
+  const bool removed = (platform_stat(path.c_str(), &info) == 0) &&
+                       (unlink(path.c_str()) == 0);
+  pthread_mutex_lock(lock_compiled_);
+  if (removed)
+    compiled_size_ -= min(compiled_size_, uint64_t(info.st_size));
+  compiled_verified_.erase(catalog_hash);
+  pthread_mutex_unlock(lock_compiled_);
+  if (removed)
+    perf::Inc(n_compiled_removed_);
+}
+
+
+uint64_t ClientCatalogManager::GetCompiledSize() {
+  MutexLockGuard guard(lock_compiled_);
+  return compiled_size_;
+}
+
+
+/**
+ * Removes compiled catalogs whose catalogs are not in the cache anymore and
+ * leftover temporary files.  If the rest exceeds the limit, the oldest
+ * compiled catalogs are removed, except for the one to keep.  Recomputes the
+ * size of the compiled catalogs.  Runs when compiled catalogs are enabled and
+ * later in the compiler thread.
+ */
+void ClientCatalogManager::SweepCompiled(const shash::Any &keep) {
+  cache::PosixCacheManager *cache_mgr =
+    reinterpret_cast<cache::PosixCacheManager *>(fetcher_->cache_mgr());
+  vector<pair<time_t, shash::Any> > candidates;
+  uint64_t compiled_size = 0;
+
+  const vector<string> paths = FindFiles(compiled_dir_, "");
+  for (unsigned i = 0; i < paths.size(); ++i) {
+    const string name = GetFileName(paths[i]);
+    if ((name == ".") || (name == ".."))
+      continue;
+    platform_stat64 info;
+    if ((platform_lstat(paths[i].c_str(), &info) != 0) ||
+        !S_ISREG(info.st_mode))
+    {
+      continue;
+    }
+    if (!shash::HexPtr(name).IsValid()) {
+      unlink(paths[i].c_str());
+      continue;
+    }
+    const shash::Any hash =
+      shash::MkFromHexPtr(shash::HexPtr(name), shash::kSuffixCatalog);
+    if (!FileExists(cache_mgr->GetPathInCache(hash))) {
+      LogCvmfs(kLogCatalog, kLogDebug, "removing compiled catalog %s, the "
+               "catalog is not cached anymore", name.c_str());
+      RemoveCompiled(hash);
+      continue;
+    }
+    compiled_size += info.st_size;
+    if (hash != keep)
+      candidates.push_back(make_pair(info.st_mtime, hash));
+  }
+
+  pthread_mutex_lock(lock_compiled_);
+  compiled_size_ = compiled_size;
+  pthread_mutex_unlock(lock_compiled_);
+
+  if ((compiled_limit_ == 0) || (compiled_size <= compiled_limit_))
+    return;
+  sort(candidates.begin(), candidates.end());
+  for (unsigned i = 0; i < candidates.size(); ++i) {
+    if (GetCompiledSize() <= compiled_limit_)
+      break;
+    RemoveCompiled(candidates[i].second);
+  }
+  LogCvmfs(kLogCatalog, kLogDebug, "compiled catalogs use %"PRIu64" bytes "
+           "(limit %"PRIu64")", GetCompiledSize(), compiled_limit_);
+}
+
+
 void ClientCatalogManager::UnloadCatalog(const Catalog *catalog) {
   LogCvmfs(kLogCache, kLogDebug, "unloading catalog %s",
            catalog->path().c_str());
@@ -240,6 +819,14 @@ void ClientCatalogManager::UnloadCatalog(const Catalog *catalog) {
     mounted_catalogs_.find(catalog->path());
   assert(iter != mounted_catalogs_.end());
   fetcher_->cache_mgr()->quota_mgr()->Unpin(iter->second);
+  pthread_mutex_lock(lock_warm_pinned_);
+  map<shash::Any, uint64_t>::iterator warm_pin =
+    warm_pinned_.find(iter->second);
+  if (warm_pin != warm_pinned_.end()) {
+    warm_pinned_size_ -= warm_pin->second;
+    warm_pinned_.erase(warm_pin);
+  }
+  pthread_mutex_unlock(lock_warm_pinned_);
   mounted_catalogs_.erase(iter);
   const catalog::Counters &counters = catalog->GetCounters();
   loaded_inodes_ -= counters.GetSelfEntries();
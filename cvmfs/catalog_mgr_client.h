@@ -7,7 +7,9 @@
 
 #include "catalog_mgr.h"
 
+#include <gtest/gtest_prod.h>
 #include <inttypes.h>
+#include <pthread.h>
 
 #include <map>
 #include <string>
@@ -15,7 +17,9 @@
 #include "backoff.h"
 #include "hash.h"
 #include "manifest_fetch.h"
+#include "platform.h"
 #include "shortstring.h"
+#include "util_concurrency.h"
 
 namespace cache {
 class CacheManager;
@@ -62,6 +66,13 @@ class ClientCatalogManager : public AbstractCatalogManager {
   virtual ~ClientCatalogManager();
 
   bool InitFixed(const shash::Any &root_hash);
+  /**
+   * Try to reconstruct changed catalogs from catalog deltas and the previous
+   * catalog revisions in the cache before downloading them in full.
+   */
+  void EnableCatalogDeltas() { catalog_deltas_ = true; }
+  void EnableCompiledCatalogs();
+  void Spawn();
 
   shash::Any GetRootHash();
 
@@ -79,27 +90,135 @@ class ClientCatalogManager : public AbstractCatalogManager {
                                   const shash::Any  &catalog_hash,
                                   catalog::Catalog *parent_catalog);
   void ActivateCatalog(catalog::Catalog *catalog);
+  LoadError WarmCatalog(const PathString &mountpoint,
+                        const shash::Any &hash,
+                        const bool pin,
+                        Catalog::NestedCatalogList *nested_catalogs);
 
  private:
+  /**
+   * Catalogs pinned by warming may use at most this fraction of the cache
+   * (1/kWarmPinFraction), so that mounted catalogs can still be pinned.
+   */
+  static const unsigned kWarmPinFraction = 4;
+  /**
+   * Catalogs activated while the compile queue is full are compiled on their
+   * next activation
+   */
+  static const unsigned kCompileQueueLength = 64;
+  /**
+   * Compiled catalogs may use at most 1/kCompiledFraction of the cache
+   */
+  static const unsigned kCompiledFraction = 8;
+
+  /**
+   * A catalog revision to be compiled by the background thread
+   */
+  struct CompileJob {
+    CompileJob(const PathString &m, const shash::Any &h, const shash::Any &p)
+      : mountpoint(m), hash(h), previous_hash(p) { }
+    PathString mountpoint;
+    shash::Any hash;
+    shash::Any previous_hash;
+  };
+
+  /**
+   * Identifies the compiled catalog file whose checksum has been verified
+   */
+  struct CompiledStamp {
+    CompiledStamp() : inode(0), size(0), mtime(0) { }
+    explicit CompiledStamp(const platform_stat64 &info)
+      : inode(info.st_ino), size(info.st_size), mtime(info.st_mtime) { }
+    bool operator ==(const CompiledStamp &other) const {
+      return (inode == other.inode) && (size == other.size) &&
+             (mtime == other.mtime);
+    }
+    uint64_t inode;
+    uint64_t size;
+    time_t mtime;
+  };
+
+  static void *MainCompile(void *data);
+
+  std::string GetDeltaReference(const PathString &mountpoint,
+                                const shash::Any &hash);
   LoadError LoadCatalogCas(const shash::Any &hash,
                            const std::string &name,
+                           const std::string &delta_reference,
                            std::string *catalog_path);
+  void LoadCatalogDelta(const shash::Any &hash,
+                        const std::string &name,
+                        const std::string &delta_reference);
+  void LoadCompiledCatalog(Catalog *catalog);
+  bool AttachCompiledCatalog(Catalog *catalog);
+  void CompileCatalog(const CompileJob &job);
+  void RemoveCompiled(const shash::Any &catalog_hash);
+  uint64_t GetCompiledSize();
+  void SweepCompiled(const shash::Any &keep);
+  std::string GetCompiledPath(const shash::Any &catalog_hash) const {
+    return compiled_dir_ + "/" + catalog_hash.ToString();
+  }
 
   /**
    * Required for unpinning
    */
   std::map<PathString, shash::Any> loaded_catalogs_;
   std::map<PathString, shash::Any> mounted_catalogs_;
+  /**
+   * Root catalog and its delta reference from the last fetched manifest
+   */
+  shash::Any manifest_catalog_hash_;
+  std::string manifest_catalog_delta_;
+  /**
+   * Catalogs pinned by WarmSubtree() and their sizes.  They stay pinned until
+   * they are mounted and unloaded or until the catalog manager is destructed.
+   */
+  std::map<shash::Any, uint64_t> warm_pinned_;
+  uint64_t warm_pinned_size_;
+  pthread_mutex_t *lock_warm_pinned_;
 
   std::string repo_name_;
   cvmfs::Fetcher *fetcher_;
   signature::SignatureManager *signature_mgr_;
   bool offline_mode_;  /**< cached copy used because there is no network */
+  bool catalog_deltas_;
+  bool compiled_catalogs_;
+  /**
+   * Compiled catalogs are kept outside the content-addressed part of the cache
+   */
+  std::string compiled_dir_;
+  FifoChannel<CompileJob *> *compile_queue_;
+  pthread_t thread_compile_;
+  bool spawned_;
+  /**
+   * Compiled catalogs that don't need to be checksummed again when they are
+   * attached.  Compiled catalogs are attached by the compiler thread, too.
+   */
+  std::map<shash::Any, CompiledStamp> compiled_verified_;
+  /**
+   * Size of the compiled catalogs and its limit (0 for unlimited)
+   */
+  uint64_t compiled_size_;
+  uint64_t compiled_limit_;
+  /**
+   * Protects compiled_verified_ and compiled_size_
+   */
+  pthread_mutex_t *lock_compiled_;
   uint64_t all_inodes_;
   uint64_t loaded_inodes_;
   BackoffThrottle backoff_throttle_;
   perf::Counter *n_certificate_hits_;
   perf::Counter *n_certificate_misses_;
+  perf::Counter *n_deltas_applied_;
+  perf::Counter *n_delta_fallbacks_;
+  perf::Counter *sz_delta_bytes_;
+  perf::Counter *sz_delta_catalog_bytes_;
+  perf::Counter *n_compiled_;
+  perf::Counter *n_compiled_mapped_;
+  perf::Counter *n_compiled_verified_;
+  perf::Counter *n_compiled_removed_;
+
+  FRIEND_TEST(T_CatalogMgrClient, CompiledSizeLimit);
 };
 
 
@@ -14,7 +14,9 @@
 #include <cstdlib>
 #include <string>
 
+#include "catalog_delta.h"
 #include "catalog_rw.h"
+#include "compression.h"
 #include "logging.h"
 #include "manifest.h"
 #include "smalloc.h"
@@ -38,6 +40,7 @@ WritableCatalogManager::WritableCatalogManager(
       statistics)
   , spooler_(spooler)
   , catalog_entry_warn_threshold_(catalog_entry_warn_threshold)
+  , catalog_deltas_(false)
 {
   sync_lock_ =
     reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
@@ -47,6 +50,11 @@ WritableCatalogManager::WritableCatalogManager(
 
 
 WritableCatalogManager::~WritableCatalogManager() {
+  for (set<string>::const_iterator i = base_copies_.begin(),
+       iEnd = base_copies_.end(); i != iEnd; ++i)
+  {
+    unlink(i->c_str());
+  }
   pthread_mutex_destroy(sync_lock_);
   free(sync_lock_);
 }
@@ -77,6 +85,33 @@ void WritableCatalogManager::ActivateCatalog(Catalog *catalog) {
 }
 
 
+/**
+ * With catalog deltas, keeps a copy of the downloaded catalog as base revision
+ * for the delta of the next revision.
+ */
+LoadError WritableCatalogManager::LoadCatalog(
+  const PathString  &mountpoint,
+  const shash::Any  &hash,
+  std::string       *catalog_path,
+  shash::Any        *catalog_hash)
+{
+  LoadError retval = SimpleCatalogManager::LoadCatalog(
+    mountpoint, hash, catalog_path, catalog_hash);
+  if (!catalog_deltas_ || (retval != kLoadNew))
+    return retval;
+
+  const string base_path = *catalog_path + ".base";
+  if (CopyPath2Path(*catalog_path, base_path)) {
+    base_copies_.insert(base_path);
+  } else {
+    LogCvmfs(kLogCatalog, kLogStderr, "failed to copy catalog %s, "
+             "no catalog delta", catalog_hash->ToString().c_str());
+    unlink(base_path.c_str());
+  }
+  return retval;
+}
+
+
 /**
  * This method is invoked if we create a completely new repository.
  * The new root catalog will already contain a root entry.
@@ -334,7 +369,9 @@ void WritableCatalogManager::AddFile(
     assert(false);
   }
 
-  assert(!entry.IsRegular() || !entry.checksum().IsNull());
+  // Chunked files might be stored without a bulk object
+  assert(!entry.IsRegular() || entry.IsChunkedFile() ||
+         !entry.checksum().IsNull());
   catalog->AddEntry(entry, xattrs, file_path, parent_path);
   SyncUnlock();
 }
@@ -702,7 +739,8 @@ manifest::Manifest *WritableCatalogManager::Commit(
         (*i)->SetRevision(manual_revision - 1);
       }
     }
-    shash::Any hash = SnapshotCatalog(*i);
+    string delta_reference;
+    shash::Any hash = SnapshotCatalog(*i, &delta_reference);
 
     if ((*i)->GetCounters().GetSelfEntries() > catalog_entry_warn_threshold_) {
       LogCvmfs(kLogCatalog, kLogStdout,
@@ -730,6 +768,7 @@ manifest::Manifest *WritableCatalogManager::Commit(
       result = new manifest::Manifest(hash, catalog_size, "");
       result->set_ttl((*i)->GetTTL());
       result->set_revision((*i)->GetRevision());
+      result->set_catalog_delta(delta_reference);
     }
   }
 
@@ -773,10 +812,13 @@ int WritableCatalogManager::GetModifiedCatalogsRecursively(
 
 /**
  * Makes a new catalog revision.  Compresses and uploads catalog.  Returns
- * content hash.
+ * content hash.  The delta reference of the new revision (see CatalogDelta) is
+ * stored in the parent catalog; for the root catalog, it is returned in
+ * delta_reference for the manifest.
  */
-shash::Any WritableCatalogManager::SnapshotCatalog(WritableCatalog *catalog)
-  const
+shash::Any WritableCatalogManager::SnapshotCatalog(
+  WritableCatalog *catalog,
+  string *delta_reference) const
 {
   LogCvmfs(kLogCatalog, kLogVerboseMsg, "creating snapshot of catalog '%s'",
            catalog->path().c_str());
@@ -793,17 +835,25 @@ shash::Any WritableCatalogManager::SnapshotCatalog(WritableCatalog *catalog)
   catalog->IncrementRevision();
 
   // Previous revision
+  shash::Any hash_previous;
   if (catalog->IsRoot()) {
-    catalog->SetPreviousRevision(base_hash());
+    hash_previous = base_hash();
   } else {
-    shash::Any hash_previous;
     uint64_t size_previous;
     const bool retval =
       catalog->parent()->FindNested(catalog->path(),
                                     &hash_previous, &size_previous);
     assert(retval);
-    catalog->SetPreviousRevision(hash_previous);
   }
+  catalog->SetPreviousRevision(hash_previous);
+
+  // The delta object is announced before it is created in order to keep the
+  // catalog's own hash stable
+  const bool upload_delta =
+    catalog_deltas_ && !hash_previous.IsNull() &&
+    (base_copies_.count(catalog->database_path() + ".base") > 0);
+  if (upload_delta || !catalog->GetDeltaBase().IsNull())
+    catalog->SetDeltaBase(upload_delta ? hash_previous : shash::Any());
   catalog->Commit();
 
   catalog->VacuumDatabaseIfNecessary();
@@ -824,6 +874,19 @@ shash::Any WritableCatalogManager::SnapshotCatalog(WritableCatalog *catalog)
   // Upload catalog
   spooler_->Upload(catalog->database_path() + ".compressed",
                    "data/" + hash_catalog.MakePath());
+  // Clients verify the reconstructed catalog against the uncompressed content
+  // hash because the compressed catalog depends on the zlib version
+  *delta_reference = "";
+  if (upload_delta &&
+      UploadCatalogDelta(catalog, hash_previous, hash_catalog))
+  {
+    shash::Any hash_content(spooler_->GetHashAlgorithm());
+    if (!shash::HashFile(catalog->database_path(), &hash_content)) {
+      PrintError("could not hash catalog " + catalog->path().ToString());
+      assert(false);
+    }
+    *delta_reference = CatalogDelta::MakeReference(hash_previous, hash_content);
+  }
 
   // Update registered catalog hash in nested catalog
   if (catalog->HasParent()) {
@@ -831,11 +894,63 @@ shash::Any WritableCatalogManager::SnapshotCatalog(WritableCatalog *catalog)
     WritableCatalog *parent = static_cast<WritableCatalog *>(catalog->parent());
     parent->UpdateNestedCatalog(catalog->path().ToString(), hash_catalog,
                                 catalog_size);
+    if (catalog_deltas_ ||
+        !parent->GetNestedDeltaReference(catalog->path()).empty())
+    {
+      parent->SetNestedDeltaReference(catalog->path().ToString(),
+                                      *delta_reference);
+    }
   }
 
   return hash_catalog;
 }
 
+/**
+ * Uploads data/<catalog hash>D.  If the delta is not much smaller than the
+ * catalog, a placeholder is uploaded instead, because the catalog already
+ * refers to the delta object.
+ * @return  true if a real delta, not a placeholder, was uploaded
+ */
+bool WritableCatalogManager::UploadCatalogDelta(
+  const WritableCatalog *catalog,
+  const shash::Any &hash_previous,
+  const shash::Any &catalog_hash) const
+{
+  const string base_path = catalog->database_path() + ".base";
+  const string delta_path = catalog->database_path() + ".delta";
+  const uint64_t catalog_size = GetFileSize(catalog->database_path());
+  UniquePtr<CatalogDelta> delta(
+    CatalogDelta::Create(base_path, hash_previous,
+                         catalog->database_path()));
+  unlink(base_path.c_str());
+  if (!delta.IsValid() || (delta->size() > catalog_size / 2)) {
+    LogCvmfs(kLogCatalog, kLogVerboseMsg, "no useful catalog delta for '%s'",
+             catalog->path().c_str());
+    delta = CatalogDelta::CreatePlaceholder(catalog_size);
+  } else {
+    LogCvmfs(kLogCatalog, kLogVerboseMsg, "catalog delta for '%s': "
+             "%u changed blocks out of %"PRIu64,
+             catalog->path().c_str(), delta->num_blocks(),
+             (catalog_size + CatalogDelta::kBlockSize - 1) /
+               CatalogDelta::kBlockSize);
+  }
+
+  if (!delta->Save(delta_path) ||
+      !zlib::CompressPath2Path(delta_path, delta_path + ".compressed"))
+  {
+    PrintError("could not create catalog delta " + delta_path);
+    assert(false);
+  }
+  unlink(delta_path.c_str());
+
+  shash::Any hash_delta(catalog_hash);
+  hash_delta.suffix = shash::kSuffixDelta;
+  spooler_->Upload(delta_path + ".compressed",
+                   "data/" + hash_delta.MakePath());
+  return !delta->IsPlaceholder();
+}
+
+
 void WritableCatalogManager::CatalogUploadCallback(
                                           const upload::SpoolerResult &result) {
   if (result.return_code != 0) {
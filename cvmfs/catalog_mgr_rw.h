@@ -112,9 +112,20 @@ class WritableCatalogManager : public SimpleCatalogManager {
   manifest::Manifest *Commit(const bool     stop_for_tweaks,
                              const uint64_t manual_revision);
 
+  /**
+   * Publish catalog deltas against the previous catalog revisions.  Has to be
+   * called before Init().
+   */
+  void EnableCatalogDeltas() { catalog_deltas_ = true; }
+
  protected:
   void EnforceSqliteMemLimit() { }
 
+  LoadError LoadCatalog(const PathString  &mountpoint,
+                        const shash::Any  &hash,
+                        std::string       *catalog_path,
+                        shash::Any        *catalog_hash);
+
   Catalog *CreateCatalog(const PathString &mountpoint,
                          const shash::Any &catalog_hash,
                          Catalog *parent_catalog);
@@ -140,7 +151,11 @@ class WritableCatalogManager : public SimpleCatalogManager {
   int GetModifiedCatalogsRecursively(const Catalog *catalog,
                                      WritableCatalogList *result) const;
 
-  shash::Any SnapshotCatalog(WritableCatalog *catalog) const;
+  shash::Any SnapshotCatalog(WritableCatalog *catalog,
+                             std::string *delta_reference) const;
+  bool UploadCatalogDelta(const WritableCatalog *catalog,
+                          const shash::Any &hash_previous,
+                          const shash::Any &catalog_hash) const;
   void CatalogUploadCallback(const upload::SpoolerResult &result);
 
  private:
@@ -156,6 +171,13 @@ class WritableCatalogManager : public SimpleCatalogManager {
 
   uint64_t catalog_entry_warn_threshold_;
 
+  bool catalog_deltas_;
+  /**
+   * Pristine copies of the loaded catalogs (<database path>.base), the base
+   * revisions of the catalog deltas
+   */
+  std::set<std::string> base_copies_;
+
   /**
    * Directories don't have extended attributes at this point.
    */
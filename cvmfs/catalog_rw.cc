@@ -145,8 +145,14 @@ void WritableCatalog::AddEntry(
                                         entry_path.c_str(),
                                         path().c_str());
 
-  shash::Md5 path_hash((shash::AsciiPtr(entry_path)));
-  shash::Md5 parent_hash((shash::AsciiPtr(parent_path)));
+  // Path and parent path hashes are computed together
+  const char *paths[2] = {entry_path.data(), parent_path.data()};
+  const unsigned lengths[2] = {static_cast<unsigned>(entry_path.length()),
+                               static_cast<unsigned>(parent_path.length())};
+  shash::Md5 path_hashes[2];
+  shash::Md5Multi(2, paths, lengths, path_hashes);
+  const shash::Md5 &path_hash = path_hashes[0];
+  const shash::Md5 &parent_hash = path_hashes[1];
   DirectoryEntry effective_entry(entry);
   effective_entry.set_has_xattrs(!xattrs.IsEmpty());
 
@@ -319,6 +325,28 @@ void WritableCatalog::SetPreviousRevision(const shash::Any &hash) {
 }
 
 
+/**
+ * Announces a catalog delta object (data/<catalog hash>D) against the given
+ * base revision.  A null hash removes the announcement.
+ */
+void WritableCatalog::SetDeltaBase(const shash::Any &hash) {
+  database().SetProperty("delta_base",
+                         hash.IsNull() ? string("") : hash.ToString());
+}
+
+
+/**
+ * Stores the delta reference (see CatalogDelta) for the current revision of
+ * the nested catalog at the given mountpoint.  An empty reference means that
+ * the nested catalog has no catalog delta.
+ */
+void WritableCatalog::SetNestedDeltaReference(const string &mountpoint,
+                                              const string &reference)
+{
+  database().SetProperty("nested_delta:" + mountpoint, reference);
+}
+
+
 /**
  * Moves a subtree from this catalog into a just created nested catalog.
  */
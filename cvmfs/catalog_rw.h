@@ -90,6 +90,9 @@ class WritableCatalog : public Catalog {
   void IncrementRevision();
   void SetRevision(const uint64_t new_revision);
   void SetPreviousRevision(const shash::Any &hash);
+  void SetDeltaBase(const shash::Any &hash);
+  void SetNestedDeltaReference(const std::string &mountpoint,
+                               const std::string &reference);
 
  protected:
   static const double kMaximalFreePageRatio   = 0.20;
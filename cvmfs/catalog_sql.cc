@@ -320,7 +320,7 @@ uint64_t SqlDirent::MakeHardlinks(const uint32_t hardlink_group,
  * Expands variant symlinks containing $(VARIABLE) string.  Uses the environment
  * variables of the current process (cvmfs2)
  */
-void SqlDirent::ExpandSymlink(LinkString *raw_symlink) const {
+void SqlDirent::ExpandSymlink(LinkString *raw_symlink) {
   const char *c = raw_symlink->GetChars();
   const char *cEnd = c+raw_symlink->GetLength();
   for (; c < cEnd; ++c) {
@@ -428,10 +428,10 @@ SqlListContentHashes::SqlListContentHashes(const CatalogDatabase &database) {
       "UNION "
       "SELECT chunks.hash, catalog.flags, 1 "
       "  FROM catalog "
-      "  LEFT JOIN chunks "
+      "  INNER JOIN chunks "
       "  ON catalog.md5path_1 = chunks.md5path_1 AND "
       "     catalog.md5path_2 = chunks.md5path_2 "
-      "  WHERE length(catalog.hash) > 0;";
+      "  WHERE length(chunks.hash) > 0;";
 
   const bool successful_init = Init(database.sqlite_db(), statement);
   assert(successful_init);
@@ -568,6 +568,55 @@ DirectoryEntry SqlLookup::GetDirent(const Catalog *catalog,
 }
 
 
+/**
+ * This method is a friend of DirectoryEntry.
+ */
+DirectoryEntry SqlLookup::GetRawDirent() const {
+  DirectoryEntry result;
+
+  const unsigned database_flags = RetrieveInt(5);
+  result.is_nested_catalog_root_ = (database_flags & kFlagDirNestedRoot);
+  result.is_nested_catalog_mountpoint_ =
+    (database_flags & kFlagDirNestedMountpoint);
+  const char *name = reinterpret_cast<const char *>(RetrieveText(6));
+  const char *symlink = reinterpret_cast<const char *>(RetrieveText(7));
+
+  const uint64_t hardlinks = RetrieveInt64(1);
+  result.linkcount_       = Hardlinks2Linkcount(hardlinks);
+  result.hardlink_group_  = Hardlinks2HardlinkGroup(hardlinks);
+  result.is_chunked_file_ = (database_flags & kFlagFileChunk);
+  result.has_xattrs_      = RetrieveInt(15) != 0;
+  result.checksum_        =
+    RetrieveHashBlob(0, RetrieveHashAlgorithm(database_flags));
+  result.uid_             = RetrieveInt64(13);
+  result.gid_             = RetrieveInt64(14);
+  result.mode_            = RetrieveInt(3);
+  result.size_            = RetrieveInt64(2);
+  result.mtime_           = RetrieveInt64(4);
+  result.name_.Assign(name, strlen(name));
+  result.symlink_.Assign(symlink, strlen(symlink));
+
+  return result;
+}
+
+
+uint64_t SqlLookup::GetRowId() const {
+  return RetrieveInt64(12);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+SqlAllDirents::SqlAllDirents(const CatalogDatabase &database) {
+  const string statement =
+    "SELECT " +
+    GetFieldsToSelect(database.schema_version(), database.schema_revision()) +
+    " FROM catalog;";
+  Init(database.sqlite_db(), statement);
+}
+
+
 //------------------------------------------------------------------------------
 
 
@@ -185,6 +185,13 @@ class SqlDirent : public Sql {
   // hashes
   static const int kFlagPosHash             = 8;
 
+  /**
+   * Replaces place holder variables in a symbolic link by actual path elements.
+   * @param raw_symlink the raw symlink path (may) containing place holders
+   * @return the expanded symlink
+   */
+  static void ExpandSymlink(LinkString *raw_symlink);
+
  protected:
   /**
    * Take the meta data from the DirectoryEntry and transform it
@@ -205,13 +212,6 @@ class SqlDirent : public Sql {
   uint32_t Hardlinks2HardlinkGroup(const uint64_t hardlinks) const;
   uint64_t MakeHardlinks(const uint32_t hardlink_group,
                          const uint32_t linkcount) const;
-
-  /**
-   * Replaces place holder variables in a symbolic link by actual path elements.
-   * @param raw_symlink the raw symlink path (may) containing place holders
-   * @return the expanded symlink
-   */
-  void ExpandSymlink(LinkString *raw_symlink) const;
 };
 
 
@@ -287,6 +287,26 @@ class SqlLookup : public SqlDirent {
    * @return the MD5 parent path hash of a freshly performed lookup
    */
   shash::Md5 GetParentPathHash() const;
+
+  /**
+   * Retrieves a DirectoryEntry as it is stored in the database, i.e. without
+   * inode, owner mapping, and symlink expansion.  Requires schema 2.1 or newer.
+   * @return the stored DirectoryEntry of a freshly performed lookup
+   */
+  DirectoryEntry GetRawDirent() const;
+  uint64_t GetRowId() const;
+};
+
+
+//------------------------------------------------------------------------------
+
+
+/**
+ * Iterates over all directory entries of a catalog, used to compile catalogs.
+ */
+class SqlAllDirents : public SqlLookup {
+ public:
+  explicit SqlAllDirents(const CatalogDatabase &database);
 };
 
 
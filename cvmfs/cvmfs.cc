@@ -65,6 +65,7 @@
 #include <string>
 #include <vector>
 
+#include "access_log.h"
 #include "atomic.h"
 #include "auto_umount.h"
 #include "backoff.h"
@@ -122,6 +123,7 @@ const unsigned kReloadSafetyMargin = 500;  // in milliseconds
 const unsigned kDefaultNumConnections = 16;
 const uint64_t kDefaultMemcache = 16*1024*1024;  // 16M RAM for meta-data caches
 const uint64_t kDefaultCacheSizeMb = 1024*1024*1024;  // 1G
+const unsigned kWarmSubtreeThreads = 8;  // parallel catalog downloads
 /**
  * If catalog reload fails, try again in 3 minutes
  */
@@ -227,14 +229,14 @@ uint64_t next_directory_handle_ = 0;
 ChunkTables *chunk_tables_;
 
 perf::Statistics *statistics_ = NULL;
-perf::Counter *n_fs_open_ = NULL;
-perf::Counter *n_fs_dir_open_ = NULL;
-perf::Counter *n_fs_lookup_ = NULL;
-perf::Counter *n_fs_lookup_negative_ = NULL;
-perf::Counter *n_fs_stat_ = NULL;
-perf::Counter *n_fs_read_ = NULL;
-perf::Counter *n_fs_readlink_ = NULL;
-perf::Counter *n_fs_forget_ = NULL;
+perf::ShardedCounter *n_fs_open_ = NULL;
+perf::ShardedCounter *n_fs_dir_open_ = NULL;
+perf::ShardedCounter *n_fs_lookup_ = NULL;
+perf::ShardedCounter *n_fs_lookup_negative_ = NULL;
+perf::ShardedCounter *n_fs_stat_ = NULL;
+perf::ShardedCounter *n_fs_read_ = NULL;
+perf::ShardedCounter *n_fs_readlink_ = NULL;
+perf::ShardedCounter *n_fs_forget_ = NULL;
 perf::Counter *n_io_error_ = NULL;
 /**
  *  number of currently open files by Fuse calls
@@ -333,6 +335,40 @@ std::string GetOpenCatalogs() {
 }
 
 
+/**
+ * Number of entries and memory per entry of the meta-data caches.  The memory
+ * of an entry is its preallocated hash table and LRU list slot plus the
+ * average size of the packed value.
+ */
+std::string GetMemcacheStatistics() {
+  const uint64_t num_dirents = lru::PackedDirent::num_instances();
+  const uint64_t num_paths = lru::PackedPath::num_instances();
+  const int64_t packed_dirent_size = (num_dirents == 0) ? 0 :
+    lru::PackedDirent::sz_bytes() / num_dirents;
+  const int64_t packed_path_size = (num_paths == 0) ? 0 :
+    lru::PackedPath::sz_bytes() / num_paths;
+  const int64_t inode_entry_size = packed_dirent_size + static_cast<int64_t>(
+    lru::LruCache<fuse_ino_t, lru::PackedDirent>::GetEntrySize());
+  const int64_t path_entry_size = packed_path_size + static_cast<int64_t>(
+    lru::LruCache<fuse_ino_t, lru::PackedPath>::GetEntrySize());
+  const int64_t md5path_entry_size = packed_dirent_size + static_cast<int64_t>(
+    lru::LruCache<shash::Md5, lru::PackedDirent>::GetEntrySize());
+
+  std::string result;
+  result += "  Inode cache: " + StringifyInt(inode_cache_->num_entries()) +
+    " entries, " + StringifyInt(inode_entry_size) + " bytes per entry\n";
+  result += "  Path cache: " + StringifyInt(path_cache_->num_entries()) +
+    " entries, " + StringifyInt(path_entry_size) + " bytes per entry\n";
+  result += "  Md5 path cache: " + StringifyInt(md5path_cache_->num_entries()) +
+    " entries, " + StringifyInt(md5path_entry_size) + " bytes per entry\n";
+  result += "  Packed directory entries: " + StringifyInt(num_dirents) +
+    " (" + StringifyInt(packed_dirent_size) + " bytes on average)\n";
+  result += "  Packed paths: " + StringifyInt(num_paths) +
+    " (" + StringifyInt(packed_path_size) + " bytes on average)\n";
+  return result;
+}
+
+
 void ResetErrorCounters() {
   n_io_error_->Set(0);
 }
@@ -539,9 +575,10 @@ static bool GetDirentForPath(const PathString &path,
     return true;
   }
 
-  // Lookup inode in catalog TODO: not twice md5 calculation
+  // Lookup inode in catalog
   bool retval;
-  retval = catalog_manager_->LookupPath(path, catalog::kLookupSole, dirent);
+  retval = catalog_manager_->LookupPath(path, md5path, catalog::kLookupSole,
+                                        dirent);
   if (retval) {
     if (nfs_maps_) {
       // Fix inode
@@ -1070,6 +1107,14 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
         return;
       }
       remount_fence_->Leave();
+      if (access_log::active_) {
+        const shash::Md5 path_hash(path.GetChars(), path.GetLength());
+        for (unsigned i = 0; i < chunks->size(); ++i) {
+          access_log::Log(access_log::kRecordChunk, path_hash,
+                          chunks->AtPtr(i)->content_hash(),
+                          chunks->AtPtr(i)->offset(), chunks->AtPtr(i)->size());
+        }
+      }
 
       chunk_tables_->Lock();
       // Check again to avoid race
@@ -1103,6 +1148,11 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
     return;
   }
 
+  if (access_log::active_) {
+    access_log::Log(access_log::kRecordObject,
+                    shash::Md5(path.GetChars(), path.GetLength()),
+                    dirent.checksum(), 0, dirent.size());
+  }
   fd = fetcher_->Fetch(
     dirent.checksum(),
     dirent.size(),
@@ -1706,6 +1756,23 @@ bool Pin(const string &path) {
 }
 
 
+/**
+ * Fetches the nested catalogs below path into the cache, so that jobs
+ * traversing the subtree don't load them one by one.
+ */
+bool WarmSubtree(const string &path, const bool pin, unsigned *num_catalogs) {
+  string prefix = path;
+  while (!prefix.empty() && (prefix[prefix.length()-1] == '/'))
+    prefix.erase(prefix.length()-1);
+
+  remount_fence_->Enter();
+  const bool retval = catalog_manager_->WarmSubtree(
+    PathString(prefix), pin, kWarmSubtreeThreads, num_catalogs);
+  remount_fence_->Leave();
+  return retval;
+}
+
+
 /**
  * Do after-daemon() initialization
  */
@@ -1814,6 +1881,7 @@ static int Init(const loader::LoaderExports *loader_exports) {
   cvmfs::loader_exports_ = loader_exports;
 
   uint64_t mem_cache_size = cvmfs::kDefaultMemcache;
+  uint64_t catalog_mmap_size = 0;
   unsigned timeout = cvmfs::kDefaultTimeout;
   unsigned timeout_direct = cvmfs::kDefaultTimeout;
   unsigned low_speed_limit = cvmfs::kDefaultLowSpeedLimit;
@@ -1824,13 +1892,20 @@ static int Init(const loader::LoaderExports *loader_exports) {
   unsigned backoff_max = 10000;
   bool send_info_header = false;
   unsigned max_ipaddr_per_proxy = 0;
+  unsigned max_interactive_downloads = 0;
+  unsigned max_background_downloads = 0;
   string tracefile = "";
+  string access_log = "";
   string cachedir = string(cvmfs::kDefaultCachedir);
   unsigned max_ttl = 0;
   int kcache_timeout = 0;
   bool rebuild_cachedb = false;
   bool nfs_source = false;
   bool nfs_shared = false;
+  bool catalog_deltas = false;
+  bool compiled_catalogs = false;
+  bool cooperative_downloads = false;
+  bool drop_written_pages = false;
   string nfs_shared_dir = string(cvmfs::kDefaultCachedir);
   bool shared_cache = false;
   int64_t quota_limit = cvmfs::kDefaultCacheSizeMb;
@@ -1892,6 +1967,8 @@ static int Init(const loader::LoaderExports *loader_exports) {
   // Overwrite default options
   if (cvmfs::options_manager_->GetValue("CVMFS_MEMCACHE_SIZE", &parameter))
     mem_cache_size = String2Uint64(parameter) * 1024*1024;
+  if (cvmfs::options_manager_->GetValue("CVMFS_CATALOG_MMAP_SIZE", &parameter))
+    catalog_mmap_size = String2Uint64(parameter) * 1024*1024;
   if (cvmfs::options_manager_->GetValue("CVMFS_TIMEOUT", &parameter))
     timeout = String2Uint64(parameter);
   if (cvmfs::options_manager_->GetValue("CVMFS_TIMEOUT_DIRECT", &parameter))
@@ -1918,6 +1995,16 @@ static int Init(const loader::LoaderExports *loader_exports) {
   {
     max_ipaddr_per_proxy = String2Uint64(parameter);
   }
+  if (cvmfs::options_manager_->GetValue("CVMFS_MAX_INTERACTIVE_DOWNLOADS",
+                                        &parameter))
+  {
+    max_interactive_downloads = String2Uint64(parameter);
+  }
+  if (cvmfs::options_manager_->GetValue("CVMFS_MAX_BACKGROUND_DOWNLOADS",
+                                        &parameter))
+  {
+    max_background_downloads = String2Uint64(parameter);
+  }
   if (cvmfs::options_manager_->GetValue("CVMFS_USE_GEOAPI", &parameter) &&
       cvmfs::options_manager_->IsOn(parameter))
   {
@@ -1930,6 +2017,10 @@ static int Init(const loader::LoaderExports *loader_exports) {
   }
   if (cvmfs::options_manager_->GetValue("CVMFS_TRACEFILE", &parameter))
     tracefile = parameter;
+  if (cvmfs::options_manager_->GetValue("CVMFS_ACCESS_LOG", &parameter)) {
+    access_log =
+      ReplaceAll(parameter, "@fqrn@", loader_exports->repository_name);
+  }
   if (cvmfs::options_manager_->GetValue("CVMFS_MAX_TTL", &parameter))
     max_ttl = String2Uint64(parameter);
   if (cvmfs::options_manager_->GetValue("CVMFS_KCACHE_TIMEOUT", &parameter))
@@ -1973,6 +2064,17 @@ static int Init(const loader::LoaderExports *loader_exports) {
   {
     cvmfs::fixed_catalog_ = true;
   }
+  if (cvmfs::options_manager_->GetValue("CVMFS_CATALOG_DELTAS", &parameter) &&
+      cvmfs::options_manager_->IsOn(parameter))
+  {
+    catalog_deltas = true;
+  }
+  if (cvmfs::options_manager_->GetValue("CVMFS_COMPILED_CATALOGS",
+                                        &parameter) &&
+      cvmfs::options_manager_->IsOn(parameter))
+  {
+    compiled_catalogs = true;
+  }
   if (cvmfs::options_manager_->GetValue("CVMFS_HIDE_MAGIC_XATTRS", &parameter)
       && cvmfs::options_manager_->IsOn(parameter))
   {
@@ -2000,6 +2102,18 @@ static int Init(const loader::LoaderExports *loader_exports) {
   if (cvmfs::options_manager_->GetValue("CVMFS_ALIEN_CACHE", &parameter)) {
     alien_cache = parameter;
   }
+  if (cvmfs::options_manager_->GetValue("CVMFS_COOPERATIVE_DOWNLOADS",
+                                        &parameter) &&
+      cvmfs::options_manager_->IsOn(parameter))
+  {
+    cooperative_downloads = true;
+  }
+  if (cvmfs::options_manager_->GetValue("CVMFS_CACHE_DROP_WRITTEN_PAGES",
+                                        &parameter) &&
+      cvmfs::options_manager_->IsOn(parameter))
+  {
+    drop_written_pages = true;
+  }
   if (cvmfs::options_manager_->GetValue("CVMFS_UID_MAP", &parameter)) {
     retval = cvmfs::options_manager_->ParseUIntMap(parameter, &uid_map);
     if (!retval) {
@@ -2072,6 +2186,13 @@ static int Init(const loader::LoaderExports *loader_exports) {
   // 4 KB
   retval = sqlite3_config(SQLITE_CONFIG_LOOKASIDE, 32, 128);
   assert(retval == SQLITE_OK);
+  // Catalogs are memory mapped by the read-only VFS within this budget
+  if (catalog_mmap_size > 0) {
+    retval = sqlite3_config(SQLITE_CONFIG_MMAP_SIZE,
+                            static_cast<sqlite3_int64>(catalog_mmap_size),
+                            static_cast<sqlite3_int64>(catalog_mmap_size));
+    assert(retval == SQLITE_OK);
+  }
 
   // Disable SQlite3 locks
   retval = sqlite3_vfs_register(sqlite3_vfs_find("unix-none"), 1);
@@ -2100,22 +2221,22 @@ static int Init(const loader::LoaderExports *loader_exports) {
   cvmfs::chunk_tables_ = new ChunkTables();
 
   // Runtime counters
-  cvmfs::n_fs_open_ = cvmfs::statistics_->Register("cvmfs.n_fs_open",
+  cvmfs::n_fs_open_ = cvmfs::statistics_->RegisterSharded("cvmfs.n_fs_open",
       "Overall number of file open operations");
-  cvmfs::n_fs_dir_open_ = cvmfs::statistics_->Register("cvmfs.n_fs_dir_open",
-      "Overall number of directory open operations");
-  cvmfs::n_fs_lookup_ = cvmfs::statistics_->Register("cvmfs.n_fs_lookup",
-      "Number of lookups");
-  cvmfs::n_fs_lookup_negative_ = cvmfs::statistics_->Register(
+  cvmfs::n_fs_dir_open_ = cvmfs::statistics_->RegisterSharded(
+      "cvmfs.n_fs_dir_open", "Overall number of directory open operations");
+  cvmfs::n_fs_lookup_ = cvmfs::statistics_->RegisterSharded(
+      "cvmfs.n_fs_lookup", "Number of lookups");
+  cvmfs::n_fs_lookup_negative_ = cvmfs::statistics_->RegisterSharded(
       "cvmfs.n_fs_lookup_negative", "Number of negative lookups");
-  cvmfs::n_fs_stat_ = cvmfs::statistics_->Register("cvmfs.n_fs_stat",
+  cvmfs::n_fs_stat_ = cvmfs::statistics_->RegisterSharded("cvmfs.n_fs_stat",
       "Number of stats");
-  cvmfs::n_fs_read_ = cvmfs::statistics_->Register("cvmfs.n_fs_read",
+  cvmfs::n_fs_read_ = cvmfs::statistics_->RegisterSharded("cvmfs.n_fs_read",
       "Number of files read");
-  cvmfs::n_fs_readlink_ = cvmfs::statistics_->Register("cvmfs.n_fs_readlink",
-      "Number of links read");
-  cvmfs::n_fs_forget_ = cvmfs::statistics_->Register("cvmfs.n_fs_forget",
-      "Number of inode forgets");
+  cvmfs::n_fs_readlink_ = cvmfs::statistics_->RegisterSharded(
+      "cvmfs.n_fs_readlink", "Number of links read");
+  cvmfs::n_fs_forget_ = cvmfs::statistics_->RegisterSharded(
+      "cvmfs.n_fs_forget", "Number of inode forgets");
   cvmfs::n_io_error_ = cvmfs::statistics_->Register("cvmfs.n_io_error",
       "Number of I/O errors");
 
@@ -2198,13 +2319,16 @@ static int Init(const loader::LoaderExports *loader_exports) {
       return loader::kFailCacheDir;
     }
   }
-  cvmfs::cache_manager_ =
+  cache::PosixCacheManager *posix_cache_manager =
     cache::PosixCacheManager::Create(alien_cache, alien_cache != ".");
-  if (cvmfs::cache_manager_ == NULL) {
+  if (posix_cache_manager == NULL) {
     *g_boot_error = "Failed to setup cache in " + alien_cache +
                     ": " + strerror(errno);
     return loader::kFailCacheDir;
   }
+  posix_cache_manager->set_cooperative_downloads(cooperative_downloads);
+  posix_cache_manager->set_drop_written_pages(drop_written_pages);
+  cvmfs::cache_manager_ = posix_cache_manager;
   CreateFile("./.cvmfscache", 0600);
 
   // Init quota / managed cache
@@ -2328,6 +2452,14 @@ static int Init(const loader::LoaderExports *loader_exports) {
                                                backoff_init,
                                                backoff_max);
   cvmfs::download_manager_->SetMaxIpaddrPerProxy(max_ipaddr_per_proxy);
+  if (max_interactive_downloads > 0) {
+    cvmfs::download_manager_->SetPriorityLimit(download::kPriorityInteractive,
+                                               max_interactive_downloads);
+  }
+  if (max_background_downloads > 0) {
+    cvmfs::download_manager_->SetPriorityLimit(download::kPriorityBackground,
+                                               max_background_downloads);
+  }
   cvmfs::download_manager_->SetProxyTemplates(uuid->uuid(), proxy_template);
   delete uuid;
   uuid = NULL;
@@ -2375,9 +2507,20 @@ static int Init(const loader::LoaderExports *loader_exports) {
     cvmfs::backoff_throttle_,
     cvmfs::statistics_);
 
+  // Before the first catalog is loaded, catalogs are part of the access log
+  if (access_log != "") {
+    if (!access_log::Init(access_log)) {
+      *g_boot_error = "failed to open access log " + access_log;
+      return loader::kFailOptions;
+    }
+  } else {
+    access_log::InitNull();
+  }
+
   // Load initial file catalog
   retval = sqlite::RegisterVfsRdOnly(
-    cvmfs::cache_manager_, cvmfs::statistics_, sqlite::kVfsOptDefault);
+    cvmfs::cache_manager_, cvmfs::statistics_, sqlite::kVfsOptDefault,
+    catalog_mmap_size);
   assert(retval);
   LogCvmfs(kLogCvmfs, kLogDebug, "fuse inode size is %d bits",
            sizeof(fuse_ino_t) * 8);
@@ -2392,6 +2535,10 @@ static int Init(const loader::LoaderExports *loader_exports) {
     cvmfs::catalog_manager_->SetInodeAnnotation(cvmfs::inode_annotation_);
   }
   cvmfs::catalog_manager_->SetOwnerMaps(uid_map, gid_map);
+  if (catalog_deltas)
+    cvmfs::catalog_manager_->EnableCatalogDeltas();
+  if (compiled_catalogs)
+    cvmfs::catalog_manager_->EnableCompiledCatalogs();
 
   // Load specific tag (root hash has precedence, then repository_tag)
   if ((root_hash == "") &&
@@ -2525,6 +2672,7 @@ static void Spawn() {
   }
   cvmfs::download_manager_->Spawn();
   cvmfs::cache_manager_->quota_mgr()->Spawn();
+  cvmfs::catalog_manager_->Spawn();
   if (cvmfs::cache_manager_->quota_mgr()->IsEnforcing()) {
     cvmfs::watchdog_listener_ = quota::RegisterWatchdogListener(
       cvmfs::cache_manager_->quota_mgr(),
@@ -2539,7 +2687,7 @@ static void Spawn() {
     nfs_maps::Spawn();
 
   if (*cvmfs::tracefile_ != "")
-    tracer::Init(8192, 7000, *cvmfs::tracefile_);
+    tracer::Init(1024, 768, *cvmfs::tracefile_);
   else
     tracer::InitNull();
 }
@@ -2566,6 +2714,7 @@ static void Fini() {
   }
 
   tracer::Fini();
+  access_log::Fini();
   if (g_signature_ready) cvmfs::signature_manager_->Fini();
   if (g_download_ready) cvmfs::download_manager_->Fini();
   if (g_nfs_maps_ready) nfs_maps::Fini();
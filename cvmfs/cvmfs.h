@@ -45,10 +45,13 @@ extern perf::Statistics *statistics_;
 
 bool Evict(const std::string &path);
 bool Pin(const std::string &path);
+bool WarmSubtree(const std::string &path, const bool pin,
+                 unsigned *num_catalogs);
 catalog::LoadError RemountStart();
 void GetReloadStatus(bool *drainout_mode, bool *maintenance_mode);
 unsigned GetRevision();
 std::string GetOpenCatalogs();
+std::string GetMemcacheStatistics();
 unsigned GetMaxTTL();  // in minutes
 void SetMaxTTL(const unsigned value);  // in minutes
 void ResetErrorCounters();
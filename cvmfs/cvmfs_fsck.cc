@@ -10,18 +10,25 @@
 
 #include "cvmfs_config.h"
 
+#include <alloca.h>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdint.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "atomic.h"
 #include "compression.h"
@@ -42,19 +49,25 @@ enum Errors {
   kErrorUsage = 16,
 };
 
+/**
+ * Files are read and compressed in blocks of this size.
+ */
+const unsigned kBlockSize = 1024 * 1024;
+const int kNumCacheDirs = 256;
+/**
+ * Records when every cache sub directory was verified completely.
+ */
+const char *kCheckpointFile = "fsck_checkpoint";
+
 string *g_cache_dir;
 atomic_int32 g_num_files;
+atomic_int32 g_num_skipped;
+atomic_int64 g_num_bytes;
 atomic_int32 g_num_err_fixed;
 atomic_int32 g_num_err_unfixed;
 atomic_int32 g_num_err_operational;
 atomic_int32 g_num_tmp_catalog;
-/**
- * Traversal of the file system tree is serialized.
- */
-pthread_mutex_t g_lock_traverse = PTHREAD_MUTEX_INITIALIZER;
-DIR *g_DIRP_current = NULL;
-int g_num_dirs = -1;  /**< Number of cache directories already examined. */
-string *g_current_dir;  /**< Current cache sub directory */
+timeval g_time_start;
 
 int g_num_threads = 1;
 bool g_fix_errors = false;
@@ -62,6 +75,33 @@ bool g_verbose = false;
 atomic_int32 g_force_rebuild;
 atomic_int32 g_modified_cache;
 
+/**
+ * I/O bandwidth limit in bytes per second, 0 for unlimited.  All worker
+ * threads share a token bucket that holds at most kThrottleBurst seconds worth
+ * of bytes, so that idle periods (e.g. skipped directories) do not build up
+ * credit for a burst at full speed.  The bucket goes negative when workers
+ * read ahead of the limit; they then sleep until the debt is paid off.
+ */
+const double kThrottleBurst = 0.25;
+uint64_t g_max_bandwidth = 0;
+double g_throttle_tokens = 0.0;
+double g_throttle_last = 0.0;
+pthread_mutex_t g_lock_throttle = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Incremental checks: files of cache directories verified within the last
+ * g_incremental_days days (or verified by an interrupted run that is resumed)
+ * are skipped unless they were added to the cache afterwards.
+ */
+int g_incremental_days = -1;
+bool g_resume = false;
+bool g_use_checkpoint = false;
+time_t g_run_started = 0;
+time_t g_prev_run_started = 0;
+time_t g_prev_run_finished = 0;
+time_t g_dir_verified[kNumCacheDirs];
+pthread_mutex_t g_lock_checkpoint = PTHREAD_MUTEX_INITIALIZER;
+
 
 static void Usage() {
   LogCvmfs(kLogCvmfs, kLogStdout,
@@ -69,167 +109,351 @@ static void Usage() {
            "This tool checks a cvmfs cache directory for consistency.\n"
            "If necessary, the managed cache db is removed so that\n"
            "it will be rebuilt on next mount.\n\n"
-           "Usage: cvmfs_fsck [-v] [-p] [-f] [-j #threads] <cache directory>\n"
+           "Usage: cvmfs_fsck [-v] [-p] [-f] [-j #threads] [-b MB/s] [-n]\n"
+           "                  [-i days] [-r] <cache directory>\n"
            "Options:\n"
            "  -v verbose output\n"
            "  -p try to fix automatically\n"
            "  -f force rebuild of managed cache db on next mount\n"
-           "  -j number of concurrent integrity check worker threads\n",
+           "  -j number of concurrent integrity check worker threads\n"
+           "  -b limit the I/O bandwidth to the given MB/s\n"
+           "  -n run in the background with lowest CPU and I/O priority\n"
+           "  -i incremental check, skip files verified within the given days\n"
+           "  -r resume an interrupted incremental check\n",
            VERSION);
 }
 
 
-static bool GetNextFile(string *relative_path, string *hash_name) {
-  platform_dirent64 *d = NULL;
+static double GetElapsedTime() {
+  timeval now;
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - g_time_start.tv_sec) +
+         (now.tv_usec - g_time_start.tv_usec) / 1000000.0;
+}
 
-  pthread_mutex_lock(&g_lock_traverse);
- get_next_file_again:
-  while (g_DIRP_current && ((d = platform_readdir(g_DIRP_current)) != NULL)) {
-    const string name = d->d_name;
-    if ((name == ".") || (name == "..")) continue;
 
-    platform_stat64 info;
-    *relative_path = *g_current_dir + "/" + name;
-    *hash_name = *g_current_dir + name;
-    const string path = *g_cache_dir + "/" + *relative_path;
-    if (platform_lstat(relative_path->c_str(), &info) != 0) {
-      LogCvmfs(kLogCvmfs, kLogStdout, "Warning: failed to stat() %s (%d)",
-               path.c_str(), errno);
-      continue;
-    }
+/**
+ * Takes nbytes from the token bucket and delays the calling worker until the
+ * bucket is refilled to zero.
+ */
+static void Throttle(const uint64_t nbytes) {
+  if (g_max_bandwidth == 0)
+    return;
+
+  pthread_mutex_lock(&g_lock_throttle);
+  const double now = GetElapsedTime();
+  const double burst = kThrottleBurst * g_max_bandwidth;
+  g_throttle_tokens = std::min(burst,
+    g_throttle_tokens + (now - g_throttle_last) * g_max_bandwidth);
+  g_throttle_last = now;
+  g_throttle_tokens -= static_cast<double>(nbytes);
+  const double wait =
+    (g_throttle_tokens < 0.0) ? -g_throttle_tokens / g_max_bandwidth : 0.0;
+  pthread_mutex_unlock(&g_lock_throttle);
+
+  if (wait > 0.0)
+    SafeSleepMs(static_cast<unsigned>(wait * 1000));
+}
 
-    if (!S_ISREG(info.st_mode)) {
-      LogCvmfs(kLogCvmfs, kLogStdout, "Warning: %s is not a regular file",
-               path.c_str());
-      continue;
-    }
 
-    break;
+static void LoadCheckpoint() {
+  memset(g_dir_verified, 0, sizeof(g_dir_verified));
+  FILE *f = fopen(kCheckpointFile, "r");
+  if (f == NULL)
+    return;
+
+  char key[16];
+  uint64_t value;
+  while (fscanf(f, "%15s %" SCNu64, key, &value) == 2) {
+    const string k = key;
+    if (k == "started") {
+      g_prev_run_started = value;
+    } else if (k == "finished") {
+      g_prev_run_finished = value;
+    } else {
+      const int dir = strtol(key, NULL, 16);
+      if ((k.length() == 2) && (dir >= 0) && (dir < kNumCacheDirs))
+        g_dir_verified[dir] = value;
+    }
   }
+  fclose(f);
+}
 
-  if (!d) {
-    if (g_DIRP_current) {
-      closedir(g_DIRP_current);
-      g_DIRP_current = NULL;
-    }
-    g_num_dirs++;
-    if (g_num_dirs < 256) {
-      char hex[3];
-      snprintf(hex, sizeof(hex), "%02x", g_num_dirs);
-      *g_current_dir = string(hex, 2);
-
-      if (g_verbose)
-        LogCvmfs(kLogCvmfs, kLogStdout, "Entering %s", g_current_dir->c_str());
-      if ((g_DIRP_current = opendir(hex)) == NULL) {
-        LogCvmfs(kLogCvmfs, kLogStderr,
-                 "Invalid cache directory, %s/%s does not exist",
-                 g_cache_dir->c_str(), g_current_dir->c_str());
-        pthread_mutex_unlock(&g_lock_traverse);
-        exit(kErrorUnfixed);
+
+/**
+ * Rewrites the checkpoint file after a cache directory is done or when the
+ * run is finished.  The file is replaced atomically.
+ */
+static void SaveCheckpoint(const int dir, const time_t verified,
+                           const time_t finished)
+{
+  pthread_mutex_lock(&g_lock_checkpoint);
+  if (dir >= 0)
+    g_dir_verified[dir] = verified;
+
+  const string tmp_path = string(kCheckpointFile) + ".tmp";
+  FILE *f = fopen(tmp_path.c_str(), "w");
+  bool retval = (f != NULL);
+  if (retval) {
+    fprintf(f, "started %" PRIu64 "\nfinished %" PRIu64 "\n",
+            static_cast<uint64_t>(g_run_started),
+            static_cast<uint64_t>(finished));
+    for (int i = 0; i < kNumCacheDirs; ++i) {
+      if (g_dir_verified[i] > 0) {
+        fprintf(f, "%02x %" PRIu64 "\n",
+                i, static_cast<uint64_t>(g_dir_verified[i]));
       }
-      goto get_next_file_again;
     }
+    retval = (fclose(f) == 0) &&
+             (rename(tmp_path.c_str(), kCheckpointFile) == 0);
+  }
+  if (!retval) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "Warning: failed to write %s/%s (%d)",
+             g_cache_dir->c_str(), kCheckpointFile, errno);
   }
-  pthread_mutex_unlock(&g_lock_traverse);
+  pthread_mutex_unlock(&g_lock_checkpoint);
+}
 
-  if (d)
-    return true;
 
-  return false;
+/**
+ * Files of the cache directory that are older than the returned time don't
+ * need to be checked again.  Returns 0 if all files need to be checked.
+ */
+static time_t GetVerifiedSince(const int dir) {
+  const time_t verified = g_dir_verified[dir];
+  if (verified == 0)
+    return 0;
+  if (g_resume && (g_prev_run_finished == 0) &&
+      (verified >= g_prev_run_started))
+  {
+    return verified;
+  }
+  if ((g_incremental_days >= 0) &&
+      (verified + g_incremental_days * 86400 > g_run_started))
+  {
+    return verified;
+  }
+  return 0;
 }
 
 
-static void *MainCheck(void *data __attribute__((unused))) {
-  string relative_path;
-  string hash_name;
+/**
+ * Compresses the file in large sequential blocks and calculates the hash of
+ * the compressed stream.
+ */
+static bool CompressAndHash(int fd_src, unsigned char *buffer,
+                            shash::Any *compressed_hash)
+{
+  z_stream strm;
+  shash::ContextPtr hash_context(compressed_hash->algorithm);
+  hash_context.buffer = alloca(hash_context.size);
+  shash::Init(hash_context);
+  zlib::CompressInit(&strm);
+
+  zlib::StreamStates state;
+  ssize_t nbytes;
+  do {
+    nbytes = read(fd_src, buffer, kBlockSize);
+    if (nbytes < 0) {
+      if (errno == EINTR)
+        continue;
+      state = zlib::kStreamIOError;
+      break;
+    }
+    atomic_xadd64(&g_num_bytes, nbytes);
+    Throttle(nbytes);
+    state = zlib::CompressZStream2Null(buffer, nbytes, nbytes == 0, &strm,
+                                       &hash_context);
+  } while ((nbytes != 0) && (state == zlib::kStreamContinue));
+  zlib::CompressFini(&strm);
+
+  if (state != zlib::kStreamEnd)
+    return false;
+  shash::Final(hash_context, compressed_hash);
+  return true;
+}
 
-  while (GetNextFile(&relative_path, &hash_name)) {
-    const string path = *g_cache_dir + "/" + relative_path;
 
-    int n = atomic_xadd32(&g_num_files, 1);
-    if (g_verbose)
-      LogCvmfs(kLogCvmfs, kLogStdout, "Checking file %s", path.c_str());
-    if (!g_verbose && ((n % 1000) == 0))
-      LogCvmfs(kLogCvmfs, kLogStdout | kLogNoLinebreak, ".");
+/**
+ * @return false if the file has an error that was not fixed
+ */
+static bool CheckFile(const string &relative_path, const string &hash_name,
+                      unsigned char *buffer)
+{
+  const string path = *g_cache_dir + "/" + relative_path;
+
+  int n = atomic_xadd32(&g_num_files, 1);
+  if (g_verbose)
+    LogCvmfs(kLogCvmfs, kLogStdout, "Checking file %s", path.c_str());
+  if (!g_verbose && ((n % 1000) == 0))
+    LogCvmfs(kLogCvmfs, kLogStdout | kLogNoLinebreak, ".");
+
+  if (relative_path[relative_path.length()-1] == 'T') {
+    LogCvmfs(kLogCvmfs, kLogStdout,
+             "Warning: temporary file catalog %s found", path.c_str());
+    atomic_inc32(&g_num_tmp_catalog);
+    if (g_fix_errors) {
+      if (unlink(relative_path.c_str()) == 0) {
+        LogCvmfs(kLogCvmfs, kLogStdout, "Fix: %s unlinked", path.c_str());
+        atomic_inc32(&g_num_err_fixed);
+      } else {
+        LogCvmfs(kLogCvmfs, kLogStdout, "Error: failed to unlink %s",
+                 path.c_str());
+        atomic_inc32(&g_num_err_unfixed);
+        return false;
+      }
+    }
+    return true;
+  }
 
-    if (relative_path[relative_path.length()-1] == 'T') {
-      LogCvmfs(kLogCvmfs, kLogStdout,
-               "Warning: temporary file catalog %s found", path.c_str());
-      atomic_inc32(&g_num_tmp_catalog);
+  int fd_src = open(relative_path.c_str() , O_RDONLY);
+  if (fd_src < 0) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "Error: cannot open %s", path.c_str());
+    atomic_inc32(&g_num_err_operational);
+    return false;
+  }
+  // Don't thrash kernel buffers
+  platform_disable_kcache(fd_src);
+
+  // Compress every file and calculate SHA-1 of stream
+  bool result = true;
+  shash::Any expected_hash = shash::MkFromHexPtr(shash::HexPtr(hash_name));
+  shash::Any hash(expected_hash.algorithm);
+  if (!CompressAndHash(fd_src, buffer, &hash)) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "Error: could not compress %s",
+             path.c_str());
+    atomic_inc32(&g_num_err_operational);
+    result = false;
+  } else {
+    if (hash != expected_hash) {
       if (g_fix_errors) {
-        if (unlink(relative_path.c_str()) == 0) {
-          LogCvmfs(kLogCvmfs, kLogStdout, "Fix: %s unlinked", path.c_str());
-          atomic_inc32(&g_num_err_fixed);
+        const string quarantaine_path = "./quarantaine/" + hash_name;
+        bool fixed = false;
+        if (rename(relative_path.c_str(), quarantaine_path.c_str()) == 0) {
+          LogCvmfs(kLogCvmfs, kLogStdout,
+                   "Fix: %s is corrupted, moved to quarantaine folder",
+                   path.c_str());
+          fixed = true;
         } else {
-          LogCvmfs(kLogCvmfs, kLogStdout, "Error: failed to unlink %s",
+          LogCvmfs(kLogCvmfs, kLogStdout,
+                   "Warning: failed to move %s into quarantaine folder",
                    path.c_str());
-          atomic_inc32(&g_num_err_unfixed);
-        }
-      }
-      continue;
-    }
-
-    int fd_src = open(relative_path.c_str() , O_RDONLY);
-    if (fd_src < 0) {
-      LogCvmfs(kLogCvmfs, kLogStdout, "Error: cannot open %s", path.c_str());
-      atomic_inc32(&g_num_err_operational);
-      continue;
-    }
-    // Don't thrash kernel buffers
-    platform_disable_kcache(fd_src);
-
-    // Compress every file and calculate SHA-1 of stream
-    shash::Any expected_hash = shash::MkFromHexPtr(shash::HexPtr(hash_name));
-    shash::Any hash(expected_hash.algorithm);
-    if (!zlib::CompressFd2Null(fd_src, &hash)) {
-      LogCvmfs(kLogCvmfs, kLogStdout, "Error: could not compress %s",
-               path.c_str());
-      atomic_inc32(&g_num_err_operational);
-    } else {
-      if (hash != expected_hash) {
-        if (g_fix_errors) {
-          const string quarantaine_path = "./quarantaine/" + hash_name;
-          bool fixed = false;
-          if (rename(relative_path.c_str(), quarantaine_path.c_str()) == 0) {
+          if (unlink(relative_path.c_str()) == 0) {
             LogCvmfs(kLogCvmfs, kLogStdout,
-                     "Fix: %s is corrupted, moved to quarantaine folder",
-                     path.c_str());
+                     "Fix: %s is corrupted, file unlinked", path.c_str());
             fixed = true;
           } else {
             LogCvmfs(kLogCvmfs, kLogStdout,
-                     "Warning: failed to move %s into quarantaine folder",
+                     "Error: %s is corrupted, could not unlink",
                      path.c_str());
-            if (unlink(relative_path.c_str()) == 0) {
-              LogCvmfs(kLogCvmfs, kLogStdout,
-                       "Fix: %s is corrupted, file unlinked", path.c_str());
-              fixed = true;
-            } else {
-              LogCvmfs(kLogCvmfs, kLogStdout,
-                       "Error: %s is corrupted, could not unlink",
-                       path.c_str());
-            }
           }
+        }
 
-          if (fixed) {
-            atomic_inc32(&g_num_err_fixed);
+        if (fixed) {
+          atomic_inc32(&g_num_err_fixed);
 
-            // Changes made, we have to rebuild the managed cache db
-            atomic_cas32(&g_force_rebuild, 0, 1);
-            atomic_cas32(&g_modified_cache, 0, 1);
-          } else {
-            atomic_inc32(&g_num_err_unfixed);
-          }
+          // Changes made, we have to rebuild the managed cache db
+          atomic_cas32(&g_force_rebuild, 0, 1);
+          atomic_cas32(&g_modified_cache, 0, 1);
         } else {
-          LogCvmfs(kLogCvmfs, kLogStdout, "Error: %s has compressed checksum %s"
-                   ", delete this file from cache directory!",
-                   path.c_str(), hash.ToString().c_str());
           atomic_inc32(&g_num_err_unfixed);
+          result = false;
         }
+      } else {
+        LogCvmfs(kLogCvmfs, kLogStdout, "Error: %s has compressed checksum %s"
+                 ", delete this file from cache directory!",
+                 path.c_str(), hash.ToString().c_str());
+        atomic_inc32(&g_num_err_unfixed);
+        result = false;
       }
     }
-    close(fd_src);
+  }
+  close(fd_src);
+  return result;
+}
+
+
+/**
+ * Checks the files of one of the 256 cache sub directories.  The files are
+ * processed in inode order, which roughly follows their location on disk.
+ */
+static void CheckDirectory(const int dir, unsigned char *buffer) {
+  char hex[3];
+  snprintf(hex, sizeof(hex), "%02x", dir);
+  const string dir_name(hex, 2);
+  const time_t verified_since = GetVerifiedSince(dir);
+  const time_t started = time(NULL);
+
+  if (g_verbose)
+    LogCvmfs(kLogCvmfs, kLogStdout, "Entering %s", dir_name.c_str());
+  DIR *dirp = opendir(hex);
+  if (dirp == NULL) {
+    LogCvmfs(kLogCvmfs, kLogStderr,
+             "Invalid cache directory, %s/%s does not exist",
+             g_cache_dir->c_str(), dir_name.c_str());
+    exit(kErrorUnfixed);
+  }
+  vector< pair<uint64_t, string> > entries;
+  platform_dirent64 *d;
+  while ((d = platform_readdir(dirp)) != NULL) {
+    const string name = d->d_name;
+    if ((name == ".") || (name == "..")) continue;
+    entries.push_back(make_pair(static_cast<uint64_t>(d->d_ino), name));
+  }
+  closedir(dirp);
+  sort(entries.begin(), entries.end());
+
+  bool all_verified = true;
+  bool skipped = false;
+  for (unsigned i = 0; i < entries.size(); ++i) {
+    const string &name = entries[i].second;
+    const string relative_path = dir_name + "/" + name;
+    const string hash_name = dir_name + name;
+    const string path = *g_cache_dir + "/" + relative_path;
+
+    platform_stat64 info;
+    if (platform_lstat(relative_path.c_str(), &info) != 0) {
+      LogCvmfs(kLogCvmfs, kLogStdout, "Warning: failed to stat() %s (%d)",
+               path.c_str(), errno);
+      continue;
+    }
+    if (!S_ISREG(info.st_mode)) {
+      LogCvmfs(kLogCvmfs, kLogStdout, "Warning: %s is not a regular file",
+               path.c_str());
+      continue;
+    }
+
+    // Objects are renamed into the cache directory when they are complete,
+    // so the ctime tells if the file was present at the last verification
+    if ((verified_since > 0) && (info.st_ctime < verified_since)) {
+      atomic_inc32(&g_num_skipped);
+      skipped = true;
+      continue;
+    }
+
+    if (!CheckFile(relative_path, hash_name, buffer))
+      all_verified = false;
   }
 
+  // Skipped files keep their previous verification time, so that every file
+  // is checked again once the directory falls out of the incremental window
+  if (g_use_checkpoint && all_verified)
+    SaveCheckpoint(dir, skipped ? verified_since : started, 0);
+}
+
+
+/**
+ * The cache directories are partitioned among the workers, so that workers
+ * don't need to synchronize the traversal.
+ */
+static void *MainCheck(void *data) {
+  const int worker = *static_cast<int *>(data);
+  unsigned char *buffer = static_cast<unsigned char *>(smalloc(kBlockSize));
+
+  for (int dir = worker; dir < kNumCacheDirs; dir += g_num_threads)
+    CheckDirectory(dir, buffer);
+
+  free(buffer);
   return NULL;
 }
 
@@ -237,10 +461,10 @@ static void *MainCheck(void *data __attribute__((unused))) {
 int main(int argc, char **argv) {
   atomic_init32(&g_force_rebuild);
   atomic_init32(&g_modified_cache);
-  g_current_dir = new string();
+  bool background = false;
 
   int c;
-  while ((c = getopt(argc, argv, "hvpfj:")) != -1) {
+  while ((c = getopt(argc, argv, "hvpfj:b:ni:r")) != -1) {
     switch (c) {
       case 'h':
         Usage();
@@ -262,6 +486,25 @@ int main(int argc, char **argv) {
           return kErrorUsage;
         }
         break;
+      case 'b':
+        g_max_bandwidth = String2Uint64(optarg) * 1024 * 1024;
+        break;
+      case 'n':
+        background = true;
+        break;
+      case 'i':
+        g_incremental_days = atoi(optarg);
+        if (g_incremental_days < 0) {
+          LogCvmfs(kLogCvmfs, kLogStdout,
+                   "The number of days must not be negative");
+          return kErrorUsage;
+        }
+        g_use_checkpoint = true;
+        break;
+      case 'r':
+        g_resume = true;
+        g_use_checkpoint = true;
+        break;
       case '?':
       default:
         Usage();
@@ -302,20 +545,48 @@ int main(int argc, char **argv) {
   }
   closedir(dirp_txn);
 
+  if (background && !platform_background_priority()) {
+    LogCvmfs(kLogCvmfs, kLogStdout,
+             "Warning: failed to lower CPU and I/O priority (%d)", errno);
+  }
+
+  g_run_started = time(NULL);
+  if (g_use_checkpoint) {
+    LoadCheckpoint();
+    if (g_resume) {
+      if ((g_prev_run_started > 0) && (g_prev_run_finished == 0)) {
+        // The resumed run keeps its start time, so that further
+        // interruptions can be resumed as well
+        g_run_started = g_prev_run_started;
+      } else {
+        LogCvmfs(kLogCvmfs, kLogStdout,
+                 "No interrupted check found, checking all cache directories");
+      }
+    }
+  }
+
   // Run workers to recalculate checksums
   atomic_init32(&g_num_files);
+  atomic_init32(&g_num_skipped);
+  atomic_init64(&g_num_bytes);
   atomic_init32(&g_num_err_fixed);
   atomic_init32(&g_num_err_unfixed);
   atomic_init32(&g_num_err_operational);
   atomic_init32(&g_num_tmp_catalog);
+  if (g_num_threads > kNumCacheDirs)
+    g_num_threads = kNumCacheDirs;
   pthread_t *workers = reinterpret_cast<pthread_t *>(
     smalloc(g_num_threads * sizeof(pthread_t)));
+  int *worker_ids = reinterpret_cast<int *>(
+    smalloc(g_num_threads * sizeof(int)));
+  gettimeofday(&g_time_start, NULL);
   if (!g_verbose)
     LogCvmfs(kLogCvmfs, kLogStdout | kLogNoLinebreak, "Verifying: ");
   for (int i = 0; i < g_num_threads; ++i) {
     if (g_verbose)
       LogCvmfs(kLogCvmfs, kLogStdout, "Starting worker %d", i+1);
-    if (pthread_create(&workers[i], NULL, MainCheck, NULL) != 0) {
+    worker_ids[i] = i;
+    if (pthread_create(&workers[i], NULL, MainCheck, &worker_ids[i]) != 0) {
       LogCvmfs(kLogCvmfs, kLogStdout, "Fatal: could not create worker thread");
       return kErrorOperational;
     }
@@ -326,10 +597,23 @@ int main(int argc, char **argv) {
       LogCvmfs(kLogCvmfs, kLogStdout, "Stopping worker %d", i+1);
   }
   free(workers);
+  free(worker_ids);
+  const double elapsed = GetElapsedTime();
+  if (g_use_checkpoint)
+    SaveCheckpoint(-1, 0, time(NULL));
+
   if (!g_verbose)
     LogCvmfs(kLogCvmfs, kLogStdout, "");
   LogCvmfs(kLogCvmfs, kLogStdout, "Verified %d files",
            atomic_read32(&g_num_files));
+  if (atomic_read32(&g_num_skipped) > 0) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "Skipped %d files verified before",
+             atomic_read32(&g_num_skipped));
+  }
+  const double scanned_gb =
+    static_cast<double>(atomic_read64(&g_num_bytes)) / (1024 * 1024 * 1024);
+  LogCvmfs(kLogCvmfs, kLogStdout, "Scanned %.2f GB in %.1f seconds (%.3f GB/s)",
+           scanned_gb, elapsed, (elapsed > 0) ? scanned_gb / elapsed : 0.0);
 
   if (atomic_read32(&g_num_tmp_catalog) > 0)
     LogCvmfs(kLogCvmfs, kLogStdout, "Temporary file catalogs were found.");
@@ -29,6 +29,10 @@ namespace swissknife {
 class CommandMigrate;
 }
 
+namespace lru {
+class PackedDirent;
+}
+
 namespace catalog {
 
 // Create DirectoryEntries for unit test purposes.
@@ -51,6 +55,8 @@ class DirectoryEntryBase {
   friend class publish::SyncItem;
   // Simplify file system like _touch_ of DirectoryEntry objects
   friend class SqlDirentTouch;
+  // Compact copies in the meta-data caches
+  friend class lru::PackedDirent;
 
  public:
   static const inode_t kInvalidInode = 0;
@@ -203,6 +209,7 @@ class DirectoryEntryBase {
 class DirectoryEntry : public DirectoryEntryBase {
   // Simplify creation of DirectoryEntry objects
   friend class SqlLookup;
+  friend class CompiledCatalog;
   // Simplify write of DirectoryEntry objects in database
   friend class SqlDirentWrite;
   // For fixing DirectoryEntry glitches
@@ -211,6 +218,8 @@ class DirectoryEntry : public DirectoryEntryBase {
   friend class WritableCatalogManager;
   // Create DirectoryEntries for unit test purposes.
   friend class DirectoryEntryTestFactory;
+  // Compact copies in the meta-data caches
+  friend class lru::PackedDirent;
 
  public:
   /**
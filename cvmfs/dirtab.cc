@@ -108,8 +108,10 @@ bool Dirtab::ParseLine(const std::string &line) {
 void Dirtab::AddRule(const Rule &rule) {
   if (rule.is_negation) {
     negative_rules_.push_back(rule);
+    matcher_.AddRelaxed(rule.pathspec);
   } else {
     positive_rules_.push_back(rule);
+    matcher_.AddStrict(rule.pathspec);
   }
 }
 
@@ -135,6 +137,26 @@ bool Dirtab::CheckRuleValidity() const {
 
 
 bool Dirtab::IsMatching(const std::string &path) const {
+  if (!PathspecMatcher::CanMatch(path)) {
+    return IsMatchingPathspecs(path);
+  }
+  return matcher_.IsMatchingStrict(path) && !matcher_.IsMatchingRelaxed(path);
+}
+
+
+bool Dirtab::IsOpposing(const std::string &path) const {
+  if (!PathspecMatcher::CanMatch(path)) {
+    return IsOpposingPathspecs(path);
+  }
+  return matcher_.IsMatchingRelaxed(path);
+}
+
+
+/**
+ * Matches the path rule by rule, using the regular expressions of the
+ * Pathspecs.
+ */
+bool Dirtab::IsMatchingPathspecs(const std::string &path) const {
   // check if path has a positive match
   bool has_positive_match = false;
         Rules::const_iterator p    = positive_rules_.begin();
@@ -147,11 +169,11 @@ bool Dirtab::IsMatching(const std::string &path) const {
     }
   }
 
-  return has_positive_match && !IsOpposing(path);
+  return has_positive_match && !IsOpposingPathspecs(path);
 }
 
 
-bool Dirtab::IsOpposing(const std::string &path) const {
+bool Dirtab::IsOpposingPathspecs(const std::string &path) const {
         Rules::const_iterator n    = negative_rules_.begin();
   const Rules::const_iterator nend = negative_rules_.end();
   for (; n != nend; ++n) {
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "pathspec/pathspec.h"
+#include "pathspec/pathspec_matcher.h"
 
 namespace catalog {
 
@@ -43,6 +44,8 @@ namespace catalog {
  *       path strings.
  *       See: swissknife_sync.{h,cc} or t_dirtab.cc for the usage of this class.
  *
+ * The rules are compiled into a PathspecMatcher, so that the cost of matching
+ * a path grows with the path length rather than with the number of rules.
  */
 class Dirtab {
  public:
@@ -125,11 +128,17 @@ class Dirtab {
     for (; *itr != end && **itr == ' '; ++(*itr)) { }
   }
   bool CheckRuleValidity() const;
+  bool IsMatchingPathspecs(const std::string &path) const;
+  bool IsOpposingPathspecs(const std::string &path) const;
 
  private:
   bool  valid_;
   Rules positive_rules_;
   Rules negative_rules_;
+  /**
+   * Positive rules are added as strict, negative rules as relaxed Pathspecs
+   */
+  PathspecMatcher matcher_;
 };
 
 }  // namespace catalog
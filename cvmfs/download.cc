@@ -477,14 +477,8 @@ void *DownloadManager::MainDownload(void *data) {
       ReadPipe(download_mgr->pipe_jobs_[0], &info, sizeof(info));
       if (!still_running)
         gettimeofday(&timeval_start, NULL);
-      CURL *handle = download_mgr->AcquireCurlHandle();
-      download_mgr->InitializeRequest(info, handle);
-      download_mgr->SetUrlOptions(info);
-      curl_multi_add_handle(download_mgr->curl_multi_, handle);
-      retval = curl_multi_socket_action(download_mgr->curl_multi_,
-                                        CURL_SOCKET_TIMEOUT,
-                                        0,
-                                        &still_running);
+      download_mgr->scheduler_->Submit(info);
+      download_mgr->StartJobs(&still_running);
     }
 
     // Activity on curl sockets
@@ -512,6 +506,7 @@ void *DownloadManager::MainDownload(void *data) {
     // Check if transfers are completed
     CURLMsg *curl_msg;
     int msgs_in_queue;
+    bool has_finished_jobs = false;
     while ((curl_msg = curl_multi_info_read(download_mgr->curl_multi_,
                                             &msgs_in_queue)))
     {
@@ -530,14 +525,22 @@ void *DownloadManager::MainDownload(void *data) {
                                             0,
                                             &still_running);
         } else {
-          // Return easy handle into pool and write result back
+          // Return easy handle into pool and write result back.  The job
+          // belongs to the caller of Fetch() once the result is written.
           download_mgr->ReleaseCurlHandle(easy_handle);
+          download_mgr->scheduler_->Finish(info);
+          download_mgr->RecordJobFinish(info);
+          has_finished_jobs = true;
 
           WritePipe(info->wait_at[1], &info->error_code,
                     sizeof(info->error_code));
         }
       }
     }
+
+    // Freed curl handles go to the waiting jobs
+    if (has_finished_jobs)
+      download_mgr->StartJobs(&still_running);
   }
 
   for (set<CURL *>::iterator i = download_mgr->pool_handles_inuse_->begin(),
@@ -652,6 +655,72 @@ void HeaderLists::AddBlock() {
 //------------------------------------------------------------------------------
 
 
+/**
+ * By default, catalogs can use all the handles, interactive requests leave
+ * some handles for catalogs, and background jobs use at most a quarter of the
+ * handles.
+ */
+JobScheduler::JobScheduler(const unsigned max_active)
+  : num_active_(0)
+  , max_active_(max_active > 0 ? max_active : 1)
+{
+  for (unsigned i = 0; i < kPriorityNumEntries; ++i)
+    active_[i] = 0;
+  SetLimit(kPriorityCatalog, max_active_);
+  SetLimit(kPriorityInteractive, max_active_ - max_active_ / 8);
+  SetLimit(kPriorityBackground, max_active_ / 4);
+}
+
+
+/**
+ * Jobs of a class are started as long as less than max_active jobs of the
+ * class are running.  The limit is at least one job and at most the overall
+ * limit.
+ */
+void JobScheduler::SetLimit(const Priority priority,
+                            const unsigned max_active)
+{
+  assert(priority < kPriorityNumEntries);
+  limits_[priority] = std::max(1U, std::min(max_active, max_active_));
+}
+
+
+void JobScheduler::Submit(JobInfo *info) {
+  assert(info->priority < kPriorityNumEntries);
+  waiting_[info->priority].push_back(info);
+}
+
+
+/**
+ * Returns the job that should be started next or NULL if there is none that
+ * can be started now.  The returned job counts as active until Finish().
+ */
+JobInfo *JobScheduler::Next() {
+  if (num_active_ >= max_active_)
+    return NULL;
+  for (unsigned i = 0; i < kPriorityNumEntries; ++i) {
+    if (waiting_[i].empty() || (active_[i] >= limits_[i]))
+      continue;
+    JobInfo *info = waiting_[i].front();
+    waiting_[i].pop_front();
+    active_[i]++;
+    num_active_++;
+    return info;
+  }
+  return NULL;
+}
+
+
+void JobScheduler::Finish(const JobInfo *info) {
+  assert(active_[info->priority] > 0);
+  active_[info->priority]--;
+  num_active_--;
+}
+
+
+//------------------------------------------------------------------------------
+
+
 string DownloadManager::ProxyInfo::Print() {
   if (url == "DIRECT")
     return url;
@@ -716,6 +785,57 @@ void DownloadManager::ReleaseCurlHandle(CURL *handle) {
 }
 
 
+/**
+ * Wall clock time in miliseconds for the per priority class statistics.
+ */
+uint64_t DownloadManager::GetTimestampMs() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return static_cast<uint64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+}
+
+
+void DownloadManager::RecordJobStart(JobInfo *info) {
+  info->timestamp_started = GetTimestampMs();
+  if (info->timestamp_started > info->timestamp_submitted) {
+    perf::Xadd(counters_->sz_wait_time[info->priority],
+               info->timestamp_started - info->timestamp_submitted);
+  }
+}
+
+
+void DownloadManager::RecordJobFinish(const JobInfo *info) {
+  const uint64_t now = GetTimestampMs();
+  perf::Inc(counters_->n_jobs[info->priority]);
+  if (now > info->timestamp_submitted) {
+    perf::Xadd(counters_->sz_latency[info->priority],
+               now - info->timestamp_submitted);
+  }
+}
+
+
+/**
+ * Starts the transfers of the waiting jobs for which the scheduler finds a
+ * free slot.  Runs in the I/O thread.
+ */
+void DownloadManager::StartJobs(int *still_running) {
+  bool has_started_jobs = false;
+  JobInfo *info;
+  while ((info = scheduler_->Next()) != NULL) {
+    RecordJobStart(info);
+    CURL *handle = AcquireCurlHandle();
+    InitializeRequest(info, handle);
+    SetUrlOptions(info);
+    curl_multi_add_handle(curl_multi_, handle);
+    has_started_jobs = true;
+  }
+  if (has_started_jobs) {
+    curl_multi_socket_action(curl_multi_, CURL_SOCKET_TIMEOUT, 0,
+                             still_running);
+  }
+}
+
+
 /**
  * HTTP request options: set the URL and other options such as timeout and
  * proxy.
@@ -1307,6 +1427,7 @@ DownloadManager::DownloadManager() {
   pipe_terminate_[0] = pipe_terminate_[1] = -1;
 
   pipe_jobs_[0] = pipe_jobs_[1] = -1;
+  scheduler_ = NULL;
   watch_fds_ = NULL;
   watch_fds_size_ = 0;
   watch_fds_inuse_ = 0;
@@ -1399,6 +1520,7 @@ void DownloadManager::Init(const unsigned max_pool_handles,
   pool_handles_inuse_ = new set<CURL *>;
   pool_max_handles_ = max_pool_handles;
   watch_fds_max_ = 4*pool_max_handles_;
+  scheduler_ = new JobScheduler(pool_max_handles_);
 
   opt_timeout_proxy_ = 5;
   opt_timeout_direct_ = 10;
@@ -1470,6 +1592,8 @@ void DownloadManager::Fini() {
   pool_handles_idle_ = NULL;
   pool_handles_inuse_ = NULL;
   curl_multi_ = NULL;
+  delete scheduler_;
+  scheduler_ = NULL;
 
   FiniHeaders();
   if (user_agent_)
@@ -1516,6 +1640,7 @@ Failures DownloadManager::Fetch(JobInfo *info) {
   assert(info != NULL);
   assert(info->url != NULL);
 
+  info->timestamp_submitted = GetTimestampMs();
   Failures result;
   result = PrepareDownloadDestination(info);
   if (result != kFailOk)
@@ -1554,6 +1679,7 @@ Failures DownloadManager::Fetch(JobInfo *info) {
     // LogCvmfs(kLogDownload, kLogDebug, "got result %d", result);
   } else {
     pthread_mutex_lock(lock_synchronous_mode_);
+    RecordJobStart(info);
     CURL *handle = AcquireCurlHandle();
     InitializeRequest(info, handle);
     SetUrlOptions(info);
@@ -1568,6 +1694,7 @@ Failures DownloadManager::Fetch(JobInfo *info) {
     } while (VerifyAndFinalize(retval, info));
     result = info->error_code;
     ReleaseCurlHandle(info->curl_handle);
+    RecordJobFinish(info);
     pthread_mutex_unlock(lock_synchronous_mode_);
   }
 
@@ -2460,4 +2587,19 @@ void DownloadManager::EnableRedirects() {
   follow_redirects_ = true;
 }
 
+
+/**
+ * Limits the number of concurrent transfers of a priority class.  Has to be
+ * called before Spawn().
+ */
+void DownloadManager::SetPriorityLimit(
+  const Priority priority,
+  const unsigned max_active)
+{
+  assert(atomic_xadd32(&multi_threaded_, 0) == 0);
+  scheduler_->SetLimit(priority, max_active);
+  LogCvmfs(kLogDownload, kLogDebug, "limit %s downloads to %u",
+           Priority2Ascii(priority), scheduler_->GetLimit(priority));
+}
+
 }  // namespace download
@@ -11,6 +11,7 @@
 #include <unistd.h>
 
 #include <cstdio>
+#include <deque>
 #include <set>
 #include <string>
 #include <vector>
@@ -85,6 +86,30 @@ enum Destination {
 };  // Destination
 
 
+/**
+ * Download jobs are scheduled by priority class.  Catalogs come first because
+ * path lookups wait for them, background jobs (e.g. pinning files) only get
+ * the curl handles that are left over by the other classes.
+ */
+enum Priority {
+  kPriorityCatalog = 0,
+  kPriorityInteractive,
+  kPriorityBackground,
+
+  kPriorityNumEntries
+};  // Priority
+
+
+inline const char *Priority2Ascii(const Priority priority) {
+  const char *texts[kPriorityNumEntries + 1];
+  texts[0] = "catalog";
+  texts[1] = "interactive";
+  texts[2] = "background";
+  texts[3] = "no text";
+  return texts[priority];
+}
+
+
 struct Counters {
   perf::Counter *sz_transferred_bytes;
   perf::Counter *sz_transfer_time;  // measured in miliseconds
@@ -92,6 +117,11 @@ struct Counters {
   perf::Counter *n_retries;
   perf::Counter *n_proxy_failover;
   perf::Counter *n_host_failover;
+  // Per priority class: finished jobs, time spent waiting for a curl handle
+  // and time from submission to result (miliseconds)
+  perf::Counter *n_jobs[kPriorityNumEntries];
+  perf::Counter *sz_wait_time[kPriorityNumEntries];
+  perf::Counter *sz_latency[kPriorityNumEntries];
 
   explicit Counters(perf::Statistics *statistics) {
     sz_transferred_bytes = statistics->Register("download.sz_transferred_bytes",
@@ -106,6 +136,15 @@ struct Counters {
         "Number of proxy failovers");
     n_host_failover = statistics->Register("download.n_host_failover",
         "Number of host failovers");
+    for (unsigned i = 0; i < kPriorityNumEntries; ++i) {
+      const std::string name = Priority2Ascii(static_cast<Priority>(i));
+      n_jobs[i] = statistics->Register("download.n_jobs_" + name,
+          "Number of " + name + " jobs");
+      sz_wait_time[i] = statistics->Register("download.sz_wait_time_" + name,
+          "Time " + name + " jobs waited for a connection (miliseconds)");
+      sz_latency[i] = statistics->Register("download.sz_latency_" + name,
+          "Time from submission to result of " + name + " jobs (miliseconds)");
+    }
   }
 };  // Counters
 
@@ -130,6 +169,7 @@ struct JobInfo {
   cvmfs::Sink *destination_sink;
   const shash::Any *expected_hash;
   const std::string *extra_info;
+  Priority priority;
 
   // Default initialization of fields
   void Init() {
@@ -146,6 +186,7 @@ struct JobInfo {
     destination_sink = NULL;
     expected_hash = NULL;
     extra_info = NULL;
+    priority = kPriorityInteractive;
 
     curl_handle = NULL;
     headers = NULL;
@@ -156,6 +197,7 @@ struct JobInfo {
     error_code = kFailOther;
     num_used_proxies = num_used_hosts = num_retries = 0;
     backoff_ms = 0;
+    timestamp_submitted = timestamp_started = 0;
   }
 
   // One constructor per destination + head request
@@ -231,9 +273,50 @@ struct JobInfo {
   unsigned char num_used_hosts;
   unsigned char num_retries;
   unsigned backoff_ms;
+  uint64_t timestamp_submitted;  /**< Miliseconds, set by Fetch() */
+  uint64_t timestamp_started;  /**< Miliseconds, got a curl handle */
 };  // JobInfo
 
 
+/**
+ * Decides which of the submitted jobs get a curl handle.  Every priority class
+ * has a FIFO queue.  Jobs are started from the highest priority class that has
+ * waiting jobs and that is below its limit of active jobs, as long as the
+ * overall number of active jobs is below max_active.  Lower limits for the
+ * lower classes keep handles free for catalogs and interactive requests even
+ * if a lot of bulk data is transferred.
+ *
+ * Only used by the I/O thread, not thread-safe.
+ */
+class JobScheduler {
+ public:
+  explicit JobScheduler(const unsigned max_active);
+  void SetLimit(const Priority priority, const unsigned max_active);
+  unsigned GetLimit(const Priority priority) const {
+    return limits_[priority];
+  }
+
+  void Submit(JobInfo *info);
+  JobInfo *Next();
+  void Finish(const JobInfo *info);
+
+  unsigned num_waiting(const Priority priority) const {
+    return waiting_[priority].size();
+  }
+  unsigned num_active(const Priority priority) const {
+    return active_[priority];
+  }
+  unsigned num_active() const { return num_active_; }
+
+ private:
+  std::deque<JobInfo *> waiting_[kPriorityNumEntries];
+  unsigned active_[kPriorityNumEntries];
+  unsigned limits_[kPriorityNumEntries];
+  unsigned num_active_;
+  unsigned max_active_;
+};
+
+
 /**
  * Manages blocks of arrays of curl_slist storing header strings.  In contrast
  * to curl's slists, these ones don't take ownership of the header strings.
@@ -347,11 +430,13 @@ class DownloadManager {
   void EnableInfoHeader();
   void EnablePipelining();
   void EnableRedirects();
+  void SetPriorityLimit(const Priority priority, const unsigned max_active);
 
  private:
   static int CallbackCurlSocket(CURL *easy, curl_socket_t s, int action,
                                 void *userp, void *socketp);
   static void *MainDownload(void *data);
+  static uint64_t GetTimestampMs();
 
   bool StripDirect(const std::string &proxy_list, std::string *cleaned_list);
   bool ValidateGeoReply(const std::string &reply_order,
@@ -362,6 +447,9 @@ class DownloadManager {
   void RebalanceProxiesUnlocked();
   CURL *AcquireCurlHandle();
   void ReleaseCurlHandle(CURL *handle);
+  void StartJobs(int *still_running);
+  void RecordJobStart(JobInfo *info);
+  void RecordJobFinish(const JobInfo *info);
   void InitializeRequest(JobInfo *info, CURL *handle);
   void SetUrlOptions(JobInfo *info);
   void ValidateProxyIpsUnlocked(const std::string &url, const dns::Host &host);
@@ -386,6 +474,7 @@ class DownloadManager {
   int pipe_terminate_[2];
 
   int pipe_jobs_[2];
+  JobScheduler *scheduler_;
   struct pollfd *watch_fds_;
   uint32_t watch_fds_size_;
   uint32_t watch_fds_inuse_;
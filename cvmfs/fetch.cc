@@ -73,6 +73,25 @@ Fetcher::ThreadLocalStorage *Fetcher::GetTls() {
 }
 
 
+/**
+ * Catalogs are needed to resolve paths, so they are downloaded first.  Pinned
+ * objects are not requested by an application but by the pinning of files in
+ * the cache, they only use the connections left over by interactive requests.
+ */
+download::Priority Fetcher::GetPriority(
+  const cache::CacheManager::ObjectType object_type)
+{
+  switch (object_type) {
+    case cache::CacheManager::kTypeCatalog:
+      return download::kPriorityCatalog;
+    case cache::CacheManager::kTypePinned:
+      return download::kPriorityBackground;
+    default:
+      return download::kPriorityInteractive;
+  }
+}
+
+
 int Fetcher::Fetch(
   const shash::Any &id,
   const uint64_t size,
@@ -117,6 +136,21 @@ int Fetcher::Fetch(
     pthread_mutex_unlock(lock_queues_download_);
   }
 
+  // Same as with threads for processes that share the cache: only the first
+  // process downloads, the others find the object in the cache
+  const int download_lock = cache_mgr_->LockDownload(id);
+  if (download_lock >= 0) {
+    fd_return = OpenSelect(id, name, object_type);
+    if (fd_return >= 0) {
+      LogCvmfs(kLogCache, kLogDebug, "%s downloaded by another process",
+               name.c_str());
+      perf::Inc(n_downloads_saved);
+      cache_mgr_->UnlockDownload(id, download_lock);
+      SignalWaitingThreads(fd_return, id, tls);
+      return fd_return;
+    }
+  }
+
   perf::Inc(n_downloads);
 
   // Involve the download manager
@@ -127,6 +161,7 @@ int Fetcher::Fetch(
   if (retval < 0) {
     LogCvmfs(kLogCache, kLogDebug, "could not start transaction on %s",
              name.c_str());
+    cache_mgr_->UnlockDownload(id, download_lock);
     SignalWaitingThreads(retval, id, tls);
     return retval;
   }
@@ -138,6 +173,7 @@ int Fetcher::Fetch(
   tls->download_job.destination_sink = &sink;
   tls->download_job.expected_hash = &id;
   tls->download_job.extra_info = &name;
+  tls->download_job.priority = GetPriority(object_type);
   download_mgr_->Fetch(&tls->download_job);
 
   if (tls->download_job.error_code == download::kFailOk) {
@@ -146,11 +182,13 @@ int Fetcher::Fetch(
     fd_return = cache_mgr_->OpenFromTxn(txn);
     if (fd_return < 0) {
       cache_mgr_->AbortTxn(txn);
+      cache_mgr_->UnlockDownload(id, download_lock);
       SignalWaitingThreads(fd_return, id, tls);
       return fd_return;
     }
 
     retval = cache_mgr_->CommitTxn(txn);
+    cache_mgr_->UnlockDownload(id, download_lock);
     if (retval < 0) {
       cache_mgr_->Close(fd_return);
       SignalWaitingThreads(retval, id, tls);
@@ -166,6 +204,7 @@ int Fetcher::Fetch(
            id.ToString().c_str(), tls->download_job.error_code,
            download::Code2Ascii(tls->download_job.error_code));
   cache_mgr_->AbortTxn(txn);
+  cache_mgr_->UnlockDownload(id, download_lock);
   backoff_throttle_->Throttle();
   SignalWaitingThreads(-EIO, id, tls);
   return -EIO;
@@ -196,6 +235,8 @@ Fetcher::Fetcher(
   assert(retval == 0);
   n_downloads = statistics->Register("fetch.n_downloads",
     "overall number of downloaded files (incl. catalogs, chunks)");
+  n_downloads_saved = statistics->Register("fetch.n_downloads_saved",
+    "number of objects downloaded by another process sharing the cache");
 }
 
 
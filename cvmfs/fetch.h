@@ -57,7 +57,8 @@ class TransactionSink : public Sink {
  * context of the cache manager.
  * If the object is not in the cache, it is downloaded and stored in the cache.
  *
- * Concurrent download requests for the same id are collapsed.
+ * Concurrent download requests for the same id are collapsed.  Processes that
+ * share the cache collapse their downloads if the cache manager supports it.
  */
 class Fetcher : SingleCopy {
   FRIEND_TEST(T_Fetcher, GetTls);
@@ -122,6 +123,9 @@ class Fetcher : SingleCopy {
    */
   typedef std::map< shash::Any, std::vector<int> * > ThreadQueues;
 
+  static download::Priority GetPriority(
+    const cache::CacheManager::ObjectType object_type);
+
   ThreadLocalStorage *GetTls();
   void CleanupTls(ThreadLocalStorage *tls);
   void SignalWaitingThreads(const int fd, const shash::Any &id,
@@ -149,6 +153,7 @@ class Fetcher : SingleCopy {
   download::DownloadManager *download_mgr_;
   BackoffThrottle *backoff_throttle_;
   perf::Counter *n_downloads;
+  perf::Counter *n_downloads_saved;
 };
 
 }  // namespace cvmfs
@@ -9,13 +9,13 @@ namespace upload {
 
 CharBuffer* AbstractReader::CreateBuffer(const size_t size) {
   ++buffers_in_flight_counter_;
-  CharBuffer *buffer = new CharBuffer(size);
+  CharBuffer *buffer = buffer_pool_.AllocateThrottled(size);
   return buffer;
 }
 
 
 void AbstractReader::ReleaseBuffer(CharBuffer *buffer) {
-  delete buffer;
+  buffer_pool_.ReleasePending(buffer);
   --buffers_in_flight_counter_;
 }
 
@@ -5,15 +5,19 @@
 #ifndef CVMFS_FILE_PROCESSING_ASYNC_READER_H_
 #define CVMFS_FILE_PROCESSING_ASYNC_READER_H_
 
-#include <tbb/concurrent_queue.h>
+#include <pthread.h>
 #include <tbb/task.h>
 #include <tbb/tbb_thread.h>
 
+#include <cassert>
+#include <deque>
 #include <list>
 #include <string>
+#include <vector>
 
 #include "../util_concurrency.h"
 #include "char_buffer.h"
+#include "char_buffer_pool.h"
 
 // TODO(rmeusel): remove this... wrong namespace (for testing)
 namespace upload {
@@ -22,8 +26,15 @@ class AbstractFile;
 
 class AbstractReader {
  public:
-  explicit AbstractReader(const unsigned int max_buffers_in_flight) :
-    buffers_in_flight_counter_(max_buffers_in_flight)
+  /**
+   * Memory of returned buffers that is kept for recycling
+   */
+  static const uint64_t kMaxIdleBufferBytes = 64 * 1024 * 1024;
+
+  AbstractReader(const unsigned int max_buffers_in_flight,
+                 const uint64_t     max_bytes_in_flight) :
+    buffers_in_flight_counter_(max_buffers_in_flight),
+    buffer_pool_(kMaxIdleBufferBytes, max_bytes_in_flight)
   {}
 
   virtual ~AbstractReader() {}
@@ -39,16 +50,24 @@ class AbstractReader {
    */
   virtual void FinalizedFile(AbstractFile *file) = 0;
 
+  /**
+   * The pool is shared with the rest of the processing pipeline, e.g. for the
+   * buffers of compressed data.
+   */
+  CharBufferPool *buffer_pool() { return &buffer_pool_; }
+
  protected:
   /**
    * Creates a new Buffer object with the provided size. If too many buffers
-   * are currently processed, this method blocks until a Buffer slot gets free.
+   * are currently processed or if the buffers in flight use too much memory,
+   * this method blocks until a Buffer gets released.
    */
   CharBuffer *CreateBuffer(const size_t size);
 
 
  private:
   SynchronizingCounter<uint32_t> buffers_in_flight_counter_;
+  CharBufferPool buffer_pool_;
 };
 
 
@@ -62,6 +81,11 @@ class AbstractReader {
  * individual File needs to be processed sequentially. Though data Blocks of
  * different Files are independent of each other and allow for higher throughput.
  *
+ * The read-in can be spread over multiple I/O threads.  Every thread has its
+ * own set of open Files, so that the Blocks of a File are still read in order.
+ * Files that fit into a single Block are handed out before bigger Files and
+ * are read right away, in order to finish them quickly.
+ *
  * Note: The Reader produces CharBuffers that are passed into the processing
  *       pipeline. The Reader claims ownership of these specific CharBuffers,
  *       thus they need to be released using the Reader::ReleaseBuffer() method!
@@ -100,77 +124,86 @@ class Reader : public AbstractReader,
     FileT *file;
     bool   terminate;
   };
-  typedef tbb::concurrent_bounded_queue<FileJob> JobQueue;
 
  public:
+  /**
+   * @param max_buffer_size      size of the data Blocks to read-in
+   * @param max_files_in_flight  ScheduleRead() blocks if more Files are in
+   *                             processing
+   * @param max_bytes_in_flight  memory limit for CharBuffers in flight before
+   *                             the read-in is throttled, 0 means no limit
+   * @param number_of_threads    number of I/O threads
+   */
   Reader(const size_t       max_buffer_size,
-         const unsigned int max_files_in_flight) :
-    AbstractReader(max_files_in_flight * 5),
+         const unsigned int max_files_in_flight,
+         const uint64_t     max_bytes_in_flight = 0,
+         const unsigned int number_of_threads = 1) :
+    AbstractReader(max_files_in_flight * 5, max_bytes_in_flight),
     max_buffer_size_(max_buffer_size),
-    draining_(false),
+    number_of_threads_((number_of_threads > 0) ? number_of_threads : 1),
+    terminating_(false),
     files_in_flight_counter_(max_files_in_flight),
-    running_(false) {}
+    running_(false)
+  {
+    const bool init_successful = (
+      pthread_mutex_init(&lock_jobs_, NULL) == 0 &&
+      pthread_cond_init(&cond_jobs_, NULL) == 0);
+    assert(init_successful);
+  }
 
   virtual ~Reader() {
     assert(!running_);
+    pthread_mutex_destroy(&lock_jobs_);
+    pthread_cond_destroy(&cond_jobs_);
   }
 
   bool Initialize();
   void TearDown() { Terminate(); }
 
-  void ScheduleRead(FileT *file) {
-    assert(running_);
-    ++files_in_flight_counter_;
-    queue_.push(FileJob(file));
-  }
+  void ScheduleRead(FileT *file);
 
   void Wait() {
     files_in_flight_counter_.WaitForZero();
   }
 
-  void Terminate() {
-    Wait();
+  void Terminate();
 
-    if (running_ && read_thread_.joinable()) {
-      // send a termination signal through the queue and wait for the read
-      // thread to terminate
-      queue_.push(FileJob());
-      read_thread_.join();
-      running_ = false;
-    }
-  }
+  unsigned int number_of_threads() const { return number_of_threads_; }
 
  protected:
   void ReadThread();
 
-  /** Checks if there is still data to be worked on */
-  bool HasData() const { return !draining_ || open_files_.size() > 0; }
-
-  /**
-   * When all Files have been scheduled from the outside, we enable the draining
-   * mode to bring all reading to an end and terminate eventually.
-   */
-  void EnableDraining() { draining_ = true; }
-
-  bool TryToAcquireNewJob(FileJob *next_job);
-  void OpenNewFile(FileT          *file);
-  void CloseFile(OpenFile         *file);
+  bool AcquireJob(const bool block, FileJob *next_job);
+  void OpenNewFile(FileT *file, OpenFile *open_file);
+  void CloseFile(OpenFile *file);
 
   bool ReadAndScheduleNextBuffer(OpenFile *open_file);
 
   void FinalizedFile(AbstractFile *file);
 
  private:
-  JobQueue queue_;  ///< reference to the JobQueue (see IoDispatcher)
+  /**
+   * Upper bound of single-Block Files a thread reads before it continues with
+   * the Blocks of its big Files
+   */
+  static const unsigned kMaxSmallFilesPerRound = 64;
+
   const size_t max_buffer_size_;  ///< size of data Blocks to read-in
+  const unsigned int number_of_threads_;
 
-  bool                            draining_;
-  OpenFileList                    open_files_;
+  /**
+   * Files waiting to be opened.  Files that fit into a single Block are kept
+   * separately and are preferred.
+   */
+  std::deque<FileT *>             small_files_;
+  std::deque<FileT *>             big_files_;
+  bool                            terminating_;
+  pthread_mutex_t                 lock_jobs_;
+  pthread_cond_t                  cond_jobs_;
 
   SynchronizingCounter<uint32_t>  files_in_flight_counter_;
 
-  tbb::tbb_thread                 read_thread_;
-  Future<bool>                    thread_started_executing_;
+  std::vector<tbb::tbb_thread *>  read_threads_;
   bool                            running_;
 };
 
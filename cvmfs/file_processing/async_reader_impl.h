@@ -19,83 +19,145 @@ bool Reader<FileScrubbingTaskT, FileT>::Initialize() {
   // implemented in AbstractUploader. It might be worth to facter out that code
   // into an extra template that handles clean thread creation/destruction
   // and perhaps the connection of the thread using a tbb::[...]queue
-  tbb::tbb_thread thread(&ThreadProxy<Reader>,
-                          this,
-                         &Reader<FileScrubbingTaskT, FileT>::ReadThread);
-
-  assert(!read_thread_.joinable());
-  read_thread_ = thread;
-  assert(read_thread_.joinable());
-  assert(!thread.joinable());
-
-  // wait for the thread to call back...
-  const bool successful_startup = thread_started_executing_.Get();
-  if (successful_startup) {
-    running_ = true;
+  assert(read_threads_.empty());
+  for (unsigned i = 0; i < number_of_threads_; ++i) {
+    read_threads_.push_back(
+      new tbb::tbb_thread(&ThreadProxy<Reader>,
+                           this,
+                          &Reader<FileScrubbingTaskT, FileT>::ReadThread));
+    assert(read_threads_.back()->joinable());
   }
 
-  return successful_startup;
+  running_ = true;
+  return true;
 }
 
 
 template <class FileScrubbingTaskT, class FileT>
-void Reader<FileScrubbingTaskT, FileT>::ReadThread() {
-  thread_started_executing_.Set(true);
+void Reader<FileScrubbingTaskT, FileT>::ScheduleRead(FileT *file) {
+  assert(running_);
+  ++files_in_flight_counter_;
+
+  MutexLockGuard guard(lock_jobs_);
+  if (file->size() <= max_buffer_size_) {
+    small_files_.push_back(file);
+  } else {
+    big_files_.push_back(file);
+  }
+  pthread_cond_signal(&cond_jobs_);
+}
+
+
+template <class FileScrubbingTaskT, class FileT>
+void Reader<FileScrubbingTaskT, FileT>::Terminate() {
+  Wait();
 
-  while (HasData()) {
-    // acquire a new job from the job queue:
-    // -> if the queue is empty, just continue on the work currently in flight
-    // -> if the popped value is NULL, the drainout is initiated
+  if (!running_) {
+    return;
+  }
+
+  // send a termination signal to the read threads and wait for them to
+  // terminate
+  {
+    MutexLockGuard guard(lock_jobs_);
+    terminating_ = true;
+    pthread_cond_broadcast(&cond_jobs_);
+  }
+  for (unsigned i = 0; i < read_threads_.size(); ++i) {
+    read_threads_[i]->join();
+    delete read_threads_[i];
+  }
+  read_threads_.clear();
+  running_ = false;
+}
+
+
+template <class FileScrubbingTaskT, class FileT>
+void Reader<FileScrubbingTaskT, FileT>::ReadThread() {
+  OpenFileList open_files;
+  bool         draining = false;
+
+  while (!draining || !open_files.empty()) {
+    // acquire new jobs from the job queue:
+    // -> if there is no work in flight, block until a new job arrives
+    // -> Files that fit into a single Block are read right away and we keep on
+    //    acquiring jobs
+    // -> a new big File joins the round robin below
+    // -> a termination job initiates the drainout
     FileJob job;
-    const bool popped_new_job = TryToAcquireNewJob(&job);
-    if (popped_new_job) {
-      if (!job.terminate) {
-        OpenNewFile(job.file);
-      } else {
-        EnableDraining();
+    unsigned num_small_files = 0;
+    while (!draining &&
+           (num_small_files < kMaxSmallFilesPerRound) &&
+           AcquireJob(open_files.empty(), &job))
+    {
+      if (job.terminate) {
+        draining = true;
+        break;
+      }
+
+      OpenFile open_file;
+      OpenNewFile(job.file, &open_file);
+      if (job.file->size() > max_buffer_size_) {
+        open_files.push_back(open_file);
+        break;
       }
+
+      const bool finished_reading = ReadAndScheduleNextBuffer(&open_file);
+      assert(finished_reading);
+      CloseFile(&open_file);
+      ++num_small_files;
     }
 
     // read File Blocks in a round robin fashion and schedule these blocks for
     // processing
-    typename OpenFileList::iterator       i    = open_files_.begin();
-    typename OpenFileList::const_iterator iend = open_files_.end();
-    for (; i != iend; ++i) {
+    typename OpenFileList::iterator       i    = open_files.begin();
+    typename OpenFileList::const_iterator iend = open_files.end();
+    while (i != iend) {
       const bool finished_reading = ReadAndScheduleNextBuffer(&(*i));
       if (finished_reading) {
-        OpenFile file = *i;
-        i = open_files_.erase(i);
-        CloseFile(&file);
+        CloseFile(&(*i));
+        i = open_files.erase(i);
+      } else {
+        ++i;
       }
     }
   }
 }
 
 
+/**
+ * Pops the next File to be read, Files that fit into a single Block first.
+ * If the Reader is terminating and there are no more Files, a termination
+ * job is returned.
+ *
+ * @param block  wait for a new job if there is none
+ * @return       false if no job was available
+ */
 template <class FileScrubbingTaskT, class FileT>
-bool Reader<FileScrubbingTaskT, FileT>::TryToAcquireNewJob(FileJob *next_job) {
-  // In draining mode we only process files that are already open
-  if (draining_) {
-    return false;
-  }
-
-  bool popped = false;
-
-  // If we have no more work, we allow the thread to block otherwise we just
-  // acquire what we can get and continue working
-  if (open_files_.empty()) {
-    queue_.pop(*next_job);
-    popped = true;
+bool Reader<FileScrubbingTaskT, FileT>::AcquireJob(const bool  block,
+                                                   FileJob    *next_job) {
+  MutexLockGuard guard(lock_jobs_);
+  while (block && small_files_.empty() && big_files_.empty() && !terminating_)
+    pthread_cond_wait(&cond_jobs_, &lock_jobs_);
+
+  if (!small_files_.empty()) {
+    *next_job = FileJob(small_files_.front());
+    small_files_.pop_front();
+  } else if (!big_files_.empty()) {
+    *next_job = FileJob(big_files_.front());
+    big_files_.pop_front();
+  } else if (terminating_) {
+    *next_job = FileJob();
   } else {
-    popped = queue_.try_pop(*next_job);
+    return false;
   }
-
-  return popped;
+  return true;
 }
 
 
 template <class FileScrubbingTaskT, class FileT>
-void Reader<FileScrubbingTaskT, FileT>::OpenNewFile(FileT *file) {
+void Reader<FileScrubbingTaskT, FileT>::OpenNewFile(FileT    *file,
+                                                    OpenFile *open_file) {
   const int fd = open(file->path().c_str(), O_RDONLY, 0);
   if (fd < 0) {
     switch (errno) {
@@ -113,10 +175,8 @@ void Reader<FileScrubbingTaskT, FileT>::OpenNewFile(FileT *file) {
   }
   assert(fd > 0);
 
-  OpenFile open_file;
-  open_file.file            = file;
-  open_file.file_descriptor = fd;
-  open_files_.push_back(open_file);
+  open_file->file            = file;
+  open_file->file_descriptor = fd;
 }
 
 
@@ -224,8 +284,11 @@ bool Reader<FileScrubbingTaskT, FileT>::
 
   // decorate the predecessor task (i-1) with it's successor (i) and allow the
   // predecessor to be scheduled by TBB (task::enqueue)
+  // Note: once enqueued, the data Block is pending in the CharBufferPool, i.e.
+  //       it will be released without further read-in
   if (open_file->previous_task != NULL) {
     open_file->previous_task->SetNext(new_task);
+    buffer_pool()->MarkPending();
     tbb::task::enqueue(*open_file->previous_sync_task);
   }
 
@@ -234,6 +297,7 @@ bool Reader<FileScrubbingTaskT, FileT>::
 
   // make sure that the last chunk is processed
   if (finished_reading) {
+    buffer_pool()->MarkPending();
     tbb::task::enqueue(*open_file->previous_sync_task);
   }
 
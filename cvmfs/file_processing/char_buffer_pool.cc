@@ -0,0 +1,210 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "char_buffer_pool.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "../util_concurrency.h"
+
+namespace upload {
+
+CharBufferPool::CharBufferPool(const uint64_t max_idle_bytes,
+                               const uint64_t max_bytes_in_flight) :
+  max_idle_bytes_(max_idle_bytes),
+  max_bytes_in_flight_(max_bytes_in_flight)
+{
+  idle_bytes_              = 0;
+  bytes_in_flight_         = 0;
+  num_pending_             = 0;
+  num_waiting_             = 0;
+  num_allocated_           = 0;
+  num_recycled_            = 0;
+  num_unpooled_            = 0;
+  num_freed_               = 0;
+  peak_bytes_in_flight_    = 0;
+
+  const bool init_successful = (
+    pthread_mutex_init(&lock_throttle_, NULL) == 0 &&
+    pthread_cond_init(&cond_throttle_, NULL) == 0);
+  assert(init_successful);
+}
+
+
+CharBufferPool::~CharBufferPool() {
+  tbb::enumerable_thread_specific<ThreadCache>::iterator i    =
+    thread_caches_.begin();
+  tbb::enumerable_thread_specific<ThreadCache>::iterator iend =
+    thread_caches_.end();
+  for (; i != iend; ++i) {
+    for (unsigned c = 0; c < kNumSizeClasses; ++c) {
+      for (unsigned j = 0; j < i->buffers[c].size(); ++j)
+        delete i->buffers[c][j];
+    }
+  }
+
+  for (unsigned c = 0; c < kNumSizeClasses; ++c) {
+    CharBuffer *buffer;
+    while (depot_[c].try_pop(buffer))
+      delete buffer;
+  }
+
+  pthread_mutex_destroy(&lock_throttle_);
+  pthread_cond_destroy(&cond_throttle_);
+}
+
+
+/**
+ * @return  the smallest size class that fits size bytes or -1 if the size
+ *          exceeds the largest size class
+ */
+int CharBufferPool::GetSizeClass(const size_t size) {
+  for (unsigned c = 0; c < kNumSizeClasses; ++c) {
+    if (size <= GetClassSize(c))
+      return c;
+  }
+  return -1;
+}
+
+
+size_t CharBufferPool::GetClassSize(const unsigned size_class) {
+  return size_t(4096) << size_class;
+}
+
+
+/**
+ * Provides an empty buffer of at least size bytes.  Never blocks.
+ */
+CharBuffer *CharBufferPool::Allocate(const size_t size) {
+  const int size_class = GetSizeClass(size);
+  CharBuffer *buffer = NULL;
+  if (size_class < 0) {
+    ++num_unpooled_;
+    buffer = new CharBuffer(size);
+  } else {
+    std::vector<CharBuffer *> &cache =
+      thread_caches_.local().buffers[size_class];
+    if (!cache.empty()) {
+      buffer = cache.back();
+      cache.pop_back();
+    } else if (!depot_[size_class].try_pop(buffer)) {
+      buffer = NULL;
+    }
+
+    if (buffer != NULL) {
+      ++num_recycled_;
+      idle_bytes_ -= buffer->size();
+      buffer->SetUsedBytes(0);
+      buffer->SetBaseOffset(0);
+    } else {
+      ++num_allocated_;
+      buffer = new CharBuffer(GetClassSize(size_class));
+    }
+  }
+
+  AccountAllocation(buffer->size());
+  return buffer;
+}
+
+
+/**
+ * Like Allocate() but blocks while the buffers in flight exceed the in-flight
+ * limit and pending buffers are still being processed.  Once the buffer is
+ * scheduled for processing, it should be marked by MarkPending() and it has to
+ * be returned by ReleasePending().
+ */
+CharBuffer *CharBufferPool::AllocateThrottled(const size_t size) {
+  if ((max_bytes_in_flight_ > 0) &&
+      (bytes_in_flight_ >= max_bytes_in_flight_) &&
+      (num_pending_ > 0))
+  {
+    MutexLockGuard guard(lock_throttle_);
+    ++num_waiting_;
+    while ((bytes_in_flight_ >= max_bytes_in_flight_) && (num_pending_ > 0))
+      pthread_cond_wait(&cond_throttle_, &lock_throttle_);
+    --num_waiting_;
+  }
+
+  return Allocate(size);
+}
+
+
+/**
+ * Copies the used bytes of a buffer into a new buffer from the pool.
+ */
+CharBuffer *CharBufferPool::Clone(const CharBuffer &buffer) {
+  assert(buffer.IsInitialized());
+  CharBuffer *new_buffer = Allocate(buffer.size());
+  memcpy(new_buffer->ptr(), buffer.ptr(), buffer.used_bytes());
+  new_buffer->SetUsedBytes(buffer.used_bytes());
+  new_buffer->SetBaseOffset(buffer.base_offset());
+  return new_buffer;
+}
+
+
+/**
+ * Returns a buffer obtained by Allocate() or Clone().  The buffer is recycled
+ * if there is room in the pool, otherwise it is freed.
+ */
+void CharBufferPool::Release(CharBuffer *buffer) {
+  assert(buffer != NULL);
+  const size_t bytes = buffer->size();
+  const int size_class = GetSizeClass(bytes);
+
+  if ((size_class < 0) || (GetClassSize(size_class) != bytes)) {
+    delete buffer;
+  } else if (idle_bytes_.fetch_and_add(bytes) + bytes > max_idle_bytes_) {
+    idle_bytes_ -= bytes;
+    ++num_freed_;
+    delete buffer;
+  } else {
+    std::vector<CharBuffer *> &cache =
+      thread_caches_.local().buffers[size_class];
+    if (cache.size() < kThreadCacheSize) {
+      cache.push_back(buffer);
+    } else {
+      depot_[size_class].push(buffer);
+    }
+  }
+
+  bytes_in_flight_ -= bytes;
+  if (num_waiting_ > 0) {
+    MutexLockGuard guard(lock_throttle_);
+    pthread_cond_broadcast(&cond_throttle_);
+  }
+}
+
+
+void CharBufferPool::ReleasePending(CharBuffer *buffer) {
+  --num_pending_;
+  Release(buffer);
+}
+
+
+CharBufferPool::Counters CharBufferPool::GetCounters() const {
+  Counters result;
+  result.num_allocated        = num_allocated_;
+  result.num_recycled         = num_recycled_;
+  result.num_unpooled         = num_unpooled_;
+  result.num_freed            = num_freed_;
+  result.peak_bytes_in_flight = peak_bytes_in_flight_;
+  return result;
+}
+
+
+void CharBufferPool::AccountAllocation(const size_t bytes) {
+  const uint64_t in_flight = bytes_in_flight_.fetch_and_add(bytes) + bytes;
+  uint64_t peak = peak_bytes_in_flight_;
+  while (peak < in_flight) {
+    const uint64_t seen =
+      peak_bytes_in_flight_.compare_and_swap(in_flight, peak);
+    if (seen == peak)
+      break;
+    peak = seen;
+  }
+}
+
+}  // namespace upload
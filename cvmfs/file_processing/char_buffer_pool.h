@@ -0,0 +1,110 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_FILE_PROCESSING_CHAR_BUFFER_POOL_H_
+#define CVMFS_FILE_PROCESSING_CHAR_BUFFER_POOL_H_
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <tbb/atomic.h>
+#include <tbb/concurrent_queue.h>
+#include <tbb/enumerable_thread_specific.h>
+
+#include <vector>
+
+#include "../util.h"
+#include "char_buffer.h"
+
+namespace upload {
+
+/**
+ * Recycles the CharBuffers of the file processing pipeline.  Buffers are
+ * handed out in fixed size classes (powers of two from 4 kB to 1 MB).
+ * Returned buffers are kept in a small per-thread cache first and in a shared
+ * depot if the thread cache is full.  The overall memory of idle buffers is
+ * bounded; surplus buffers are freed.  Buffers larger than the largest size
+ * class are allocated and freed directly.
+ *
+ * In addition, the pool keeps track of the memory of all buffers that are
+ * currently handed out.  The throttled allocation used by the Reader blocks
+ * while this memory exceeds the in-flight limit, which applies back-pressure
+ * to the read-in if compression or upload fall behind.  In order to avoid
+ * dead locks (e.g. with deferred writes that hold buffers until a file is
+ * fully read, or with buffers that a reader thread holds back until it read
+ * the next block of the file), a throttled allocation only blocks as long as
+ * there are pending buffers.  Pending buffers are scheduled for processing
+ * and will be released without further action of the allocating thread.
+ */
+class CharBufferPool : SingleCopy {
+ public:
+  struct Counters {
+    Counters() : num_allocated(0), num_recycled(0), num_unpooled(0),
+                 num_freed(0), peak_bytes_in_flight(0) { }
+
+    uint64_t num_allocated;  ///< buffers freshly allocated for a size class
+    uint64_t num_recycled;   ///< buffers served from the pool
+    uint64_t num_unpooled;   ///< buffers larger than the largest size class
+    uint64_t num_freed;      ///< returned buffers freed because pool was full
+    uint64_t peak_bytes_in_flight;
+  };
+
+  /**
+   * @param max_idle_bytes       upper bound for the memory of pooled buffers
+   * @param max_bytes_in_flight  limit for throttled allocations, 0 disables
+   *                             the back-pressure
+   */
+  CharBufferPool(const uint64_t max_idle_bytes,
+                 const uint64_t max_bytes_in_flight);
+  ~CharBufferPool();
+
+  CharBuffer *Allocate(const size_t size);
+  CharBuffer *AllocateThrottled(const size_t size);
+  CharBuffer *Clone(const CharBuffer &buffer);
+  void MarkPending() { ++num_pending_; }
+  void Release(CharBuffer *buffer);
+  void ReleasePending(CharBuffer *buffer);
+
+  Counters GetCounters() const;
+  uint64_t bytes_in_flight() const { return bytes_in_flight_; }
+  uint64_t idle_bytes() const { return idle_bytes_; }
+
+ private:
+  static const unsigned kNumSizeClasses = 9;
+  /**
+   * Number of buffers per size class kept in every thread's cache
+   */
+  static const unsigned kThreadCacheSize = 4;
+
+  struct ThreadCache {
+    std::vector<CharBuffer *> buffers[kNumSizeClasses];
+  };
+
+  static int GetSizeClass(const size_t size);
+  static size_t GetClassSize(const unsigned size_class);
+
+  void AccountAllocation(const size_t bytes);
+
+  const uint64_t max_idle_bytes_;
+  const uint64_t max_bytes_in_flight_;
+
+  tbb::enumerable_thread_specific<ThreadCache> thread_caches_;
+  tbb::concurrent_queue<CharBuffer *> depot_[kNumSizeClasses];
+
+  tbb::atomic<uint64_t> idle_bytes_;
+  tbb::atomic<uint64_t> bytes_in_flight_;
+  tbb::atomic<unsigned> num_pending_;
+  tbb::atomic<unsigned> num_waiting_;
+  pthread_mutex_t lock_throttle_;
+  pthread_cond_t cond_throttle_;
+
+  tbb::atomic<uint64_t> num_allocated_;
+  tbb::atomic<uint64_t> num_recycled_;
+  tbb::atomic<uint64_t> num_unpooled_;
+  tbb::atomic<uint64_t> num_freed_;
+  tbb::atomic<uint64_t> peak_bytes_in_flight_;
+};
+
+}  // namespace upload
+
+#endif  // CVMFS_FILE_PROCESSING_CHAR_BUFFER_POOL_H_
@@ -18,7 +18,8 @@ CharBuffer* Chunk::GetDeflateBuffer(const size_t bytes) {
     if (current_deflate_buffer_ != NULL) {
       ScheduleWrite(current_deflate_buffer_);
     }
-    current_deflate_buffer_ = new CharBuffer(bytes);
+    current_deflate_buffer_ =
+      file_->io_dispatcher()->buffer_pool()->Allocate(bytes);
   }
 
   return current_deflate_buffer_;
@@ -122,7 +123,9 @@ Chunk::Chunk(const Chunk &other) :
   assert(other.bytes_written_ == 0);
   assert(other.zlib_context_.avail_in == 0);
 
-  current_deflate_buffer_ = other.current_deflate_buffer_->Clone();
+  current_deflate_buffer_ =
+    file_->io_dispatcher()->buffer_pool()->Clone(
+      *other.current_deflate_buffer_);
 
   content_hash_context_.buffer = smalloc(content_hash_context_.size);
   memcpy(content_hash_context_.buffer,
@@ -16,10 +16,12 @@ File::File(const std::string    &path,
            IoDispatcher         *io_dispatcher,
            ChunkDetector        *chunk_detector,
            shash::Algorithms     hash_algorithm,
-           const shash::Suffix   hash_suffix) :
+           const shash::Suffix   hash_suffix,
+           const bool            generate_bulk_chunk) :
   AbstractFile(path, GetFileSize(path)),
   might_become_chunked_(chunk_detector != NULL &&
                         chunk_detector->MightFindChunks(size())),
+  generate_bulk_chunk_(generate_bulk_chunk),
   hash_algorithm_(hash_algorithm),
   hash_suffix_(hash_suffix),
   bulk_chunk_(NULL),
@@ -76,7 +78,10 @@ void File::CreateInitialChunk() {
     // write back of data until a final decision has been made
     // as soon as a second chunk has been generated, this chunk will be
     // duplicated and serve as the beginning of the bulk chunk as well
-    new_chunk->EnableDeferredWrite();
+    // without bulk chunk generation, there is nothing to duplicate and the
+    // data can be written right away
+    if (generate_bulk_chunk_)
+      new_chunk->EnableDeferredWrite();
   } else {
     // if we are dealing with a file that will definitely _not_ be chunked, we
     // directly mark the initial chunk as being a bulk chunk
@@ -101,7 +106,7 @@ Chunk* File::CreateNextChunk(const off_t offset) {
   // copy the initially created Chunk as the bulk_chunk_ as soon as we create
   // a second Chunk, thus defining the file to be chunked in general
   // (see CreateInitialChunk())
-  if (!HasBulkChunk()) {
+  if (generate_bulk_chunk_ && !HasBulkChunk()) {
     ForkOffBulkChunk();
   }
 
@@ -164,7 +169,7 @@ void File::FullyDefineLastChunk() {
   // only one Chunk was generated during the processing of this file, though it
   // was classified as possible chunked file --> re-define the file as not being
   // chunked and use the single generated Chunk as bulk Chunk
-  if (might_become_chunked_ && !HasBulkChunk()) {
+  if (might_become_chunked_ && !IsChunked()) {
     PromoteSingleChunkAsBulkChunk();
   }
 }
@@ -194,10 +199,13 @@ void File::Finalize() {
 #endif
 
   // more sanity checks
-  assert(HasBulkChunk());
-  assert(bulk_chunk_->offset() == 0);
-  assert(bulk_chunk_->size()   == size());
-  assert(bulk_chunk_->IsFullyProcessed());
+  if (HasBulkChunk()) {
+    assert(bulk_chunk_->offset() == 0);
+    assert(bulk_chunk_->size()   == size());
+    assert(bulk_chunk_->IsFullyProcessed());
+  } else {
+    assert(!generate_bulk_chunk_ && IsChunked());
+  }
 
   // notify about the finished file processing
   io_dispatcher_->CommitFile(this);
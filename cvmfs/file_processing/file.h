@@ -34,10 +34,12 @@ class File : public AbstractFile {
        IoDispatcher         *io_dispatcher,
        ChunkDetector        *chunk_detector,
        shash::Algorithms     hash_algorithm,
-       const shash::Suffix   hash_suffix = shash::kSuffixNone);
+       const shash::Suffix   hash_suffix = shash::kSuffixNone,
+       const bool            generate_bulk_chunk = true);
   ~File();
 
   bool MightBecomeChunked() const { return might_become_chunked_; }
+  bool IsChunked() const { return chunks_.size() > 1; }
 
   /**
    * This creates a next chunk which will be the successor of the current chunk
@@ -83,6 +85,9 @@ class File : public AbstractFile {
 
   IoDispatcher* io_dispatcher() { return io_dispatcher_; }
 
+  const std::string &hash_cache_key() const { return hash_cache_key_; }
+  void set_hash_cache_key(const std::string &key) { hash_cache_key_ = key; }
+
  protected:
   void AddChunk(Chunk *chunk, const bool register_chunk = true);
   void CreateInitialChunk();
@@ -92,6 +97,11 @@ class File : public AbstractFile {
 
  private:
   const bool might_become_chunked_;  ///< Result of the chunkedness forecast
+  /**
+   * If false, a chunked file is only stored as its chunks and has no bulk
+   * Chunk.  Files with a single chunk always end up as bulk Chunk.
+   */
+  const bool generate_bulk_chunk_;
   /**
    * Secure hash algorithm creating content-addressable storage
    */
@@ -113,6 +123,11 @@ class File : public AbstractFile {
    * The ChunkDetector to be used for this file.
    */
   ChunkDetector *chunk_detector_;
+  /**
+   * Key of the processing result in the publish hash cache, empty if the
+   * result is not cached
+   */
+  std::string hash_cache_key_;
 };
 
 }  // namespace upload
@@ -9,6 +9,7 @@
 #include <string>
 
 #include "../logging.h"
+#include "../upload_hash_cache.h"
 #include "chunk.h"
 #include "chunk_detector.h"
 #include "file.h"
@@ -20,9 +21,14 @@ FileProcessor::FileProcessor(AbstractUploader         *uploader,
                              const SpoolerDefinition  &spooler_definition) :
   io_dispatcher_(new IoDispatcher(uploader,
                                   this,
-                                  spooler_definition.number_of_threads)),
+                                  spooler_definition.number_of_threads,
+                                  spooler_definition.number_of_read_threads,
+                                  spooler_definition.max_read_bytes_in_flight)),
+  hash_cache_(NULL),
+  hash_cache_queue_(NULL),
   hash_algorithm_(spooler_definition.hash_algorithm),
   chunking_enabled_(spooler_definition.use_file_chunking),
+  generate_bulk_chunks_(spooler_definition.generate_legacy_bulk_chunks),
   minimal_chunk_size_(spooler_definition.min_file_chunk_size),
   average_chunk_size_(spooler_definition.avg_file_chunk_size),
   maximal_chunk_size_(spooler_definition.max_file_chunk_size)
@@ -33,18 +39,120 @@ FileProcessor::FileProcessor(AbstractUploader         *uploader,
   assert(!chunking_enabled_ || maximal_chunk_size_ > 0);
   assert(!chunking_enabled_ || minimal_chunk_size_ <= average_chunk_size_);
   assert(!chunking_enabled_ || average_chunk_size_ <= maximal_chunk_size_);
+
+  atomic_init64(&num_skipped_bytes_);
+  if (!spooler_definition.hash_cache_path.empty()) {
+    hash_cache_ = HashCache::Open(spooler_definition.hash_cache_path);
+    if (hash_cache_ == NULL) {
+      LogCvmfs(kLogSpooler, kLogWarning, "hash cache %s unavailable, "
+               "processing all files",
+               spooler_definition.hash_cache_path.c_str());
+    }
+  }
+  if (hash_cache_ != NULL) {
+    const unsigned num_threads = spooler_definition.number_of_threads;
+    hash_cache_queue_ =
+      new FifoChannel<HashCacheJob *>(kHashCacheQueueLength,
+                                      kHashCacheQueueLength / 2);
+    hash_cache_threads_.resize(num_threads);
+    for (unsigned i = 0; i < num_threads; ++i) {
+      int retval =
+        pthread_create(&hash_cache_threads_[i], NULL, MainHashCache, this);
+      assert(retval == 0);
+    }
+  }
 }
 
 
 FileProcessor::~FileProcessor() {
+  if (hash_cache_queue_ != NULL) {
+    for (unsigned i = 0; i < hash_cache_threads_.size(); ++i)
+      hash_cache_queue_->Enqueue(NULL);
+    for (unsigned i = 0; i < hash_cache_threads_.size(); ++i)
+      pthread_join(hash_cache_threads_[i], NULL);
+    delete hash_cache_queue_;
+  }
   delete io_dispatcher_;
   io_dispatcher_ = NULL;
+  delete hash_cache_;
+}
+
+
+void *FileProcessor::MainHashCache(void *data) {
+  FileProcessor *processor = reinterpret_cast<FileProcessor *>(data);
+  while (true) {
+    HashCacheJob *job = processor->hash_cache_queue_->Dequeue();
+    if (job == NULL)
+      break;
+    const bool chunked = processor->chunking_enabled_ && job->allow_chunking;
+    std::string key;
+    if (!processor->ProcessFromHashCache(job->local_path, chunked, &key)) {
+      processor->ScheduleRead(job->local_path, job->allow_chunking,
+                              shash::kSuffixNone, key);
+    }
+    delete job;
+    --processor->hash_cache_jobs_in_flight_;
+  }
+  return NULL;
+}
+
+
+/**
+ * Looks up the content of a regular file in the hash cache.  On a hit, the
+ * processing result is announced right away.  On a miss, the cache key is
+ * returned for storing the result once the file is processed.
+ *
+ * @return  true if the file does not need to be processed
+ */
+bool FileProcessor::ProcessFromHashCache(const std::string &local_path,
+                                         const bool chunked,
+                                         std::string *key)
+{
+  // Same content, same processing parameters, same result.  The pipeline
+  // always compresses with zlib.
+  shash::Any content(hash_algorithm_);
+  if (!shash::HashFile(local_path, &content))
+    return false;
+  *key = content.ToString() + "|zlib";
+  if (chunked) {
+    *key += "|" + StringifyInt(minimal_chunk_size_) +
+            ":" + StringifyInt(average_chunk_size_) +
+            ":" + StringifyInt(maximal_chunk_size_) +
+            (generate_bulk_chunks_ ? "+bulk" : "");
+  }
+
+  shash::Any bulk_hash;
+  FileChunkList chunks;
+  if (!hash_cache_->Lookup(*key, &bulk_hash, &chunks))
+    return false;
+
+  // Chunked files without bulk chunk have a null bulk hash
+  LogCvmfs(kLogSpooler, kLogVerboseMsg, "File '%s' found in hash cache "
+                                        "(bulk hash: %s)",
+           local_path.c_str(), bulk_hash.ToString().c_str());
+  atomic_xadd64(&num_skipped_bytes_, GetFileSize(local_path));
+  NotifyListeners(SpoolerResult(0, local_path, bulk_hash, chunks));
+  return true;
 }
 
 
 void FileProcessor::Process(const std::string   &local_path,
                             const bool           allow_chunking,
                             const shash::Suffix  hash_suffix) {
+  // Only data objects are cached, catalogs and other special files are not
+  if ((hash_cache_ != NULL) && (hash_suffix == shash::kSuffixNone)) {
+    ++hash_cache_jobs_in_flight_;
+    hash_cache_queue_->Enqueue(new HashCacheJob(local_path, allow_chunking));
+    return;
+  }
+  ScheduleRead(local_path, allow_chunking, hash_suffix, "");
+}
+
+
+void FileProcessor::ScheduleRead(const std::string   &local_path,
+                                 const bool           allow_chunking,
+                                 const shash::Suffix  hash_suffix,
+                                 const std::string   &hash_cache_key) {
   ChunkDetector *chunk_detector = (chunking_enabled_ && allow_chunking)
                                         ? new Xor32Detector(minimal_chunk_size_,
                                                             average_chunk_size_,
@@ -54,7 +162,9 @@ void FileProcessor::Process(const std::string   &local_path,
                         io_dispatcher_,
                         chunk_detector,
                         hash_algorithm_,
-                        hash_suffix);
+                        hash_suffix,
+                        generate_bulk_chunks_);
+  file->set_hash_cache_key(hash_cache_key);
 
   LogCvmfs(kLogSpooler, kLogVerboseMsg, "Scheduling '%s' for processing ("
                                         "chunking: %s, hash_suffix: %c)",
@@ -68,8 +178,16 @@ void FileProcessor::Process(const std::string   &local_path,
 void FileProcessor::FileDone(File *file) {
   assert(file != NULL);
   assert(!file->path().empty());
-  assert(file->bulk_chunk() != NULL);
-  assert(!file->bulk_chunk()->content_hash().IsNull());
+  assert((file->bulk_chunk() != NULL) || file->IsChunked());
+
+  // chunked files processed without bulk chunk are announced with a null
+  // bulk hash
+  shash::Any bulk_hash(hash_algorithm_);
+  bulk_hash.suffix = file->hash_suffix();
+  if (file->HasBulkChunk()) {
+    bulk_hash = file->bulk_chunk()->content_hash();
+    assert(!bulk_hash.IsNull());
+  }
 
   // extract crucial information from the Chunk structures and wrap them into
   // the global FileChunk data structure
@@ -89,18 +207,39 @@ void FileProcessor::FileDone(File *file) {
   LogCvmfs(kLogSpooler, kLogVerboseMsg, "File '%s' processed completely "
                                         "(bulk hash: %s suffix: %c)",
            file->path().c_str(),
-           file->bulk_chunk()->content_hash().ToString().c_str(),
+           bulk_hash.ToString().c_str(),
            file->hash_suffix());
-  assert(file->hash_suffix() == file->bulk_chunk()->content_hash().suffix);
+  assert(file->hash_suffix() == bulk_hash.suffix);
+
+  if ((hash_cache_ != NULL) && !file->hash_cache_key().empty() &&
+      !hash_cache_->Store(file->hash_cache_key(), bulk_hash, resulting_chunks))
+  {
+    LogCvmfs(kLogSpooler, kLogVerboseMsg, "failed to store '%s' in the "
+                                          "hash cache", file->path().c_str());
+  }
+
   NotifyListeners(SpoolerResult(0,
                                 file->path(),
-                                file->bulk_chunk()->content_hash(),
+                                bulk_hash,
                                 resulting_chunks));
 }
 
 
+/**
+ * Waits for all scheduled files and commits the hash cache entries of the
+ * processed files.
+ */
 void FileProcessor::WaitForProcessing() {
+  if (hash_cache_ != NULL)
+    hash_cache_jobs_in_flight_.WaitForZero();
   io_dispatcher_->Wait();
+  if (hash_cache_ != NULL)
+    hash_cache_->Commit();
+}
+
+
+CharBufferPool::Counters FileProcessor::GetBufferPoolCounters() const {
+  return io_dispatcher_->buffer_pool()->GetCounters();
 }
 
 }  // namespace upload
@@ -5,12 +5,17 @@
 #ifndef CVMFS_FILE_PROCESSING_FILE_PROCESSOR_H_
 #define CVMFS_FILE_PROCESSING_FILE_PROCESSOR_H_
 
+#include <pthread.h>
+
 #include <string>
+#include <vector>
 
+#include "../atomic.h"
 #include "../hash.h"
 #include "../upload_spooler_result.h"
 #include "../util.h"
 #include "../util_concurrency.h"
+#include "char_buffer_pool.h"
 
 namespace upload {
 
@@ -61,6 +66,7 @@ namespace upload {
 
 
 class AbstractUploader;
+class HashCache;
 class IoDispatcher;
 class File;
 struct SpoolerDefinition;
@@ -84,15 +90,61 @@ class FileProcessor : public Observable<SpoolerResult> {
 
   void WaitForProcessing();
 
+  /**
+   * Number of bytes of input files that were not processed and uploaded
+   * because their content was found in the hash cache.
+   */
+  uint64_t GetNumSkippedBytes() const {
+    return atomic_read64(&num_skipped_bytes_);
+  }
+
+  CharBufferPool::Counters GetBufferPoolCounters() const;
+
  protected:
   friend class IoDispatcher;
   void FileDone(File *file);
 
  private:
-  IoDispatcher  *io_dispatcher_;
+  /**
+   * A regular file waiting for the hash cache lookup
+   */
+  struct HashCacheJob {
+    HashCacheJob(const std::string &local_path, const bool allow_chunking)
+      : local_path(local_path), allow_chunking(allow_chunking) { }
+    std::string local_path;
+    bool allow_chunking;
+  };
+
+  static void *MainHashCache(void *data);
+  bool ProcessFromHashCache(const std::string &local_path,
+                            const bool chunked,
+                            std::string *key);
+  void ScheduleRead(const std::string   &local_path,
+                    const bool           allow_chunking,
+                    const shash::Suffix  hash_suffix,
+                    const std::string   &hash_cache_key);
+
+  /**
+   * Number of regular files that can wait for the hash cache lookup before
+   * Process() blocks
+   */
+  static const unsigned kHashCacheQueueLength = 1000;
+
+  IoDispatcher      *io_dispatcher_;
+  /**
+   * NULL if the hash cache is disabled.  Regular files are hashed and looked
+   * up by a pool of threads, so that the spooling thread does not block.
+   * Files that miss the cache carry their cache key through the pipeline.
+   */
+  HashCache                        *hash_cache_;
+  FifoChannel<HashCacheJob *>      *hash_cache_queue_;
+  std::vector<pthread_t>            hash_cache_threads_;
+  SynchronizingCounter<uint32_t>    hash_cache_jobs_in_flight_;
+  mutable atomic_int64              num_skipped_bytes_;
 
   shash::Algorithms  hash_algorithm_;
   const bool         chunking_enabled_;
+  const bool         generate_bulk_chunks_;
   const size_t       minimal_chunk_size_;
   const size_t       average_chunk_size_;
   const size_t       maximal_chunk_size_;
@@ -77,7 +77,7 @@ void IoDispatcher::BufferUploadCompleteCallback(
 
   chunk->add_bytes_written(buffer->used_bytes());
   if (delete_buffer) {
-    delete buffer;
+    buffer_pool()->Release(buffer);
   }
 }
 
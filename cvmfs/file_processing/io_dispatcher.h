@@ -118,13 +118,25 @@ class IoDispatcher {
  public:
   typedef tbb::concurrent_bounded_queue<WriteJob> WriteJobQueue;
 
+  /**
+   * Unless specified otherwise, read-in is throttled if the buffers in flight
+   * exceed this limit
+   */
+  static const uint64_t kMaxBufferBytesInFlightPerThread = 32 * 1024 * 1024;
+
  public:
   IoDispatcher(AbstractUploader    *uploader,
                FileProcessor       *file_processor,
                const unsigned int   number_of_threads,
+               const unsigned int   number_of_read_threads = 1,
+               const uint64_t       max_read_bytes_in_flight = 0,
                const size_t         max_read_buffer_size = 512 * 1024) :
     max_read_buffer_size_(max_read_buffer_size),
-    reader_(max_read_buffer_size_, number_of_threads * 10),
+    reader_(max_read_buffer_size_, number_of_threads * 10,
+            (max_read_bytes_in_flight > 0)
+              ? max_read_bytes_in_flight
+              : uint64_t(number_of_threads) * kMaxBufferBytesInFlightPerThread,
+            number_of_read_threads),
     uploader_(uploader),
     file_processor_(file_processor)
   {
@@ -173,6 +185,11 @@ class IoDispatcher {
 
   void CommitFile(File *file);
 
+  /**
+   * All CharBuffers of the processing pipeline are taken from this pool
+   */
+  CharBufferPool *buffer_pool() { return reader_.buffer_pool(); }
+
  protected:
   friend class Chunk;
   friend class File;
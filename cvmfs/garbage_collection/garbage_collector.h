@@ -32,6 +32,7 @@
 #ifndef CVMFS_GARBAGE_COLLECTION_GARBAGE_COLLECTOR_H_
 #define CVMFS_GARBAGE_COLLECTION_GARBAGE_COLLECTOR_H_
 
+#include <cstdio>
 #include <vector>
 
 #include "../upload_facility.h"
@@ -60,7 +61,8 @@ class GarbageCollector {
       , keep_history_depth(kFullHistory)
       , keep_history_timestamp(kNoTimestamp)
       , dry_run(false)
-      , verbose(false) {}
+      , verbose(false)
+      , deleted_objects_logfile(NULL) {}
 
     upload::AbstractUploader  *uploader;
     ObjectFetcherTN           *object_fetcher;
@@ -68,6 +70,7 @@ class GarbageCollector {
     time_t                     keep_history_timestamp;
     bool                       dry_run;
     bool                       verbose;
+    FILE                      *deleted_objects_logfile;  ///< also in dry runs
   };
 
  public:
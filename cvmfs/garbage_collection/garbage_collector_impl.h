@@ -132,20 +132,28 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::Sweep(
     LogCvmfs(kLogGc, kLogStdout, "Sweep: %s", hash.ToString().c_str());
   }
 
+  if (configuration_.deleted_objects_logfile != NULL) {
+    fprintf(configuration_.deleted_objects_logfile, "%s\n",
+            hash.ToStringWithSuffix().c_str());
+  }
+
   if (configuration_.dry_run) {
     return;
   }
 
-  configuration_.uploader->Remove(hash);
+  // Removed in parallel batches, Collect() waits for the removals
+  configuration_.uploader->ScheduleRemove(hash);
 }
 
 
 template <class CatalogTraversalT, class HashFilterT>
 bool GarbageCollector<CatalogTraversalT, HashFilterT>::Collect() {
-  return AnalyzePreservedCatalogTree()   &&
-         CheckPreservedRevisions()       &&
-         SweepCondemnedCatalogTree()     &&
-         SweepHistoricRevisions();
+  const bool success = AnalyzePreservedCatalogTree()   &&
+                       CheckPreservedRevisions()       &&
+                       SweepCondemnedCatalogTree()     &&
+                       SweepHistoricRevisions();
+  configuration_.uploader->WaitForRemove();
+  return success;
 }
 
 
@@ -7,13 +7,28 @@
 
 #include <alloca.h>
 #include <openssl/md5.h>
+#include <openssl/opensslconf.h>
+#include <openssl/opensslv.h>
 #include <openssl/ripemd.h>
 #include <openssl/sha.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <cstdio>
+#include <cstring>
 
 #include "sha2.h"
 
+// OpenSSL selects the fastest SHA-256 implementation for the CPU at runtime
+// (e.g. SHA extensions, AVX2).  The bundled implementation is only a fallback.
+// The version and the OPENSSL_NO_* macros come from opensslv.h and
+// opensslconf.h, which are included explicitly for this check.
+#if (OPENSSL_VERSION_NUMBER >= 0x00908000L) && !defined(OPENSSL_NO_SHA256)
+#define CVMFS_OPENSSL_SHA256
+#endif
+
 using namespace std;  // NOLINT
 
 #ifdef CVMFS_NAMESPACE_GUARD
@@ -102,7 +117,11 @@ unsigned GetContextSize(const Algorithms algorithm) {
     case kRmd160:
       return sizeof(RIPEMD160_CTX);
     case kSha256:
+#ifdef CVMFS_OPENSSL_SHA256
+      return sizeof(SHA256_CTX);
+#else
       return sizeof(sha256_ctx);
+#endif
     default:
       LogCvmfs(kLogHash, kLogDebug | kLogSyslogErr, "tried to generate hash "
                "context for unspecified hash. Aborting...");
@@ -125,8 +144,13 @@ void Init(ContextPtr context) {
       RIPEMD160_Init(reinterpret_cast<RIPEMD160_CTX *>(context.buffer));
       break;
     case kSha256:
+#ifdef CVMFS_OPENSSL_SHA256
+      assert(context.size == sizeof(SHA256_CTX));
+      SHA256_Init(reinterpret_cast<SHA256_CTX *>(context.buffer));
+#else
       assert(context.size == sizeof(sha256_ctx));
       sha256_init(reinterpret_cast<sha256_ctx *>(context.buffer));
+#endif
       break;
     default:
       abort();  // Undefined hash
@@ -153,9 +177,15 @@ void Update(const unsigned char *buffer, const unsigned buffer_length,
                        buffer, buffer_length);
       break;
     case kSha256:
+#ifdef CVMFS_OPENSSL_SHA256
+      assert(context.size == sizeof(SHA256_CTX));
+      SHA256_Update(reinterpret_cast<SHA256_CTX *>(context.buffer),
+                    buffer, buffer_length);
+#else
       assert(context.size == sizeof(sha256_ctx));
       sha256_update(reinterpret_cast<sha256_ctx *>(context.buffer),
                     buffer, buffer_length);
+#endif
       break;
     default:
       abort();  // Undefined hash
@@ -180,9 +210,15 @@ void Final(ContextPtr context, Any *any_digest) {
                       reinterpret_cast<RIPEMD160_CTX *>(context.buffer));
       break;
     case kSha256:
+#ifdef CVMFS_OPENSSL_SHA256
+      assert(context.size == sizeof(SHA256_CTX));
+      SHA256_Final(any_digest->digest,
+                   reinterpret_cast<SHA256_CTX *>(context.buffer));
+#else
       assert(context.size == sizeof(sha256_ctx));
       sha256_final(reinterpret_cast<sha256_ctx *>(context.buffer),
                    any_digest->digest);
+#endif
       break;
     default:
       abort();  // Undefined hash
@@ -283,6 +319,250 @@ bool HashFile(const std::string &filename, Any *any_digest) {
 }
 
 
+namespace {
+
+#ifdef __SSE2__
+/**
+ * Number of MD5 digests that are computed in parallel in the 32bit lanes of
+ * the SSE2 registers.
+ */
+const unsigned kMd5Lanes = 4;
+
+const uint32_t kMd5Constants[64] = {
+  0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+  0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+  0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+  0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+  0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+  0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+  0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+  0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+  0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+  0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+  0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+const unsigned kMd5Shifts[16] = {
+  7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21
+};
+
+
+/**
+ * Copies block number block_index of the MD5-padded message into block.
+ * @return  false if the padded message has fewer blocks
+ */
+bool GetMd5Block(
+  const unsigned char *message,
+  const unsigned length,
+  const uint64_t block_index,
+  unsigned char *block)
+{
+  const uint64_t num_blocks = (uint64_t(length) + 8) / 64 + 1;
+  if (block_index >= num_blocks)
+    return false;
+  const uint64_t offset = block_index * 64;
+  if (offset + 64 <= length) {
+    memcpy(block, message + offset, 64);
+    return true;
+  }
+
+  memset(block, 0, 64);
+  if (offset <= length) {
+    memcpy(block, message + offset, length - offset);
+    block[length - offset] = 0x80;
+  }
+  if (block_index == num_blocks - 1) {
+    const uint64_t num_bits = uint64_t(length) * 8;
+    for (unsigned i = 0; i < 8; ++i)
+      block[56 + i] = static_cast<unsigned char>(num_bits >> (8 * i));
+  }
+  return true;
+}
+
+
+inline __m128i Md5Step(
+  const __m128i a, const __m128i b, const __m128i f, const __m128i w,
+  const unsigned i, const unsigned shift)
+{
+  __m128i x = _mm_add_epi32(_mm_add_epi32(a, f),
+    _mm_add_epi32(w, _mm_set1_epi32(kMd5Constants[i])));
+  x = _mm_or_si128(_mm_sll_epi32(x, _mm_cvtsi32_si128(shift)),
+                   _mm_srl_epi32(x, _mm_cvtsi32_si128(32 - shift)));
+  return _mm_add_epi32(b, x);
+}
+
+
+/**
+ * Computes the MD5 digests of up to kMd5Lanes messages at once.  The messages
+ * are processed block by block in lockstep.  Lanes of shorter messages keep
+ * running on empty blocks, their digests are taken after their last block.
+ */
+void Md5Lanes(
+  const unsigned num_messages,
+  const unsigned char * const *messages,
+  const unsigned *lengths,
+  unsigned char * const *digests)
+{
+  assert(num_messages <= kMd5Lanes);
+  uint64_t num_blocks[kMd5Lanes];
+  uint64_t max_blocks = 0;
+  for (unsigned l = 0; l < num_messages; ++l) {
+    num_blocks[l] = (uint64_t(lengths[l]) + 8) / 64 + 1;
+    max_blocks = (num_blocks[l] > max_blocks) ? num_blocks[l] : max_blocks;
+  }
+
+  __m128i a = _mm_set1_epi32(0x67452301);
+  __m128i b = _mm_set1_epi32(0xefcdab89);
+  __m128i c = _mm_set1_epi32(0x98badcfe);
+  __m128i d = _mm_set1_epi32(0x10325476);
+  const __m128i ones = _mm_set1_epi32(-1);
+  unsigned char blocks[kMd5Lanes][64];
+  __m128i w[16];
+  for (uint64_t k = 0; k < max_blocks; ++k) {
+    for (unsigned l = 0; l < kMd5Lanes; ++l) {
+      if ((l >= num_messages) ||
+          !GetMd5Block(messages[l], lengths[l], k, blocks[l]))
+      {
+        memset(blocks[l], 0, 64);
+      }
+    }
+    for (unsigned j = 0; j < 16; ++j) {
+      uint32_t words[kMd5Lanes];
+      for (unsigned l = 0; l < kMd5Lanes; ++l)
+        memcpy(&words[l], blocks[l] + 4 * j, 4);
+      w[j] = _mm_set_epi32(words[3], words[2], words[1], words[0]);
+    }
+
+    const __m128i a0 = a, b0 = b, c0 = c, d0 = d;
+    for (unsigned i = 0; i < 16; ++i) {
+      // F(b, c, d) = (b & c) | (~b & d)
+      const __m128i f = _mm_xor_si128(d, _mm_and_si128(b, _mm_xor_si128(c, d)));
+      const __m128i t = d;
+      d = c;
+      c = b;
+      b = Md5Step(a, b, f, w[i], i, kMd5Shifts[i % 4]);
+      a = t;
+    }
+    for (unsigned i = 16; i < 32; ++i) {
+      // G(b, c, d) = (b & d) | (c & ~d)
+      const __m128i f = _mm_xor_si128(c, _mm_and_si128(d, _mm_xor_si128(b, c)));
+      const __m128i t = d;
+      d = c;
+      c = b;
+      b = Md5Step(a, b, f, w[(5 * i + 1) % 16], i, kMd5Shifts[4 + i % 4]);
+      a = t;
+    }
+    for (unsigned i = 32; i < 48; ++i) {
+      // H(b, c, d) = b ^ c ^ d
+      const __m128i f = _mm_xor_si128(_mm_xor_si128(b, c), d);
+      const __m128i t = d;
+      d = c;
+      c = b;
+      b = Md5Step(a, b, f, w[(3 * i + 5) % 16], i, kMd5Shifts[8 + i % 4]);
+      a = t;
+    }
+    for (unsigned i = 48; i < 64; ++i) {
+      // I(b, c, d) = c ^ (b | ~d)
+      const __m128i f =
+        _mm_xor_si128(c, _mm_or_si128(b, _mm_xor_si128(d, ones)));
+      const __m128i t = d;
+      d = c;
+      c = b;
+      b = Md5Step(a, b, f, w[(7 * i) % 16], i, kMd5Shifts[12 + i % 4]);
+      a = t;
+    }
+    a = _mm_add_epi32(a, a0);
+    b = _mm_add_epi32(b, b0);
+    c = _mm_add_epi32(c, c0);
+    d = _mm_add_epi32(d, d0);
+
+    uint32_t state[4][kMd5Lanes];
+    bool stored = false;
+    for (unsigned l = 0; l < num_messages; ++l) {
+      if (k != num_blocks[l] - 1)
+        continue;
+      if (!stored) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(state[0]), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(state[1]), b);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(state[2]), c);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(state[3]), d);
+        stored = true;
+      }
+      for (unsigned r = 0; r < 4; ++r)
+        memcpy(digests[l] + 4 * r, &state[r][l], 4);
+    }
+  }
+}
+#endif  // __SSE2__
+
+}  // anonymous namespace
+
+
+/**
+ * Hashes several buffers.  Where SSE2 is available, MD5 digests are computed
+ * four at a time, which pays off for short buffers such as path names.  Other
+ * algorithms are hashed one after another.
+ */
+void HashMemMulti(
+  const unsigned num_buffers,
+  const unsigned char * const *buffers,
+  const unsigned *buffer_sizes,
+  Any *any_digests)
+{
+  unsigned i = 0;
+  while (i < num_buffers) {
+#ifdef __SSE2__
+    const unsigned char *lane_buffers[kMd5Lanes];
+    unsigned lane_sizes[kMd5Lanes];
+    unsigned char *lane_digests[kMd5Lanes];
+    unsigned num_lanes = 0;
+    while ((i + num_lanes < num_buffers) && (num_lanes < kMd5Lanes) &&
+           (any_digests[i + num_lanes].algorithm == kMd5))
+    {
+      lane_buffers[num_lanes] = buffers[i + num_lanes];
+      lane_sizes[num_lanes] = buffer_sizes[i + num_lanes];
+      lane_digests[num_lanes] = any_digests[i + num_lanes].digest;
+      num_lanes++;
+    }
+    if (num_lanes > 1) {
+      Md5Lanes(num_lanes, lane_buffers, lane_sizes, lane_digests);
+      i += num_lanes;
+      continue;
+    }
+#endif
+    HashMem(buffers[i], buffer_sizes[i], &any_digests[i]);
+    i++;
+  }
+}
+
+
+/**
+ * Multi-buffer variant of the Md5(chars, length) constructor.
+ */
+void Md5Multi(
+  const unsigned num_paths,
+  const char * const *chars,
+  const unsigned *lengths,
+  Md5 *digests)
+{
+  unsigned i = 0;
+#ifdef __SSE2__
+  for (; i + 1 < num_paths; i += kMd5Lanes) {
+    const unsigned num_lanes =
+      (num_paths - i < kMd5Lanes) ? num_paths - i : kMd5Lanes;
+    unsigned char *lane_digests[kMd5Lanes];
+    for (unsigned l = 0; l < num_lanes; ++l)
+      lane_digests[l] = digests[i + l].digest;
+    Md5Lanes(num_lanes, reinterpret_cast<const unsigned char * const *>(
+                          chars + i),
+             lengths + i, lane_digests);
+  }
+#endif
+  for (; i < num_paths; ++i)
+    digests[i] = Md5(chars[i], lengths[i]);
+}
+
+
 /**
  * Fast constructor for hashing path names.
  */
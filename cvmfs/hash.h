@@ -48,6 +48,7 @@ const char kSuffixMicroCatalog = 'L';  // currently unused
 const char kSuffixPartial      = 'P';
 const char kSuffixTemporary    = 'T';
 const char kSuffixCertificate  = 'X';
+const char kSuffixDelta        = 'D';
 
 
 /**
@@ -432,6 +433,20 @@ bool HashFile(const std::string &filename, Any *any_digest);
 void HashMem(const unsigned char *buffer, const unsigned buffer_size,
              Any *any_digest);
 void HashString(const std::string &content, Any *any_digest);
+/**
+ * Hashes num_buffers buffers at once, each with the algorithm preset in the
+ * corresponding any_digests entry.  Digests are the same as from HashMem().
+ */
+void HashMemMulti(const unsigned num_buffers,
+                  const unsigned char * const *buffers,
+                  const unsigned *buffer_sizes,
+                  Any *any_digests);
+/**
+ * Same as Md5(chars[i], lengths[i]) for all i < num_paths
+ */
+void Md5Multi(const unsigned num_paths,
+              const char * const *chars, const unsigned *lengths,
+              Md5 *digests);
 void Hmac(const std::string &key,
           const unsigned char *buffer, const unsigned buffer_size,
           Any *any_digest);
@@ -247,7 +247,7 @@ int cvmfs_globals::Setup(const options &opts) {
   }
 
   retval = sqlite::RegisterVfsRdOnly(
-    cache_mgr_, statistics_, sqlite::kVfsOptDefault);
+    cache_mgr_, statistics_, sqlite::kVfsOptDefault, 0);
   assert(retval);
   vfs_registered_ = true;
 
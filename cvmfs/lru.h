@@ -59,6 +59,7 @@
 #include "directory_entry.h"
 #include "hash.h"
 #include "logging.h"
+#include "lru_packed.h"
 #include "murmur.h"
 #include "platform.h"
 #include "shortstring.h"
@@ -74,36 +75,37 @@ namespace lru {
  */
 struct Counters {
   perf::Counter *sz_size;
-  perf::Counter *n_hit;
-  perf::Counter *n_miss;
-  perf::Counter *n_insert;
-  perf::Counter *n_insert_negative;
+  perf::ShardedCounter *n_hit;
+  perf::ShardedCounter *n_miss;
+  perf::ShardedCounter *n_insert;
+  perf::ShardedCounter *n_insert_negative;
   uint64_t num_collisions;
   uint32_t max_collisions;
-  perf::Counter *n_update;
-  perf::Counter *n_replace;
-  perf::Counter *n_forget;
-  perf::Counter *n_drop;
+  perf::ShardedCounter *n_update;
+  perf::ShardedCounter *n_replace;
+  perf::ShardedCounter *n_forget;
+  perf::ShardedCounter *n_drop;
   perf::Counter *sz_allocated;
 
   Counters(perf::Statistics *statistics, const std::string &name) {
     sz_size = statistics->Register(name + ".sz_size", "Size for " + name);
     num_collisions = 0;
     max_collisions = 0;
-    n_hit = statistics->Register(name + ".n_hit", "Number of hits for " + name);
-    n_miss = statistics->Register(name + ".n_miss",
+    n_hit = statistics->RegisterSharded(name + ".n_hit",
+        "Number of hits for " + name);
+    n_miss = statistics->RegisterSharded(name + ".n_miss",
         "Number of misses for " + name);
-    n_insert = statistics->Register(name + ".n_insert",
+    n_insert = statistics->RegisterSharded(name + ".n_insert",
         "Number of inserts for " + name);
-    n_insert_negative = statistics->Register(name + ".n_insert_negative",
-        "Number of negative inserts for " + name);
-    n_update = statistics->Register(name + ".n_update",
+    n_insert_negative = statistics->RegisterSharded(
+        name + ".n_insert_negative", "Number of negative inserts for " + name);
+    n_update = statistics->RegisterSharded(name + ".n_update",
         "Number of updates for " + name);
-    n_replace = statistics->Register(name + ".n_replace",
+    n_replace = statistics->RegisterSharded(name + ".n_replace",
         "Number of replaces for " + name);
-    n_forget = statistics->Register(name + ".n_forget",
+    n_forget = statistics->RegisterSharded(name + ".n_forget",
         "Number of forgets for " + name);
-    n_drop = statistics->Register(name + ".n_drop",
+    n_drop = statistics->RegisterSharded(name + ".n_drop",
         "Number of drops for " + name);
     sz_allocated = statistics->Register(name + ".sz_allocated",
         "Number of allocated bytes for " + name);
@@ -691,6 +693,7 @@ class LruCache : SingleCopy {
 
   inline bool IsFull() const { return cache_gauge_ >= cache_size_; }
   inline bool IsEmpty() const { return cache_gauge_ == 0; }
+  inline unsigned num_entries() const { return cache_gauge_; }
 
   Counters counters() {
     Lock();
@@ -790,26 +793,39 @@ static inline uint32_t hasher_inode(const fuse_ino_t &inode) {
 // uint32_t hasher_inode(const fuse_ino_t &inode);
 
 
-class InodeCache : public LruCache<fuse_ino_t, catalog::DirectoryEntry>
+/**
+ * The inode cache and the md5 path cache store directory entries as
+ * PackedDirent and the path cache stores paths as PackedPath.  The public
+ * interface still takes and returns DirectoryEntry and PathString objects.
+ */
+class InodeCache : public LruCache<fuse_ino_t, PackedDirent>
 {
  public:
   explicit InodeCache(unsigned int cache_size, perf::Statistics *statistics) :
-    LruCache<fuse_ino_t, catalog::DirectoryEntry>(
+    LruCache<fuse_ino_t, PackedDirent>(
       cache_size, fuse_ino_t(-1), hasher_inode, statistics, "inode_cache")
   {
   }
 
+  static double GetEntrySize() {
+    return LruCache<fuse_ino_t, PackedDirent>::GetEntrySize() +
+           PackedDirent::kTypicalSize;
+  }
+
   bool Insert(const fuse_ino_t &inode, const catalog::DirectoryEntry &dirent) {
     LogCvmfs(kLogLru, kLogDebug, "insert inode --> dirent: %u -> '%s'",
              inode, dirent.name().c_str());
     const bool result =
-      LruCache<fuse_ino_t, catalog::DirectoryEntry>::Insert(inode, dirent);
+      LruCache<fuse_ino_t, PackedDirent>::Insert(inode, PackedDirent(dirent));
     return result;
   }
 
   bool Lookup(const fuse_ino_t &inode, catalog::DirectoryEntry *dirent) {
+    PackedDirent packed;
     const bool result =
-      LruCache<fuse_ino_t, catalog::DirectoryEntry>::Lookup(inode, dirent);
+      LruCache<fuse_ino_t, PackedDirent>::Lookup(inode, &packed);
+    if (result)
+      packed.Unpack(dirent);
     LogCvmfs(kLogLru, kLogDebug, "lookup inode --> dirent: %u (%s)",
              inode, result ? "hit" : "miss");
     return result;
@@ -817,30 +833,38 @@ class InodeCache : public LruCache<fuse_ino_t, catalog::DirectoryEntry>
 
   void Drop() {
     LogCvmfs(kLogLru, kLogDebug, "dropping inode cache");
-    LruCache<fuse_ino_t, catalog::DirectoryEntry>::Drop();
+    LruCache<fuse_ino_t, PackedDirent>::Drop();
   }
 };  // InodeCache
 
 
-class PathCache : public LruCache<fuse_ino_t, PathString> {
+class PathCache : public LruCache<fuse_ino_t, PackedPath> {
  public:
   explicit PathCache(unsigned int cache_size, perf::Statistics *statistics) :
-    LruCache<fuse_ino_t, PathString>(cache_size, fuse_ino_t(-1), hasher_inode,
+    LruCache<fuse_ino_t, PackedPath>(cache_size, fuse_ino_t(-1), hasher_inode,
         statistics, "path_cache")
   {
   }
 
+  static double GetEntrySize() {
+    return LruCache<fuse_ino_t, PackedPath>::GetEntrySize() +
+           PackedPath::kTypicalSize;
+  }
+
   bool Insert(const fuse_ino_t &inode, const PathString &path) {
     LogCvmfs(kLogLru, kLogDebug, "insert inode --> path %u -> '%s'",
              inode, path.c_str());
     const bool result =
-      LruCache<fuse_ino_t, PathString>::Insert(inode, path);
+      LruCache<fuse_ino_t, PackedPath>::Insert(inode, PackedPath(path));
     return result;
   }
 
   bool Lookup(const fuse_ino_t &inode, PathString *path) {
+    PackedPath packed;
     const bool found =
-      LruCache<fuse_ino_t, PathString>::Lookup(inode, path);
+      LruCache<fuse_ino_t, PackedPath>::Lookup(inode, &packed);
+    if (found)
+      packed.Unpack(path);
     LogCvmfs(kLogLru, kLogDebug, "lookup inode --> path: %u (%s)",
              inode, found ? "hit" : "miss");
     return found;
@@ -848,41 +872,52 @@ class PathCache : public LruCache<fuse_ino_t, PathString> {
 
   void Drop() {
     LogCvmfs(kLogLru, kLogDebug, "dropping path cache");
-    LruCache<fuse_ino_t, PathString>::Drop();
+    LruCache<fuse_ino_t, PackedPath>::Drop();
   }
 };  // PathCache
 
 
 class Md5PathCache :
-  public LruCache<shash::Md5, catalog::DirectoryEntry>
+  public LruCache<shash::Md5, PackedDirent>
 {
  public:
   explicit Md5PathCache(unsigned int cache_size, perf::Statistics *statistics) :
-    LruCache<shash::Md5, catalog::DirectoryEntry>(
+    LruCache<shash::Md5, PackedDirent>(
       cache_size, shash::Md5(shash::AsciiPtr("!")), hasher_md5, statistics,
       "md5_path_cache")
   {
-    dirent_negative_ = catalog::DirectoryEntry(catalog::kDirentNegative);
+    dirent_negative_ =
+      PackedDirent(catalog::DirectoryEntry(catalog::kDirentNegative));
+  }
+
+  static double GetEntrySize() {
+    return LruCache<shash::Md5, PackedDirent>::GetEntrySize() +
+           PackedDirent::kTypicalSize;
   }
 
   bool Insert(const shash::Md5 &hash, const catalog::DirectoryEntry &dirent) {
     LogCvmfs(kLogLru, kLogDebug, "insert md5 --> dirent: %s -> '%s'",
              hash.ToString().c_str(), dirent.name().c_str());
     const bool result =
-      LruCache<shash::Md5, catalog::DirectoryEntry>::Insert(hash, dirent);
+      LruCache<shash::Md5, PackedDirent>::Insert(hash, PackedDirent(dirent));
     return result;
   }
 
   bool InsertNegative(const shash::Md5 &hash) {
-    const bool result = Insert(hash, dirent_negative_);
+    // All negative entries share the same buffer
+    const bool result =
+      LruCache<shash::Md5, PackedDirent>::Insert(hash, dirent_negative_);
     if (result)
       perf::Inc(counters_.n_insert_negative);
     return result;
   }
 
   bool Lookup(const shash::Md5 &hash, catalog::DirectoryEntry *dirent) {
+    PackedDirent packed;
     const bool result =
-      LruCache<shash::Md5, catalog::DirectoryEntry>::Lookup(hash, dirent);
+      LruCache<shash::Md5, PackedDirent>::Lookup(hash, &packed);
+    if (result)
+      packed.Unpack(dirent);
     LogCvmfs(kLogLru, kLogDebug, "lookup md5 --> dirent: %s (%s)",
              hash.ToString().c_str(), result ? "hit" : "miss");
     return result;
@@ -891,16 +926,16 @@ class Md5PathCache :
   bool Forget(const shash::Md5 &hash) {
     LogCvmfs(kLogLru, kLogDebug, "forget md5: %s",
              hash.ToString().c_str());
-    return LruCache<shash::Md5, catalog::DirectoryEntry>::Forget(hash);
+    return LruCache<shash::Md5, PackedDirent>::Forget(hash);
   }
 
   void Drop() {
     LogCvmfs(kLogLru, kLogDebug, "dropping md5path cache");
-    LruCache<shash::Md5, catalog::DirectoryEntry>::Drop();
+    LruCache<shash::Md5, PackedDirent>::Drop();
   }
 
  private:
-  catalog::DirectoryEntry dirent_negative_;
+  PackedDirent dirent_negative_;
 };  // Md5PathCache
 
 }  // namespace lru
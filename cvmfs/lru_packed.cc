@@ -0,0 +1,160 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "lru_packed.h"
+
+#include <cassert>
+
+#include "directory_entry.h"
+#include "hash.h"
+
+namespace lru {
+
+namespace {
+
+const unsigned char kFlagNestedRoot = 1;
+const unsigned char kFlagNestedMountpoint = 2;
+const unsigned char kFlagChunked = 4;
+const unsigned char kFlagNegative = 8;
+const unsigned char kFlagXattrs = 16;
+const unsigned char kFlagDigest = 32;
+
+// Number of varint encoded fields, including the string lengths
+const unsigned kNumFields = 12;
+
+unsigned VarintSize(uint64_t value) {
+  unsigned result = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    result++;
+  }
+  return result;
+}
+
+unsigned char *EncodeVarint(uint64_t value, unsigned char *pos) {
+  while (value >= 0x80) {
+    *pos++ = static_cast<unsigned char>(value) | 0x80;
+    value >>= 7;
+  }
+  *pos++ = static_cast<unsigned char>(value);
+  return pos;
+}
+
+const unsigned char *DecodeVarint(const unsigned char *pos, uint64_t *value) {
+  *value = 0;
+  unsigned shift = 0;
+  while (*pos & 0x80) {
+    *value |= uint64_t(*pos++ & 0x7f) << shift;
+    shift += 7;
+  }
+  *value |= uint64_t(*pos++) << shift;
+  return pos;
+}
+
+/**
+ * Timestamps can be negative.  Zig-zag encoding keeps small negative values
+ * small.
+ */
+uint64_t ZigZag(const int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ (value >> 63);
+}
+
+int64_t UnZigZag(const uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+}  // anonymous namespace
+
+
+/**
+ * Layout: flags, hash algorithm, hash suffix, varints for the numeric fields
+ * and for the string lengths, the name, the symlink, and the digest if it is
+ * not null.
+ */
+PackedDirent::PackedDirent(const catalog::DirectoryEntry &dirent) {
+  unsigned char flags = 0;
+  if (dirent.is_nested_catalog_root_) flags |= kFlagNestedRoot;
+  if (dirent.is_nested_catalog_mountpoint_) flags |= kFlagNestedMountpoint;
+  if (dirent.is_chunked_file_) flags |= kFlagChunked;
+  if (dirent.is_negative_) flags |= kFlagNegative;
+  if (dirent.has_xattrs_) flags |= kFlagXattrs;
+  if (!dirent.checksum_.IsNull()) flags |= kFlagDigest;
+
+  const uint64_t fields[kNumFields] = {
+    dirent.inode_,
+    dirent.parent_inode_,
+    dirent.mode_,
+    dirent.uid_,
+    dirent.gid_,
+    dirent.size_,
+    ZigZag(dirent.mtime_),
+    ZigZag(dirent.cached_mtime_),
+    dirent.linkcount_,
+    dirent.hardlink_group_,
+    dirent.name_.GetLength(),
+    dirent.symlink_.GetLength()
+  };
+  const unsigned digest_size = (flags & kFlagDigest) ?
+    shash::kDigestSizes[dirent.checksum_.algorithm] : 0;
+
+  uint32_t size = 3 + dirent.name_.GetLength() + dirent.symlink_.GetLength() +
+                  digest_size;
+  for (unsigned i = 0; i < kNumFields; ++i)
+    size += VarintSize(fields[i]);
+
+  unsigned char *pos = buffer_.Allocate(size);
+  *pos++ = flags;
+  *pos++ = dirent.checksum_.algorithm;
+  *pos++ = dirent.checksum_.suffix;
+  for (unsigned i = 0; i < kNumFields; ++i)
+    pos = EncodeVarint(fields[i], pos);
+  memcpy(pos, dirent.name_.GetChars(), dirent.name_.GetLength());
+  pos += dirent.name_.GetLength();
+  memcpy(pos, dirent.symlink_.GetChars(), dirent.symlink_.GetLength());
+  pos += dirent.symlink_.GetLength();
+  memcpy(pos, dirent.checksum_.digest, digest_size);
+  assert(pos + digest_size == buffer_.data() + size);
+}
+
+
+void PackedDirent::Unpack(catalog::DirectoryEntry *dirent) const {
+  assert(!buffer_.IsEmpty());
+  const unsigned char *pos = buffer_.data();
+  const unsigned char flags = *pos++;
+  const shash::Algorithms algorithm = static_cast<shash::Algorithms>(*pos++);
+  const shash::Suffix suffix = *pos++;
+
+  uint64_t fields[kNumFields];
+  for (unsigned i = 0; i < kNumFields; ++i)
+    pos = DecodeVarint(pos, &fields[i]);
+  dirent->inode_ = fields[0];
+  dirent->parent_inode_ = fields[1];
+  dirent->mode_ = fields[2];
+  dirent->uid_ = fields[3];
+  dirent->gid_ = fields[4];
+  dirent->size_ = fields[5];
+  dirent->mtime_ = UnZigZag(fields[6]);
+  dirent->cached_mtime_ = UnZigZag(fields[7]);
+  dirent->linkcount_ = fields[8];
+  dirent->hardlink_group_ = fields[9];
+  const uint64_t name_length = fields[10];
+  const uint64_t symlink_length = fields[11];
+
+  dirent->name_.Assign(reinterpret_cast<const char *>(pos), name_length);
+  pos += name_length;
+  dirent->symlink_.Assign(reinterpret_cast<const char *>(pos), symlink_length);
+  pos += symlink_length;
+  dirent->checksum_ = shash::Any(algorithm, suffix);
+  if (flags & kFlagDigest)
+    memcpy(dirent->checksum_.digest, pos, shash::kDigestSizes[algorithm]);
+
+  dirent->is_nested_catalog_root_ = (flags & kFlagNestedRoot);
+  dirent->is_nested_catalog_mountpoint_ = (flags & kFlagNestedMountpoint);
+  dirent->is_chunked_file_ = (flags & kFlagChunked);
+  dirent->is_negative_ = (flags & kFlagNegative);
+  dirent->has_xattrs_ = (flags & kFlagXattrs);
+}
+
+}  // namespace lru
@@ -0,0 +1,160 @@
+/**
+ * This file is part of the CernVM File System.
+ *
+ * Compact representations of the values stored in the meta-data caches.  A
+ * DirectoryEntry or a PathString reserves stack space for its strings and for
+ * the largest possible content hash, most of which is unused.  The packed
+ * values only keep a pointer to a heap buffer that contains the variable-length
+ * encoded fields, so that the hash tables of the caches become small and more
+ * entries fit into the memory budget.
+ */
+
+#ifndef CVMFS_LRU_PACKED_H_
+#define CVMFS_LRU_PACKED_H_
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#include <cstdlib>
+#include <cstring>
+
+#include "atomic.h"
+#include "shortstring.h"
+#include "smalloc.h"
+#include "statistics.h"
+
+namespace catalog {
+class DirectoryEntry;
+}
+
+namespace lru {
+
+/**
+ * Immutable, reference counted byte buffer.  Copies share the buffer, which
+ * keeps moving values in and out of the hash tables cheap.  The Type parameter
+ * separates the instance and memory counters of different packed types.
+ */
+template<char Type>
+class PackedBuffer {
+ public:
+  PackedBuffer() : buffer_(NULL) { }
+  PackedBuffer(const PackedBuffer &other) : buffer_(other.buffer_) { Ref(); }
+  PackedBuffer &operator= (const PackedBuffer &other) {
+    if (buffer_ != other.buffer_) {
+      other.Ref();
+      Unref();
+      buffer_ = other.buffer_;
+    }
+    return *this;
+  }
+  ~PackedBuffer() { Unref(); }
+
+  /**
+   * Replaces the buffer by a new one of the given size that is filled by the
+   * caller.
+   */
+  unsigned char *Allocate(const uint32_t size) {
+    Unref();
+    buffer_ = static_cast<Header *>(smalloc(sizeof(Header) + size));
+    atomic_init32(&buffer_->refcount);
+    atomic_inc32(&buffer_->refcount);
+    buffer_->size = size;
+    num_instances_.Inc();
+    sz_bytes_.Add(sizeof(Header) + size);
+    return reinterpret_cast<unsigned char *>(buffer_ + 1);
+  }
+
+  const unsigned char *data() const {
+    return reinterpret_cast<const unsigned char *>(buffer_ + 1);
+  }
+  uint32_t size() const { return buffer_ ? buffer_->size : 0; }
+  bool IsEmpty() const { return buffer_ == NULL; }
+
+  static uint64_t num_instances() { return num_instances_.Get(); }
+  static uint64_t sz_bytes() { return sz_bytes_.Get(); }
+
+ private:
+  struct Header {
+    atomic_int32 refcount;
+    uint32_t size;
+  };
+
+  void Ref() const {
+    if (buffer_)
+      atomic_inc32(&buffer_->refcount);
+  }
+  void Unref() {
+    if (buffer_ && (atomic_xadd32(&buffer_->refcount, -1) == 1)) {
+      num_instances_.Dec();
+      sz_bytes_.Add(-static_cast<int64_t>(sizeof(Header) + buffer_->size));
+      free(buffer_);
+    }
+    buffer_ = NULL;
+  }
+
+  Header *buffer_;
+  static perf::ShardedCounter num_instances_;
+  static perf::ShardedCounter sz_bytes_;
+};  // class PackedBuffer
+
+template<char Type>
+perf::ShardedCounter PackedBuffer<Type>::num_instances_;
+template<char Type>
+perf::ShardedCounter PackedBuffer<Type>::sz_bytes_;
+
+
+/**
+ * Packed value of the inode and md5 path caches.  Numeric fields are stored
+ * as varints, the content hash only with the digest length of its algorithm,
+ * the name and the symlink without padding.
+ */
+class PackedDirent {
+ public:
+  /**
+   * Expected size of the heap buffer, used to size the caches
+   */
+  static const unsigned kTypicalSize = 96;
+
+  PackedDirent() { }
+  explicit PackedDirent(const catalog::DirectoryEntry &dirent);
+  void Unpack(catalog::DirectoryEntry *dirent) const;
+
+  uint32_t size() const { return buffer_.size(); }
+  static uint64_t num_instances() { return Buffer::num_instances(); }
+  static uint64_t sz_bytes() { return Buffer::sz_bytes(); }
+
+ private:
+  typedef PackedBuffer<'d'> Buffer;
+  Buffer buffer_;
+};
+
+
+/**
+ * Packed value of the path cache: the bare characters of the path.
+ */
+class PackedPath {
+ public:
+  static const unsigned kTypicalSize = 96;
+
+  PackedPath() { }
+  explicit PackedPath(const PathString &path) {
+    memcpy(buffer_.Allocate(path.GetLength()), path.GetChars(),
+           path.GetLength());
+  }
+  void Unpack(PathString *path) const {
+    path->Assign(reinterpret_cast<const char *>(buffer_.data()),
+                 buffer_.size());
+  }
+
+  uint32_t size() const { return buffer_.size(); }
+  static uint64_t num_instances() { return Buffer::num_instances(); }
+  static uint64_t sz_bytes() { return Buffer::sz_bytes(); }
+
+ private:
+  typedef PackedBuffer<'p'> Buffer;
+  Buffer buffer_;
+};
+
+}  // namespace lru
+
+#endif  // CVMFS_LRU_PACKED_H_
@@ -84,9 +84,13 @@ Manifest *Manifest::Load(const map<char, string> &content) {
   if ((iter = content.find('G')) != content.end())
     garbage_collectable = (iter->second == "yes");
 
-  return new Manifest(catalog_hash, catalog_size, root_path, ttl, revision,
-                      micro_catalog_hash, repository_name, certificate,
-                      history, publish_timestamp, garbage_collectable);
+  Manifest *manifest =
+    new Manifest(catalog_hash, catalog_size, root_path, ttl, revision,
+                 micro_catalog_hash, repository_name, certificate,
+                 history, publish_timestamp, garbage_collectable);
+  if ((iter = content.find('U')) != content.end())
+    manifest->set_catalog_delta(iter->second);
+  return manifest;
 }
 
 
@@ -126,6 +130,8 @@ string Manifest::ExportString() const {
     manifest += "H" + history_.ToString() + "\n";
   if (publish_timestamp_ > 0)
     manifest += "T" + StringifyInt(publish_timestamp_) + "\n";
+  if (catalog_delta_ != "")
+    manifest += "U" + catalog_delta_ + "\n";
   // Reserved: Z -> for identification of channel tips
 
   return manifest;
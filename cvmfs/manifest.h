@@ -78,6 +78,13 @@ class Manifest {
   }
   void set_catalog_hash(const shash::Any &catalog_hash) {
     catalog_hash_ = catalog_hash;
+    catalog_delta_ = "";
+  }
+  /**
+   * Delta reference of the root catalog, see catalog::CatalogDelta
+   */
+  void set_catalog_delta(const std::string &catalog_delta) {
+    catalog_delta_ = catalog_delta;
   }
   void set_garbage_collectability(const bool garbage_collectable) {
     garbage_collectable_ = garbage_collectable;
@@ -92,6 +99,7 @@ class Manifest {
   shash::Any history() const { return history_; }
   uint64_t publish_timestamp() const { return publish_timestamp_; }
   bool garbage_collectable() const { return garbage_collectable_; }
+  std::string catalog_delta() const { return catalog_delta_; }
 
  private:
   static Manifest *Load(const std::map<char, std::string> &content);
@@ -106,6 +114,7 @@ class Manifest {
   shash::Any history_;
   uint64_t publish_timestamp_;
   bool garbage_collectable_;
+  std::string catalog_delta_;
 };  // class Manifest
 
 }  // namespace manifest
@@ -52,6 +52,9 @@ Failures Fetch(const std::string &base_url, const std::string &repository_name,
   string certificate_url = base_url + "/data";  // rest is in manifest
   download::JobInfo download_certificate(&certificate_url, true, probe_hosts,
                                          &certificate_hash);
+  // Catalog loading waits for the manifest and the certificate
+  download_manifest.priority = download::kPriorityCatalog;
+  download_certificate.priority = download::kPriorityCatalog;
 
   retval_dl = download_manager->Fetch(&download_manifest);
   if (retval_dl != download::kFailOk) {
@@ -299,3 +299,12 @@ void Pathspec::GenerateGlobString() const {
     is_first = false;
   }
 }
+
+
+Pathspec::TokenSequence Pathspec::GenerateTokenSequence() const {
+  TokenSequence result(patterns_.size());
+  for (unsigned i = 0; i < patterns_.size(); ++i) {
+    patterns_[i].GenerateTokens(&result[i]);
+  }
+  return result;
+}
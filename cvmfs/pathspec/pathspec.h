@@ -56,6 +56,7 @@ class Pathspec {
 
  public:
   typedef std::vector<std::string> GlobStringSequence;
+  typedef std::vector<PathspecTokens> TokenSequence;
 
  public:
   /**
@@ -118,6 +119,14 @@ class Pathspec {
    */
   const std::string& GetGlobString() const;
 
+  /**
+   * Generates the compiled path elements of this Pathspec, in the same order
+   * as GetGlobStringSequence().  Used by the PathspecMatcher.
+   *
+   * @return  one list of tokens per path element
+   */
+  TokenSequence GenerateTokenSequence() const;
+
   Pathspec& operator=(const Pathspec &other);
   bool operator== (const Pathspec &other) const;
   bool operator!= (const Pathspec &other) const { return !(*this == other); }
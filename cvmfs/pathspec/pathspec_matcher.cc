@@ -0,0 +1,235 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "pathspec_matcher.h"
+
+#include <cassert>
+
+namespace {
+
+// Trie roots for absolute and relative Pathspecs
+const unsigned kAbsoluteRoot = 0;
+const unsigned kRelativeRoot = 1;
+
+}  // anonymous namespace
+
+
+PathspecMatcher::PathspecMatcher() : nodes_(2) { }
+
+
+void PathspecMatcher::AddStrict(const Pathspec &pathspec) {
+  assert(pathspec.IsValid());
+  const Pathspec::TokenSequence elements = pathspec.GenerateTokenSequence();
+  unsigned node = pathspec.IsAbsolute() ? kAbsoluteRoot : kRelativeRoot;
+  for (unsigned i = 0; i < elements.size(); ++i) {
+    node = AddChild(node, elements[i]);
+  }
+  nodes_[node].is_terminal = true;
+}
+
+
+void PathspecMatcher::AddRelaxed(const Pathspec &pathspec) {
+  assert(pathspec.IsValid());
+  const PathspecToken separator(PathspecToken::kLiteral, Pathspec::kSeparator);
+  const Pathspec::TokenSequence elements = pathspec.GenerateTokenSequence();
+  PathspecTokens tokens;
+  if (pathspec.IsAbsolute()) {
+    tokens.push_back(separator);
+  }
+  for (unsigned i = 0; i < elements.size(); ++i) {
+    if (i > 0) {
+      tokens.push_back(separator);
+    }
+    tokens.insert(tokens.end(), elements[i].begin(), elements[i].end());
+  }
+  relaxed_.push_back(tokens);
+}
+
+
+unsigned PathspecMatcher::AddChild(
+  const unsigned parent,
+  const PathspecTokens &tokens)
+{
+  if (IsPlaintext(tokens)) {
+    std::string name;
+    for (unsigned i = 0; i < tokens.size(); ++i) {
+      name.push_back(tokens[i].chr);
+    }
+    std::map<std::string, unsigned>::const_iterator i =
+      nodes_[parent].plaintext_children.find(name);
+    if (i != nodes_[parent].plaintext_children.end()) {
+      return i->second;
+    }
+    const unsigned child = nodes_.size();
+    nodes_.push_back(Node());
+    nodes_[parent].plaintext_children[name] = child;
+    return child;
+  }
+
+  for (unsigned i = 0; i < nodes_[parent].pattern_children.size(); ++i) {
+    if (nodes_[parent].pattern_children[i].first == tokens) {
+      return nodes_[parent].pattern_children[i].second;
+    }
+  }
+  const unsigned child = nodes_.size();
+  nodes_.push_back(Node());
+  nodes_[parent].pattern_children.push_back(std::make_pair(tokens, child));
+  return child;
+}
+
+
+bool PathspecMatcher::IsPlaintext(const PathspecTokens &tokens) {
+  for (unsigned i = 0; i < tokens.size(); ++i) {
+    if (tokens[i].type != PathspecToken::kLiteral) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/**
+ * Glob matching of [begin, end).  Wildcards match any sequence of characters,
+ * placeholders match a single character except the separator.  On a mismatch,
+ * only the most recent wildcard needs to be extended, which keeps the matching
+ * free of exponential backtracking.
+ */
+bool PathspecMatcher::MatchTokens(
+  const PathspecTokens &tokens,
+  const char *begin,
+  const char *end)
+{
+  const unsigned num_tokens = tokens.size();
+  unsigned t = 0;
+  const char *s = begin;
+  bool has_wildcard = false;
+  unsigned wildcard_t = 0;
+  const char *wildcard_s = NULL;
+
+  while (s < end) {
+    if ((t < num_tokens) && (tokens[t].type == PathspecToken::kWildcard)) {
+      has_wildcard = true;
+      wildcard_t = ++t;
+      wildcard_s = s;
+      continue;
+    }
+    if ((t < num_tokens) &&
+        (((tokens[t].type == PathspecToken::kPlaceholder) &&
+          (*s != Pathspec::kSeparator)) ||
+         ((tokens[t].type == PathspecToken::kLiteral) &&
+          (*s == tokens[t].chr))))
+    {
+      ++t;
+      ++s;
+      continue;
+    }
+    if (!has_wildcard) {
+      return false;
+    }
+    t = wildcard_t;
+    s = ++wildcard_s;
+  }
+
+  while ((t < num_tokens) && (tokens[t].type == PathspecToken::kWildcard)) {
+    ++t;
+  }
+  return t == num_tokens;
+}
+
+
+bool PathspecMatcher::IsMatchingStrict(const std::string &path) const {
+  if (path.empty()) {
+    return false;
+  }
+  if (path[0] == Pathspec::kSeparator) {
+    return IsMatchingTrie(kAbsoluteRoot, path);
+  }
+  return IsMatchingTrie(kRelativeRoot, path);
+}
+
+
+/**
+ * Walks the path components through the trie, keeping the set of nodes that
+ * match the components seen so far.  Like the regular expressions of the
+ * Pathspecs, a single trailing slash is optional.
+ */
+bool PathspecMatcher::IsMatchingTrie(
+  const unsigned root,
+  const std::string &path) const
+{
+  const char *pos = path.data();
+  const char *end = pos + path.length();
+  if (root == kAbsoluteRoot) {
+    ++pos;
+  }
+
+  std::vector<unsigned> active(1, root);
+  std::vector<unsigned> next;
+  std::string component;
+  while (true) {
+    const char *separator = pos;
+    while ((separator < end) && (*separator != Pathspec::kSeparator)) {
+      ++separator;
+    }
+    const bool is_last = (separator == end);
+    if (is_last && (pos == end)) {
+      for (unsigned i = 0; i < active.size(); ++i) {
+        if (nodes_[active[i]].is_terminal) {
+          return true;
+        }
+      }
+    }
+
+    component.assign(pos, separator - pos);
+    next.clear();
+    for (unsigned i = 0; i < active.size(); ++i) {
+      const Node &node = nodes_[active[i]];
+      std::map<std::string, unsigned>::const_iterator child =
+        node.plaintext_children.find(component);
+      if (child != node.plaintext_children.end()) {
+        next.push_back(child->second);
+      }
+      for (unsigned j = 0; j < node.pattern_children.size(); ++j) {
+        if (MatchTokens(node.pattern_children[j].first, pos, separator)) {
+          next.push_back(node.pattern_children[j].second);
+        }
+      }
+    }
+    active.swap(next);
+    if (active.empty()) {
+      return false;
+    }
+
+    if (is_last) {
+      break;
+    }
+    pos = separator + 1;
+  }
+
+  for (unsigned i = 0; i < active.size(); ++i) {
+    if (nodes_[active[i]].is_terminal) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool PathspecMatcher::IsMatchingRelaxed(const std::string &path) const {
+  if (path.empty()) {
+    return false;
+  }
+  const char *begin = path.data();
+  const char *end = begin + path.length();
+  const bool has_trailing_slash = (*(end - 1) == Pathspec::kSeparator);
+  for (unsigned i = 0; i < relaxed_.size(); ++i) {
+    if (MatchTokens(relaxed_[i], begin, end) ||
+        (has_trailing_slash && MatchTokens(relaxed_[i], begin, end - 1)))
+    {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,83 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_PATHSPEC_PATHSPEC_MATCHER_H_
+#define CVMFS_PATHSPEC_PATHSPEC_MATCHER_H_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pathspec.h"
+
+/**
+ * Matches path strings against a whole set of Pathspecs at once, without
+ * regular expressions.  The results are the same as asking every Pathspec
+ * separately.
+ *
+ * Pathspecs added with AddStrict() are matched like Pathspec::IsMatching().
+ * They are compiled into a trie of path elements.  Elements without special
+ * characters are looked up by name, elements with wildcards or placeholders
+ * are states that are tried on every path component.  A path is walked once
+ * through the trie, regardless of the number of Pathspecs.
+ *
+ * Pathspecs added with AddRelaxed() are matched like
+ * Pathspec::IsMatchingRelaxed().  Their wildcards span directory boundaries,
+ * so they cannot be split into path elements.  They are kept as token lists
+ * for the full path and matched by a glob matcher.
+ *
+ * POSIX regular expressions with REG_NEWLINE treat new lines specially.  Paths
+ * that contain a new line are not handled by the matcher (see CanMatch()).
+ */
+class PathspecMatcher {
+ public:
+  PathspecMatcher();
+
+  void AddStrict(const Pathspec &pathspec);
+  void AddRelaxed(const Pathspec &pathspec);
+
+  /**
+   * @return  true if at least one of the strict Pathspecs matches
+   */
+  bool IsMatchingStrict(const std::string &path) const;
+
+  /**
+   * @return  true if at least one of the relaxed Pathspecs matches
+   */
+  bool IsMatchingRelaxed(const std::string &path) const;
+
+  /**
+   * Paths with new line characters need to be matched by the Pathspecs.
+   */
+  static bool CanMatch(const std::string &path) {
+    return path.find('\n') == std::string::npos;
+  }
+
+  unsigned num_states() const { return nodes_.size(); }
+
+ private:
+  /**
+   * A trie node corresponds to a sequence of path elements.  Children are
+   * indexes into nodes_.
+   */
+  struct Node {
+    Node() : is_terminal(false) { }
+    std::map<std::string, unsigned> plaintext_children;
+    std::vector<std::pair<PathspecTokens, unsigned> > pattern_children;
+    bool is_terminal;
+  };
+
+  static bool IsPlaintext(const PathspecTokens &tokens);
+  static bool MatchTokens(const PathspecTokens &tokens,
+                          const char *begin, const char *end);
+
+  unsigned AddChild(const unsigned parent, const PathspecTokens &tokens);
+  bool IsMatchingTrie(const unsigned root, const std::string &path) const;
+
+  std::vector<Node> nodes_;
+  std::vector<PathspecTokens> relaxed_;
+};
+
+#endif  // CVMFS_PATHSPEC_PATHSPEC_MATCHER_H_
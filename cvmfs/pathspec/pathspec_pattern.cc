@@ -145,6 +145,25 @@ std::string PathspecElementPattern::GenerateGlobString() const {
   return result;
 }
 
+void PathspecElementPattern::GenerateTokens(PathspecTokens *tokens) const {
+        SubPatterns::const_iterator i    = subpatterns_.begin();
+  const SubPatterns::const_iterator iend = subpatterns_.end();
+  for (; i != iend; ++i) {
+    if ((*i)->IsWildcard()) {
+      tokens->push_back(PathspecToken(PathspecToken::kWildcard, '*'));
+    } else if ((*i)->IsPlaceholder()) {
+      tokens->push_back(PathspecToken(PathspecToken::kPlaceholder, '?'));
+    } else {
+      const PlaintextSubPattern *plaintext =
+                                  dynamic_cast<const PlaintextSubPattern*>(*i);
+      assert(plaintext != NULL);
+      const std::string &chars = plaintext->chars();
+      for (unsigned j = 0; j < chars.length(); ++j)
+        tokens->push_back(PathspecToken(PathspecToken::kLiteral, chars[j]));
+    }
+  }
+}
+
 bool PathspecElementPattern::operator== (
   const PathspecElementPattern &other) const
 {
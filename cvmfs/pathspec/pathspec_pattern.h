@@ -8,6 +8,30 @@
 #include <string>
 #include <vector>
 
+/**
+ * Compiled form of a path element that is matched without regular expressions
+ * (see PathspecMatcher).  Each token is a literal character, a wildcard, or a
+ * placeholder.
+ */
+struct PathspecToken {
+  enum Type {
+    kLiteral,
+    kWildcard,
+    kPlaceholder,
+  };
+
+  PathspecToken(const Type type, const char chr) : type(type), chr(chr) { }
+  bool operator== (const PathspecToken &other) const {
+    return (type == other.type) && (type != kLiteral || chr == other.chr);
+  }
+
+  Type type;
+  char chr;
+};
+
+typedef std::vector<PathspecToken> PathspecTokens;
+
+
 /**
  * The PathspecElementPattern is used internally by the Pathspec class!
  *
@@ -62,6 +86,7 @@ class PathspecElementPattern {
     void AddChar(const char chr);
     bool IsEmpty() const { return chars_.empty(); }
     bool IsPlaintext() const { return true; }
+    const std::string &chars() const { return chars_; }
 
     std::string GenerateRegularExpression(const bool is_relaxed) const;
     std::string GenerateGlobString()                             const;
@@ -107,6 +132,7 @@ class PathspecElementPattern {
 
   std::string GenerateRegularExpression(const bool is_relaxed = false) const;
   std::string GenerateGlobString()                                     const;
+  void GenerateTokens(PathspecTokens *tokens)                          const;
 
   bool IsValid() const { return valid_; }
 
@@ -16,11 +16,14 @@
 #include <mntent.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stdint.h>
 #include <sys/file.h>
 #include <sys/mount.h>
 #include <sys/prctl.h>
+#include <sys/resource.h>
 #include <sys/select.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include <cassert>
@@ -192,6 +195,22 @@ inline bool platform_allow_ptrace(const pid_t pid) {
 }
 
 
+/**
+ * Lowers the CPU priority and puts the calling thread into the idle I/O
+ * scheduling class.  Threads created afterwards inherit the priorities.
+ */
+inline bool platform_background_priority() {
+  if (setpriority(PRIO_PROCESS, 0, 19) != 0)
+    return false;
+#ifdef SYS_ioprio_set
+  // ioprio_set(IOPRIO_WHO_PROCESS, 0, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0))
+  return syscall(SYS_ioprio_set, 1, 0, 3 << 13) == 0;
+#else
+  return true;
+#endif
+}
+
+
 /**
  * File system functions, ensure 64bit versions.
  */
@@ -276,6 +295,41 @@ inline int platform_readahead(int filedes) {
   return readahead(filedes, 0, static_cast<size_t>(-1));
 }
 
+/**
+ * Reserves disk space for a file that is about to be written, without changing
+ * the file size.  Best effort, not all file systems support it.
+ */
+inline void platform_preallocate(int filedes, const uint64_t size) {
+#ifdef FALLOC_FL_KEEP_SIZE
+  (void)fallocate(filedes, FALLOC_FL_KEEP_SIZE, 0, size);
+#endif
+}
+
+/**
+ * Starts the write-back of the dirty pages in the given range.
+ */
+inline void platform_writeback(int filedes, const uint64_t offset,
+                               const uint64_t size)
+{
+#ifdef SYNC_FILE_RANGE_WRITE
+  (void)sync_file_range(filedes, offset, size, SYNC_FILE_RANGE_WRITE);
+#endif
+}
+
+/**
+ * Starts the write-back of the given range and drops its clean pages from
+ * the page cache.  Does not wait for the disk; pages still under write-back
+ * stay in the page cache.  A size of zero means up to the end of the file.
+ */
+inline void platform_evict_written(int filedes, const uint64_t offset,
+                                   const uint64_t size)
+{
+#ifdef SYNC_FILE_RANGE_WRITE
+  (void)sync_file_range(filedes, offset, size, SYNC_FILE_RANGE_WRITE);
+  (void)posix_fadvise(filedes, offset, size, POSIX_FADV_DONTNEED);
+#endif
+}
+
 
 inline std::string platform_libname(const std::string &base_name) {
   return "lib" + base_name + ".so";
@@ -14,8 +14,10 @@
 #include <mach/mach.h>
 #include <mach-o/dyld.h>
 #include <signal.h>
+#include <stdint.h>
 #include <sys/mount.h>
 #include <sys/param.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/ucred.h>
 #include <sys/xattr.h>
@@ -111,6 +113,17 @@ inline bool platform_allow_ptrace(const pid_t pid) {
 }
 
 
+/**
+ * Lowers the CPU priority and throttles the disk I/O of the process.
+ */
+inline bool platform_background_priority() {
+  if (setpriority(PRIO_PROCESS, 0, 19) != 0)
+    return false;
+  return setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_PROCESS,
+                        IOPOL_THROTTLE) == 0;
+}
+
+
 /**
  * File system functions, Mac OS X has 64bit functions by default.
  */
@@ -193,6 +206,28 @@ inline int platform_readahead(int filedes) {
   return 0;
 }
 
+inline void platform_preallocate(int filedes, const uint64_t size) {
+  fstore_t store;
+  store.fst_flags = F_ALLOCATEALL;
+  store.fst_posmode = F_PEOFPOSMODE;
+  store.fst_offset = 0;
+  store.fst_length = size;
+  store.fst_bytesalloc = 0;
+  (void)fcntl(filedes, F_PREALLOCATE, &store);
+}
+
+inline void platform_writeback(int filedes, const uint64_t offset,
+                               const uint64_t size)
+{
+  // No write-back control on Mac OS X
+}
+
+inline void platform_evict_written(int filedes, const uint64_t offset,
+                                   const uint64_t size)
+{
+  // No write-back control on Mac OS X
+}
+
 /**
  * strdupa does not exist on OSX
  */
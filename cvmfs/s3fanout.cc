@@ -4,6 +4,7 @@
  * Runs a thread using libcurls asynchronous I/O mode to push data to S3
  */
 
+#include <inttypes.h>
 #include <pthread.h>
 
 #include <cerrno>
@@ -27,6 +28,13 @@ static size_t CallbackCurlHeader(void *ptr, size_t size, size_t nmemb,
   const string header_line(static_cast<const char *>(ptr), num_bytes);
   JobInfo *info = static_cast<JobInfo *>(info_link);
 
+  if (HasPrefix(header_line, "ETAG:", true)) {
+    // Required to complete multipart uploads
+    size_t end = header_line.find_first_of("\r\n");
+    info->etag = Trim(header_line.substr(5, end - 5));
+    return num_bytes;
+  }
+
   // Check for http status code errors
   if (HasPrefix(header_line, "HTTP/1.", false)) {
     if (header_line.length() < 10)
@@ -51,8 +59,13 @@ static size_t CallbackCurlHeader(void *ptr, size_t size, size_t nmemb,
           info->error_code = kFailServiceUnavailable;
           break;
         case 501:
+          info->error_code = kFailNotImplemented;
+          break;
         case 400:
           info->error_code = kFailBadRequest;
+          // The error body tells if multi-object deletion is unsupported
+          if (info->request == JobInfo::kReqDeleteObjects)
+            return num_bytes;
           break;
         case 403:
           info->error_code = kFailForbidden;
@@ -92,8 +105,16 @@ static size_t CallbackCurlData(void *ptr, size_t size, size_t nmemb,
     LogCvmfs(kLogS3Fanout, kLogDebug, "mem pushed out %d bytes", send_size);
     return send_size;
   } else if (info->origin == kOriginPath) {
-    size_t read_bytes = fread(ptr, 1, num_bytes, info->origin_file);
-    if (read_bytes != num_bytes) {
+    size_t max_bytes = num_bytes;
+    if (info->parent != NULL) {
+      const uint64_t avail_bytes =
+        info->origin_range.size - info->origin_range.pos;
+      if (avail_bytes < max_bytes)
+        max_bytes = avail_bytes;
+    }
+    size_t read_bytes = fread(ptr, 1, max_bytes, info->origin_file);
+    info->origin_range.pos += read_bytes;
+    if (read_bytes != max_bytes) {
       if (ferror(info->origin_file) != 0) {
         LogCvmfs(kLogS3Fanout, kLogStderr, "local I/O error reading %s",
                  info->origin_path.c_str());
@@ -108,6 +129,58 @@ static size_t CallbackCurlData(void *ptr, size_t size, size_t nmemb,
 }
 
 
+/**
+ * Collects the response body, which is only needed for multipart uploads and
+ * multi-object deletions.
+ */
+static size_t CallbackCurlBody(void *ptr, size_t size, size_t nmemb,
+                               void *info_link) {
+  const size_t num_bytes = size*nmemb;
+  JobInfo *info = static_cast<JobInfo *>(info_link);
+  const size_t kMaxResponseSize = 64 * 1024;
+  if (info->response.size() + num_bytes <= kMaxResponseSize)
+    info->response.append(static_cast<char *>(ptr), num_bytes);
+  return num_bytes;
+}
+
+
+/**
+ * Hashes the part of a file that is sent by a part upload.
+ */
+static bool HashFileRange(const string &path,
+                          const uint64_t offset,
+                          const uint64_t size,
+                          shash::Any *any_digest)
+{
+  FILE *file = fopen(path.c_str(), "r");
+  if (file == NULL)
+    return false;
+  if (fseeko(file, offset, SEEK_SET) != 0) {
+    fclose(file);
+    return false;
+  }
+
+  shash::ContextPtr context(any_digest->algorithm);
+  context.buffer = alloca(context.size);
+  shash::Init(context);
+  unsigned char buffer[4096];
+  uint64_t remaining = size;
+  while (remaining > 0) {
+    const size_t nbytes = (remaining < sizeof(buffer)) ? remaining
+                                                      : sizeof(buffer);
+    if (fread(buffer, 1, nbytes, file) != nbytes) {
+      fclose(file);
+      return false;
+    }
+    shash::Update(buffer, nbytes, context);
+    remaining -= nbytes;
+  }
+  fclose(file);
+  shash::Final(context, any_digest);
+  return true;
+}
+
+
 /**
  * Called when new curl sockets arrive or existing curl sockets depart.
  */
@@ -194,27 +267,12 @@ void *S3FanoutManager::MainUpload(void *data) {
     pthread_mutex_unlock(s3fanout_mgr->jobs_todo_lock_);
 
     if (info != NULL) {
-      CURL *handle = s3fanout_mgr->AcquireCurlHandle();
-      if (handle == NULL) {
-        LogCvmfs(kLogS3Fanout, kLogStderr, "Failed to acquire CURL handle.");
-        assert(handle != NULL);
+      if ((info->request == JobInfo::kReqPut) ||
+          (info->request == JobInfo::kReqPutNoCache))
+      {
+        s3fanout_mgr->SwitchToMultipart(info);
       }
-
-      s3fanout::Failures init_failure = s3fanout_mgr->InitializeRequest(info,
-                                                                        handle);
-      assert(init_failure == s3fanout::kFailOk);
-      s3fanout_mgr->SetUrlOptions(info);
-
-      curl_multi_add_handle(s3fanout_mgr->curl_multi_, handle);
-      int still_running = 0, retval = 0;
-      retval = curl_multi_socket_action(s3fanout_mgr->curl_multi_,
-                                        CURL_SOCKET_TIMEOUT,
-                                        0,
-                                        &still_running);
-
-      LogCvmfs(kLogS3Fanout, kLogDebug,
-               "curl_multi_socket_action: %d - %d",
-               retval, still_running);
+      s3fanout_mgr->StartRequest(info);
     }
 
     // Check events with 1ms timeout
@@ -284,6 +342,9 @@ void *S3FanoutManager::MainUpload(void *data) {
         } else {
           // Return easy handle into pool and write result back
           s3fanout_mgr->ReleaseCurlHandle(info, easy_handle);
+          if (s3fanout_mgr->ContinueMultipart(info))
+            continue;
+          s3fanout_mgr->ReleaseOrigin(info);
           s3fanout_mgr->available_jobs_->Decrement();
 
           pthread_mutex_lock(s3fanout_mgr->jobs_completed_lock_);
@@ -334,6 +395,8 @@ CURL *S3FanoutManager::AcquireCurlHandle() const {
     assert(retval == CURLE_OK);
     retval = curl_easy_setopt(handle, CURLOPT_READFUNCTION, CallbackCurlData);
     assert(retval == CURLE_OK);
+    retval = curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, CallbackCurlBody);
+    assert(retval == CURLE_OK);
   } else {
     handle = *(pool_handles_idle_->begin());
     pool_handles_idle_->erase(pool_handles_idle_->begin());
@@ -404,6 +467,39 @@ string S3FanoutManager::MkAuthoritzation(const string &access_key,
 }
 
 
+/**
+ * The query string that selects the multipart upload operation
+ */
+string S3FanoutManager::MkSubresource(const JobInfo *info) const {
+  switch (info->request) {
+    case JobInfo::kReqInitMultipart:
+      return "?uploads";
+    case JobInfo::kReqPutPart:
+      return "?partNumber=" + StringifyInt(info->part_number) +
+             "&uploadId=" + info->parent->multipart->upload_id;
+    case JobInfo::kReqCompleteMultipart:
+    case JobInfo::kReqAbortMultipart:
+      return "?uploadId=" + info->multipart->upload_id;
+    case JobInfo::kReqDeleteObjects:
+      return "?delete";
+    default:
+      return "";
+  }
+}
+
+
+string S3FanoutManager::MkCompleteMultipartBody(const JobInfo *info) const {
+  const MultipartUpload *multipart = info->multipart;
+  string body = "<CompleteMultipartUpload>\n";
+  for (unsigned i = 0; i < multipart->num_parts; ++i) {
+    body += "  <Part><PartNumber>" + StringifyInt(i + 1) + "</PartNumber>"
+            "<ETag>" + multipart->etags[i] + "</ETag></Part>\n";
+  }
+  body += "</CompleteMultipartUpload>\n";
+  return body;
+}
+
+
 void S3FanoutManager::InitializeDnsSettingsCurl(
   CURL *handle,
   CURLSH *sharehandle,
@@ -510,13 +606,18 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
 
   InitializeDnsSettings(handle, info->hostname);
 
-  // HEAD or PUT
+  info->etag.clear();
+  info->response.clear();
+  const string object_key = info->object_key + MkSubresource(info);
+
+  // HEAD, DELETE, POST, or PUT
   shash::Any content_md5;
   content_md5.algorithm = shash::kMd5;
   string timestamp;
   CURLcode retval;
   if (info->request == JobInfo::kReqHead ||
-      info->request == JobInfo::kReqDelete)
+      info->request == JobInfo::kReqDelete ||
+      info->request == JobInfo::kReqAbortMultipart)
   {
     retval = curl_easy_setopt(handle, CURLOPT_UPLOAD, 0);
     assert(retval == CURLE_OK);
@@ -532,17 +633,71 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
                                            req.c_str(),
                                            "",
                                            info->bucket,
-                                           info->object_key).c_str());
+                                           object_key).c_str());
     info->http_headers =
         curl_slist_append(info->http_headers, "Content-Length: 0");
 
-    if (info->request == JobInfo::kReqDelete) {
+    if (info->request != JobInfo::kReqHead) {
       retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, req.c_str());
       assert(retval == CURLE_OK);
     } else {
       retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, NULL);
       assert(retval == CURLE_OK);
     }
+  } else if (info->request == JobInfo::kReqInitMultipart ||
+             info->request == JobInfo::kReqCompleteMultipart ||
+             info->request == JobInfo::kReqDeleteObjects)
+  {
+    retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, NULL);
+    assert(retval == CURLE_OK);
+    retval = curl_easy_setopt(handle, CURLOPT_UPLOAD, 0);
+    assert(retval == CURLE_OK);
+    retval = curl_easy_setopt(handle, CURLOPT_NOBODY, 0);
+    assert(retval == CURLE_OK);
+    retval = curl_easy_setopt(handle, CURLOPT_POST, 1);
+    assert(retval == CURLE_OK);
+    const bool is_init = (info->request == JobInfo::kReqInitMultipart);
+    string body;
+    string content_md5_base64;
+    if (info->request == JobInfo::kReqCompleteMultipart) {
+      body = MkCompleteMultipartBody(info);
+    } else if (info->request == JobInfo::kReqDeleteObjects) {
+      body = string(reinterpret_cast<const char *>(info->origin_mem.data),
+                    info->origin_mem.size);
+      // Mandatory for multi-object deletions
+      shash::HashMem(info->origin_mem.data, info->origin_mem.size,
+                     &content_md5);
+      content_md5_base64 =
+        Base64(string(reinterpret_cast<char *>(content_md5.digest),
+                      content_md5.GetDigestSize()));
+      info->http_headers =
+          curl_slist_append(info->http_headers,
+                            ("Content-MD5: " + content_md5_base64).c_str());
+    }
+    retval = curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, body.length());
+    assert(retval == CURLE_OK);
+    retval = curl_easy_setopt(handle, CURLOPT_COPYPOSTFIELDS, body.c_str());
+    assert(retval == CURLE_OK);
+
+    // The content type of the object is set when the upload is initiated
+    const string content_type =
+      is_init ? "binary/octet-stream" : "application/xml";
+    timestamp = RfcTimestamp();
+    info->http_headers =
+        curl_slist_append(info->http_headers,
+                          MkAuthoritzation(info->access_key,
+                                           info->secret_key,
+                                           timestamp, content_type,
+                                           "POST", content_md5_base64,
+                                           info->bucket,
+                                           object_key).c_str());
+    info->http_headers =
+        curl_slist_append(info->http_headers,
+                          ("Content-Type: " + content_type).c_str());
+    if (is_init && info->multipart->no_cache) {
+      info->http_headers =
+          curl_slist_append(info->http_headers, "Cache-Control: no-cache");
+    }
   } else {
     retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, NULL);
     assert(retval == CURLE_OK);
@@ -555,20 +710,46 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
       retval = curl_easy_setopt(handle, CURLOPT_INFILESIZE_LARGE,
                                 static_cast<curl_off_t>(info->origin_mem.size));
       assert(retval == CURLE_OK);
-      shash::HashMem(info->origin_mem.data,
-                     info->origin_mem.size,
-                     &content_md5);
+      if (info->content_md5.algorithm == shash::kMd5) {
+        content_md5 = info->content_md5;
+      } else {
+        shash::HashMem(info->origin_mem.data,
+                       info->origin_mem.size,
+                       &content_md5);
+      }
     } else if (info->origin == kOriginPath) {
-      bool hashretval = shash::HashFile(info->origin_path, &content_md5);
-      if (!hashretval)
-        return kFailLocalIO;
-      int64_t file_size = GetFileSize(info->origin_path);
-      if (file_size == -1)
-        return kFailLocalIO;
+      int64_t file_size;
+      if (info->parent != NULL) {
+        if (!HashFileRange(info->origin_path, info->origin_range.offset,
+                           info->origin_range.size, &content_md5))
+        {
+          return kFailLocalIO;
+        }
+        file_size = info->origin_range.size;
+      } else {
+        if (info->content_md5.algorithm == shash::kMd5) {
+          content_md5 = info->content_md5;
+        } else {
+          bool hashretval = shash::HashFile(info->origin_path, &content_md5);
+          if (!hashretval)
+            return kFailLocalIO;
+        }
+        file_size = GetFileSize(info->origin_path);
+        if (file_size == -1)
+          return kFailLocalIO;
+      }
       assert(info->origin_file == NULL);
       info->origin_file = fopen(info->origin_path.c_str(), "r");
       if (info->origin_file == NULL)
         return kFailLocalIO;
+      if (info->parent != NULL) {
+        info->origin_range.pos = 0;
+        if (fseeko(info->origin_file, info->origin_range.offset,
+                   SEEK_SET) != 0)
+        {
+          return kFailLocalIO;
+        }
+      }
       retval = curl_easy_setopt(handle, CURLOPT_INFILESIZE_LARGE,
                                 static_cast<curl_off_t>(file_size));
       assert(retval == CURLE_OK);
@@ -591,7 +772,7 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
                                            timestamp, "binary/octet-stream",
                                            "PUT", content_md5_base64,
                                            info->bucket,
-                                           (info->object_key)).c_str());
+                                           object_key).c_str());
 
     info->http_headers =
         curl_slist_append(info->http_headers,
@@ -626,6 +807,9 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
   retval = curl_easy_setopt(handle, CURLOPT_WRITEHEADER,
                             static_cast<void *>(info));
   assert(retval == CURLE_OK);
+  retval = curl_easy_setopt(handle, CURLOPT_WRITEDATA,
+                            static_cast<void *>(info));
+  assert(retval == CURLE_OK);
   retval = curl_easy_setopt(handle, CURLOPT_READDATA,
                             static_cast<void *>(info));
   assert(retval == CURLE_OK);
@@ -655,7 +839,8 @@ void S3FanoutManager::SetUrlOptions(JobInfo *info) const {
   assert(retval == CURLE_OK);
   pthread_mutex_unlock(lock_options_);
 
-  string url = MkUrl(info->hostname, info->bucket, (info->object_key));
+  string url = MkUrl(info->hostname, info->bucket,
+                     info->object_key + MkSubresource(info));
   retval = curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
   assert(retval == CURLE_OK);
 }
@@ -730,6 +915,17 @@ bool S3FanoutManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
   // Verification and error classification
   switch (curl_error) {
     case CURLE_OK:
+      if ((info->request == JobInfo::kReqDeleteObjects) &&
+          (info->error_code == kFailBadRequest))
+      {
+        // Rejected request whose error body has been collected
+        if (info->response.find("<Code>NotImplemented</Code>") !=
+            string::npos)
+        {
+          info->error_code = kFailNotImplemented;
+        }
+        break;
+      }
       info->error_code = kFailOk;
       break;
     case CURLE_UNSUPPORTED_PROTOCOL:
@@ -757,23 +953,32 @@ bool S3FanoutManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
       break;
   }
 
+  // Errors of a multipart completion can be reported in the body of a
+  // successful response; internal errors and throttling are transient
+  if ((info->error_code == kFailOk) &&
+      (info->request == JobInfo::kReqCompleteMultipart) &&
+      (info->response.find("<Error>") != string::npos))
+  {
+    const bool is_transient =
+      (info->response.find("<Code>InternalError</Code>") != string::npos) ||
+      (info->response.find("<Code>SlowDown</Code>") != string::npos);
+    info->error_code = is_transient ? kFailServiceUnavailable : kFailOther;
+  }
+
   // Transform HEAD to PUT request
   if ((info->error_code == kFailNotFound) &&
       (info->request == JobInfo::kReqHead)) {
     LogCvmfs(kLogS3Fanout, kLogDebug, "not found: %s, uploading",
              info->object_key.c_str());
     info->request = JobInfo::kReqPut;
+    SwitchToMultipart(info);
     curl_slist_free_all(info->http_headers);
     info->http_headers = NULL;
     s3fanout::Failures init_failure = InitializeRequest(info,
                                                         info->curl_handle);
     assert(init_failure == s3fanout::kFailOk);
     SetUrlOptions(info);
-    // Reset origin
-    if (info->origin == kOriginMem)
-      info->origin_mem.pos = 0;
-    if (info->origin == kOriginPath)
-      rewind(info->origin_file);
+    ResetOrigin(info);
     return true;  // Again, Put
   }
 
@@ -784,22 +989,46 @@ bool S3FanoutManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
   }
   if (try_again) {
     if (info->request == JobInfo::kReqPut ||
-        info->request == JobInfo::kReqPutNoCache) {
+        info->request == JobInfo::kReqPutNoCache ||
+        info->request == JobInfo::kReqPutPart) {
       LogCvmfs(kLogS3Fanout, kLogDebug, "Trying again to upload %s",
                info->object_key.c_str());
-      // Reset origin
-      if (info->origin == kOriginMem)
-        info->origin_mem.pos = 0;
-      if (info->origin == kOriginPath) {
-        assert(info->origin_file != NULL);
-        rewind(info->origin_file);
-      }
+      ResetOrigin(info);
     }
+    // The response of the failed attempt must not leak into the next one
+    info->response.clear();
+    info->etag.clear();
     Backoff(info);
     return true;  // try again
   }
 
-  // Cleanup opened resources
+  return false;  // stop transfer
+}
+
+
+/**
+ * Rewinds the data source of a PUT request in order to send it again.
+ */
+void S3FanoutManager::ResetOrigin(JobInfo *info) {
+  if (info->origin == kOriginMem)
+    info->origin_mem.pos = 0;
+  if ((info->origin == kOriginPath) && (info->origin_file != NULL)) {
+    if (info->parent != NULL) {
+      info->origin_range.pos = 0;
+      int retval = fseeko(info->origin_file, info->origin_range.offset,
+                          SEEK_SET);
+      assert(retval == 0);
+    } else {
+      rewind(info->origin_file);
+    }
+  }
+}
+
+
+/**
+ * Cleanup opened resources once a job is finished.
+ */
+void S3FanoutManager::ReleaseOrigin(JobInfo *info) {
   if (info->origin == kOriginPath) {
     assert(info->mmf == NULL);
     if (info->origin_file != NULL) {
@@ -815,8 +1044,221 @@ bool S3FanoutManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
       info->mmf = NULL;
     }
   }
+}
 
-  return false;  // stop transfer
+
+/**
+ * Objects larger than the part size of the job are uploaded in parts.  Turns
+ * the PUT request into the initiation of a multipart upload.
+ *
+ * @return true if the job is going to be uploaded in parts
+ */
+bool S3FanoutManager::SwitchToMultipart(JobInfo *info) const {
+  if ((info->part_size == 0) || (info->parent != NULL))
+    return false;
+
+  int64_t object_size;
+  if (info->origin == kOriginMem) {
+    object_size = info->origin_mem.size;
+  } else {
+    // Failures are reported by the ordinary PUT request
+    object_size = GetFileSize(info->origin_path);
+  }
+  if ((object_size < 0) || (static_cast<uint64_t>(object_size) <=
+                            info->part_size))
+  {
+    return false;
+  }
+
+  LogCvmfs(kLogS3Fanout, kLogDebug, "multipart upload of %s (%" PRId64
+           " bytes)", info->object_key.c_str(), object_size);
+  delete info->multipart;
+  info->multipart = new MultipartUpload(
+    object_size, info->part_size, info->request == JobInfo::kReqPutNoCache);
+  info->request = JobInfo::kReqInitMultipart;
+  return true;
+}
+
+
+/**
+ * Creates the job for uploading a single part of a multipart upload.  The part
+ * reads its data directly from the memory or the file of the entire object.
+ */
+JobInfo *S3FanoutManager::CreatePartJob(JobInfo *info,
+                                        const unsigned part_index) const
+{
+  const MultipartUpload *multipart = info->multipart;
+  const uint64_t offset = part_index * multipart->part_size;
+  uint64_t size = multipart->object_size - offset;
+  if (size > multipart->part_size)
+    size = multipart->part_size;
+
+  JobInfo *part;
+  if (info->origin == kOriginMem) {
+    part = new JobInfo(info->access_key, info->secret_key, info->hostname,
+                       info->bucket, info->object_key, NULL, NULL,
+                       info->origin_mem.data + offset, size);
+  } else {
+    part = new JobInfo(info->access_key, info->secret_key, info->hostname,
+                       info->bucket, info->object_key, NULL,
+                       info->origin_path);
+    part->origin_range.offset = offset;
+    part->origin_range.size = size;
+  }
+  part->request = JobInfo::kReqPutPart;
+  part->parent = info;
+  part->part_number = part_index + 1;
+  return part;
+}
+
+
+/**
+ * Queues the upload for part slots as long as it has parts left to start.
+ * Once all parts are done, the multipart upload is completed or, if a part
+ * failed, aborted.
+ */
+void S3FanoutManager::ScheduleParts(JobInfo *info) {
+  MultipartUpload *multipart = info->multipart;
+  if ((multipart->error_code == kFailOk) &&
+      (multipart->next_part < multipart->num_parts))
+  {
+    if (!multipart->waiting) {
+      multipart->waiting = true;
+      jobs_waiting_parts_.push_back(info);
+    }
+    StartWaitingParts();
+    return;
+  }
+  if (multipart->waiting) {
+    multipart->waiting = false;
+    jobs_waiting_parts_.remove(info);
+  }
+  if (multipart->parts_in_flight > 0)
+    return;
+
+  info->request = (multipart->error_code == kFailOk)
+                  ? JobInfo::kReqCompleteMultipart
+                  : JobInfo::kReqAbortMultipart;
+  StartRequest(info);
+}
+
+
+/**
+ * Starts parts of the waiting multipart uploads, in order of arrival, until
+ * pool_max_handles_ parts are in flight.
+ */
+void S3FanoutManager::StartWaitingParts() {
+  while (!jobs_waiting_parts_.empty() &&
+         (num_parts_in_flight_ < pool_max_handles_))
+  {
+    JobInfo *info = jobs_waiting_parts_.front();
+    MultipartUpload *multipart = info->multipart;
+    StartRequest(CreatePartJob(info, multipart->next_part));
+    multipart->next_part++;
+    multipart->parts_in_flight++;
+    num_parts_in_flight_++;
+    if (multipart->next_part == multipart->num_parts) {
+      multipart->waiting = false;
+      jobs_waiting_parts_.pop_front();
+    }
+  }
+}
+
+
+/**
+ * Drives the multipart upload state machine after a request is finished.
+ *
+ * @return true if more requests of the multipart upload are pending, false if
+ *         the job is finished
+ */
+bool S3FanoutManager::ContinueMultipart(JobInfo *info) {
+  if (info->parent != NULL) {
+    JobInfo *parent = info->parent;
+    MultipartUpload *multipart = parent->multipart;
+    multipart->parts_in_flight--;
+    num_parts_in_flight_--;
+    if ((info->error_code == kFailOk) && !info->etag.empty()) {
+      multipart->etags[info->part_number - 1] = info->etag;
+    } else if (multipart->error_code == kFailOk) {
+      LogCvmfs(kLogS3Fanout, kLogStderr, "failed to upload part %u of %s",
+               info->part_number, info->object_key.c_str());
+      multipart->error_code = (info->error_code == kFailOk)
+                              ? kFailOther : info->error_code;
+    }
+    ReleaseOrigin(info);
+    delete info;
+    ScheduleParts(parent);
+    // The part's slot may go to another upload
+    StartWaitingParts();
+    return true;
+  }
+
+  MultipartUpload *multipart = info->multipart;
+  if (multipart == NULL)
+    return false;
+
+  switch (info->request) {
+    case JobInfo::kReqInitMultipart: {
+      if (info->error_code != kFailOk)
+        return false;
+      const string kTagBegin = "<UploadId>";
+      const string kTagEnd = "</UploadId>";
+      const size_t begin = info->response.find(kTagBegin);
+      const size_t end = info->response.find(kTagEnd);
+      if ((begin == string::npos) || (end == string::npos) || (end < begin)) {
+        LogCvmfs(kLogS3Fanout, kLogStderr, "invalid response to multipart "
+                 "upload initiation of %s", info->object_key.c_str());
+        info->error_code = kFailOther;
+        return false;
+      }
+      multipart->upload_id =
+        info->response.substr(begin + kTagBegin.length(),
+                              end - begin - kTagBegin.length());
+      ScheduleParts(info);
+      return true;
+    }
+    case JobInfo::kReqCompleteMultipart:
+      if (info->error_code == kFailOk)
+        return false;
+      multipart->error_code = info->error_code;
+      info->request = JobInfo::kReqAbortMultipart;
+      StartRequest(info);
+      return true;
+    case JobInfo::kReqAbortMultipart:
+      // Report the original failure
+      info->error_code = multipart->error_code;
+      return false;
+    default:
+      return false;
+  }
+}
+
+
+/**
+ * Acquires a curl handle for the request of the job and hands it to the
+ * curl multi handle.
+ */
+void S3FanoutManager::StartRequest(JobInfo *info) {
+  CURL *handle = AcquireCurlHandle();
+  if (handle == NULL) {
+    LogCvmfs(kLogS3Fanout, kLogStderr, "Failed to acquire CURL handle.");
+    assert(handle != NULL);
+  }
+
+  s3fanout::Failures init_failure = InitializeRequest(info, handle);
+  assert(init_failure == s3fanout::kFailOk);
+  SetUrlOptions(info);
+
+  curl_multi_add_handle(curl_multi_, handle);
+  int still_running = 0, retval = 0;
+  retval = curl_multi_socket_action(curl_multi_,
+                                    CURL_SOCKET_TIMEOUT,
+                                    0,
+                                    &still_running);
+
+  LogCvmfs(kLogS3Fanout, kLogDebug,
+           "curl_multi_socket_action: %d - %d",
+           retval, still_running);
 }
 
 S3FanoutManager::S3FanoutManager() {
@@ -858,6 +1300,7 @@ S3FanoutManager::S3FanoutManager() {
   opt_ipv4_only_ = false;
 
   max_available_jobs_ = 0;
+  num_parts_in_flight_ = 0;
   thread_upload_ = 0;
   thread_upload_run_ = false;
   resolver_ = NULL;
@@ -891,6 +1334,7 @@ void S3FanoutManager::Init(const unsigned int max_pool_handles) {
   max_available_jobs_ = 4*pool_max_handles_;
   available_jobs_ = new Semaphore(max_available_jobs_);
   assert(NULL != available_jobs_);
+  num_parts_in_flight_ = 0;
 
   opt_timeout_ = 20;
   statistics_ = new Statistics();
@@ -9,6 +9,7 @@
 #include <semaphore.h>
 
 #include <climits>
+#include <list>
 #include <map>
 #include <set>
 #include <string>
@@ -17,6 +18,7 @@
 
 #include "dns.h"
 #include "duplex_curl.h"
+#include "hash.h"
 #include "prng.h"
 #include "util.h"
 #include "util_concurrency.h"
@@ -44,6 +46,7 @@ enum Failures {
   kFailNotFound,
   kFailServiceUnavailable,
   kFailOther,
+  kFailNotImplemented,
 
   kFailNumEntries
 };  // Failures
@@ -60,7 +63,8 @@ inline const char *Code2Ascii(const Failures error) {
   texts[6] = "S3: not found";
   texts[7] = "S3: service not available";
   texts[8] = "S3: unknown network error";
-  texts[9] = "no text";
+  texts[9] = "S3: not implemented";
+  texts[10] = "no text";
   return texts[error];
 }
 
@@ -83,6 +87,37 @@ struct Statistics {
 };  // Statistics
 
 
+/**
+ * State of an object that is uploaded in several parts.  The parts are
+ * uploaded in parallel once S3 assigned an upload id.  Parts are numbered from
+ * 1 and the ETag of every part is required to complete the upload.
+ */
+struct MultipartUpload {
+  MultipartUpload(const uint64_t object_size, const uint64_t part_size,
+                  const bool no_cache)
+    : object_size(object_size)
+    , part_size(part_size)
+    , num_parts((object_size + part_size - 1) / part_size)
+    , next_part(0)
+    , parts_in_flight(0)
+    , waiting(false)
+    , etags(num_parts)
+    , no_cache(no_cache)
+    , error_code(kFailOk) { }
+
+  const uint64_t object_size;
+  const uint64_t part_size;
+  const unsigned num_parts;
+  unsigned next_part;  ///< index of the next part to upload
+  unsigned parts_in_flight;
+  bool waiting;  ///< queued for a free part slot of the fanout manager
+  std::string upload_id;
+  std::vector<std::string> etags;
+  const bool no_cache;
+  Failures error_code;  ///< first failed part, if any
+};
+
+
 /**
  * Contains all the information to specify an upload job.
  */
@@ -92,6 +127,13 @@ struct JobInfo {
     kReqPut,
     kReqPutNoCache,
     kReqDelete,
+    // Internal requests of multipart uploads
+    kReqInitMultipart,
+    kReqPutPart,
+    kReqCompleteMultipart,
+    kReqAbortMultipart,
+    // Removes the objects listed in the body (origin_mem), see RemoveBatch()
+    kReqDeleteObjects
   };
 
   Origin origin;
@@ -110,6 +152,17 @@ struct JobInfo {
   bool test_and_set;
   void *callback;  // Callback to be called when job is finished
   MemoryMappedFile *mmf;
+  /**
+   * Precomputed MD5 of the upload, if the algorithm is kMd5.  Otherwise the
+   * content is hashed before the request is sent.
+   */
+  shash::Any content_md5;
+  bool owns_origin_mem;  // origin_mem.data is malloc'd and belongs to the job
+  /**
+   * Uploads larger than part_size are split into parts that are uploaded in
+   * parallel.  0 uploads the object with a single PUT request.
+   */
+  uint64_t part_size;
 
   // One constructor per destination + head request
   JobInfo() { JobInfoInit(); }
@@ -148,19 +201,38 @@ struct JobInfo {
     origin_mem.data = NULL;
     callback = NULL;
     mmf = NULL;
+    content_md5 = shash::Any();
+    owns_origin_mem = false;
+    part_size = 0;
     origin_file = NULL;
+    origin_range.offset = 0;
+    origin_range.size = 0;
+    origin_range.pos = 0;
+    multipart = NULL;
+    parent = NULL;
+    part_number = 0;
     request = kReqPut;
     error_code = kFailOk;
     num_retries = 0;
     backoff_ms = 0;
     origin = kOriginPath;
   }
-  ~JobInfo() {}
+  ~JobInfo() { delete multipart; }
 
   // Internal state, don't touch
   CURL *curl_handle;
   struct curl_slist *http_headers;
   FILE *origin_file;
+  struct {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t pos;
+  } origin_range;  ///< part of the origin file sent by a part upload
+  MultipartUpload *multipart;  ///< the job uploads its object in parts
+  JobInfo *parent;  ///< set for the part uploads of a multipart upload
+  unsigned part_number;
+  std::string etag;
+  std::string response;
   RequestType request;
   Failures error_code;
   unsigned char num_retries;
@@ -220,6 +292,14 @@ class S3FanoutManager : SingleCopy {
                                  curl_slist *clist) const;
   Failures InitializeRequest(JobInfo *info, CURL *handle) const;
   void SetUrlOptions(JobInfo *info) const;
+  void StartRequest(JobInfo *info);
+  bool SwitchToMultipart(JobInfo *info) const;
+  JobInfo *CreatePartJob(JobInfo *info, const unsigned part_index) const;
+  void ScheduleParts(JobInfo *info);
+  void StartWaitingParts();
+  bool ContinueMultipart(JobInfo *info);
+  void ResetOrigin(JobInfo *info);
+  void ReleaseOrigin(JobInfo *info);
   void UpdateStatistics(CURL *handle);
   bool CanRetry(const JobInfo *info);
   void Backoff(JobInfo *info);
@@ -232,6 +312,8 @@ class S3FanoutManager : SingleCopy {
                                const std::string &content_md5_base64,
                                const std::string &bucket,
                                const std::string &object_key) const;
+  std::string MkSubresource(const JobInfo *info) const;
+  std::string MkCompleteMultipartBody(const JobInfo *info) const;
   std::string MkUrl(const std::string &host,
                     const std::string &bucket,
                     const std::string &objkey2) const {
@@ -267,6 +349,12 @@ class S3FanoutManager : SingleCopy {
 
   unsigned int max_available_jobs_;
   Semaphore *available_jobs_;
+  /**
+   * Parts of all multipart uploads share pool_max_handles_ slots.  Uploads
+   * with parts left to start wait in line for a free slot.
+   */
+  unsigned num_parts_in_flight_;
+  std::list<JobInfo *> jobs_waiting_parts_;
 
   // Writes and reads should be atomic because reading happens in a different
   // thread than writing.
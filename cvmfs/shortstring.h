@@ -13,7 +13,7 @@
 #include <cstring>
 #include <string>
 
-#include "atomic.h"
+#include "statistics.h"
 
 #ifdef CVMFS_NAMESPACE_GUARD
 namespace CVMFS_NAMESPACE_GUARD {
@@ -27,18 +27,18 @@ template<unsigned char StackSize, char Type>
 class ShortString {
  public:
   ShortString() : long_string_(NULL), length_(0) {
-    atomic_inc64(&num_instances_);
+    num_instances_.Inc();
   }
   ShortString(const ShortString &other) : long_string_(NULL) {
-    atomic_inc64(&num_instances_);
+    num_instances_.Inc();
     Assign(other);
   }
   ShortString(const char *chars, const unsigned length) : long_string_(NULL) {
-    atomic_inc64(&num_instances_);
+    num_instances_.Inc();
     Assign(chars, length);
   }
   explicit ShortString(const std::string &std_string) : long_string_(NULL) {
-    atomic_inc64(&num_instances_);
+    num_instances_.Inc();
     Assign(std_string.data(), std_string.length());
   }
 
@@ -54,7 +54,7 @@ class ShortString {
     delete long_string_;
     long_string_ = NULL;
     if (length > StackSize) {
-      atomic_inc64(&num_overflows_);
+      num_overflows_.Inc();
       long_string_ = new std::string(chars, length);
     } else {
       if (length)
@@ -75,7 +75,7 @@ class ShortString {
 
     const unsigned new_length = this->length_ + length;
     if (new_length > StackSize) {
-      atomic_inc64(&num_overflows_);
+      num_overflows_.Inc();
       long_string_ = new std::string();
       long_string_->reserve(new_length);
       long_string_->assign(stack_, length_);
@@ -175,15 +175,16 @@ class ShortString {
     return ShortString(this->GetChars() + start_at, length-start_at);
   }
 
-  static uint64_t num_instances() { return atomic_read64(&num_instances_); }
-  static uint64_t num_overflows() { return atomic_read64(&num_overflows_); }
+  static uint64_t num_instances() { return num_instances_.Get(); }
+  static uint64_t num_overflows() { return num_overflows_.Get(); }
 
  private:
   std::string *long_string_;
   char stack_[StackSize+1];  // +1 to add a final '\0' if necessary
   unsigned char length_;
-  static atomic_int64 num_overflows_;
-  static atomic_int64 num_instances_;
+  // Updated by every construction, zero-initialized before any code runs
+  static perf::ShardedCounter num_overflows_;
+  static perf::ShardedCounter num_instances_;
 };  // class ShortString
 
 typedef ShortString<kDefaultMaxPath, 0> PathString;
@@ -191,9 +192,9 @@ typedef ShortString<kDefaultMaxName, 1> NameString;
 typedef ShortString<kDefaultMaxLink, 2> LinkString;
 
 template<unsigned char StackSize, char Type>
-atomic_int64 ShortString<StackSize, Type>::num_overflows_ = 0;
+perf::ShardedCounter ShortString<StackSize, Type>::num_overflows_;
 template<unsigned char StackSize, char Type>
-atomic_int64 ShortString<StackSize, Type>::num_instances_ = 0;
+perf::ShardedCounter ShortString<StackSize, Type>::num_instances_;
 
 #ifdef CVMFS_NAMESPACE_GUARD
 }  // namespace CVMFS_NAMESPACE_GUARD
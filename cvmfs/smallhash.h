@@ -97,12 +97,16 @@ class SmallHashBase {
     const bool found = DoLookup(key, &bucket, &collisions);
     if (found) {
       keys_[bucket] = empty_key_;
+      values_[bucket] = Value();
       size_--;
       bucket = (bucket+1) % capacity_;
       while (!(keys_[bucket] == empty_key_)) {
         Key rehash = keys_[bucket];
         keys_[bucket] = empty_key_;
         DoInsert(rehash, values_[bucket], false);
+        // Release resources held by values in vacated buckets
+        if (keys_[bucket] == empty_key_)
+          values_[bucket] = Value();
         bucket = (bucket+1) % capacity_;
       }
       static_cast<Derived *>(this)->Shrink();  // No-op if fixed-size
@@ -201,8 +205,10 @@ class SmallHashBase {
   void DoClear(const bool reset_capacity) {
     if (reset_capacity)
       static_cast<Derived *>(this)->ResetCapacity();  // No-op if fixed-size
-    for (uint32_t i = 0; i < capacity_; ++i)
+    for (uint32_t i = 0; i < capacity_; ++i) {
       keys_[i] = empty_key_;
+      values_[i] = Value();
+    }
     size_ = 0;
   }
 
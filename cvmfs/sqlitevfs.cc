@@ -16,6 +16,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
+#include <sys/mman.h>
 #include <sys/select.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -49,6 +50,7 @@ const char *kVfsName = "cvmfs-readonly";
 struct VfsRdOnly {
   VfsRdOnly()
     : cache_mgr(NULL)
+    , mmap_budget(0)
     , n_access(NULL)
     , no_open(NULL)
     , n_rand(NULL)
@@ -58,8 +60,11 @@ struct VfsRdOnly {
     , n_sleep(NULL)
     , sz_sleep(NULL)
     , n_time(NULL)
+    , n_fetch(NULL)
+    , sz_mmap(NULL)
   { }
   cache::CacheManager *cache_mgr;
+  uint64_t mmap_budget;
   perf::Counter *n_access;
   perf::Counter *no_open;
   perf::Counter *n_rand;
@@ -69,6 +74,8 @@ struct VfsRdOnly {
   perf::Counter *n_sleep;
   perf::Counter *sz_sleep;
   perf::Counter *n_time;
+  perf::Counter *n_fetch;
+  perf::Counter *sz_mmap;
 };
 
 /**
@@ -79,13 +86,61 @@ struct VfsRdOnlyFile {
   VfsRdOnly *vfs_rdonly;
   int fd;
   uint64_t size;
+  /**
+   * NULL if the file is not memory mapped.  Otherwise the entire file is mapped
+   * read-only until it is closed.
+   */
+  unsigned char *mapping;
 };
 
 }  // anonymous namespace
 
 
+/**
+ * Maps the entire file into memory if memory mapped I/O is enabled and the
+ * budget is not yet exhausted.  That only works for cache managers that hand
+ * out system file descriptors.  On failure, reads are served by pread().
+ */
+static void VfsRdOnlyMap(VfsRdOnlyFile *p) {
+  p->mapping = NULL;
+  VfsRdOnly *vfs_rdonly = p->vfs_rdonly;
+  if ((vfs_rdonly->mmap_budget == 0) || (p->size == 0))
+    return;
+  if (vfs_rdonly->cache_mgr->id() != cache::kPosixCacheManager)
+    return;
+
+  const int64_t size = static_cast<int64_t>(p->size);
+  const int64_t mapped = perf::Xadd(vfs_rdonly->sz_mmap, size);
+  if (static_cast<uint64_t>(mapped + size) > vfs_rdonly->mmap_budget) {
+    perf::Xadd(vfs_rdonly->sz_mmap, -size);
+    LogCvmfs(kLogSql, kLogDebug, "mmap budget exhausted, not mapping fd %d",
+             p->fd);
+    return;
+  }
+
+  void *mapping = mmap(NULL, p->size, PROT_READ, MAP_SHARED, p->fd, 0);
+  if (mapping == MAP_FAILED) {
+    perf::Xadd(vfs_rdonly->sz_mmap, -size);
+    LogCvmfs(kLogSql, kLogDebug, "failed to mmap fd %d (%d)", p->fd, errno);
+    return;
+  }
+  p->mapping = reinterpret_cast<unsigned char *>(mapping);
+}
+
+
+static void VfsRdOnlyUnmap(VfsRdOnlyFile *p) {
+  if (p->mapping == NULL)
+    return;
+  int retval = munmap(p->mapping, p->size);
+  assert(retval == 0);
+  perf::Xadd(p->vfs_rdonly->sz_mmap, -static_cast<int64_t>(p->size));
+  p->mapping = NULL;
+}
+
+
 static int VfsRdOnlyClose(sqlite3_file *pFile) {
   VfsRdOnlyFile *p = reinterpret_cast<VfsRdOnlyFile *>(pFile);
+  VfsRdOnlyUnmap(p);
   int retval = p->vfs_rdonly->cache_mgr->Close(p->fd);
   if (retval == 0) {
     perf::Dec(p->vfs_rdonly->no_open);
@@ -209,6 +264,42 @@ static int VfsRdOnlyDeviceCharacteristics(
 }
 
 
+/**
+ * Serves pages directly from the memory mapped file, which avoids a copy into
+ * SQlite's page cache.  SQlite falls back to xRead if *pp is NULL.
+ */
+static int VfsRdOnlyFetch(
+  sqlite3_file *pFile,
+  sqlite3_int64 iOfst,
+  int iAmt,
+  void **pp)
+{
+  VfsRdOnlyFile *p = reinterpret_cast<VfsRdOnlyFile *>(pFile);
+  if ((p->mapping != NULL) &&
+      (static_cast<uint64_t>(iOfst + iAmt) <= p->size))
+  {
+    *pp = p->mapping + iOfst;
+    perf::Inc(p->vfs_rdonly->n_fetch);
+  } else {
+    *pp = NULL;
+  }
+  return SQLITE_OK;
+}
+
+
+/**
+ * The mapping is immutable and stays in place until the file is closed, so
+ * there is nothing to release here.
+ */
+static int VfsRdOnlyUnfetch(
+  sqlite3_file *pFile __attribute__((unused)),
+  sqlite3_int64 iOfst __attribute__((unused)),
+  void *pPage __attribute__((unused)))
+{
+  return SQLITE_OK;
+}
+
+
 /**
  * Supports only read-only opens.  The "file name" has to be in the form of
  * '@<file descriptor>', where file descriptor is usable by the cache manager.
@@ -221,7 +312,7 @@ static int VfsRdOnlyOpen(
   int *pOutFlags)
 {
   static const sqlite3_io_methods io_methods = {
-    1,  // iVersion
+    3,  // iVersion
     VfsRdOnlyClose,
     VfsRdOnlyRead,
     VfsRdOnlyWrite,
@@ -233,7 +324,13 @@ static int VfsRdOnlyOpen(
     VfsRdOnlyCheckReservedLock,
     VfsRdOnlyFileControl,
     VfsRdOnlySectorSize,
-    VfsRdOnlyDeviceCharacteristics
+    VfsRdOnlyDeviceCharacteristics,
+    NULL,  // xShmMap
+    NULL,  // xShmLock
+    NULL,  // xShmBarrier
+    NULL,  // xShmUnmap
+    VfsRdOnlyFetch,
+    VfsRdOnlyUnfetch
   };
 
   VfsRdOnlyFile *p = reinterpret_cast<VfsRdOnlyFile *>(pFile);
@@ -242,17 +339,18 @@ static int VfsRdOnlyOpen(
   // Prevent xClose from being called in case of errors
   p->base.pMethods = NULL;
 
-  if (flags & SQLITE_OPEN_READWRITE)
-    return SQLITE_IOERR;
-  if (flags & SQLITE_OPEN_DELETEONCLOSE)
-    return SQLITE_IOERR;
-  if (flags & SQLITE_OPEN_EXCLUSIVE)
-    return SQLITE_IOERR;
-
+  // The file descriptor is owned by the vfs from here on and closed on errors
   assert(zName && (zName[0] == '@'));
   p->fd = String2Int64(string(&zName[1]));
   if (p->fd < 0)
     return SQLITE_IOERR;
+  if (flags & (SQLITE_OPEN_READWRITE | SQLITE_OPEN_DELETEONCLOSE |
+               SQLITE_OPEN_EXCLUSIVE))
+  {
+    cache_mgr->Close(p->fd);
+    p->fd = -1;
+    return SQLITE_IOERR;
+  }
   int64_t size = cache_mgr->GetSize(p->fd);
   if (size < 0) {
     cache_mgr->Close(p->fd);
@@ -268,10 +366,12 @@ static int VfsRdOnlyOpen(
   if (pOutFlags)
     *pOutFlags = flags;
   p->vfs_rdonly = reinterpret_cast<VfsRdOnly *>(vfs->pAppData);
+  VfsRdOnlyMap(p);
   p->base.pMethods = &io_methods;
   perf::Inc(p->vfs_rdonly->no_open);
-  LogCvmfs(kLogSql, kLogDebug, "open sqlite3 catalog on fd %d, size %"PRIu64,
-           p->fd, p->size);
+  LogCvmfs(kLogSql, kLogDebug, "open sqlite3 catalog on fd %d, size %"PRIu64
+           " (mapped: %s)",
+           p->fd, p->size, (p->mapping != NULL) ? "yes" : "no");
   return SQLITE_OK;
 }
 
@@ -434,12 +534,16 @@ static int VfsRdOnlyGetLastError(
 
 
 /**
- * Can only be registered once.
+ * Can only be registered once.  With a non-zero mmap_budget, catalogs are
+ * memory mapped as long as the sum of the mapped file sizes stays within the
+ * budget.  SQlite only uses the mappings if its mmap_size limit is set as well
+ * (PRAGMA mmap_size or SQLITE_CONFIG_MMAP_SIZE).
  */
 bool RegisterVfsRdOnly(
   cache::CacheManager *cache_mgr,
   perf::Statistics *statistics,
-  const VfsOptions options)
+  const VfsOptions options,
+  const uint64_t mmap_budget)
 {
   sqlite3_vfs *vfs = reinterpret_cast<sqlite3_vfs *>(
     smalloc(sizeof(sqlite3_vfs)));
@@ -475,6 +579,7 @@ bool RegisterVfsRdOnly(
   }
 
   vfs_rdonly->cache_mgr = cache_mgr;
+  vfs_rdonly->mmap_budget = mmap_budget;
   vfs_rdonly->n_access =
     statistics->Register("sqlite.n_access", "overall number of access() calls");
   vfs_rdonly->no_open =
@@ -493,6 +598,10 @@ bool RegisterVfsRdOnly(
     statistics->Register("sqlite.sz_sleep", "overall microseconds slept");
   vfs_rdonly->n_time =
     statistics->Register("sqlite.n_time", "overall number of time() calls");
+  vfs_rdonly->n_fetch =
+    statistics->Register("sqlite.n_fetch", "overall number of mmap'd pages");
+  vfs_rdonly->sz_mmap =
+    statistics->Register("sqlite.sz_mmap", "currently memory mapped bytes");
 
   return true;
 }
@@ -5,6 +5,8 @@
 #ifndef CVMFS_SQLITEVFS_H_
 #define CVMFS_SQLITEVFS_H_
 
+#include <stdint.h>
+
 #include <string>
 
 namespace cache {
@@ -24,7 +26,8 @@ enum VfsOptions {
 
 bool RegisterVfsRdOnly(cache::CacheManager *cache_mgr,
                        perf::Statistics *statistics,
-                       const VfsOptions options);
+                       const VfsOptions options,
+                       const uint64_t mmap_budget);
 bool UnregisterVfsRdOnly();
 
 }  // namespace sqlite
@@ -31,17 +31,40 @@ std::string Counter::PrintRatio(Counter divider) {
 }
 
 
+std::string ShardedCounter::ToString() { return StringifyInt(Get()); }
+
+
+void *ShardedCounter::operator new(size_t size) {
+  void *mem = NULL;
+  int retval = posix_memalign(&mem, __alignof__(Shard), size);
+  assert((retval == 0) && "Out Of Memory");
+  return mem;
+}
+
+
 //-----------------------------------------------------------------------------
 
+/**
+ * Sharded counters are not found, see LookupSharded().
+ */
 Counter *Statistics::Lookup(const std::string &name) {
   MutexLockGuard lock_guard(lock_);
   map<string, CounterInfo *>::const_iterator i = counters_.find(name);
-  if (i != counters_.end())
+  if ((i != counters_.end()) && (i->second->sharded_counter == NULL))
     return &i->second->counter;
   return NULL;
 }
 
 
+ShardedCounter *Statistics::LookupSharded(const std::string &name) {
+  MutexLockGuard lock_guard(lock_);
+  map<string, CounterInfo *>::const_iterator i = counters_.find(name);
+  if (i != counters_.end())
+    return i->second->sharded_counter;
+  return NULL;
+}
+
+
 string Statistics::LookupDesc(const std::string &name) {
   MutexLockGuard lock_guard(lock_);
   map<string, CounterInfo *>::const_iterator i = counters_.find(name);
@@ -60,8 +83,10 @@ string Statistics::PrintList(const PrintOptions print_options) {
   for (map<string, CounterInfo *>::const_iterator i = counters_.begin(),
        iEnd = counters_.end(); i != iEnd; ++i)
   {
-    result += i->first + "|" + i->second->counter.ToString() +
-              "|" + i->second->desc + "\n";
+    const string value = (i->second->sharded_counter != NULL)
+                         ? i->second->sharded_counter->ToString()
+                         : i->second->counter.ToString();
+    result += i->first + "|" + value + "|" + i->second->desc + "\n";
   }
   return result;
 }
@@ -76,6 +101,18 @@ Counter *Statistics::Register(const string &name, const string &desc) {
 }
 
 
+ShardedCounter *Statistics::RegisterSharded(const string &name,
+                                            const string &desc)
+{
+  MutexLockGuard lock_guard(lock_);
+  assert(counters_.find(name) == counters_.end());
+  CounterInfo *counter_info = new CounterInfo(desc);
+  counter_info->sharded_counter = new ShardedCounter();
+  counters_[name] = counter_info;
+  return counter_info->sharded_counter;
+}
+
+
 Statistics::Statistics() {
   lock_ =
     reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
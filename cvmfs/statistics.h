@@ -7,6 +7,7 @@
 
 #include <pthread.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <map>
 #include <string>
@@ -44,17 +45,87 @@ class Counter {
   atomic_int64 counter_;
 };
 
+
+/**
+ * A counter for code paths that run concurrently in many threads, such as the
+ * file system callbacks.  The value is spread over cache line sized shards.
+ * Threads update the shard selected by their stack address, so that concurrent
+ * updates usually do not contend for the same cache line.  Reading the value
+ * sums up all the shards and is comparably expensive.  The value is only
+ * modified in increments; there is no atomic fetch-and-add.
+ *
+ * ShardedCounter has no constructor, so that static instances are initialized
+ * before any code runs.  Other instances must be value-initialized, e.g. by
+ * new ShardedCounter().  The class-specific operator new keeps the shards on
+ * cache line boundaries, which the global one does not guarantee.
+ */
+class ShardedCounter {
+ public:
+  static const unsigned kLog2NumShards = 5;
+  static const unsigned kNumShards = 1 << kLog2NumShards;
+
+  void Inc() { atomic_inc64(&GetShard()->value); }
+  void Dec() { atomic_dec64(&GetShard()->value); }
+  void Add(const int64_t delta) { atomic_xadd64(&GetShard()->value, delta); }
+  int64_t Get() {
+    int64_t result = 0;
+    for (unsigned i = 0; i < kNumShards; ++i)
+      result += atomic_read64(&shards_[i].value);
+    return result;
+  }
+  /**
+   * Not atomic with respect to concurrent updates
+   */
+  void Set(const int64_t val) {
+    atomic_write64(&shards_[0].value, val);
+    for (unsigned i = 1; i < kNumShards; ++i)
+      atomic_write64(&shards_[i].value, 0);
+  }
+
+  std::string ToString();
+
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr) { free(ptr); }
+
+ private:
+  struct Shard {
+    atomic_int64 value;
+    char padding[64 - sizeof(atomic_int64)];
+  } __attribute__((aligned(64)));
+
+  /**
+   * The stacks of different threads are at least a few pages apart.  Within a
+   * thread, the shard might change with the call depth, which does not matter.
+   */
+  Shard *GetShard() {
+    int anchor;
+    const uint64_t address = reinterpret_cast<uintptr_t>(&anchor) >> 12;
+    const uint64_t hash = address * 0x9E3779B97F4A7C15ULL;
+    return &shards_[hash >> (64 - kLog2NumShards)];
+  }
+
+  Shard shards_[kNumShards];
+};
+
+
 // perf::Func(Counter) is more clear to read in the code
 inline void Dec(class Counter *counter) { counter->Dec(); }
 inline void Inc(class Counter *counter) { counter->Inc(); }
 inline int64_t Xadd(class Counter *counter, const int64_t delta) {
   return counter->Xadd(delta);
 }
+inline void Dec(class ShardedCounter *counter) { counter->Dec(); }
+inline void Inc(class ShardedCounter *counter) { counter->Inc(); }
+inline void Xadd(class ShardedCounter *counter, const int64_t delta) {
+  counter->Add(delta);
+}
 
 
 /**
  * A collection of Counter objects with a name and a description.  Counters in
- * a Statistics class have a name and a description.  Thread-safe.
+ * a Statistics class have a name and a description.  Sharded counters are
+ * registered separately but they are listed together with the plain counters.
+ * Thread-safe.
  */
 class Statistics {
  public:
@@ -66,15 +137,22 @@ class Statistics {
   Statistics();
   ~Statistics();
   Counter *Register(const std::string &name, const std::string &desc);
+  ShardedCounter *RegisterSharded(const std::string &name,
+                                  const std::string &desc);
   Counter *Lookup(const std::string &name);
+  ShardedCounter *LookupSharded(const std::string &name);
   std::string LookupDesc(const std::string &name);
   std::string PrintList(const PrintOptions print_options);
+
  private:
   Statistics(const Statistics &other);
   Statistics& operator=(const Statistics &other);
   struct CounterInfo {
-    explicit CounterInfo(const std::string &desc) : desc(desc) { }
+    explicit CounterInfo(const std::string &desc)
+      : sharded_counter(NULL), desc(desc) { }
+    ~CounterInfo() { delete sharded_counter; }
     Counter counter;
+    ShardedCounter *sharded_counter;  ///< Replaces counter if not NULL
     std::string desc;
   };
   std::map<std::string, CounterInfo *> counters_;
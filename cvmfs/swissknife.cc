@@ -24,9 +24,11 @@
 #include "swissknife_lsrepo.h"
 #include "swissknife_migrate.h"
 #include "swissknife_pull.h"
+#include "swissknife_replay.h"
 #include "swissknife_scrub.h"
 #include "swissknife_sign.h"
 #include "swissknife_sync.h"
+#include "swissknife_trace.h"
 #include "swissknife_zpipe.h"
 
 using namespace std;  // NOLINT
@@ -96,6 +98,8 @@ int main(int argc, char **argv) {
   swissknife::command_list.push_back(new swissknife::CommandCheck());
   swissknife::command_list.push_back(new swissknife::CommandListCatalogs());
   swissknife::command_list.push_back(new swissknife::CommandPull());
+  swissknife::command_list.push_back(new swissknife::CommandReplay());
+  swissknife::command_list.push_back(new swissknife::CommandTrace2Csv());
   swissknife::command_list.push_back(new swissknife::CommandZpipe());
   swissknife::command_list.push_back(new swissknife::CommandInfo());
   swissknife::command_list.push_back(new swissknife::CommandVersion());
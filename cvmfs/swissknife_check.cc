@@ -10,6 +10,7 @@
 #include "swissknife_check.h"
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #include <map>
@@ -17,6 +18,7 @@
 #include <string>
 #include <vector>
 
+#include "atomic.h"
 #include "catalog_sql.h"
 #include "compression.h"
 #include "download.h"
@@ -26,15 +28,76 @@
 #include "manifest.h"
 #include "shortstring.h"
 #include "util.h"
+#include "util_concurrency.h"
 
 using namespace std;  // NOLINT
 
 namespace swissknife {
 
 namespace {
+
+/**
+ * A nested catalog that is inspected in a separate thread.
+ */
+struct InspectTreeJob {
+  InspectTreeJob(CommandCheck *command,
+                 const string &path,
+                 const shash::Any &catalog_hash,
+                 const uint64_t catalog_size,
+                 const catalog::DirectoryEntry &transition_point)
+    : command(command)
+    , path(path)
+    , catalog_hash(catalog_hash)
+    , catalog_size(catalog_size)
+    , transition_point(transition_point)
+    , retval(false)
+    , spawned(false) { }
+
+  CommandCheck *command;
+  string path;
+  shash::Any catalog_hash;
+  uint64_t catalog_size;
+  catalog::DirectoryEntry transition_point;
+  catalog::DeltaCounters computed_counters;
+  bool retval;
+  bool spawned;
+  pthread_t thread;
+};
+
+/**
+ * An object in the data store whose existence is checked asynchronously.
+ */
+struct ObjectJob {
+  ObjectJob(const string &path, const string &description)
+    : path(path), description(description) { }
+  string path;
+  string description;
+};
+
 bool check_chunks;
 std::string *remote_repository;
-}
+unsigned num_parallel;
+/**
+ * Number of threads left for inspecting nested catalogs in parallel.  If
+ * there is no thread left, nested catalogs are inspected in the current
+ * thread.
+ */
+atomic_int32 free_inspect_threads;
+FifoChannel<ObjectJob *> *object_queue = NULL;
+vector<pthread_t> object_threads;
+/**
+ * Objects that are already queued or verified.  Objects referenced by many
+ * entries are only checked once.
+ */
+ObjectSet *scheduled_objects = NULL;
+pthread_mutex_t lock_scheduled_objects = PTHREAD_MUTEX_INITIALIZER;
+atomic_int64 num_checked_objects;
+atomic_int64 num_missing_objects;
+
+const unsigned kObjectQueueLength = 10000;
+const int64_t kProgressInterval = 100000;
+
+}  // anonymous namespace
 
 bool CommandCheck::CompareEntries(const catalog::DirectoryEntry &a,
                                   const catalog::DirectoryEntry &b,
@@ -144,6 +207,63 @@ bool CommandCheck::Exists(const string &file)
 }
 
 
+/**
+ * Queues an object of the data store for the existence check.  Objects are
+ * checked by a pool of threads, which sends concurrent HTTP HEAD requests
+ * through the download manager or concurrent stat calls for local storage.
+ */
+void CommandCheck::ScheduleObjectCheck(const shash::Any &hash,
+                                       const shash::Suffix suffix,
+                                       const string &description)
+{
+  pthread_mutex_lock(&lock_scheduled_objects);
+  const bool is_new = scheduled_objects->Insert(hash, suffix);
+  pthread_mutex_unlock(&lock_scheduled_objects);
+  if (!is_new)
+    return;
+
+  string path = "data/" + hash.MakePathWithoutSuffix();
+  if (suffix != shash::kSuffixNone)
+    path.push_back(suffix);
+  object_queue->Enqueue(new ObjectJob(path, description));
+}
+
+
+void *CommandCheck::MainCheckObjects(void *data) {
+  CommandCheck *command = reinterpret_cast<CommandCheck *>(data);
+  while (true) {
+    ObjectJob *job = object_queue->Dequeue();
+    if (job == NULL)
+      break;
+
+    if (!command->Exists(job->path)) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "%s missing", job->description.c_str());
+      atomic_inc64(&num_missing_objects);
+    }
+    const int64_t num_checked = atomic_xadd64(&num_checked_objects, 1) + 1;
+    if (num_checked % kProgressInterval == 0) {
+      LogCvmfs(kLogCvmfs, kLogStdout, "[checked objects] %"PRId64
+               " (%"PRId64" missing)",
+               num_checked, atomic_read64(&num_missing_objects));
+    }
+    delete job;
+  }
+  return NULL;
+}
+
+
+void *CommandCheck::MainInspectTree(void *data) {
+  InspectTreeJob *job = reinterpret_cast<InspectTreeJob *>(data);
+  job->retval = job->command->InspectTree(job->path,
+                                          job->catalog_hash,
+                                          job->catalog_size,
+                                          &job->transition_point,
+                                          &job->computed_counters);
+  atomic_inc32(&free_inspect_threads);
+  return NULL;
+}
+
+
 /**
  * Recursive catalog walk-through
  */
@@ -197,8 +317,11 @@ bool CommandCheck::Find(const catalog::Catalog *catalog,
       found_nested_marker = true;
     }
 
-    // Check if checksum is not null
-    if (entries[i].IsRegular() && entries[i].checksum().IsNull()) {
+    // Check if checksum is not null; chunked files without a bulk object are
+    // checked through their chunks
+    if (entries[i].IsRegular() && !entries[i].IsChunkedFile() &&
+        entries[i].checksum().IsNull())
+    {
       LogCvmfs(kLogCvmfs, kLogStderr,
                "regular file pointing to zero-hash: '%s'", full_path.c_str());
       retval = false;
@@ -206,14 +329,12 @@ bool CommandCheck::Find(const catalog::Catalog *catalog,
 
     // Check if the chunk is there
     if (!entries[i].checksum().IsNull() && check_chunks) {
-      string chunk_path = "data/" + entries[i].checksum().MakePath();
-      if (entries[i].IsDirectory())
-        chunk_path += shash::kSuffixMicroCatalog;
-      if (!Exists(chunk_path)) {
-        LogCvmfs(kLogCvmfs, kLogStderr, "data chunk %s (%s) missing",
-                 entries[i].checksum().ToString().c_str(), full_path.c_str());
-        retval = false;
-      }
+      const shash::Suffix suffix = entries[i].IsDirectory()
+                                   ? shash::kSuffixMicroCatalog
+                                   : entries[i].checksum().suffix;
+      ScheduleObjectCheck(entries[i].checksum(), suffix,
+                          "data chunk " + entries[i].checksum().ToString() +
+                          " (" + full_path.ToString() + ")");
     }
 
     // Add hardlinks to counting map
@@ -341,16 +462,11 @@ bool CommandCheck::Find(const catalog::Catalog *catalog,
         // are all data chunks in the data store?
         if (check_chunks) {
           const shash::Any &chunk_hash = this_chunk.content_hash();
-          const string chunk_path = "data/" + chunk_hash.MakePath();
-          if (!Exists(chunk_path)) {
-            LogCvmfs(kLogCvmfs, kLogStderr, "partial data chunk %s (%s -> "
-                                            "offset: %d | size: %d) missing",
-                     this_chunk.content_hash().ToStringWithSuffix().c_str(),
-                     full_path.c_str(),
-                     this_chunk.offset(),
-                     this_chunk.size());
-            retval = false;
-          }
+          ScheduleObjectCheck(chunk_hash, chunk_hash.suffix,
+            "partial data chunk " + chunk_hash.ToStringWithSuffix() +
+            " (" + full_path.ToString() + " -> offset: " +
+            StringifyInt(this_chunk.offset()) + " | size: " +
+            StringifyInt(this_chunk.size()) + ")");
         }
       }
 
@@ -401,7 +517,10 @@ bool CommandCheck::Find(const catalog::Catalog *catalog,
 
 string CommandCheck::DownloadPiece(const shash::Any catalog_hash) {
   string source = "data/" + catalog_hash.MakePath();
-  const string dest = "/tmp/" + catalog_hash.ToString();
+  // Unique per call, the same catalog can be inspected by several threads
+  const string dest = CreateTempPath("/tmp/" + catalog_hash.ToString(), 0600);
+  if (dest.empty())
+    return "";
   const string url = *remote_repository + "/" + source;
   download::JobInfo download_catalog(&url, true, false, &dest, &catalog_hash);
   download::Failures retval = g_download_manager->Fetch(&download_catalog);
@@ -417,9 +536,13 @@ string CommandCheck::DownloadPiece(const shash::Any catalog_hash) {
 
 string CommandCheck::DecompressPiece(const shash::Any catalog_hash) {
   string source = "data/" + catalog_hash.MakePath();
-  const string dest = "/tmp/" + catalog_hash.ToString();
-  if (!zlib::DecompressPath2Path(source, dest))
+  const string dest = CreateTempPath("/tmp/" + catalog_hash.ToString(), 0600);
+  if (dest.empty())
+    return "";
+  if (!zlib::DecompressPath2Path(source, dest)) {
+    unlink(dest.c_str());
     return "";
+  }
 
   return dest;
 }
@@ -533,6 +656,7 @@ bool CommandCheck::InspectTree(const string &path,
              nested_catalogs.size());
     retval = false;
   }
+  vector<InspectTreeJob *> nested_jobs;
   for (catalog::Catalog::NestedCatalogList::const_iterator i =
        nested_catalogs.begin(), iEnd = nested_catalogs.end(); i != iEnd; ++i)
   {
@@ -541,13 +665,36 @@ bool CommandCheck::InspectTree(const string &path,
       LogCvmfs(kLogCvmfs, kLogStderr, "failed to lookup transition point %s",
                i->path.c_str());
       retval = false;
+      continue;
+    }
+
+    InspectTreeJob *job = new InspectTreeJob(this, i->path.ToString(),
+                                             i->hash, i->size,
+                                             nested_transition_point);
+    nested_jobs.push_back(job);
+    // Fan out to a new thread if there is one left, otherwise recurse
+    if (atomic_xadd32(&free_inspect_threads, -1) > 0) {
+      int retval_create =
+        pthread_create(&job->thread, NULL, MainInspectTree, job);
+      assert(retval_create == 0);
+      job->spawned = true;
     } else {
-      catalog::DeltaCounters nested_counters;
-      if (!InspectTree(i->path.ToString(), i->hash, i->size,
-                       &nested_transition_point, &nested_counters))
-        retval = false;
-      nested_counters.PopulateToParent(computed_counters);
+      atomic_inc32(&free_inspect_threads);
+      job->retval = InspectTree(job->path, job->catalog_hash, job->catalog_size,
+                                &job->transition_point,
+                                &job->computed_counters);
+    }
+  }
+  for (unsigned i = 0; i < nested_jobs.size(); ++i) {
+    InspectTreeJob *job = nested_jobs[i];
+    if (job->spawned) {
+      int retval_join = pthread_join(job->thread, NULL);
+      assert(retval_join == 0);
     }
+    if (!job->retval)
+      retval = false;
+    job->computed_counters.PopulateToParent(computed_counters);
+    delete job;
   }
 
   // Check statistics counters
@@ -574,6 +721,13 @@ int CommandCheck::Main(const swissknife::ArgumentList &args) {
     tag_name = *args.find('t')->second;
   if (args.find('c') != args.end())
     check_chunks = true;
+  num_parallel = 1;
+  if (args.find('n') != args.end())
+    num_parallel = String2Uint64(*args.find('n')->second);
+  if (num_parallel == 0) {
+    swissknife::Usage();
+    return 1;
+  }
   if (args.find('l') != args.end()) {
     unsigned log_level =
       1 << (kLogLevel0 + String2Uint64(*args.find('l')->second));
@@ -588,7 +742,9 @@ int CommandCheck::Main(const swissknife::ArgumentList &args) {
   // Repository can be HTTP address or on local file system
   if (repository.substr(0, 7) == "http://") {
     remote_repository = new string(repository);
-    g_download_manager->Init(1, true, g_statistics);
+    // Catalog downloads and object checks of all threads run concurrently
+    g_download_manager->Init(2 * num_parallel, true, g_statistics);
+    g_download_manager->Spawn();
   } else {
     remote_repository = NULL;
   }
@@ -676,9 +832,45 @@ int CommandCheck::Main(const swissknife::ArgumentList &args) {
              tag_name.c_str());
   }
 
+  // The current thread is the first catalog inspection thread
+  atomic_init32(&free_inspect_threads);
+  atomic_xadd32(&free_inspect_threads, num_parallel - 1);
+  atomic_init64(&num_checked_objects);
+  atomic_init64(&num_missing_objects);
+  if (check_chunks) {
+    scheduled_objects = new ObjectSet();
+    object_queue = new FifoChannel<ObjectJob *>(kObjectQueueLength,
+                                                kObjectQueueLength / 2);
+    object_threads.resize(num_parallel);
+    for (unsigned i = 0; i < num_parallel; ++i) {
+      int retval_create =
+        pthread_create(&object_threads[i], NULL, MainCheckObjects, this);
+      assert(retval_create == 0);
+    }
+  }
+
   catalog::DeltaCounters computed_counters;
   bool retval = InspectTree("", root_hash, root_size, NULL, &computed_counters);
 
+  if (check_chunks) {
+    for (unsigned i = 0; i < num_parallel; ++i)
+      object_queue->Enqueue(NULL);
+    for (unsigned i = 0; i < num_parallel; ++i) {
+      int retval_join = pthread_join(object_threads[i], NULL);
+      assert(retval_join == 0);
+    }
+    LogCvmfs(kLogCvmfs, kLogStdout, "Checked %"PRId64" objects, "
+             "%"PRId64" missing",
+             atomic_read64(&num_checked_objects),
+             atomic_read64(&num_missing_objects));
+    if (atomic_read64(&num_missing_objects) > 0)
+      retval = false;
+    delete object_queue;
+    object_queue = NULL;
+    delete scheduled_objects;
+    scheduled_objects = NULL;
+  }
+
   delete manifest;
   return retval ? 0 : 1;
 }
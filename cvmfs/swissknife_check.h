@@ -5,10 +5,15 @@
 #ifndef CVMFS_SWISSKNIFE_CHECK_H_
 #define CVMFS_SWISSKNIFE_CHECK_H_
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 #include "catalog.h"
 #include "hash.h"
+#include "smallhash.h"
 #include "swissknife.h"
 
 namespace download {
@@ -17,6 +22,56 @@ class DownloadManager;
 
 namespace swissknife {
 
+/**
+ * Set of data store objects, used to check every object only once.  Only the
+ * first 16 bytes of the digest are stored, with the suffix folded in.  In
+ * the hash table, that takes some 30-50 bytes per object instead of more
+ * than 100 bytes for a std::set of hashes.
+ */
+class ObjectSet {
+ public:
+  ObjectSet() { objects_.Init(1024, ObjectDigest(), HashObjectDigest); }
+
+  /**
+   * Returns false if the object is already in the set.
+   */
+  bool Insert(const shash::Any &hash, const shash::Suffix suffix) {
+    ObjectDigest key;
+    memcpy(key.digest, hash.digest,
+           std::min(sizeof(key.digest),
+                    static_cast<size_t>(hash.GetDigestSize())));
+    key.digest[sizeof(key.digest) - 1] ^= static_cast<uint8_t>(suffix);
+    if (objects_.Contains(key))
+      return false;
+    objects_.Insert(key, true);
+    return true;
+  }
+
+  uint32_t size() const { return objects_.size(); }
+
+ private:
+  struct ObjectDigest {
+    ObjectDigest() { memset(digest, 0, sizeof(digest)); }
+    bool operator ==(const ObjectDigest &other) const {
+      return memcmp(digest, other.digest, sizeof(digest)) == 0;
+    }
+    bool operator !=(const ObjectDigest &other) const {
+      return !(*this == other);
+    }
+    uint8_t digest[16];
+  };
+
+  // The digest is already uniformly distributed
+  static uint32_t HashObjectDigest(const ObjectDigest &key) {
+    uint32_t result;
+    memcpy(&result, key.digest, sizeof(result));
+    return result;
+  }
+
+  SmallHashDynamic<ObjectDigest, bool> objects_;
+};
+
+
 class CommandCheck : public Command {
  public:
   ~CommandCheck() { }
@@ -32,6 +87,8 @@ class CommandCheck : public Command {
     r.push_back(Parameter::Optional('t', "check specific repository tag"));
     r.push_back(Parameter::Optional('l', "log level (0-4, default: 2)"));
     r.push_back(Parameter::Switch('c', "check availability of data chunks"));
+    r.push_back(Parameter::Optional('n', "number of parallel threads "
+                                         "(default: 1)"));
     return r;
   }
   int Main(const ArgumentList &args);
@@ -48,6 +105,11 @@ class CommandCheck : public Command {
             const PathString &path,
             catalog::DeltaCounters *computed_counters);
   bool Exists(const std::string &file);
+  void ScheduleObjectCheck(const shash::Any &hash,
+                           const shash::Suffix suffix,
+                           const std::string &description);
+  static void *MainInspectTree(void *data);
+  static void *MainCheckObjects(void *data);
   bool CompareCounters(const catalog::Counters &a,
                        const catalog::Counters &b);
   bool CompareEntries(const catalog::DirectoryEntry &a,
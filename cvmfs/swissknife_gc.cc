@@ -5,9 +5,14 @@
  * outdated and/or unneeded data objects.
  */
 
+#define __STDC_FORMAT_MACROS
+
 #include "cvmfs_config.h"
 #include "swissknife_gc.h"
 
+#include <inttypes.h>
+
+#include <cstdio>
 #include <string>
 
 #include "garbage_collection/garbage_collector.h"
@@ -34,6 +39,8 @@ ParameterList CommandGc::GetParams() {
   r.push_back(Parameter::Optional('t', "temporary directory"));
   r.push_back(Parameter::Switch('d', "dry run"));
   r.push_back(Parameter::Switch('l', "list objects to be removed"));
+  r.push_back(Parameter::Optional('c', "number of concurrent removals"));
+  r.push_back(Parameter::Optional('L', "log file of removed objects"));
   // to be extended...
   return r;
 }
@@ -54,6 +61,8 @@ int CommandGc::Main(const ArgumentList &args) {
   const bool list_condemned_objects = (args.count('l') > 0);
   const std::string temp_directory = (args.count('t') > 0) ?
     *args.find('t')->second : "/tmp";
+  const std::string deletion_log_path = (args.count('L') > 0) ?
+    *args.find('L')->second : "";
 
   if (revisions < 0) {
     LogCvmfs(kLogCvmfs, kLogStderr,
@@ -96,7 +105,15 @@ int CommandGc::Main(const ArgumentList &args) {
   }
 
   GcConfig config;
-  const upload::SpoolerDefinition spooler_definition(spooler, shash::kAny);
+  upload::SpoolerDefinition spooler_definition(spooler, shash::kAny);
+  if (args.count('c') > 0) {
+    const int64_t concurrent_removals = String2Int64(*args.find('c')->second);
+    if (concurrent_removals <= 0) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "invalid number of concurrent removals");
+      return 1;
+    }
+    spooler_definition.number_of_concurrent_removals = concurrent_removals;
+  }
   config.uploader = upload::AbstractUploader::Construct(spooler_definition);
   config.keep_history_depth = revisions;
   config.keep_history_timestamp = timestamp;
@@ -110,9 +127,37 @@ int CommandGc::Main(const ArgumentList &args) {
     return 1;
   }
 
+  if (!deletion_log_path.empty()) {
+    config.deleted_objects_logfile = fopen(deletion_log_path.c_str(), "w");
+    if (config.deleted_objects_logfile == NULL) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "failed to open deletion log %s",
+               deletion_log_path.c_str());
+      config.uploader->TearDown();
+      delete config.uploader;
+      return 1;
+    }
+  }
+
+  StopWatch stopwatch;
+  stopwatch.Start();
   GC collector(config);
   const bool success = collector.Collect();
+  stopwatch.Stop();
+
+  if (!dry_run) {
+    const uint64_t num_removed = config.uploader->GetNumRemovedObjects();
+    const uint64_t num_failed = config.uploader->GetNumFailedRemovals();
+    const double seconds = stopwatch.GetTime();
+    LogCvmfs(kLogCvmfs, kLogStdout, "Removed %"PRIu64" objects "
+             "(%"PRIu64" failed) in %.1f seconds (%.0f objects/s)",
+             num_removed, num_failed, seconds,
+             (seconds > 0.0) ? num_removed / seconds : 0.0);
+  }
 
+  if (config.deleted_objects_logfile != NULL)
+    fclose(config.deleted_objects_logfile);
+  config.uploader->TearDown();
+  delete config.uploader;
   download_manager.Fini();
   signature_manager.Fini();
 
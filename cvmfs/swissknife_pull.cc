@@ -227,6 +227,33 @@ static void *MainWorker(void *data) {
 }
 
 
+/**
+ * Catalog deltas are optional, clients fall back to the full catalog.  They are
+ * not content-addressed and therefore not verified here.
+ */
+static void PullCatalogDelta(const shash::Any &catalog_hash) {
+  shash::Any delta_hash(catalog_hash);
+  delta_hash.suffix = shash::kSuffixDelta;
+  if (Peek(delta_hash))
+    return;
+
+  string tmp_file;
+  FILE *fdelta = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w", &tmp_file);
+  assert(fdelta);
+  const string url_delta = *stratum0_url + "/data/" + delta_hash.MakePath();
+  download::JobInfo download_delta(&url_delta, false, false, fdelta, NULL);
+  download::Failures retval = g_download_manager->Fetch(&download_delta);
+  fclose(fdelta);
+  if (retval != download::kFailOk) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "  Skipping catalog delta (%d - %s)",
+             retval, download::Code2Ascii(retval));
+    unlink(tmp_file.c_str());
+    return;
+  }
+  Store(tmp_file, delta_hash);
+}
+
+
 static bool Pull(const shash::Any &catalog_hash, const std::string &path) {
   int retval;
   download::Failures dl_retval;
@@ -292,6 +319,10 @@ static bool Pull(const shash::Any &catalog_hash, const std::string &path) {
     goto pull_cleanup;
   }
 
+  // Catalog deltas are only used by clients, not by a preloaded cache
+  if (!preload_cache && !catalog->GetDeltaBase().IsNull())
+    PullCatalogDelta(catalog_hash);
+
   // Traverse the chunks
   LogCvmfs(kLogCvmfs, kLogStdout | kLogNoLinebreak,
            "  Processing chunks: ");
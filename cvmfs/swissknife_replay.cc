@@ -0,0 +1,84 @@
+/**
+ * This file is part of the CernVM File System.
+ *
+ * Preloads a cache directory with the objects recorded in an access log,
+ * see access_log_replay.h.
+ */
+
+#define _FILE_OFFSET_BITS 64
+#define __STDC_FORMAT_MACROS
+
+#include "cvmfs_config.h"
+#include "swissknife_replay.h"
+
+#include <inttypes.h>
+
+#include <string>
+#include <vector>
+
+#include "access_log.h"
+#include "access_log_replay.h"
+#include "download.h"
+#include "hash.h"
+#include "logging.h"
+#include "util.h"
+
+using namespace std;  // NOLINT
+
+namespace swissknife {
+
+int CommandReplay::Main(const ArgumentList &args) {
+  unsigned num_parallel = 4;
+  unsigned timeout = 10;
+  unsigned retries = 3;
+  if (args.find('l') != args.end()) {
+    unsigned log_level =
+      1 << (kLogLevel0 + String2Uint64(*args.find('l')->second));
+    if (log_level > kLogNone) {
+      swissknife::Usage();
+      return 1;
+    }
+    SetLogVerbosity(static_cast<LogLevels>(log_level));
+  }
+  const string access_log_path = *args.find('f')->second;
+  if (args.find('n') != args.end())
+    num_parallel = String2Uint64(*args.find('n')->second);
+  if (args.find('t') != args.end())
+    timeout = String2Uint64(*args.find('t')->second);
+  if (args.find('a') != args.end())
+    retries = String2Uint64(*args.find('a')->second);
+  if (num_parallel == 0) {
+    swissknife::Usage();
+    return 1;
+  }
+
+  vector<access_log::Record> records;
+  if (!access_log::ReadLog(access_log_path, &records)) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to read access log %s",
+             access_log_path.c_str());
+    return 1;
+  }
+  vector<shash::Any> objects;
+  access_log::Replayer::ListObjects(records, &objects);
+  LogCvmfs(kLogCvmfs, kLogStdout,
+           "Replaying %"PRIu64" accesses to %"PRIu64" objects",
+           static_cast<uint64_t>(records.size()),
+           static_cast<uint64_t>(objects.size()));
+
+  g_download_manager->Init(num_parallel+1, true, g_statistics);
+  g_download_manager->SetTimeout(timeout, timeout);
+  g_download_manager->SetRetryParameters(retries, timeout, 3*timeout);
+  g_download_manager->Spawn();
+  access_log::Replayer replayer(g_download_manager, *args.find('u')->second,
+                                *args.find('r')->second);
+  const bool retval = replayer.Run(objects, num_parallel);
+  g_download_manager->Fini();
+
+  LogCvmfs(kLogCvmfs, kLogStdout, "\nFetched %"PRId64" new objects out of "
+           "%"PRIu64" referenced objects (%"PRId64" failed)",
+           replayer.num_new(), static_cast<uint64_t>(objects.size()),
+           replayer.num_failed());
+  return retval ? 0 : 1;
+}
+
+}  // namespace swissknife
@@ -0,0 +1,37 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_SWISSKNIFE_REPLAY_H_
+#define CVMFS_SWISSKNIFE_REPLAY_H_
+
+#include <string>
+
+#include "swissknife.h"
+
+namespace swissknife {
+
+class CommandReplay : public Command {
+ public:
+  ~CommandReplay() { }
+  std::string GetName() { return "replay"; }
+  std::string GetDescription() {
+    return "Preloads a cache directory with the objects of an access log.";
+  }
+  ParameterList GetParams() {
+    ParameterList r;
+    r.push_back(Parameter::Mandatory('u', "repository url"));
+    r.push_back(Parameter::Mandatory('f', "access log file"));
+    r.push_back(Parameter::Mandatory('r', "cache directory"));
+    r.push_back(Parameter::Optional('n', "number of download threads"));
+    r.push_back(Parameter::Optional('l', "log level (0-4, default: 2)"));
+    r.push_back(Parameter::Optional('t', "timeout (s)"));
+    r.push_back(Parameter::Optional('a', "number of retries"));
+    return r;
+  }
+  int Main(const ArgumentList &args);
+};
+
+}  // namespace swissknife
+
+#endif  // CVMFS_SWISSKNIFE_REPLAY_H_
@@ -17,12 +17,14 @@
  */
 
 #define _FILE_OFFSET_BITS 64
+#define __STDC_FORMAT_MACROS
 
 #include "cvmfs_config.h"
 #include "swissknife_sync.h"
 
 #include <fcntl.h>
 #include <glob.h>
+#include <inttypes.h>
 
 #include <cstdio>
 #include <cstdlib>
@@ -489,6 +491,7 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
   if (args.find('d') != args.end()) params.stop_for_catalog_tweaks = true;
   if (args.find('g') != args.end()) params.garbage_collectable = true;
   if (args.find('k') != args.end()) params.include_xattrs = true;
+  if (args.find('D') != args.end()) params.catalog_deltas = true;
   if (args.find('z') != args.end()) {
     unsigned log_level =
     1 << (kLogLevel0 + String2Uint64(*args.find('z')->second));
@@ -506,6 +509,7 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
       return 2;
     }
   }
+  if (args.find('O') != args.end()) params.generate_legacy_bulk_chunks = false;
   shash::Algorithms hash_algorithm = shash::kSha1;
   if (args.find('e') != args.end()) {
     hash_algorithm = shash::ParseHashAlgorithm(*args.find('e')->second);
@@ -528,6 +532,28 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
     params.max_concurrent_write_jobs = String2Uint64(*args.find('q')->second);
   }
 
+  if (args.find('C') != args.end()) {
+    params.hash_cache_path = MakeCanonicalPath(*args.find('C')->second);
+  }
+
+  if (args.find('E') != args.end()) {
+    params.existence_filter_path =
+      MakeCanonicalPath(*args.find('E')->second);
+  }
+  if (args.find('U') != args.end()) params.trust_existence_filter = true;
+
+  if (args.find('T') != args.end()) {
+    params.num_traversal_threads = String2Uint64(*args.find('T')->second);
+  }
+
+  if (args.find('R') != args.end()) {
+    params.num_reader_threads = String2Uint64(*args.find('R')->second);
+  }
+
+  if (args.find('M') != args.end()) {
+    params.max_read_buffer_mb = String2Uint64(*args.find('M')->second);
+  }
+
   if (!CheckParams(params)) return 2;
 
   // Start spooler
@@ -542,6 +568,15 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
     spooler_definition.number_of_concurrent_uploads =
                                                params.max_concurrent_write_jobs;
   }
+  spooler_definition.hash_cache_path = params.hash_cache_path;
+  spooler_definition.existence_filter_path = params.existence_filter_path;
+  spooler_definition.verify_existence_filter_hits =
+    !params.trust_existence_filter;
+  spooler_definition.generate_legacy_bulk_chunks =
+    params.generate_legacy_bulk_chunks;
+  spooler_definition.number_of_read_threads = params.num_reader_threads;
+  spooler_definition.max_read_bytes_in_flight =
+    params.max_read_buffer_mb * 1024 * 1024;
 
   params.spooler = upload::Spooler::Construct(spooler_definition);
   if (NULL == params.spooler)
@@ -557,6 +592,8 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
                     params.spooler, g_download_manager,
                     params.catalog_entry_warn_threshold,
                     g_statistics);
+  if (params.catalog_deltas)
+    catalog_manager.EnableCatalogDeltas();
   catalog_manager.Init();
   publish::SyncMediator mediator(&catalog_manager, &params);
   publish::SyncUnion *sync;
@@ -576,6 +613,7 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
     return 3;
   }
 
+  sync->set_num_traversal_threads(params.num_traversal_threads);
   sync->Traverse();
 
   LogCvmfs(kLogCvmfs, kLogStdout, "Exporting repository manifest");
@@ -591,6 +629,25 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
 
   // finalize the spooler
   params.spooler->WaitForUpload();
+  if (!params.hash_cache_path.empty()) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "Skipped processing of %"PRIu64" bytes "
+             "of unchanged content (hash cache)",
+             params.spooler->GetNumSkippedBytes());
+  }
+  if (!params.existence_filter_path.empty()) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "Skipped upload of %"PRIu64" objects "
+             "(%"PRIu64" bytes) already in the backend storage",
+             params.spooler->GetNumAvoidedUploads(),
+             params.spooler->GetNumAvoidedBytes());
+  }
+  const upload::CharBufferPool::Counters buffer_counters =
+    params.spooler->GetBufferPoolCounters();
+  LogCvmfs(kLogCvmfs, kLogStdout, "Data buffers: %"PRIu64" allocated, "
+           "%"PRIu64" recycled, %"PRIu64" oversized, %"PRIu64" freed, "
+           "peak memory in flight %"PRIu64" kB",
+           buffer_counters.num_allocated, buffer_counters.num_recycled,
+           buffer_counters.num_unpooled, buffer_counters.num_freed,
+           buffer_counters.peak_bytes_in_flight / 1024);
   delete params.spooler;
 
   if (!manifest->Export(params.manifest_path)) {
@@ -15,20 +15,26 @@ struct SyncParameters {
   SyncParameters() :
     spooler(NULL),
     union_fs_type("aufs"),
+    trust_existence_filter(false),
     print_changeset(false),
     dry_run(false),
     mucatalogs(false),
     use_file_chunking(false),
+    generate_legacy_bulk_chunks(true),
     ignore_xdir_hardlinks(false),
     stop_for_catalog_tweaks(false),
     garbage_collectable(false),
     include_xattrs(false),
+    catalog_deltas(false),
     catalog_entry_warn_threshold(500000),
     min_file_chunk_size(4*1024*1024),
     avg_file_chunk_size(8*1024*1024),
     max_file_chunk_size(16*1024*1024),
     manual_revision(0),
-    max_concurrent_write_jobs(0) {}
+    max_concurrent_write_jobs(0),
+    num_traversal_threads(1),
+    num_reader_threads(1),
+    max_read_buffer_mb(0) {}
 
   upload::Spooler *spooler;
   std::string      dir_union;
@@ -40,20 +46,28 @@ struct SyncParameters {
   std::string      manifest_path;
   std::string      spooler_definition;
   std::string      union_fs_type;
+  std::string      hash_cache_path;
+  std::string      existence_filter_path;
+  bool             trust_existence_filter;
   bool             print_changeset;
   bool             dry_run;
   bool             mucatalogs;
   bool             use_file_chunking;
+  bool             generate_legacy_bulk_chunks;
   bool             ignore_xdir_hardlinks;
   bool             stop_for_catalog_tweaks;
   bool             garbage_collectable;
   bool             include_xattrs;
+  bool             catalog_deltas;
   uint64_t         catalog_entry_warn_threshold;
   size_t           min_file_chunk_size;
   size_t           avg_file_chunk_size;
   size_t           max_file_chunk_size;
   uint64_t         manual_revision;
   uint64_t         max_concurrent_write_jobs;
+  unsigned         num_traversal_threads;
+  unsigned         num_reader_threads;
+  uint64_t         max_read_buffer_mb;
 };
 
 namespace catalog {
@@ -207,7 +221,9 @@ class CommandSync : public Command {
                                           "catalog tweaks"));
     r.push_back(Parameter::Switch('g', "repo is garbage collectable"));
     r.push_back(Parameter::Switch('p', "enable file chunking"));
+    r.push_back(Parameter::Switch('O', "no bulk objects for chunked files"));
     r.push_back(Parameter::Switch('k', "include extended attributes"));
+    r.push_back(Parameter::Switch('D', "publish catalog deltas"));
     r.push_back(Parameter::Optional('z', "log level (0-4, default: 2)"));
     r.push_back(Parameter::Optional('a',
       "desired average chunk size in bytes"));
@@ -218,6 +234,12 @@ class CommandSync : public Command {
     r.push_back(Parameter::Optional('j', "catalog entry warning threshold"));
     r.push_back(Parameter::Optional('v', "manual revision number"));
     r.push_back(Parameter::Optional('q', "number of concurrent write jobs"));
+    r.push_back(Parameter::Optional('C', "publish hash cache database"));
+    r.push_back(Parameter::Optional('E', "existence filter of stored objects"));
+    r.push_back(Parameter::Switch('U', "trust existence filter hits"));
+    r.push_back(Parameter::Optional('T', "number of traversal threads"));
+    r.push_back(Parameter::Optional('R', "number of file reader threads"));
+    r.push_back(Parameter::Optional('M', "memory limit for read buffers (MB)"));
     return r;
   }
   int Main(const ArgumentList &args);
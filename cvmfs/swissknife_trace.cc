@@ -0,0 +1,28 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "swissknife_trace.h"
+
+#include <string>
+
+#include "logging.h"
+#include "tracer.h"
+
+using namespace std;  // NOLINT
+
+namespace swissknife {
+
+int CommandTrace2Csv::Main(const ArgumentList &args) {
+  const string trace_file = *args.find('i')->second;
+  const string csv_file = *args.find('o')->second;
+  if (!tracer::ConvertToCsv(trace_file, csv_file)) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to convert %s into %s",
+             trace_file.c_str(), csv_file.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace swissknife
@@ -0,0 +1,33 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_SWISSKNIFE_TRACE_H_
+#define CVMFS_SWISSKNIFE_TRACE_H_
+
+#include <string>
+
+#include "swissknife.h"
+
+namespace swissknife {
+
+class CommandTrace2Csv : public Command {
+ public:
+  ~CommandTrace2Csv() { }
+  std::string GetName() { return "trace2csv"; }
+  std::string GetDescription() {
+    return "Converts a binary trace file of the client (CVMFS_TRACEFILE) "
+      "into csv format.";
+  }
+  ParameterList GetParams() {
+    ParameterList r;
+    r.push_back(Parameter::Mandatory('i', "binary trace file"));
+    r.push_back(Parameter::Mandatory('o', "csv output file"));
+    return r;
+  }
+  int Main(const ArgumentList &args);
+};
+
+}  // namespace swissknife
+
+#endif  // CVMFS_SWISSKNIFE_TRACE_H_
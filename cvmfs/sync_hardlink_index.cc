@@ -0,0 +1,61 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#define __STDC_FORMAT_MACROS
+
+#include "sync_hardlink_index.h"
+
+#include <errno.h>
+
+#include "fs_traversal.h"
+#include "logging.h"
+#include "platform.h"
+
+using namespace std;  // NOLINT
+
+namespace publish {
+
+void HardlinkIndex::Build(const string &directory) {
+  LogCvmfs(kLogUnionFs, kLogDebug, "building hardlink index of %s",
+           directory.c_str());
+  directory_ = directory;
+  groups_.clear();
+  verified_.clear();
+
+  FileSystemTraversal<HardlinkIndex> traversal(this, directory, false);
+  traversal.fn_new_file = &HardlinkIndex::AddFileCallback;
+  traversal.fn_new_symlink = &HardlinkIndex::AddFileCallback;
+  traversal.Recurse(directory);
+  built_ = true;
+}
+
+
+/**
+ * Returns the names of all the files in the directory that share the given
+ * inode or NULL if the inode is not in the index.
+ */
+const set<string> *HardlinkIndex::GetGroup(const uint64_t inode) const {
+  GroupMap::const_iterator i = groups_.find(inode);
+  return (i == groups_.end()) ? NULL : &i->second;
+}
+
+
+void HardlinkIndex::AddFileCallback(const string &parent_dir,
+                                    const string &filename)
+{
+  const string path = directory_ + "/" + filename;
+  platform_stat64 info;
+  if (platform_lstat(path.c_str(), &info) != 0) {
+    LogCvmfs(kLogUnionFs, kLogDebug, "failed to stat %s (%d)",
+             path.c_str(), errno);
+    return;
+  }
+  if (info.st_nlink > 1) {
+    LogCvmfs(kLogUnionFs, kLogDebug, "have member of inode group %"PRIu64
+             ": %s", static_cast<uint64_t>(info.st_ino), path.c_str());
+    groups_[info.st_ino].insert(filename);
+  }
+}
+
+}  // namespace publish
@@ -0,0 +1,58 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_SYNC_HARDLINK_INDEX_H_
+#define CVMFS_SYNC_HARDLINK_INDEX_H_
+
+#include <inttypes.h>
+
+#include <map>
+#include <set>
+#include <string>
+
+namespace publish {
+
+/**
+ * Maps the inodes of the hardlinked files in a single directory to the names
+ * of the files that share the inode.  Files with a link count of one are not
+ * indexed.  The index is built by a single pass over the directory and
+ * answers hardlink group lookups without scanning the directory again.
+ *
+ * Used by the overlayfs synchronization to find the siblings of copied-up
+ * hardlinks in the read-only branch.  CernVM-FS does not support hardlinks
+ * that span directories, so the parent directory is sufficient.
+ */
+class HardlinkIndex {
+ public:
+  HardlinkIndex() : built_(false) { }
+
+  void Build(const std::string &directory);
+  const std::set<std::string> *GetGroup(const uint64_t inode) const;
+
+  /**
+   * All members of a hardlink group need to be checked only once.
+   */
+  void MarkVerified(const uint64_t inode) { verified_.insert(inode); }
+  bool IsVerified(const uint64_t inode) const {
+    return verified_.find(inode) != verified_.end();
+  }
+
+  bool built() const { return built_; }
+  unsigned size() const { return groups_.size(); }
+
+  void AddFileCallback(const std::string &parent_dir,
+                       const std::string &filename);
+
+ private:
+  typedef std::map<uint64_t, std::set<std::string> > GroupMap;
+
+  bool built_;
+  std::string directory_;
+  GroupMap groups_;
+  std::set<uint64_t> verified_;
+};
+
+}  // namespace publish
+
+#endif  // CVMFS_SYNC_HARDLINK_INDEX_H_
@@ -36,6 +36,27 @@ SyncItem::SyncItem(const string &relative_parent_path,
 }
 
 
+SyncItem::SyncItem(const string &relative_parent_path,
+                   const string &filename,
+                   const SyncItemType entry_type,
+                   const SyncUnion *union_engine,
+                   const EntryStat &rdonly_stat,
+                   const EntryStat &union_stat,
+                   const EntryStat &scratch_stat) :
+  union_engine_(union_engine),
+  rdonly_stat_(rdonly_stat),
+  union_stat_(union_stat),
+  scratch_stat_(scratch_stat),
+  whiteout_(false),
+  relative_parent_path_(relative_parent_path),
+  filename_(filename),
+  scratch_type_(entry_type),
+  rdonly_type_(GetRdOnlyFiletype())
+{
+  content_hash_.algorithm = shash::kAny;
+}
+
+
 SyncItemType SyncItem::GetRdOnlyFiletype() const {
   StatRdOnly();
   // file could not exist in read-only branch, or a regular file could have
@@ -62,6 +83,10 @@ void SyncItem::MarkAsWhiteout(const std::string &actual_filename) {
   whiteout_ = true;
   filename_ = actual_filename;
 
+  // Cached stats of the union and scratch paths refer to the whiteout file
+  union_stat_.obtained = false;
+  scratch_stat_.obtained = false;
+
   // Find the entry in the repository
   StatRdOnly(true);  // <== refreshing the stat (filename might have changed)
   if (rdonly_stat_.error_code != 0) {
@@ -51,6 +51,31 @@ class SyncItem {
            const SyncItemType entry_type,
            const SyncUnion *union_engine);
 
+  /**
+   * Structure to cache stat calls to the different file locations.
+   */
+  struct EntryStat {
+    EntryStat() : obtained(false), error_code(0) {
+      memset(&stat, 0, sizeof(stat));
+    }
+
+    bool obtained;   /**< false at the beginning, true after first stat call */
+    int error_code;  /**< errno value of the stat call */
+    platform_stat64 stat;
+  };
+
+  /**
+   * Creates a SyncItem from stat results that were obtained beforehand, e.g.
+   * by the parallel traversal of the scratch area.
+   */
+  SyncItem(const std::string &relative_parent_path,
+           const std::string &filename,
+           const SyncItemType entry_type,
+           const SyncUnion *union_engine,
+           const EntryStat &rdonly_stat,
+           const EntryStat &union_stat,
+           const EntryStat &scratch_stat);
+
   inline bool IsDirectory()     const { return scratch_type_ == kItemDir;     }
   inline bool WasDirectory()    const { return rdonly_type_  == kItemDir;     }
   inline bool IsRegularFile()   const { return scratch_type_ == kItemFile;    }
@@ -99,23 +124,14 @@ class SyncItem {
             (filename_ == other.filename_));
   }
 
+  static void StatGeneric(const std::string  &path,
+                          EntryStat          *info,
+                          const bool          refresh);
+
  protected:
   SyncItemType GetRdOnlyFiletype() const;
 
  private:
-  /**
-   * Structure to cache stat calls to the different file locations.
-   */
-  struct EntryStat {
-    EntryStat() : obtained(false), error_code(0) {
-      memset(&stat, 0, sizeof(stat));
-    }
-
-    bool obtained;   /**< false at the beginning, true after first stat call */
-    int error_code;  /**< errno value of the stat call */
-    platform_stat64 stat;
-  };
-
   const SyncUnion *union_engine_;
 
   mutable EntryStat rdonly_stat_;
@@ -142,9 +158,6 @@ class SyncItem {
   inline void StatOverlay(const bool refresh = false) const {
     StatGeneric(GetScratchPath(), &scratch_stat_, refresh);
   }
-  static void StatGeneric(const std::string  &path,
-                          EntryStat          *info,
-                          const bool          refresh);
 };
 
 typedef std::map<std::string, SyncItem> SyncItemList;
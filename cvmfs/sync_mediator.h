@@ -69,6 +69,26 @@ struct HardlinkGroup {
 typedef std::map<uint64_t, HardlinkGroup> HardlinkGroupMap;
 
 
+/**
+ * The part of the SyncMediator that is used by the union file system
+ * traversal.  Tests replace it by a mock.
+ */
+class AbstractSyncMediator {
+ public:
+  virtual ~AbstractSyncMediator() { }
+
+  virtual void RegisterUnionEngine(SyncUnion *engine) = 0;
+
+  virtual void Add(const SyncItem &entry) = 0;
+  virtual void Touch(const SyncItem &entry) = 0;
+  virtual void Remove(const SyncItem &entry) = 0;
+  virtual void Replace(const SyncItem &entry) = 0;
+
+  virtual void EnterDirectory(const SyncItem &entry) = 0;
+  virtual void LeaveDirectory(const SyncItem &entry) = 0;
+};
+
+
 /**
  * The SyncMediator refines the input received from a concrete UnionSync object.
  * For example, it resolves the insertion and deletion of complete directories
@@ -78,8 +98,7 @@ typedef std::map<uint64_t, HardlinkGroup> HardlinkGroupMap;
  * Furthermore it sends new and modified files to the spooler for compression
  * and hashing.
  */
-class SyncMediator {
-  friend class SyncUnion;
+class SyncMediator : public AbstractSyncMediator {
  private:
   enum ChangesetAction {
     kAdd,
@@ -97,6 +116,10 @@ class SyncMediator {
                const SyncParameters *params);
   virtual ~SyncMediator();
 
+  void RegisterUnionEngine(SyncUnion *engine) {
+    union_engine_ = engine;
+  }
+
   void Add(const SyncItem &entry);
   void Touch(const SyncItem &entry);
   void Remove(const SyncItem &entry);
@@ -111,10 +134,6 @@ class SyncMediator {
   typedef std::stack<HardlinkGroupMap> HardlinkGroupMapStack;
   typedef std::vector<HardlinkGroup> HardlinkGroupList;
 
-  void RegisterUnionEngine(SyncUnion *engine) {
-    union_engine_ = engine;
-  }
-
   void PrintChangesetNotice(const ChangesetAction action,
                             const std::string &extra_info) const;
 
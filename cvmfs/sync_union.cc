@@ -8,8 +8,17 @@
 
 #include <alloca.h>
 #include <errno.h>
+#include <pthread.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 // lgetxattr is only required for overlayfs which does not exist on OS X
 #ifdef __APPLE__
 #define lgetxattr(...) (-1)
@@ -23,42 +32,412 @@
 #include "sync_item.h"
 #include "sync_mediator.h"
 #include "util.h"
+#include "util_concurrency.h"
 
 using namespace std;  // NOLINT
 
 namespace publish {
 
-SyncUnion::SyncUnion(SyncMediator *mediator,
+/**
+ * Reads the directories of the scratch area with a pool of worker threads.
+ * For every directory entry, the scratch, read-only, and union locations are
+ * stat'ed in one go.  Directories that exist in the read-only branch are
+ * scanned speculatively because the traversal will most likely descend into
+ * them.  New directories are not scanned; their content is added by the
+ * SyncMediator.
+ *
+ * The synchronizing thread collects the listings with GetListing() and
+ * replays them in the order of the serial traversal.  Directories that were
+ * not scanned speculatively are scheduled on demand.  Sub directories are
+ * scanned depth-first, like the replay, and the workers stay at most
+ * kMaxListingsPerThread listings per thread ahead of the replay.  Listings
+ * that the replay does not need are dropped together with their subtree.
+ */
+class ScratchScanner : SingleCopy {
+ public:
+  struct Entry {
+    string name;
+    SyncItemType type;
+    SyncItem::EntryStat rdonly_stat;
+    SyncItem::EntryStat union_stat;
+    SyncItem::EntryStat scratch_stat;
+  };
+  typedef vector<Entry> Listing;
+
+  static const unsigned kMaxListingsPerThread = 64;
+
+  ScratchScanner(SyncUnion *union_engine, const unsigned num_threads);
+  ~ScratchScanner();
+
+  Listing *GetListing(const string &relative_path);
+  void DropListing(const string &relative_path);
+
+ private:
+  static void *MainWorker(void *data);
+  Listing *ScanDirectory(const string &relative_path, vector<string> *subdirs);
+  bool CanScan() const;
+  static bool IsInSubtree(const string &path, const string &subtree) {
+    return (path == subtree) ||
+           ((path.length() > subtree.length()) &&
+            (path[subtree.length()] == '/') &&
+            (path.compare(0, subtree.length(), subtree) == 0));
+  }
+
+  SyncUnion *union_engine_;
+  vector<pthread_t> workers_;
+  const unsigned max_listings_ahead_;
+  /**
+   * Protects all of the following fields
+   */
+  pthread_mutex_t lock_;
+  /**
+   * Signals new pending directories, new listings, and consumed listings
+   */
+  pthread_cond_t cond_;
+  deque<string> pending_dirs_;
+  /**
+   * Directories that are pending, being scanned, or listed, i.e. all
+   * directories that were scheduled and not yet collected or dropped
+   */
+  set<string> scheduled_dirs_;
+  set<string> scanning_dirs_;
+  /**
+   * Directories being scanned whose listing is dropped once it is ready
+   */
+  set<string> dropped_dirs_;
+  map<string, Listing *> listings_;
+  /**
+   * The directory the replay is waiting for, if waiting_ is true.  It may be
+   * scanned even if the workers are too far ahead.
+   */
+  string wanted_dir_;
+  bool waiting_;
+  bool terminate_;
+};
+
+
+ScratchScanner::ScratchScanner(SyncUnion *union_engine,
+                               const unsigned num_threads)
+  : union_engine_(union_engine)
+  , workers_(num_threads)
+  , max_listings_ahead_(num_threads * kMaxListingsPerThread)
+  , waiting_(false)
+  , terminate_(false)
+{
+  int retval = pthread_mutex_init(&lock_, NULL);
+  assert(retval == 0);
+  retval = pthread_cond_init(&cond_, NULL);
+  assert(retval == 0);
+
+  // The root of the scratch area is always required
+  pending_dirs_.push_back("");
+  scheduled_dirs_.insert("");
+  for (unsigned i = 0; i < workers_.size(); ++i) {
+    retval = pthread_create(&workers_[i], NULL, MainWorker, this);
+    assert(retval == 0);
+  }
+}
+
+
+/**
+ * Stops the workers and drops the listings that were not collected.
+ */
+ScratchScanner::~ScratchScanner() {
+  {
+    MutexLockGuard guard(lock_);
+    terminate_ = true;
+    pthread_cond_broadcast(&cond_);
+  }
+  for (unsigned i = 0; i < workers_.size(); ++i)
+    pthread_join(workers_[i], NULL);
+
+  for (map<string, Listing *>::iterator i = listings_.begin(),
+       iend = listings_.end(); i != iend; ++i)
+  {
+    delete i->second;
+  }
+  pthread_cond_destroy(&cond_);
+  pthread_mutex_destroy(&lock_);
+}
+
+
+/**
+ * Blocks until the listing of the given directory is available.  The caller
+ * takes ownership of the listing.
+ */
+ScratchScanner::Listing *ScratchScanner::GetListing(
+  const string &relative_path)
+{
+  MutexLockGuard guard(lock_);
+  if (scheduled_dirs_.find(relative_path) == scheduled_dirs_.end()) {
+    scheduled_dirs_.insert(relative_path);
+    pending_dirs_.push_front(relative_path);
+  } else if ((listings_.find(relative_path) == listings_.end()) &&
+             (scanning_dirs_.find(relative_path) == scanning_dirs_.end()) &&
+             (pending_dirs_.front() != relative_path))
+  {
+    // Still pending, move it to the front of the queue
+    deque<string>::iterator i =
+      find(pending_dirs_.begin(), pending_dirs_.end(), relative_path);
+    assert(i != pending_dirs_.end());
+    pending_dirs_.erase(i);
+    pending_dirs_.push_front(relative_path);
+  }
+  wanted_dir_ = relative_path;
+  waiting_ = true;
+  pthread_cond_broadcast(&cond_);
+
+  map<string, Listing *>::iterator i;
+  while ((i = listings_.find(relative_path)) == listings_.end())
+    pthread_cond_wait(&cond_, &lock_);
+  waiting_ = false;
+  Listing *listing = i->second;
+  listings_.erase(i);
+  scheduled_dirs_.erase(relative_path);
+  // Frees a slot for the workers
+  pthread_cond_broadcast(&cond_);
+  return listing;
+}
+
+
+/**
+ * Discards the listing of a directory that the replay does not descend into,
+ * including everything that was scheduled underneath it.
+ */
+void ScratchScanner::DropListing(const string &relative_path) {
+  MutexLockGuard guard(lock_);
+  // Nothing underneath an unscheduled directory can have been scheduled
+  if (scheduled_dirs_.find(relative_path) == scheduled_dirs_.end())
+    return;
+
+  for (deque<string>::iterator i = pending_dirs_.begin();
+       i != pending_dirs_.end(); )
+  {
+    if (IsInSubtree(*i, relative_path)) {
+      scheduled_dirs_.erase(*i);
+      i = pending_dirs_.erase(i);
+    } else {
+      ++i;
+    }
+  }
+  for (map<string, Listing *>::iterator i = listings_.begin();
+       i != listings_.end(); )
+  {
+    if (IsInSubtree(i->first, relative_path)) {
+      scheduled_dirs_.erase(i->first);
+      delete i->second;
+      listings_.erase(i++);
+    } else {
+      ++i;
+    }
+  }
+  for (set<string>::const_iterator i = scanning_dirs_.begin(),
+       iend = scanning_dirs_.end(); i != iend; ++i)
+  {
+    if (IsInSubtree(*i, relative_path))
+      dropped_dirs_.insert(*i);
+  }
+  pthread_cond_broadcast(&cond_);
+}
+
+
+/**
+ * Called with the lock held.
+ */
+bool ScratchScanner::CanScan() const {
+  if (pending_dirs_.empty())
+    return false;
+  if (listings_.size() + scanning_dirs_.size() < max_listings_ahead_)
+    return true;
+  return waiting_ && (pending_dirs_.front() == wanted_dir_);
+}
+
+
+void *ScratchScanner::MainWorker(void *data) {
+  ScratchScanner *scanner = reinterpret_cast<ScratchScanner *>(data);
+
+  pthread_mutex_lock(&scanner->lock_);
+  while (true) {
+    while (!scanner->terminate_ && !scanner->CanScan())
+      pthread_cond_wait(&scanner->cond_, &scanner->lock_);
+    if (scanner->terminate_)
+      break;
+
+    const string relative_path = scanner->pending_dirs_.front();
+    scanner->pending_dirs_.pop_front();
+    scanner->scanning_dirs_.insert(relative_path);
+
+    vector<string> subdirs;
+    pthread_mutex_unlock(&scanner->lock_);
+    Listing *listing = scanner->ScanDirectory(relative_path, &subdirs);
+    pthread_mutex_lock(&scanner->lock_);
+
+    scanner->scanning_dirs_.erase(relative_path);
+    if (scanner->dropped_dirs_.erase(relative_path) > 0) {
+      scanner->scheduled_dirs_.erase(relative_path);
+      delete listing;
+      pthread_cond_broadcast(&scanner->cond_);
+      continue;
+    }
+    scanner->listings_[relative_path] = listing;
+    // Depth-first, in the order of the replay
+    for (vector<string>::reverse_iterator i = subdirs.rbegin(),
+         iend = subdirs.rend(); i != iend; ++i)
+    {
+      if (scanner->scheduled_dirs_.insert(*i).second)
+        scanner->pending_dirs_.push_front(*i);
+    }
+    pthread_cond_broadcast(&scanner->cond_);
+  }
+  pthread_mutex_unlock(&scanner->lock_);
+  return NULL;
+}
+
+
+ScratchScanner::Listing *ScratchScanner::ScanDirectory(
+  const string &relative_path,
+  vector<string> *subdirs)
+{
+  const string prefix = relative_path.empty() ? "" : ("/" + relative_path);
+  const string path = union_engine_->scratch_path() + prefix;
+  DIR *dip = opendir(path.c_str());
+  if (!dip) {
+    LogCvmfs(kLogUnionFs, kLogStderr, "Failed to open %s (%d).\n"
+             "Please check directory permissions.",
+             path.c_str(), errno);
+    abort();
+  }
+
+  Listing *listing = new Listing();
+  platform_dirent64 *dit;
+  while ((dit = platform_readdir(dip)) != NULL) {
+    const string name(dit->d_name);
+    if ((name == ".") || (name == ".."))
+      continue;
+    if (union_engine_->IgnoreFilePredicate(relative_path, name)) {
+      LogCvmfs(kLogUnionFs, kLogVerboseMsg, "ignoring %s/%s",
+               path.c_str(), name.c_str());
+      continue;
+    }
+
+    Entry entry;
+    entry.name = name;
+    const string entry_path = prefix + "/" + name;
+    SyncItem::StatGeneric(union_engine_->scratch_path() + entry_path,
+                          &entry.scratch_stat, false);
+    assert(entry.scratch_stat.error_code == 0);
+    const mode_t mode = entry.scratch_stat.stat.st_mode;
+    if (S_ISDIR(mode)) {
+      entry.type = kItemDir;
+    } else if (S_ISREG(mode)) {
+      entry.type = kItemFile;
+    } else if (S_ISLNK(mode)) {
+      entry.type = kItemSymlink;
+    } else {
+      LogCvmfs(kLogUnionFs, kLogVerboseMsg, "skipping special file %s/%s",
+               path.c_str(), name.c_str());
+      continue;
+    }
+    SyncItem::StatGeneric(union_engine_->rdonly_path() + entry_path,
+                          &entry.rdonly_stat, false);
+    SyncItem::StatGeneric(union_engine_->union_path() + entry_path,
+                          &entry.union_stat, false);
+
+    // Same condition as SyncItem::IsNew()
+    if ((entry.type == kItemDir) &&
+        (entry.rdonly_stat.error_code != ENOENT) &&
+        (entry.rdonly_stat.error_code != ENOTDIR))
+    {
+      subdirs->push_back(entry_path.substr(1));
+    }
+    listing->push_back(entry);
+  }
+  closedir(dip);
+
+  return listing;
+}
+
+
+//------------------------------------------------------------------------------
+
+
+SyncUnion::SyncUnion(AbstractSyncMediator *mediator,
                      const std::string &rdonly_path,
                      const std::string &union_path,
                      const std::string &scratch_path) :
   rdonly_path_(rdonly_path),
   scratch_path_(scratch_path),
   union_path_(union_path),
-  mediator_(mediator)
+  mediator_(mediator),
+  num_traversal_threads_(1)
 {
   mediator_->RegisterUnionEngine(this);
 }
 
 
+void SyncUnion::TraverseParallel() {
+  LogCvmfs(kLogUnionFs, kLogVerboseMsg, "starting parallel traversal of "
+           "scratch_path=[%s] with %u threads",
+           scratch_path().c_str(), num_traversal_threads_);
+  ScratchScanner scanner(this, num_traversal_threads_);
+
+  SyncItem root("", "", kItemDir, this);
+  mediator_->EnterDirectory(root);
+  ReplayDirectory(&scanner, "");
+  mediator_->LeaveDirectory(root);
+}
+
+
+/**
+ * Feeds the prefetched listing of a directory to the mediator in the same
+ * order as the serial traversal does.
+ */
+void SyncUnion::ReplayDirectory(ScratchScanner *scanner,
+                                const string &relative_path)
+{
+  UniquePtr<ScratchScanner::Listing> listing(
+    scanner->GetListing(relative_path));
+  for (unsigned i = 0; i < listing->size(); ++i) {
+    const ScratchScanner::Entry &e = listing->at(i);
+    SyncItem entry(relative_path, e.name, e.type, this,
+                   e.rdonly_stat, e.union_stat, e.scratch_stat);
+    if (e.type == kItemDir) {
+      if (ProcessDirectoryItem(&entry)) {
+        mediator_->EnterDirectory(entry);
+        ReplayDirectory(scanner, entry.GetRelativePath());
+        mediator_->LeaveDirectory(entry);
+      } else {
+        scanner->DropListing(entry.GetRelativePath());
+      }
+    } else {
+      ProcessFile(&entry);
+    }
+  }
+}
+
+
 bool SyncUnion::ProcessDirectory(const string &parent_dir,
                                  const string &dir_name)
 {
   LogCvmfs(kLogUnionFs, kLogDebug, "SyncUnion::ProcessDirectory(%s, %s)",
            parent_dir.c_str(), dir_name.c_str());
   SyncItem entry(parent_dir, dir_name, kItemDir, this);
+  return ProcessDirectoryItem(&entry);
+}
+
 
-  if (entry.IsNew()) {
-    mediator_->Add(entry);
+bool SyncUnion::ProcessDirectoryItem(SyncItem *entry) {
+  if (entry->IsNew()) {
+    mediator_->Add(*entry);
     // Recursion stops here. All content of new directory
     // is added later by the SyncMediator
     return false;
   } else {  // directory already existed...
-    if (entry.IsOpaqueDirectory()) {  // was directory completely overwritten?
-      mediator_->Replace(entry);
+    if (entry->IsOpaqueDirectory()) {  // was directory completely overwritten?
+      mediator_->Replace(*entry);
       return false;  // <-- replace does not need any further recursion
     } else {  // directory was just changed internally... only touch needed
-      mediator_->Touch(entry);
+      mediator_->Touch(*entry);
       return true;
     }
   }
@@ -131,7 +510,7 @@ void SyncUnion::LeaveDirectory(const string &parent_dir,
 //------------------------------------------------------------------------------
 
 
-SyncUnionAufs::SyncUnionAufs(SyncMediator *mediator,
+SyncUnionAufs::SyncUnionAufs(AbstractSyncMediator *mediator,
                              const std::string &rdonly_path,
                              const std::string &union_path,
                              const std::string &scratch_path) :
@@ -150,6 +529,11 @@ SyncUnionAufs::SyncUnionAufs(SyncMediator *mediator,
 
 
 void SyncUnionAufs::Traverse() {
+  if (num_traversal_threads_ > 1) {
+    TraverseParallel();
+    return;
+  }
+
   FileSystemTraversal<SyncUnionAufs> traversal(this, scratch_path(), true);
 
   traversal.fn_enter_dir = &SyncUnionAufs::EnterDirectory;
@@ -189,13 +573,12 @@ bool SyncUnionAufs::IgnoreFilePredicate(const string &parent_dir,
 //------------------------------------------------------------------------------
 
 
-SyncUnionOverlayfs::SyncUnionOverlayfs(SyncMediator *mediator,
+SyncUnionOverlayfs::SyncUnionOverlayfs(AbstractSyncMediator *mediator,
                                        const string &rdonly_path,
                                        const string &union_path,
                                        const string &scratch_path) :
   SyncUnion(mediator, rdonly_path, union_path, scratch_path)
 {
-  hardlink_lower_inode_ = 0;
 }
 
 
@@ -209,41 +592,43 @@ void SyncUnionOverlayfs::ProcessFile(SyncItem *entry) {
              "with existing hardlinks in lowerdir.",
              entry->GetUnionPath().c_str());
 
-    hardlink_lower_inode_ = entry->GetRdOnlyInode();
-    hardlink_lower_files_.clear();
-
     string rdonly_parent_dir = GetParentPath(entry->GetRdOnlyPath());
     string scratch_parent_dir = GetParentPath(entry->GetScratchPath());
     string union_parent_dir = GetParentPath(entry->GetUnionPath());
 
     // Find all hardlinks in lowerdir corresponding to this entry
     // (only check this dir since we don't allow cross-dir hardlinks in CVMFS)
-    FileSystemTraversal<SyncUnionOverlayfs>
-      traversal(this, rdonly_path(), false);
-    traversal.fn_new_file = &SyncUnionOverlayfs::ProcessFileHardlinkCallback;
-    traversal.fn_new_symlink = &SyncUnionOverlayfs::ProcessFileHardlinkCallback;
-    traversal.Recurse(rdonly_parent_dir);
-
-    // Should now have hardlink_lower_files_ populated with the files
+    HardlinkIndex *index = &hardlink_indexes_[rdonly_parent_dir];
+    if (!index->built())
+      index->Build(rdonly_parent_dir);
+    const set<string> *group = index->GetGroup(entry->GetRdOnlyInode());
+    const set<string> empty_group;
+    const set<string> &hardlink_lower_files =
+      (group == NULL) ? empty_group : *group;
+
+    // Should now have hardlink_lower_files populated with the files
     // in this hardlink group
-    if (hardlink_lower_files_.size() != entry->GetRdOnlyLinkcount()) {
+    if (hardlink_lower_files.size() != entry->GetRdOnlyLinkcount()) {
       LogCvmfs(kLogUnionFs, kLogWarning, "Found %u entries in hardlink group "
                "for %s in overlayfs lowerdir directory %s, "
                "was expecting %u (do the hardlinks span directories?)",
-               hardlink_lower_files_.size(),
+               hardlink_lower_files.size(),
                entry->GetRdOnlyPath().c_str(),
                rdonly_parent_dir.c_str(),
                entry->GetRdOnlyLinkcount());
+    } else if (index->IsVerified(entry->GetRdOnlyInode())) {
+      LogCvmfs(kLogUnionFs, kLogDebug, "hardlink group of %s has already been "
+               "checked", entry->GetRdOnlyPath().c_str());
     } else {
       LogCvmfs(kLogUnionFs, kLogDebug, "Found %u entries in hardlink group "
                "for %s in overlayfs lowerdir directory %s, as expected.",
-               hardlink_lower_files_.size(),
+               hardlink_lower_files.size(),
                entry->GetRdOnlyPath().c_str(),
                GetParentPath(entry->GetRdOnlyPath()).c_str());
       // have the expected number of entries in the hardlink group,
       // check if they are all present in the scratch layer (upperdir)
-      for (set<string>::iterator i = hardlink_lower_files_.begin(),
-           iend = hardlink_lower_files_.end(); i != iend; ++i)
+      for (set<string>::const_iterator i = hardlink_lower_files.begin(),
+           iend = hardlink_lower_files.end(); i != iend; ++i)
       {
         string filename = *i;
 
@@ -287,34 +672,21 @@ void SyncUnionOverlayfs::ProcessFile(SyncItem *entry) {
             abort();
           }  // error == ENOENT
         }  // platform_lstat < 0
-      }  // for hardlink_lower_files_
-    }  // hardlink_lower_files_.size() == entry->GetRdOnlyLinkcount()
+      }  // for hardlink_lower_files
+      index->MarkVerified(entry->GetRdOnlyInode());
+    }  // hardlink_lower_files.size() == entry->GetRdOnlyLinkcount()
   }  // Is hardlink
 
   SyncUnion::ProcessFile(entry);
 }
 
 
-void SyncUnionOverlayfs::ProcessFileHardlinkCallback(const string &parent_dir,
-                                                     const string &filename)
-{
-  LogCvmfs(kLogUnionFs, kLogDebug,
-           "SyncUnionOverlayfs::ProcessFileHardlinkCallback(%s, %s)",
-           parent_dir.c_str(), filename.c_str());
-  SyncItem entry(parent_dir, filename, kItemFile, this);
-  if (entry.GetRdOnlyLinkcount() > 1) {
-    if (hardlink_lower_inode_ == entry.GetRdOnlyInode()) {
-      LogCvmfs(kLogUnionFs, kLogDebug,
-               "SyncUnionOverlayfs::ProcessFileHardlinkCallback "
-               "have member of inode group %u: %s/%s",
-               hardlink_lower_inode_, parent_dir.c_str(), filename.c_str());
-      hardlink_lower_files_.insert(entry.filename());
-    }
+void SyncUnionOverlayfs::Traverse() {
+  if (num_traversal_threads_ > 1) {
+    TraverseParallel();
+    return;
   }
-}
-
 
-void SyncUnionOverlayfs::Traverse() {
   FileSystemTraversal<SyncUnionOverlayfs>
     traversal(this, scratch_path(), true);
 
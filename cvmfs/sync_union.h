@@ -32,13 +32,17 @@
 
 #include <inttypes.h>
 
+#include <map>
 #include <set>
 #include <string>
 
+#include "sync_hardlink_index.h"
+
 namespace publish {
 
+class ScratchScanner;
 class SyncItem;
-class SyncMediator;
+class AbstractSyncMediator;
 
 /**
  * Interface definition of repository synchronization based on
@@ -54,7 +58,7 @@ class SyncUnion {
    * @param mediator a reference to a SyncMediator object used as bridge to
    *        the actual sync process
    */
-  SyncUnion(SyncMediator *mediator,
+  SyncUnion(AbstractSyncMediator *mediator,
             const std::string &rdonly_path,
             const std::string &union_path,
             const std::string &scratch_path);
@@ -69,6 +73,15 @@ class SyncUnion {
   inline std::string union_path() const { return union_path_; }
   inline std::string scratch_path() const { return scratch_path_; }
 
+  /**
+   * With more than one thread, the scratch area is read by a pool of worker
+   * threads that stat the entries ahead of the synchronization.  The
+   * SyncMediator is still fed in the order of the serial traversal.
+   */
+  void set_num_traversal_threads(const unsigned num_threads) {
+    num_traversal_threads_ = num_threads;
+  }
+
   /**
    * Whiteout files may have special naming conventions.
    * This method "unmangles" them and retrieves the original file name
@@ -100,6 +113,7 @@ class SyncUnion {
   /**
    * Union file systems may use some special files for bookkeeping.
    * They must not show up in to repository and are ignored by the recursion.
+   * Note: in the parallel traversal, this is called from the worker threads.
    * @param parent directory in which file resides
    * @param filename to decide whether to ignore or not
    * @return true if file should be ignored, othewise false
@@ -112,7 +126,16 @@ class SyncUnion {
   std::string scratch_path_;
   std::string union_path_;
 
-  SyncMediator *mediator_;
+  AbstractSyncMediator *mediator_;
+  unsigned num_traversal_threads_;
+
+  /**
+   * Traverses the scratch area with num_traversal_threads_ worker threads
+   * and replays the directory listings in order.
+   */
+  void TraverseParallel();
+  void ReplayDirectory(ScratchScanner *scanner,
+                       const std::string &relative_path);
 
   /**
    * Callback when a regular file is found.
@@ -131,6 +154,10 @@ class SyncUnion {
    */
   virtual bool ProcessDirectory(const std::string &parent_dir,
                                 const std::string &dir_name);
+  /**
+   * Same as ProcessDirectory() for an entry that is already stat'ed.
+   */
+  virtual bool ProcessDirectoryItem(SyncItem *entry);
 
   /**
    * Callback when a symlink is found.
@@ -172,7 +199,7 @@ class SyncUnion {
  */
 class SyncUnionAufs : public SyncUnion {
  public:
-  SyncUnionAufs(SyncMediator *mediator,
+  SyncUnionAufs(AbstractSyncMediator *mediator,
                 const std::string &rdonly_path,
                 const std::string &union_path,
                 const std::string &scratch_path);
@@ -198,14 +225,12 @@ class SyncUnionAufs : public SyncUnion {
  */
 class SyncUnionOverlayfs : public SyncUnion {
  public:
-  SyncUnionOverlayfs(SyncMediator *mediator,
+  SyncUnionOverlayfs(AbstractSyncMediator *mediator,
                      const std::string &rdonly_path,
                      const std::string &union_path,
                      const std::string &scratch_path);
 
   void Traverse();
-  void ProcessFileHardlinkCallback(const std::string &parent_dir,
-                                   const std::string &filename);
   static bool ReadlinkEquals(std::string const &path,
                              std::string const &compare_value);
   static bool XattrEquals(std::string const &path, std::string const &attr_name,
@@ -223,8 +248,11 @@ class SyncUnionOverlayfs : public SyncUnion {
  private:
   bool IsWhiteoutSymlinkPath(const std::string &path) const;
   bool IsOpaqueDirPath(const std::string &path) const;
-  std::set<std::string> hardlink_lower_files_;
-  uint64_t hardlink_lower_inode_;
+  /**
+   * Hardlink indexes of the read-only directories that contain copied-up
+   * hardlinks.  Every directory is scanned at most once per publish.
+   */
+  std::map<std::string, HardlinkIndex> hardlink_indexes_;
 };  // class SyncUnionOverlayfs
 
 }  // namespace publish
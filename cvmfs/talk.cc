@@ -29,6 +29,7 @@
 #include <string>
 #include <vector>
 
+#include "access_log.h"
 #include "cache.h"
 #include "cvmfs.h"
 #include "download.h"
@@ -112,6 +113,9 @@ static void *MainTalk(void *data __attribute__((unused))) {
       if (line == "tracebuffer flush") {
         tracer::Flush();
         Answer(con_fd, "OK\n");
+      } else if (line == "access log flush") {
+        access_log::Flush();
+        Answer(con_fd, "OK\n");
       } else if (line == "cache size") {
         QuotaManager *quota_mgr = cvmfs::cache_manager_->quota_mgr();
         if (!quota_mgr->IsEnforcing()) {
@@ -189,6 +193,25 @@ static void *MainTalk(void *data __attribute__((unused))) {
           else
             Answer(con_fd, "No such regular file or pinning failed\n");
         }
+      } else if (line.substr(0, 4) == "warm") {
+        if (line.length() < 6) {
+          Answer(con_fd, "Usage: warm [pinned] <path>\n");
+        } else {
+          bool pin = false;
+          string path = line.substr(5);
+          if (path.substr(0, 7) == "pinned ") {
+            pin = true;
+            path = path.substr(7);
+          }
+          unsigned num_catalogs;
+          const bool retval = cvmfs::WarmSubtree(path, pin, &num_catalogs);
+          const string result = StringifyInt(num_catalogs) + " catalogs " +
+                                (pin ? "pinned" : "loaded") + "\n";
+          if (retval)
+            Answer(con_fd, "OK, " + result);
+          else
+            Answer(con_fd, "Failed to warm subtree, " + result);
+        }
       } else if (line == "mountpoint") {
         Answer(con_fd, *cvmfs::mountpoint_ + "\n");
       } else if (line == "remount") {
@@ -407,7 +430,10 @@ static void *MainTalk(void *data __attribute__((unused))) {
           result += nfs_maps::GetStatistics();
         }
 
-        result += "SQlite Statistics:\n";
+        result += "Meta-data Cache Statistics:\n";
+        result += cvmfs::GetMemcacheStatistics();
+
+        result += "\nSQlite Statistics:\n";
         sqlite3_status(SQLITE_STATUS_MALLOC_COUNT, &current, &highwater, 0);
         result += "  Number of allocations " + StringifyInt(current) + "\n";
 
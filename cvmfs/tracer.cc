@@ -1,19 +1,23 @@
 /**
  * This file is part of the CernVM File System.
  *
- * Tracer is a thread-safe tracing module.  It uses a ring buffer
- * and spawns a helper thread, that flushes the messages onto the disk
- * when necessary.  The output file is in csv format.  Usually tracing
- * a message is a lock-free process, which therefore should have minimal
- * overhead.
+ * Tracer is a thread-safe tracing module.  Every tracing thread owns a ring
+ * buffer of fixed-size binary records.  A helper thread collects the records
+ * of all threads, orders them by time stamp and appends them to the trace
+ * file.  Tracing a message is a lock-free process that only writes into the
+ * thread's own ring buffer.  If the ring buffer is full, the message is
+ * dropped and counted instead of blocking the traced thread.  The number of
+ * dropped messages is recorded in the trace file as well.
+ *
+ * The trace file is binary, a sequence of Record structs.  It can be
+ * converted into csv format by ConvertToCsv().  Csv output is adapted from
+ * libcsv.
  *
  * This is _not_ supposed to be a debugging system.  It is optimized for
  * speed and does not try to gather any additional information (like
  * threadid, status of variables, etc.) and it's in no way "intelligent".
  * But -- most importantly -- if the thing crashes, all messages in the
- * ring buffer go to hell as well.
- *
- * Csv output is adapted from libcsv.
+ * ring buffers go to hell as well.
  *
  * \todo Currently, if anything goes wrong, the whole thing breaks
  *       down on assertion.  This might be not desired behavior.
@@ -25,11 +29,14 @@
 #include <pthread.h>
 #include <sys/time.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <string>
+#include <vector>
 
 #include "atomic.h"
 #include "util.h"
@@ -39,63 +46,52 @@ using namespace std;  // NOLINT
 namespace tracer {
 
 /**
- * Contents of a trace line.
- * TODO(jblomer): memory alignment
+ * Single-producer, single-consumer ring buffer of a tracing thread.  Only the
+ * owning thread advances head, only the flush thread advances tail.  Both
+ * are ever increasing counters that wrap at 2^32.  The ring has a power of 2
+ * number of slots, so that the position in the ring (counter & ring_mask_)
+ * stays contiguous across the wrap-around.
  */
-struct BufferEntry {
+struct ThreadBuffer {
+  Record *ring;
+  atomic_int32 head;  /**< Next record to be written by the owning thread */
+  atomic_int32 tail;  /**< Next record to be written to the trace file */
   /**
-   * This is currently with milliseconds precision (using gettimeofday).
+   * Set when the owning thread terminates.  The flush thread frees the buffer
+   * once it is drained.
    */
-  timeval time_stamp;
-  /**
-   * arbitrary code, negative codes are reserved for internal use.
-   */
-  int code;
-  PathString path;  /**< The path that is subject to the trace */
-  std::string msg;
-};
-
-struct FlushThreadStartData {
-  pthread_cond_t *sig_flush;
-  pthread_cond_t *sig_continue_trace;
-  BufferEntry *ring_buffer;
-  atomic_int32 *commit_buffer;
-  atomic_int32 *seq_no;
-  atomic_int32 *flushed;
-  atomic_int32 *terminate;
-  atomic_int32 *flush_immediately;
-  int size;
-  int threshold;
-  string filename;
+  atomic_int32 orphaned;
+  ThreadBuffer *next;
 };
 
 bool active_ = false;
 std::string filename_;
 int buffer_size_;
-int flush_threshold_;
 /**
- * Starts with 0 and gets incremented by each call to trace.  Contains the first
- * non-used sequence number.
+ * Number of ring slots minus one; the number of slots is buffer_size_ rounded
+ * up to the next power of 2
  */
-atomic_int32 seq_no_;
+uint32_t ring_mask_;
+int flush_threshold_;
+pthread_key_t thread_buffer_key_;
 /**
- * Starts with 0 and gets incremented by the flush thread.  Points to the first
- * non-flushed message. flushed <= seq_no holds.
+ * Linked list of all thread buffers.  Only the flush thread and threads
+ * tracing for the first time take the lock.
  */
-atomic_int32 flushed_;
-atomic_int32 terminate_flush_thread_;
-atomic_int32 flush_immediately_;
-BufferEntry *ring_buffer_;
+ThreadBuffer *thread_buffers_;
+pthread_mutex_t lock_thread_buffers_;
+atomic_int64 num_dropped_;
+pthread_t thread_flush_;
 /**
- * Has the same size as the ring buffer.  If a message is actually copied to the
- * ring buffer memory, the respective flag is set to 1.  Flags are reset to 0 by
- * the flush thread.
+ * Protects the flush state below.  Flush() requests a new generation, the
+ * flush thread announces the generation for which it wrote all records.
  */
-atomic_int32 *commit_buffer_;
-pthread_t thread_flush_;
+pthread_mutex_t lock_flush_;
 pthread_cond_t sig_flush_;
-pthread_cond_t sig_continue_trace_;
-pthread_mutex_t sig_continue_trace_mutex_;
+pthread_cond_t sig_flushed_;
+int flush_requested_;
+int flush_completed_;
+bool terminate_flush_thread_;
 
 
 /**
@@ -140,127 +136,187 @@ static int WriteCsvFile(FILE *fp, const string &field) {
 }
 
 
-static void *MainFlush(void *data) {
-  FlushThreadStartData *start_data =
-    reinterpret_cast<FlushThreadStartData *>(data);
-  pthread_mutex_t sig_flush_mutex;
-  int retval;
-  retval = pthread_mutex_init(&sig_flush_mutex, NULL);
-  assert(retval == 0 && "Could not initialize mutex for flush signal");
-  retval = pthread_mutex_lock(&sig_flush_mutex);
-  assert(retval == 0 && "Could not lock mutex for flush signal");
-  FILE *f = fopen(start_data->filename.c_str(), "a");
+static void FillRecord(const int event, const char *path,
+                       const unsigned path_length, const string &msg,
+                       Record *record)
+{
+  timeval now;
+  gettimeofday(&now, NULL);
+  record->time_sec = now.tv_sec;
+  record->time_usec = now.tv_usec;
+  record->code = event;
+  record->path_length = std::min(path_length, kMaxPathLength);
+  memcpy(record->path, path, record->path_length);
+  record->msg_length =
+    std::min(static_cast<unsigned>(msg.length()), kMaxMsgLength);
+  memcpy(record->msg, msg.data(), record->msg_length);
+}
+
+
+static bool CompareRecords(const Record &a, const Record &b) {
+  if (a.time_sec != b.time_sec)
+    return a.time_sec < b.time_sec;
+  return a.time_usec < b.time_usec;
+}
+
+
+static void OrphanThreadBuffer(void *data) {
+  ThreadBuffer *buffer = reinterpret_cast<ThreadBuffer *>(data);
+  atomic_inc32(&buffer->orphaned);
+}
+
+
+static ThreadBuffer *GetThreadBuffer() {
+  ThreadBuffer *buffer = reinterpret_cast<ThreadBuffer *>(
+    pthread_getspecific(thread_buffer_key_));
+  if (buffer != NULL)
+    return buffer;
+
+  buffer = new ThreadBuffer();
+  buffer->ring = new Record[ring_mask_ + 1];
+  atomic_init32(&buffer->head);
+  atomic_init32(&buffer->tail);
+  atomic_init32(&buffer->orphaned);
+  int retval = pthread_setspecific(thread_buffer_key_, buffer);
+  assert(retval == 0 && "Could not register trace buffer");
+  pthread_mutex_lock(&lock_thread_buffers_);
+  buffer->next = thread_buffers_;
+  thread_buffers_ = buffer;
+  pthread_mutex_unlock(&lock_thread_buffers_);
+  return buffer;
+}
+
+
+/**
+ * Moves all committed records of all thread buffers into batch and frees
+ * drained buffers of terminated threads.
+ */
+static void CollectRecords(vector<Record> *batch) {
+  pthread_mutex_lock(&lock_thread_buffers_);
+  ThreadBuffer **link = &thread_buffers_;
+  while (*link != NULL) {
+    ThreadBuffer *buffer = *link;
+    // Read before head: no more records after the thread terminated
+    const bool orphaned = atomic_read32(&buffer->orphaned) != 0;
+    const uint32_t head = atomic_read32(&buffer->head);
+    const uint32_t tail = atomic_read32(&buffer->tail);
+    for (uint32_t i = tail; i != head; ++i)
+      batch->push_back(buffer->ring[i & ring_mask_]);
+    atomic_xadd32(&buffer->tail, head - tail);
+
+    if (orphaned) {
+      *link = buffer->next;
+      delete[] buffer->ring;
+      delete buffer;
+    } else {
+      link = &buffer->next;
+    }
+  }
+  pthread_mutex_unlock(&lock_thread_buffers_);
+}
+
+
+static void *MainFlush(void *data __attribute__((unused))) {
+  FILE *f = fopen(filename_.c_str(), "a");
   assert(f != NULL && "Could not open trace file");
+  vector<Record> batch;
+  int64_t num_dropped_reported = 0;
   struct timespec timeout;
+  int retval;
 
-  do {
-    while ((atomic_read32(start_data->terminate) == 0) &&
-           (atomic_read32(start_data->flush_immediately) == 0) &&
-           (atomic_read32(start_data->seq_no) -
-              atomic_read32(start_data->flushed)
-              <= start_data->threshold))
-    {
+  pthread_mutex_lock(&lock_flush_);
+  while (true) {
+    if (!terminate_flush_thread_ && (flush_requested_ == flush_completed_)) {
       GetTimespecRel(2000, &timeout);
-      retval = pthread_cond_timedwait(start_data->sig_flush,
-                                      &sig_flush_mutex, &timeout);
+      retval = pthread_cond_timedwait(&sig_flush_, &lock_flush_, &timeout);
       assert(retval != EINVAL && "Error while waiting on flush signal");
     }
-
-    int base = atomic_read32(start_data->flushed) % start_data->size;
-    int pos, i = 0;
-    while ((i <= start_data->threshold) &&
-           (atomic_read32(&start_data->commit_buffer[
-             pos = ((base + i) % start_data->size)]) == 1))
-    {
-      string tmp;
-      tmp = StringifyTimeval(start_data->ring_buffer[pos].time_stamp);
-      retval = WriteCsvFile(f, tmp);
-      retval |= fputc(',', f) - ',';
-      tmp = StringifyInt(start_data->ring_buffer[pos].code);
-      retval = WriteCsvFile(f, tmp);
-      retval |= fputc(',', f) - ',';
-      retval |= WriteCsvFile(f, start_data->ring_buffer[pos].path.ToString());
-      retval |= fputc(',', f) - ',';
-      retval |= WriteCsvFile(f, start_data->ring_buffer[pos].msg);
-      retval |= (fputc(13, f) - 13) | (fputc(10, f) - 10);
+    const int generation = flush_requested_;
+    const bool terminate = terminate_flush_thread_;
+    pthread_mutex_unlock(&lock_flush_);
+
+    batch.clear();
+    CollectRecords(&batch);
+    const int64_t num_dropped = atomic_read64(&num_dropped_);
+    if (num_dropped > num_dropped_reported) {
+      Record record;
+      const string msg = StringifyInt(num_dropped - num_dropped_reported) +
+                         " records dropped";
+      FillRecord(-4, "Tracer", 6, msg, &record);
+      batch.push_back(record);
+      num_dropped_reported = num_dropped;
+    }
+    std::stable_sort(batch.begin(), batch.end(), CompareRecords);
+    if (!batch.empty()) {
+      retval = (fwrite(&batch[0], sizeof(Record), batch.size(), f) !=
+                batch.size());
       retval |= fflush(f);
       assert(retval == 0 && "Error while writing into trace file");
-
-      atomic_dec32(&start_data->commit_buffer[pos]);
-      ++i;
     }
-    atomic_xadd32(start_data->flushed, i);
-    atomic_cas32(start_data->flush_immediately, 1, 0);
 
-    retval = pthread_cond_broadcast(start_data->sig_continue_trace);
-    assert(retval == 0 && "Could not signal trace threads");
-  } while ((atomic_read32(start_data->terminate) == 0) ||
-           (atomic_read32(start_data->flushed) <
-             atomic_read32(start_data->seq_no)));
+    pthread_mutex_lock(&lock_flush_);
+    flush_completed_ = generation;
+    retval = pthread_cond_broadcast(&sig_flushed_);
+    assert(retval == 0 && "Could not signal flushing threads");
+    if (terminate)
+      break;
+  }
+  pthread_mutex_unlock(&lock_flush_);
 
   retval = fclose(f);
   assert(retval == 0 && "Could not gracefully close trace file");
-  pthread_mutex_unlock(&sig_flush_mutex);
-  retval = pthread_mutex_destroy(&sig_flush_mutex);
-  assert(retval == 0 && "Could not gracefully destroy mutex for flush signal");
-  delete start_data;
   return NULL;
 }
 
 /**
  * Initialize module and spawns the helper thread for flushing.
  * @param[in] buffer_size The number of messages that are kept at maximum in the
- *            internal ring buffer.
+ *            ring buffer of every tracing thread.
  * @param[in] flush_threshold Threshold for the flushing thread.  Messages are
- *            flushed when more then t+1 messages are pending in the ring
- *            buffer. 0 <= flush_threshold < buffer_size must hold.
+ *            flushed when a thread has more than t messages pending in its
+ *            ring buffer, and every 2 seconds.
+ *            0 < flush_threshold < buffer_size must hold.
  * @param[in] filename File name of the trace log on the disk.  The file will
  *            be opened in 'a' mode, i.e. messages are appended.
  */
 void Init(const int buffer_size, const int flush_threshold,
           const string &filename)
 {
-  active_ = true;
   filename_ = filename;
   buffer_size_ = buffer_size;
   flush_threshold_ = flush_threshold;
   assert(buffer_size_ > 1 && "Invalid size");
-  assert(0 <= flush_threshold_ && flush_threshold_ < buffer_size_ &&
+  assert(0 < flush_threshold_ && flush_threshold_ < buffer_size_ &&
          "Invalid threshold");
-
-  atomic_init32(&seq_no_);
-  atomic_init32(&flushed_);
-  atomic_init32(&terminate_flush_thread_);
-  atomic_init32(&flush_immediately_);
-  ring_buffer_ = new BufferEntry[buffer_size_];
-  commit_buffer_ = new atomic_int32[buffer_size_];
-  for (int i = 0; i < buffer_size_; i++)
-    atomic_init32(&commit_buffer_[i]);
+  ring_mask_ = buffer_size_ - 1;
+  ring_mask_ |= ring_mask_ >> 1;
+  ring_mask_ |= ring_mask_ >> 2;
+  ring_mask_ |= ring_mask_ >> 4;
+  ring_mask_ |= ring_mask_ >> 8;
+  ring_mask_ |= ring_mask_ >> 16;
+
+  thread_buffers_ = NULL;
+  atomic_init64(&num_dropped_);
+  flush_requested_ = 0;
+  flush_completed_ = 0;
+  terminate_flush_thread_ = false;
 
   int retval;
-  retval = pthread_cond_init(&sig_continue_trace_, NULL);
-  assert(retval == 0 && "Could not create continue-trace signal");
-  retval = pthread_mutex_init(&sig_continue_trace_mutex_, NULL);
-  assert(retval == 0 && "Could not create mutex for continue-trace signal");
+  retval = pthread_key_create(&thread_buffer_key_, OrphanThreadBuffer);
+  assert(retval == 0 && "Could not create trace buffer key");
+  retval = pthread_mutex_init(&lock_thread_buffers_, NULL);
+  assert(retval == 0 && "Could not create mutex for trace buffers");
+  retval = pthread_mutex_init(&lock_flush_, NULL);
+  assert(retval == 0 && "Could not create mutex for flush signal");
   retval = pthread_cond_init(&sig_flush_, NULL);
   assert(retval == 0 && "Could not create flush signal");
+  retval = pthread_cond_init(&sig_flushed_, NULL);
+  assert(retval == 0 && "Could not create flushed signal");
 
-  FlushThreadStartData *start_data = new FlushThreadStartData;
-  start_data->sig_flush = &sig_flush_;
-  start_data->sig_continue_trace = &sig_continue_trace_;
-  start_data->ring_buffer = ring_buffer_;
-  start_data->commit_buffer = commit_buffer_;
-  start_data->seq_no = &seq_no_;
-  start_data->flushed = &flushed_;
-  start_data->terminate = &terminate_flush_thread_;
-  start_data->flush_immediately = &flush_immediately_;
-  start_data->size = buffer_size_;
-  start_data->threshold = flush_threshold_;
-  start_data->filename = filename_;
-  retval = pthread_create(&thread_flush_, NULL, MainFlush,
-                          reinterpret_cast<void *> (start_data));
+  retval = pthread_create(&thread_flush_, NULL, MainFlush, NULL);
   assert(retval == 0 && "Could not create flush thread");
 
+  active_ = true;
   TraceInternal(-1, PathString("Tracer", 6), "Trace buffer created");
 }
 
@@ -275,113 +331,162 @@ void InitNull() {
 
 /**
  * Destroys everything and terminates the flush thread.  Flushes
- * all pending messages from the ring buffer.  Be sure that all trace
+ * all pending messages from the ring buffers.  Be sure that all trace
  * functions have returned before destroying.
  */
 void Fini() {
   if (!active_) return;
 
   TraceInternal(-2, PathString("Tracer", 6), "Destroying trace buffer...");
+  active_ = false;
 
   // Trigger flushing and wait for it
   int retval;
-  atomic_inc32(&terminate_flush_thread_);
+  pthread_mutex_lock(&lock_flush_);
+  terminate_flush_thread_ = true;
   retval = pthread_cond_signal(&sig_flush_);
   assert(retval == 0 && "Could not signal flush thread");
+  pthread_mutex_unlock(&lock_flush_);
   retval = pthread_join(thread_flush_, NULL);
   assert(retval == 0 && "Flush thread not gracefully terminated");
 
-  retval = pthread_cond_destroy(&sig_continue_trace_);
-  assert(retval == 0 && "Continue-trace signal could not be destroyed");
-  retval = pthread_mutex_destroy(&sig_continue_trace_mutex_);
-  assert(retval == 0 &&
-         "Mutex for continue-trace signal could not be destroyed");
+  // No more orphan callbacks from terminating threads
+  retval = pthread_key_delete(thread_buffer_key_);
+  assert(retval == 0 && "Trace buffer key could not be deleted");
+  while (thread_buffers_ != NULL) {
+    ThreadBuffer *buffer = thread_buffers_;
+    thread_buffers_ = buffer->next;
+    delete[] buffer->ring;
+    delete buffer;
+  }
+
+  retval = pthread_cond_destroy(&sig_flushed_);
+  assert(retval == 0 && "Flushed signal could not be destroyed");
   retval = pthread_cond_destroy(&sig_flush_);
   assert(retval == 0 && "Flush signal could not be destroyed");
-
-  delete[] ring_buffer_;
-  delete[] commit_buffer_;
+  retval = pthread_mutex_destroy(&lock_flush_);
+  assert(retval == 0 && "Mutex for flush signal could not be destroyed");
+  retval = pthread_mutex_destroy(&lock_thread_buffers_);
+  assert(retval == 0 && "Mutex for trace buffers could not be destroyed");
 }
 
 
 /**
- * Trace a message.  This is usually a lock-free procedure that just
- * requires two fetch_and_add operations and a gettimeofday syscall.
- * There are two exceptions:
- *   -# If the ring buffer is full, the function blocks until the flush
- *      thread made some space.  Avoid that by carefully choosing size
- *      and threshold.
+ * Trace a message.  This is a lock-free procedure that copies the message
+ * into the ring buffer of the calling thread and requires a gettimeofday
+ * syscall.  There are two exceptions:
+ *   -# The first message of a thread registers the thread's ring buffer.
  *   -# If this message reaches the threshold, the flush thread gets
  *      signaled.
+ * If the ring buffer is full, the message is dropped.
  *
  * \param[in] event Arbitrary code, for consistency applications should use one
  *            of the TraceEvents constants. Negative codes are reserved
  *            for internal use.
  * \param[in] id Arbitrary id, for example file name or module name which is
  *            doing the trace.
- * \return The sequence number which was used to trace the record
+ * \return False if the message was dropped
  */
-int32_t TraceInternal(const int event, const PathString &path,
-                      const string &msg)
+bool TraceInternal(const int event, const PathString &path,
+                   const string &msg)
 {
-  int32_t my_seq_no = atomic_xadd32(&seq_no_, 1);
-  timeval now;
-  gettimeofday(&now, NULL);
-  int pos = my_seq_no % buffer_size_;
-
-  while (my_seq_no - atomic_read32(&flushed_) >= buffer_size_) {
-    timespec timeout;
-    int retval;
-    GetTimespecRel(25, &timeout);
-    retval = pthread_mutex_lock(&sig_continue_trace_mutex_);
-    retval |= pthread_cond_timedwait(&sig_continue_trace_,
-                                     &sig_continue_trace_mutex_, &timeout);
-    retval |= pthread_mutex_unlock(&sig_continue_trace_mutex_);
-    assert((retval == ETIMEDOUT || retval == 0) &&
-           "Error while waiting to continue tracing");
+  ThreadBuffer *buffer = GetThreadBuffer();
+  const uint32_t head = atomic_read32(&buffer->head);
+  const uint32_t pending = head - atomic_read32(&buffer->tail);
+  if (pending >= static_cast<uint32_t>(buffer_size_)) {
+    atomic_inc64(&num_dropped_);
+    return false;
   }
 
-  ring_buffer_[pos].time_stamp = now;
-  ring_buffer_[pos].code = event;
-  ring_buffer_[pos].path = path;
-  ring_buffer_[pos].msg = msg;
-  atomic_inc32(&commit_buffer_[pos]);
+  FillRecord(event, path.GetChars(), path.GetLength(), msg,
+             &buffer->ring[head & ring_mask_]);
+  // Publishes the record to the flush thread
+  atomic_inc32(&buffer->head);
 
-  if (my_seq_no - atomic_read32(&flushed_) == flush_threshold_) {
+  if (pending + 1 == static_cast<uint32_t>(flush_threshold_)) {
     int err_code __attribute__((unused)) = pthread_cond_signal(&sig_flush_);
     assert(err_code == 0 && "Could not signal flush thread");
   }
 
-  return my_seq_no;
+  return true;
 }
 
 
 /**
- * Flushes the ring buffer immediately at least up to the current seq_no.
- * It blocks until the flush thread finished the work.  It does not
- * affect further tracing during its execution.
+ * Flushes the ring buffers immediately, at least up to the messages traced
+ * before the call.  It blocks until the flush thread finished the work.  It
+ * does not affect further tracing during its execution.
  */
 void Flush() {
   if (!active_) return;
 
-  int32_t save_seq_no = TraceInternal(-3, PathString("Tracer", 6),
-                                      "flushed ring buffer");
-  while (atomic_read32(&flushed_) <= save_seq_no) {
-    timespec timeout;
-    int retval;
-
-    atomic_cas32(&flush_immediately_, 0, 1);
-    retval = pthread_cond_signal(&sig_flush_);
-    assert(retval == 0 && "Could not signal flush thread");
-
-    GetTimespecRel(250, &timeout);
-    retval = pthread_mutex_lock(&sig_continue_trace_mutex_);
-    retval |= pthread_cond_timedwait(&sig_continue_trace_,
-                                       &sig_continue_trace_mutex_, &timeout);
-    retval |= pthread_mutex_unlock(&sig_continue_trace_mutex_);
-    assert((retval == ETIMEDOUT || retval == 0) &&
-           "Error while waiting in flush ()");
+  TraceInternal(-3, PathString("Tracer", 6), "flushed ring buffer");
+  int retval;
+  pthread_mutex_lock(&lock_flush_);
+  const int generation = ++flush_requested_;
+  retval = pthread_cond_signal(&sig_flush_);
+  assert(retval == 0 && "Could not signal flush thread");
+  while (flush_completed_ - generation < 0) {
+    retval = pthread_cond_wait(&sig_flushed_, &lock_flush_);
+    assert(retval == 0 && "Error while waiting in flush ()");
+  }
+  pthread_mutex_unlock(&lock_flush_);
+}
+
+
+/**
+ * Number of messages that were dropped because of full ring buffers.
+ */
+int64_t GetNumDropped() {
+  if (!active_) return 0;
+  return atomic_read64(&num_dropped_);
+}
+
+
+/**
+ * Converts a binary trace file into csv format (time stamp, code, path,
+ * message).
+ */
+bool ConvertToCsv(const string &trace_file, const string &csv_file) {
+  FILE *fin = fopen(trace_file.c_str(), "r");
+  if (fin == NULL)
+    return false;
+  FILE *fout = fopen(csv_file.c_str(), "w");
+  if (fout == NULL) {
+    fclose(fin);
+    return false;
+  }
+
+  Record record;
+  size_t nbytes;
+  int retval = 0;
+  while ((nbytes = fread(&record, 1, sizeof(record), fin)) == sizeof(record))
+  {
+    if ((record.path_length > kMaxPathLength) ||
+        (record.msg_length > kMaxMsgLength))
+    {
+      retval = -1;
+      break;
+    }
+    timeval time_stamp;
+    time_stamp.tv_sec = record.time_sec;
+    time_stamp.tv_usec = record.time_usec;
+    retval |= WriteCsvFile(fout, StringifyTimeval(time_stamp));
+    retval |= fputc(',', fout) - ',';
+    retval |= WriteCsvFile(fout, StringifyInt(record.code));
+    retval |= fputc(',', fout) - ',';
+    retval |= WriteCsvFile(fout, string(record.path, record.path_length));
+    retval |= fputc(',', fout) - ',';
+    retval |= WriteCsvFile(fout, string(record.msg, record.msg_length));
+    retval |= (fputc(13, fout) - 13) | (fputc(10, fout) - 10);
+    if (retval != 0)
+      break;
   }
+  // A truncated record at the end of the file is an error
+  const bool result = (retval == 0) && (nbytes == 0) && !ferror(fin);
+  fclose(fin);
+  retval = fclose(fout);
+  return result && (retval == 0);
 }
 
 }  // namespace tracer
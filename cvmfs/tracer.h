@@ -5,6 +5,8 @@
 #ifndef CVMFS_TRACER_H_
 #define CVMFS_TRACER_H_ 1
 
+#include <stdint.h>
+
 #include <string>
 
 #include "atomic.h"
@@ -25,15 +27,39 @@ enum TraceEvents {
   kFuseCrowd,
 };
 
+/**
+ * Size of the fixed-length strings in a trace record.  Longer paths and
+ * messages are truncated.
+ */
+const unsigned kMaxPathLength = 200;
+const unsigned kMaxMsgLength = 36;
+
+/**
+ * A binary trace record as it is stored in the trace file.
+ */
+struct Record {
+  int64_t time_sec;
+  int32_t time_usec;
+  /**
+   * arbitrary code, negative codes are reserved for internal use.
+   */
+  int32_t code;
+  uint16_t path_length;
+  uint16_t msg_length;
+  char path[kMaxPathLength];
+  char msg[kMaxMsgLength];
+};
+
 
 void Init(const int buffer_size, const int flush_threshold,
           const std::string &tracefile);
 void InitNull();
 void Fini();
 
-int32_t TraceInternal(const int event, const PathString &path,
-                      const std::string &msg);
+bool TraceInternal(const int event, const PathString &path,
+                   const std::string &msg);
 void Flush();
+int64_t GetNumDropped();
 void inline __attribute__((used)) Trace(const int event, const PathString &path,
                                         const std::string &msg)
 {
@@ -42,6 +68,8 @@ void inline __attribute__((used)) Trace(const int event, const PathString &path,
   if (active_) TraceInternal(event, path, msg);
 }
 
+bool ConvertToCsv(const std::string &trace_file, const std::string &csv_file);
+
 }  // namespace tracer
 
 #endif  // CVMFS_TRACER_H_
@@ -105,4 +105,24 @@ unsigned int Spooler::GetNumberOfErrors() const {
   return uploader_->GetNumberOfErrors();
 }
 
+
+uint64_t Spooler::GetNumSkippedBytes() const {
+  return file_processor_->GetNumSkippedBytes();
+}
+
+
+uint64_t Spooler::GetNumAvoidedUploads() const {
+  return uploader_->GetNumAvoidedUploads();
+}
+
+
+uint64_t Spooler::GetNumAvoidedBytes() const {
+  return uploader_->GetNumAvoidedBytes();
+}
+
+
+CharBufferPool::Counters Spooler::GetBufferPoolCounters() const {
+  return file_processor_->GetBufferPoolCounters();
+}
+
 }  // namespace upload
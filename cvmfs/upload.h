@@ -209,6 +209,26 @@ class Spooler : public Observable<SpoolerResult> {
    */
   unsigned int GetNumberOfErrors() const;
 
+  /**
+   * Number of bytes of processed files that were neither compressed nor
+   * uploaded because their content was found in the hash cache.
+   *
+   * @return   the number of skipped bytes at the time this method is invoked
+   */
+  uint64_t GetNumSkippedBytes() const;
+
+  /**
+   * Number of objects and their bytes that were not uploaded because they
+   * were found in the existence filter.
+   */
+  uint64_t GetNumAvoidedUploads() const;
+  uint64_t GetNumAvoidedBytes() const;
+
+  /**
+   * Allocation statistics of the data buffers used for file processing.
+   */
+  CharBufferPool::Counters GetBufferPoolCounters() const;
+
   shash::Algorithms GetHashAlgorithm() const {
     return spooler_definition_.hash_algorithm;
   }
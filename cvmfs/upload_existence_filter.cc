@@ -0,0 +1,126 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "upload_existence_filter.h"
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+
+#include "logging.h"
+#include "murmur.h"
+
+using namespace std;  // NOLINT
+
+namespace upload {
+
+ExistenceFilter *ExistenceFilter::Create(const uint64_t num_bits) {
+  assert(num_bits > 0);
+  return new ExistenceFilter(num_bits);
+}
+
+
+/**
+ * @return  NULL if the file does not exist or is not a valid filter
+ */
+ExistenceFilter *ExistenceFilter::Load(const string &path) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (f == NULL)
+    return NULL;
+
+  Header header;
+  if ((fread(&header, sizeof(header), 1, f) != 1) ||
+      (header.magic != kMagic) || (header.version != kVersion) ||
+      (header.num_bits == 0))
+  {
+    LogCvmfs(kLogSpooler, kLogStderr, "invalid existence filter %s",
+             path.c_str());
+    fclose(f);
+    return NULL;
+  }
+
+  ExistenceFilter *filter = new ExistenceFilter(header.num_bits);
+  const size_t num_words = filter->words_.size();
+  if (fread(&filter->words_[0], sizeof(uint64_t), num_words, f) != num_words) {
+    LogCvmfs(kLogSpooler, kLogStderr, "truncated existence filter %s",
+             path.c_str());
+    fclose(f);
+    delete filter;
+    return NULL;
+  }
+  fclose(f);
+  filter->num_objects_ = header.num_objects;
+  return filter;
+}
+
+
+/**
+ * Atomic store.
+ */
+bool ExistenceFilter::Save(const string &path) const {
+  string tmp_path;
+  FILE *f = CreateTempFile(path, 0644, "w", &tmp_path);
+  if (f == NULL)
+    return false;
+
+  Header header;
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.num_bits = num_bits_;
+  header.num_objects = num_objects_;
+  bool retval =
+    (fwrite(&header, sizeof(header), 1, f) == 1) &&
+    (fwrite(&words_[0], sizeof(uint64_t), words_.size(), f) == words_.size());
+  retval = (fclose(f) == 0) && retval;
+  if (!retval || (rename(tmp_path.c_str(), path.c_str()) != 0)) {
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+
+ExistenceFilter::ExistenceFilter(const uint64_t num_bits)
+  : num_bits_(num_bits)
+  , num_objects_(0)
+  , words_((num_bits + 63) / 64, 0)
+{ }
+
+
+/**
+ * Double hashing: the k bit positions are h1 + i*h2 for i = 0..k-1.
+ */
+void ExistenceFilter::GetPositions(const string &object_path,
+                                   uint64_t *positions) const
+{
+  const uint64_t h1 =
+    MurmurHash64A(object_path.data(), object_path.length(), 0x9ae16a3b);
+  const uint64_t h2 =
+    MurmurHash64A(object_path.data(), object_path.length(), 0x2f693a5c) | 1;
+  for (unsigned i = 0; i < kNumHashFunctions; ++i)
+    positions[i] = (h1 + i * h2) % num_bits_;
+}
+
+
+void ExistenceFilter::Add(const string &object_path) {
+  uint64_t positions[kNumHashFunctions];
+  GetPositions(object_path, positions);
+  for (unsigned i = 0; i < kNumHashFunctions; ++i)
+    words_[positions[i] / 64] |= uint64_t(1) << (positions[i] % 64);
+  num_objects_++;
+}
+
+
+bool ExistenceFilter::MayContain(const string &object_path) const {
+  uint64_t positions[kNumHashFunctions];
+  GetPositions(object_path, positions);
+  for (unsigned i = 0; i < kNumHashFunctions; ++i) {
+    if ((words_[positions[i] / 64] & (uint64_t(1) << (positions[i] % 64))) == 0)
+      return false;
+  }
+  return true;
+}
+
+}  // namespace upload
@@ -0,0 +1,69 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_UPLOAD_EXISTENCE_FILTER_H_
+#define CVMFS_UPLOAD_EXISTENCE_FILTER_H_
+
+#include <inttypes.h>
+
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+namespace upload {
+
+/**
+ * A Bloom filter of the backend paths (e.g. data/ab/cdef...) of objects that
+ * are known to be stored in the backend storage.  The uploaders consult the
+ * filter before they commit a streamed upload and skip objects that are
+ * already there.  The filter is kept on the release manager machine between
+ * publish runs.
+ *
+ * The filter has no false negatives but a small rate of false positives.  Also
+ * objects removed by garbage collection remain in the filter.  Therefore hits
+ * are normally verified against the backend storage.
+ *
+ * Not thread-safe, the filter is used by the uploader's worker thread only.
+ */
+class ExistenceFilter : SingleCopy {
+ public:
+  /**
+   * 16 MB, about 1% false positives for 14 million objects
+   */
+  static const uint64_t kDefaultNumBits = uint64_t(1) << 27;
+  static const unsigned kNumHashFunctions = 7;
+
+  static ExistenceFilter *Create(const uint64_t num_bits = kDefaultNumBits);
+  static ExistenceFilter *Load(const std::string &path);
+  bool Save(const std::string &path) const;
+
+  void Add(const std::string &object_path);
+  bool MayContain(const std::string &object_path) const;
+
+  uint64_t num_bits() const { return num_bits_; }
+  uint64_t num_objects() const { return num_objects_; }
+
+ private:
+  static const uint32_t kMagic = 0x46455643;  // "CVEF"
+  static const uint32_t kVersion = 1;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_bits;
+    uint64_t num_objects;
+  };
+
+  explicit ExistenceFilter(const uint64_t num_bits);
+  void GetPositions(const std::string &object_path, uint64_t *positions) const;
+
+  uint64_t num_bits_;
+  uint64_t num_objects_;  ///< Number of additions, including duplicates
+  std::vector<uint64_t> words_;
+};
+
+}  // namespace upload
+
+#endif  // CVMFS_UPLOAD_EXISTENCE_FILTER_H_
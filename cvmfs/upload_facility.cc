@@ -2,8 +2,16 @@
  * This file is part of the CernVM File System.
  */
 
+#define __STDC_FORMAT_MACROS
+
 #include "upload_facility.h"
 
+#include <inttypes.h>
+
+#include <string>
+
+#include "logging.h"
+#include "upload_existence_filter.h"
 #include "upload_local.h"
 #include "upload_s3.h"
 #include "util.h"
@@ -19,10 +27,31 @@ void AbstractUploader::RegisterPlugins() {
 AbstractUploader::AbstractUploader(const SpoolerDefinition& spooler_definition)
   : spooler_definition_(spooler_definition)
   , torn_down_(false)
-  , jobs_in_flight_(spooler_definition.number_of_concurrent_uploads) { }
+  , existence_filter_(NULL)
+  , pending_removals_(NULL)
+  , removes_in_flight_(2 * spooler_definition.number_of_concurrent_removals)
+  , jobs_in_flight_(spooler_definition.number_of_concurrent_uploads)
+{
+  atomic_init64(&num_avoided_uploads_);
+  atomic_init64(&num_avoided_bytes_);
+  atomic_init64(&num_removed_objects_);
+  atomic_init64(&num_failed_removals_);
+}
 
 
 bool AbstractUploader::Initialize() {
+  const std::string &filter_path = spooler_definition_.existence_filter_path;
+  if (!filter_path.empty()) {
+    existence_filter_ = ExistenceFilter::Load(filter_path);
+    if (existence_filter_ == NULL) {
+      existence_filter_ = ExistenceFilter::Create();
+      SeedExistenceFilter(existence_filter_);
+      LogCvmfs(kLogSpooler, kLogVerboseMsg, "created existence filter %s "
+               "with %"PRIu64" objects",
+               filter_path.c_str(), existence_filter_->num_objects());
+    }
+  }
+
   // late initialization of the writer_thread_ field. This is necessary, since
   // AbstractUploader::WriteThread is pure virtual and relies on a concrete sub-
   // class being initialized before the writer_thread_ starts running
@@ -45,9 +74,55 @@ bool AbstractUploader::Initialize() {
 
 void AbstractUploader::TearDown() {
   assert(!torn_down_);
+  // Removals might be completed by the worker thread, so they are finished
+  // first
+  if (!remove_threads_.empty()) {
+    WaitForRemove();
+    for (unsigned i = 0; i < remove_threads_.size(); ++i)
+      remove_queue_.push(NULL);
+    for (unsigned i = 0; i < remove_threads_.size(); ++i) {
+      remove_threads_[i]->join();
+      delete remove_threads_[i];
+    }
+    remove_threads_.clear();
+  }
+  delete pending_removals_;
+  pending_removals_ = NULL;
+
   upload_queue_.push(UploadJob());  // Termination signal
   writer_thread_.join();
   torn_down_ = true;
+
+  if (existence_filter_ != NULL) {
+    // Objects of failed uploads might have been registered already
+    if ((GetNumberOfErrors() == 0) &&
+        !existence_filter_->Save(spooler_definition_.existence_filter_path))
+    {
+      LogCvmfs(kLogSpooler, kLogStderr, "failed to save existence filter %s",
+               spooler_definition_.existence_filter_path.c_str());
+    }
+    delete existence_filter_;
+    existence_filter_ = NULL;
+  }
+}
+
+
+AbstractUploader::ObjectExistence AbstractUploader::LookupObject(
+  const std::string &remote_path) const
+{
+  if ((existence_filter_ == NULL) ||
+      !existence_filter_->MayContain(remote_path))
+  {
+    return kObjectUnknown;
+  }
+  return spooler_definition_.verify_existence_filter_hits ? kObjectProbable
+                                                          : kObjectPresent;
+}
+
+
+void AbstractUploader::RegisterObject(const std::string &remote_path) {
+  if (existence_filter_ != NULL)
+    existence_filter_->Add(remote_path);
 }
 
 
@@ -55,4 +130,67 @@ void AbstractUploader::WaitForUpload() const {
   jobs_in_flight_.WaitForZero();
 }
 
+
+void AbstractUploader::ScheduleRemove(const shash::Any &hash_to_delete) {
+  if (remove_threads_.empty()) {
+    const unsigned num_threads =
+      spooler_definition_.number_of_concurrent_removals;
+    for (unsigned i = 0; i < num_threads; ++i) {
+      remove_threads_.push_back(new tbb::tbb_thread(
+        &ThreadProxy<AbstractUploader>, this, &AbstractUploader::RemoveThread));
+    }
+  }
+
+  if (pending_removals_ == NULL) {
+    pending_removals_ = new RemoveBatchT();
+    pending_removals_->reserve(kRemoveBatchSize);
+  }
+  pending_removals_->push_back(hash_to_delete);
+  if (pending_removals_->size() >= kRemoveBatchSize)
+    DispatchRemoveBatch();
+}
+
+
+void AbstractUploader::WaitForRemove() {
+  if (pending_removals_ != NULL)
+    DispatchRemoveBatch();
+  removes_in_flight_.WaitForZero();
+}
+
+
+void AbstractUploader::DispatchRemoveBatch() {
+  ++removes_in_flight_;  // blocks if the removal threads fall behind
+  remove_queue_.push(pending_removals_);
+  pending_removals_ = NULL;
+}
+
+
+void AbstractUploader::RemoveThread() {
+  while (true) {
+    RemoveBatchT *batch;
+    remove_queue_.pop(batch);
+    if (batch == NULL)
+      break;
+
+    const unsigned num_failed = RemoveBatch(*batch);
+    atomic_xadd64(&num_removed_objects_, batch->size() - num_failed);
+    atomic_xadd64(&num_failed_removals_, num_failed);
+    delete batch;
+    --removes_in_flight_;
+  }
+}
+
+
+unsigned AbstractUploader::RemoveBatch(const std::vector<shash::Any> &hashes) {
+  unsigned num_failed = 0;
+  for (unsigned i = 0; i < hashes.size(); ++i) {
+    if (!Remove(hashes[i])) {
+      LogCvmfs(kLogSpooler, kLogStderr, "failed to remove %s",
+               hashes[i].ToStringWithSuffix().c_str());
+      ++num_failed;
+    }
+  }
+  return num_failed;
+}
+
 }  // namespace upload
@@ -9,7 +9,9 @@
 #include <tbb/tbb_thread.h>
 
 #include <string>
+#include <vector>
 
+#include "atomic.h"
 #include "upload_spooler_definition.h"
 #include "util.h"
 #include "util_concurrency.h"
@@ -17,6 +19,7 @@
 namespace upload {
 
 class CharBuffer;
+class ExistenceFilter;
 
 struct UploaderResults {
   enum Type {
@@ -225,6 +228,34 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
   }
 
 
+  /**
+   * Schedules the asynchronous removal of an object.  Removals are collected in
+   * batches that are handed to a pool of removal threads (see RemoveBatch()).
+   * The removal threads are started with the first scheduled removal.  Blocks
+   * if too many batches are waiting to be processed.
+   *
+   * Note: This method must not be called concurrently.
+   *
+   * @param hash_to_delete  the content hash of the object to be deleted
+   */
+  void ScheduleRemove(const shash::Any &hash_to_delete);
+
+
+  /**
+   * Hands out the incomplete batch of scheduled removals and waits until all
+   * scheduled removals are done.
+   */
+  void WaitForRemove();
+
+
+  uint64_t GetNumRemovedObjects() const {
+    return atomic_read64(&num_removed_objects_);
+  }
+  uint64_t GetNumFailedRemovals() const {
+    return atomic_read64(&num_failed_removals_);
+  }
+
+
   /**
    * Checks if a file is already present in the backend storage. This might be a
    * synchronous operation.
@@ -247,6 +278,17 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
   virtual unsigned int GetNumberOfErrors() const = 0;
   static void RegisterPlugins();
 
+  /**
+   * Number of objects and their bytes that were not uploaded because they were
+   * found in the existence filter (and, if verified, in the backend storage).
+   */
+  uint64_t GetNumAvoidedUploads() const {
+    return atomic_read64(&num_avoided_uploads_);
+  }
+  uint64_t GetNumAvoidedBytes() const {
+    return atomic_read64(&num_avoided_bytes_);
+  }
+
 
  protected:
   explicit AbstractUploader(const SpoolerDefinition& spooler_definition);
@@ -255,6 +297,48 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
                           const std::string  &remote_path,
                           const CallbackTN   *callback = NULL) = 0;
 
+  enum ObjectExistence {
+    kObjectUnknown,   ///< not in the existence filter (or no filter)
+    kObjectProbable,  ///< in the filter, needs to be checked in the backend
+    kObjectPresent    ///< in the filter, which is trusted
+  };
+
+  /**
+   * Consults the existence filter for an object about to be committed.  Must
+   * only be called from the WorkerThread().
+   *
+   * @param remote_path  the path of the object in the backend storage
+   */
+  ObjectExistence LookupObject(const std::string &remote_path) const;
+
+  /**
+   * Records an object in the existence filter once it is (or is going to be)
+   * stored in the backend.  Must only be called from the WorkerThread().
+   */
+  void RegisterObject(const std::string &remote_path);
+
+  void CountAvoidedUpload(const uint64_t bytes) {
+    atomic_inc64(&num_avoided_uploads_);
+    atomic_xadd64(&num_avoided_bytes_, bytes);
+  }
+
+  /**
+   * Fills a freshly created existence filter with the objects that are
+   * already in the backend storage.  By default, the filter starts empty and
+   * learns about objects from the uploads.
+   */
+  virtual void SeedExistenceFilter(ExistenceFilter *filter) const { }
+
+  /**
+   * Removes a batch of objects.  Called concurrently by the removal threads.
+   * By default, the objects are removed one by one using Remove().  Backends
+   * that can remove several objects in a single request should override this.
+   *
+   * @param hashes  content hashes of the objects to be deleted
+   * @return        the number of objects that could not be removed
+   */
+  virtual unsigned RemoveBatch(const std::vector<shash::Any> &hashes);
+
   /**
    * This notifies the callback that is associated to a finishing job. Please
    * do not call the handed callback yourself in concrete Uploaders!
@@ -319,6 +403,15 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
   virtual void WorkerThread() = 0;
 
 
+  /**
+   * Objects scheduled for removal are handed to the removal threads in batches
+   * of this size, which is also the limit of S3 multi-object deletions.
+   */
+  static const unsigned kRemoveBatchSize = 1000;
+
+  void DispatchRemoveBatch();
+  void RemoveThread();
+
   /**
    * This is the entry point into the worker thread.
    */
@@ -341,6 +434,29 @@ class AbstractUploader : public PolymorphicConstruction<AbstractUploader,
   tbb::tbb_thread                           writer_thread_;
   bool                                      torn_down_;
 
+  /**
+   * NULL if disabled.  Saved in TearDown() unless uploads have failed.
+   */
+  ExistenceFilter                          *existence_filter_;
+  mutable atomic_int64                      num_avoided_uploads_;
+  mutable atomic_int64                      num_avoided_bytes_;
+
+  /**
+   * Removals scheduled by ScheduleRemove().  NULL entries in the queue
+   * terminate the removal threads.
+   */
+  typedef std::vector<shash::Any>                   RemoveBatchT;
+  RemoveBatchT                                     *pending_removals_;
+  tbb::concurrent_bounded_queue<RemoveBatchT *>     remove_queue_;
+  std::vector<tbb::tbb_thread *>                    remove_threads_;
+  /**
+   * Batches handed out and not yet processed, bounded to twice the number of
+   * removal threads
+   */
+  SynchronizingCounter<int32_t>                     removes_in_flight_;
+  mutable atomic_int64                              num_removed_objects_;
+  mutable atomic_int64                              num_failed_removals_;
+
   mutable SynchronizingCounter<int32_t>     jobs_in_flight_;
   Future<bool>                              thread_started_executing_;
 };
@@ -0,0 +1,166 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "upload_hash_cache.h"
+
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "logging.h"
+#include "util_concurrency.h"
+
+using namespace std;  // NOLINT
+
+namespace upload {
+
+const float    HashCacheDatabase::kLatestSchema          = 1.0;
+const float    HashCacheDatabase::kLatestSupportedSchema = 1.0;
+const unsigned HashCacheDatabase::kLatestSchemaRevision  = 0;
+
+
+bool HashCacheDatabase::CreateEmptyDatabase() {
+  assert(read_write());
+  return sqlite::Sql(sqlite_db(),
+    "CREATE TABLE objects (key TEXT, hash TEXT, chunks TEXT, "
+    "  CONSTRAINT pk_objects PRIMARY KEY (key))").Execute();
+}
+
+
+bool HashCacheDatabase::CheckSchemaCompatibility() {
+  return !((schema_version() < kLatestSupportedSchema - kSchemaEpsilon) ||
+           (schema_version() > kLatestSchema          + kSchemaEpsilon));
+}
+
+
+//------------------------------------------------------------------------------
+
+
+/**
+ * Opens the cache database or creates a new one if the file does not exist.
+ */
+HashCache *HashCache::Open(const string &path) {
+  HashCacheDatabase *database = FileExists(path)
+    ? HashCacheDatabase::Open(path, HashCacheDatabase::kOpenReadWrite)
+    : HashCacheDatabase::Create(path);
+  if (database == NULL) {
+    LogCvmfs(kLogSpooler, kLogStderr, "failed to open hash cache %s",
+             path.c_str());
+    return NULL;
+  }
+  if (!database->BeginTransaction()) {
+    LogCvmfs(kLogSpooler, kLogStderr, "failed to open hash cache transaction");
+    delete database;
+    return NULL;
+  }
+  return new HashCache(database);
+}
+
+
+HashCache::HashCache(HashCacheDatabase *database)
+  : database_(database)
+{
+  sql_lookup_ = new sqlite::Sql(database_->sqlite_db(),
+    "SELECT hash, chunks FROM objects WHERE key = :key;");
+  sql_store_ = new sqlite::Sql(database_->sqlite_db(),
+    "INSERT OR REPLACE INTO objects (key, hash, chunks) "
+    "VALUES (:key, :hash, :chunks);");
+  int retval = pthread_mutex_init(&lock_, NULL);
+  assert(retval == 0);
+}
+
+
+HashCache::~HashCache() {
+  delete sql_lookup_;
+  delete sql_store_;
+  if (!database_->CommitTransaction()) {
+    LogCvmfs(kLogSpooler, kLogStderr, "failed to commit hash cache");
+  }
+  delete database_;
+  pthread_mutex_destroy(&lock_);
+}
+
+
+/**
+ * Chunks are stored as a list of offset:size:hash triples, separated by
+ * semicolons.
+ */
+bool HashCache::Lookup(const string &key,
+                       shash::Any *content_hash,
+                       FileChunkList *chunks)
+{
+  MutexLockGuard guard(lock_);
+  bool found = sql_lookup_->BindText(1, key) && sql_lookup_->FetchRow();
+  string hash_str;
+  string chunks_str;
+  if (found) {
+    hash_str = sql_lookup_->RetrieveString(0);
+    chunks_str = sql_lookup_->RetrieveString(1);
+  }
+  sql_lookup_->Reset();
+  if (!found)
+    return false;
+
+  // Chunked files processed without bulk chunk have a null content hash
+  *content_hash = shash::MkFromHexPtr(shash::HexPtr(hash_str));
+  chunks->Clear();
+  if (chunks_str.empty())
+    return !content_hash->IsNull();
+  vector<string> chunk_list = SplitString(chunks_str, ';');
+  for (unsigned i = 0; i < chunk_list.size(); ++i) {
+    vector<string> fields = SplitString(chunk_list[i], ':');
+    if (fields.size() != 3)
+      return false;
+    const shash::Any chunk_hash =
+      shash::MkFromHexPtr(shash::HexPtr(fields[2]), shash::kSuffixPartial);
+    if (chunk_hash.IsNull())
+      return false;
+    chunks->PushBack(FileChunk(chunk_hash,
+                               String2Uint64(fields[0]),
+                               String2Uint64(fields[1])));
+  }
+  return true;
+}
+
+
+bool HashCache::Store(const string &key,
+                      const shash::Any &content_hash,
+                      const FileChunkList &chunks)
+{
+  string chunks_str;
+  for (unsigned i = 0; i < chunks.size(); ++i) {
+    const FileChunk &chunk = *chunks.AtPtr(i);
+    if (i > 0)
+      chunks_str.push_back(';');
+    chunks_str += StringifyInt(chunk.offset()) + ":" +
+                  StringifyInt(chunk.size()) + ":" +
+                  chunk.content_hash().ToString();
+  }
+
+  const string hash_str = content_hash.ToString();
+
+  MutexLockGuard guard(lock_);
+  const bool retval = sql_store_->BindText(1, key) &&
+                      sql_store_->BindText(2, hash_str) &&
+                      sql_store_->BindText(3, chunks_str) &&
+                      sql_store_->Execute();
+  sql_store_->Reset();
+  return retval;
+}
+
+
+/**
+ * Makes the stored entries persistent and starts a new transaction.
+ */
+bool HashCache::Commit() {
+  MutexLockGuard guard(lock_);
+  if (!database_->CommitTransaction()) {
+    LogCvmfs(kLogSpooler, kLogStderr, "failed to commit hash cache");
+    return false;
+  }
+  return database_->BeginTransaction();
+}
+
+}  // namespace upload
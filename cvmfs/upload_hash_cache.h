@@ -0,0 +1,85 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_UPLOAD_HASH_CACHE_H_
+#define CVMFS_UPLOAD_HASH_CACHE_H_
+
+#include <pthread.h>
+
+#include <string>
+
+#include "file_chunk.h"
+#include "hash.h"
+#include "sql.h"
+#include "util.h"
+
+namespace upload {
+
+/**
+ * This class wraps the database structure of the publish hash cache.  For that
+ * it inherits from sqlite::Database<>, please look there for further details.
+ */
+class HashCacheDatabase : public sqlite::Database<HashCacheDatabase> {
+ public:
+  static const float kLatestSchema;
+  static const float kLatestSupportedSchema;
+  // backwards-compatible schema changes
+  static const unsigned kLatestSchemaRevision;
+
+  bool CreateEmptyDatabase();
+  bool CheckSchemaCompatibility();
+  bool LiveSchemaUpgradeIfNecessary() { return true; }
+  bool CompactDatabase() const { return true; }
+
+ protected:
+  friend class sqlite::Database<HashCacheDatabase>;
+  HashCacheDatabase(const std::string  &filename,
+                    const OpenMode      open_mode) :
+    sqlite::Database<HashCacheDatabase>(filename, open_mode) {}
+};
+
+
+/**
+ * A persistent cache on the release manager machine that maps the content of
+ * a file (the hash of the uncompressed data) to the result of processing the
+ * file, i.e. the content hash of the compressed object and the list of file
+ * chunks.  The FileProcessor consults the cache before it schedules a file and
+ * skips compression and upload for content that was published before.
+ *
+ * Changes are collected in a transaction that is committed by Commit() at the
+ * end of every publish and when the cache is destroyed.  Losing the
+ * transaction only loses cache entries.
+ *
+ * Cache hits are not checked against the backend storage.  Garbage collection
+ * removes the cache file (see cvmfs_server), because it might remove objects
+ * that the cache refers to.
+ */
+class HashCache : SingleCopy {
+ public:
+  static HashCache *Open(const std::string &path);
+  ~HashCache();
+
+  bool Lookup(const std::string &key,
+              shash::Any *content_hash,
+              FileChunkList *chunks);
+  bool Store(const std::string &key,
+             const shash::Any &content_hash,
+             const FileChunkList &chunks);
+  bool Commit();
+
+ private:
+  explicit HashCache(HashCacheDatabase *database);
+
+  HashCacheDatabase *database_;
+  sqlite::Sql *sql_lookup_;
+  sqlite::Sql *sql_store_;
+  /**
+   * Lookups come from the spooling thread, stores from the processing threads.
+   */
+  pthread_mutex_t lock_;
+};
+
+}  // namespace upload
+
+#endif  // CVMFS_UPLOAD_HASH_CACHE_H_
@@ -8,10 +8,12 @@
 #include <errno.h>
 
 #include <string>
+#include <vector>
 
 #include "compression.h"
 #include "file_processing/char_buffer.h"
 #include "logging.h"
+#include "upload_existence_filter.h"
 #include "util.h"
 
 
@@ -193,6 +195,20 @@ void LocalUploader::FinalizeStreamedUpload(UploadStreamHandle  *handle,
   }
 
   const std::string final_path = "data/" + content_hash.MakePath();
+  const ObjectExistence existence = LookupObject(final_path);
+  if ((existence == kObjectPresent) ||
+      ((existence == kObjectProbable) && Peek(final_path)))
+  {
+    LogCvmfs(kLogSpooler, kLogVerboseMsg, "object '%s' already stored, "
+                                          "skipping", final_path.c_str());
+    CountAvoidedUpload(GetFileSize(local_handle->temporary_path));
+    unlink(local_handle->temporary_path.c_str());
+    const CallbackTN *callback = handle->commit_callback;
+    delete local_handle;
+    Respond(callback, UploaderResults(0));
+    return;
+  }
+
   retval = Move(local_handle->temporary_path.c_str(), final_path.c_str());
   if (retval != 0) {
     const int cpy_errno = errno;
@@ -205,6 +221,7 @@ void LocalUploader::FinalizeStreamedUpload(UploadStreamHandle  *handle,
     Respond(handle->commit_callback, UploaderResults(cpy_errno));
     return;
   }
+  RegisterObject(final_path);
 
   const CallbackTN *callback = handle->commit_callback;
   delete local_handle;
@@ -224,6 +241,23 @@ bool LocalUploader::Peek(const std::string& path) const {
 }
 
 
+/**
+ * Adds the objects found in the data/00 to data/ff directories.
+ */
+void LocalUploader::SeedExistenceFilter(ExistenceFilter *filter) const {
+  for (unsigned i = 0; i <= 0xff; ++i) {
+    const std::string dir = "data/" + StringifyByteAsHex(i);
+    const std::vector<std::string> objects =
+      FindFiles(upstream_path_ + "/" + dir, "");
+    for (unsigned j = 0; j < objects.size(); ++j) {
+      const std::string name = GetFileName(objects[j]);
+      if (name[0] != '.')
+        filter->Add(dir + "/" + name);
+    }
+  }
+}
+
+
 int LocalUploader::Move(const std::string &local_path,
                         const std::string &remote_path) const {
   const std::string destination_path = upstream_path_ + "/" + remote_path;
@@ -80,6 +80,8 @@ class LocalUploader : public AbstractUploader {
 
   int CreateAndOpenTemporaryChunkFile(std::string *path) const;
 
+  void SeedExistenceFilter(ExistenceFilter *filter) const;
+
  private:
   // state information
   const std::string    upstream_path_;
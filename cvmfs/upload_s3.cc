@@ -11,6 +11,7 @@
 #endif
 #include <unistd.h>
 
+#include <map>
 #include <sstream>  // TODO(jblomer): remove me
 #include <string>
 #include <vector>
@@ -20,12 +21,40 @@
 #include "logging.h"
 #include "options.h"
 #include "s3fanout.h"
+#include "smalloc.h"
 #include "util.h"
 
 namespace upload {
 
+S3StreamHandle::S3StreamHandle(const CallbackTN *commit_callback,
+                               uint64_t *stream_bytes_in_memory)
+  : UploadStreamHandle(commit_callback)
+  , buffer(NULL)
+  , size(0)
+  , capacity(0)
+  , md5_context(shash::kMd5)
+  , file_descriptor(-1)
+  , stream_bytes_in_memory_(stream_bytes_in_memory)
+{
+  md5_context.buffer = smalloc(md5_context.size);
+  shash::Init(md5_context);
+}
+
+
+S3StreamHandle::~S3StreamHandle() {
+  if (buffer != NULL)
+    *stream_bytes_in_memory_ -= capacity;
+  free(buffer);
+  free(md5_context.buffer);
+}
+
+
 S3Uploader::S3Uploader(const SpoolerDefinition &spooler_definition)
     : AbstractUploader(spooler_definition),
+      max_stream_bytes_in_memory_(kDefaultMaxStreamBytesInMemory),
+      stream_bytes_in_memory_(0),
+      multipart_threshold_(kDefaultMultipartThreshold),
+      multipart_part_size_(kDefaultMultipartPartSize),
       temporary_path_(spooler_definition.temporary_path) {
   if (!ParseSpoolerDefinition(spooler_definition)) {
     abort();
@@ -38,6 +67,7 @@ S3Uploader::S3Uploader(const SpoolerDefinition &spooler_definition)
   s3fanout_mgr_.Spawn();
 
   atomic_init32(&copy_errors_);
+  atomic_init32(&multi_delete_unsupported_);
 }
 
 S3Uploader::~S3Uploader() {
@@ -124,6 +154,27 @@ bool S3Uploader::ParseSpoolerDefinition(
     return false;
   }
   max_num_parallel_uploads_ = String2Uint64(parameter);
+  if (options_manager->GetValue("CVMFS_S3_STREAM_BUFFER_LIMIT_MB",
+                                &parameter))
+  {
+    max_stream_bytes_in_memory_ = String2Uint64(parameter) * 1024 * 1024;
+  }
+  if (options_manager->GetValue("CVMFS_S3_MULTIPART_THRESHOLD_MB",
+                                &parameter))
+  {
+    multipart_threshold_ = String2Uint64(parameter) * 1024 * 1024;
+  }
+  if (options_manager->GetValue("CVMFS_S3_MULTIPART_PART_SIZE_MB",
+                                &parameter))
+  {
+    multipart_part_size_ = String2Uint64(parameter) * 1024 * 1024;
+    if (multipart_part_size_ < kMinMultipartPartSize) {
+      LogCvmfs(kLogUploadS3, kLogStderr,
+               "CVMFS_S3_MULTIPART_PART_SIZE_MB must be at least %u",
+               kMinMultipartPartSize / (1024 * 1024));
+      return false;
+    }
+  }
   delete options_manager;
   options_manager = NULL;
 
@@ -203,6 +254,14 @@ void S3Uploader::WorkerThread() {
     for (; it != itend; ++it) {
       // Report completed job
       s3fanout::JobInfo *info = *it;
+      if ((info->request == s3fanout::JobInfo::kReqDelete) ||
+          (info->request == s3fanout::JobInfo::kReqDeleteObjects))
+      {
+        // Owned by a removal thread waiting in RunRemoveJobs()
+        static_cast<SynchronizingCounter<int32_t> *>(info->callback)->
+          Decrement();
+        continue;
+      }
       int reply_code = 0;
       if (info->error_code != s3fanout::kFailOk) {
         LogCvmfs(kLogUploadS3, kLogStderr, "Upload job for '%s' failed. "
@@ -210,7 +269,13 @@ void S3Uploader::WorkerThread() {
                  info->object_key.c_str(), info->error_code,
                  s3fanout::Code2Ascii(info->error_code));
         reply_code = 99;
+      } else if ((info->request == s3fanout::JobInfo::kReqHead) &&
+                 (info->origin == s3fanout::kOriginMem))
+      {
+        // Streamed object found by the existence filter check
+        CountAvoidedUpload(info->origin_mem.size);
       }
+      ReleaseStreamMemory(info);
       if (info->origin == s3fanout::kOriginMem) {
         Respond(static_cast<CallbackTN*>(info->callback),
                 UploaderResults(reply_code));
@@ -379,6 +444,14 @@ void S3Uploader::FileUpload(
 
 
 bool S3Uploader::UploadJobInfo(s3fanout::JobInfo *info) {
+  if (multipart_threshold_ > 0) {
+    const int64_t size = (info->origin == s3fanout::kOriginMem)
+                         ? static_cast<int64_t>(info->origin_mem.size)
+                         : GetFileSize(info->origin_path);
+    if (size >= static_cast<int64_t>(multipart_threshold_))
+      info->part_size = multipart_part_size_;
+  }
+
   LogCvmfs(kLogUploadS3, kLogDebug,
            "Uploading from %s:\n"
            "--> Object: '%s'\n"
@@ -433,21 +506,50 @@ int S3Uploader::CreateAndOpenTemporaryChunkFile(std::string *path) const {
 
 
 UploadStreamHandle *S3Uploader::InitStreamedUpload(const CallbackTN *callback) {
-  std::string tmp_path;
-  const int tmp_fd = CreateAndOpenTemporaryChunkFile(&tmp_path);
+  return new S3StreamHandle(callback, &stream_bytes_in_memory_);
+}
 
-  LogCvmfs(kLogUploadS3, kLogDebug,
-           "InitStreamedUpload: %s", tmp_path.c_str());
 
-  if (tmp_fd < 0) {
-    LogCvmfs(kLogUploadS3, kLogStderr,
-             "Failed to open file (%d), %s",
-             errno, strerror(errno));
+/**
+ * Moves the data collected so far in memory to a temporary file.  Called when
+ * the memory of all streams reaches the limit.
+ */
+bool S3Uploader::SpillStreamToDisk(S3StreamHandle *handle) {
+  assert(!handle->IsSpilled());
+  handle->file_descriptor =
+    CreateAndOpenTemporaryChunkFile(&handle->temporary_path);
+  if (handle->file_descriptor < 0)
+    return false;
 
-    return NULL;
+  LogCvmfs(kLogUploadS3, kLogDebug, "spilling stream of %u bytes to %s",
+           handle->size, handle->temporary_path.c_str());
+  const ssize_t bytes_written =
+    write(handle->file_descriptor, handle->buffer, handle->size);
+  const bool retval = (bytes_written == static_cast<ssize_t>(handle->size));
+  stream_bytes_in_memory_ -= handle->capacity;
+  free(handle->buffer);
+  handle->buffer = NULL;
+  handle->capacity = 0;
+  if (!retval) {
+    LogCvmfs(kLogUploadS3, kLogStderr, "failed to write to '%s' (errno: %d)",
+             handle->temporary_path.c_str(), errno);
+    atomic_inc32(&copy_errors_);
+    return false;
   }
+  return true;
+}
+
 
-  return new S3StreamHandle(callback, tmp_fd, tmp_path);
+/**
+ * Frees the stream memory of a completed job.
+ */
+void S3Uploader::ReleaseStreamMemory(s3fanout::JobInfo *info) {
+  if (!info->owns_origin_mem)
+    return;
+  stream_bytes_in_memory_ -= info->origin_mem.size;
+  free(const_cast<unsigned char *>(info->origin_mem.data));
+  info->origin_mem.data = NULL;
+  info->owns_origin_mem = false;
 }
 
 
@@ -456,24 +558,48 @@ void S3Uploader::Upload(UploadStreamHandle  *handle,
                         const CallbackTN    *callback) {
   assert(buffer->IsInitialized());
   S3StreamHandle *local_handle = static_cast<S3StreamHandle*>(handle);
+  const size_t nbytes = buffer->used_bytes();
+  shash::Update(buffer->ptr(), nbytes, local_handle->md5_context);
+
+  if (!local_handle->IsSpilled() &&
+      (local_handle->size + nbytes > local_handle->capacity))
+  {
+    size_t new_capacity = (local_handle->capacity > 0)
+                          ? local_handle->capacity : nbytes;
+    while (new_capacity < local_handle->size + nbytes)
+      new_capacity *= 2;
+    const uint64_t growth = new_capacity - local_handle->capacity;
+    if (stream_bytes_in_memory_ + growth > max_stream_bytes_in_memory_) {
+      if (!SpillStreamToDisk(local_handle)) {
+        Respond(callback, UploaderResults(1, buffer));
+        return;
+      }
+    } else {
+      local_handle->buffer = static_cast<unsigned char *>(
+        srealloc(local_handle->buffer, new_capacity));
+      local_handle->capacity = new_capacity;
+      stream_bytes_in_memory_ += growth;
+    }
+  }
 
-  LogCvmfs(kLogUploadS3, kLogDebug, "Upload target = %s",
-           local_handle->temporary_path.c_str());
-
-  const size_t bytes_written = write(local_handle->file_descriptor,
-                                     buffer->ptr(),
-                                     buffer->used_bytes());
-  if (bytes_written != buffer->used_bytes()) {
-    const int cpy_errno = errno;
-    LogCvmfs(kLogUploadS3, kLogStderr, "failed to write %d bytes to '%s' "
-             "(errno: %d)",
-             buffer->used_bytes(),
-             local_handle->temporary_path.c_str(),
-             cpy_errno);
-    atomic_inc32(&copy_errors_);
-    Respond(callback, UploaderResults(cpy_errno, buffer));
-    return;
+  if (local_handle->IsSpilled()) {
+    const ssize_t bytes_written =
+      write(local_handle->file_descriptor, buffer->ptr(), nbytes);
+    if (bytes_written != static_cast<ssize_t>(nbytes)) {
+      const int cpy_errno = errno;
+      LogCvmfs(kLogUploadS3, kLogStderr, "failed to write %d bytes to '%s' "
+               "(errno: %d)",
+               nbytes,
+               local_handle->temporary_path.c_str(),
+               cpy_errno);
+      atomic_inc32(&copy_errors_);
+      Respond(callback, UploaderResults(cpy_errno, buffer));
+      return;
+    }
+  } else {
+    memcpy(local_handle->buffer + local_handle->size, buffer->ptr(), nbytes);
   }
+  local_handle->size += nbytes;
 
   Respond(callback, UploaderResults(0, buffer));
 }
@@ -484,61 +610,107 @@ void S3Uploader::FinalizeStreamedUpload(UploadStreamHandle  *handle,
   int retval = 0;
   S3StreamHandle *local_handle = static_cast<S3StreamHandle*>(handle);
 
-  retval = close(local_handle->file_descriptor);
-  if (retval != 0) {
-    const int cpy_errno = errno;
-    LogCvmfs(kLogUploadS3, kLogStderr, "failed to close temp file '%s' "
-             "(errno: %d)",
-             local_handle->temporary_path.c_str(), cpy_errno);
-    atomic_inc32(&copy_errors_);
-    Respond(handle->commit_callback, UploaderResults(cpy_errno));
-    return;
-  }
-
-  // Open the file for reading
-  MemoryMappedFile *mmf = new MemoryMappedFile(local_handle->temporary_path);
-  if (!mmf->Map()) {
-    LogCvmfs(kLogUploadS3, kLogStderr, "Failed to upload %s",
-             local_handle->temporary_path.c_str());
-    delete mmf;
-    atomic_inc32(&copy_errors_);
-    Respond(handle->commit_callback,
-            UploaderResults(100, local_handle->temporary_path));
-    return;
-  }
+  shash::Any content_md5(shash::kMd5);
+  shash::Final(local_handle->md5_context, &content_md5);
 
   // New file name based on content hash
   std::string final_path("data/" + content_hash.MakePath());
 
+  const ObjectExistence existence = LookupObject(final_path);
+  if (existence == kObjectPresent) {
+    LogCvmfs(kLogUploadS3, kLogDebug, "object '%s' already stored, skipping",
+             final_path.c_str());
+    CountAvoidedUpload(local_handle->size);
+    if (local_handle->IsSpilled()) {
+      close(local_handle->file_descriptor);
+      unlink(local_handle->temporary_path.c_str());
+    }
+    const CallbackTN *callback = handle->commit_callback;
+    delete local_handle;
+    Respond(callback, UploaderResults(0));
+    return;
+  }
+
   // Choose S3 account and bucket based on the filename
   std::string access_key, secret_key, bucket_name;
   const std::string mangled_filename = repository_alias_ + "/" + final_path;
   GetKeysAndBucket(mangled_filename, &access_key, &secret_key, &bucket_name);
 
-  s3fanout::JobInfo *info =
-      new s3fanout::JobInfo(access_key,
-                            secret_key,
-                            full_host_name_,
-                            bucket_name,
-                            mangled_filename,
-                            const_cast<void*>(
-                                static_cast<void const*>(
-                                    handle->commit_callback)),
-                            mmf,
-                            reinterpret_cast<unsigned char *>(mmf->buffer()),
-                            static_cast<size_t>(mmf->size()));
-  assert(info != NULL);
+  s3fanout::JobInfo *info = NULL;
+  if (!local_handle->IsSpilled()) {
+    // The job takes over the memory, which is released once it is completed
+    info = new s3fanout::JobInfo(access_key,
+                                 secret_key,
+                                 full_host_name_,
+                                 bucket_name,
+                                 mangled_filename,
+                                 const_cast<void*>(
+                                     static_cast<void const*>(
+                                         handle->commit_callback)),
+                                 NULL,
+                                 local_handle->buffer,
+                                 local_handle->size);
+    info->owns_origin_mem = true;
+    stream_bytes_in_memory_ -= local_handle->capacity - local_handle->size;
+    local_handle->buffer = NULL;
+  } else {
+    retval = close(local_handle->file_descriptor);
+    if (retval != 0) {
+      const int cpy_errno = errno;
+      LogCvmfs(kLogUploadS3, kLogStderr, "failed to close temp file '%s' "
+               "(errno: %d)",
+               local_handle->temporary_path.c_str(), cpy_errno);
+      atomic_inc32(&copy_errors_);
+      unlink(local_handle->temporary_path.c_str());
+      Respond(handle->commit_callback, UploaderResults(cpy_errno));
+      delete local_handle;
+      return;
+    }
+
+    // Open the file for reading
+    MemoryMappedFile *mmf = new MemoryMappedFile(local_handle->temporary_path);
+    if (!mmf->Map()) {
+      LogCvmfs(kLogUploadS3, kLogStderr, "Failed to upload %s",
+               local_handle->temporary_path.c_str());
+      delete mmf;
+      atomic_inc32(&copy_errors_);
+      unlink(local_handle->temporary_path.c_str());
+      Respond(handle->commit_callback,
+              UploaderResults(100, local_handle->temporary_path));
+      delete local_handle;
+      return;
+    }
+
+    info = new s3fanout::JobInfo(access_key,
+                                 secret_key,
+                                 full_host_name_,
+                                 bucket_name,
+                                 mangled_filename,
+                                 const_cast<void*>(
+                                     static_cast<void const*>(
+                                         handle->commit_callback)),
+                                 mmf,
+                                 reinterpret_cast<unsigned char *>(
+                                     mmf->buffer()),
+                                 static_cast<size_t>(mmf->size()));
+
+    // The mapping stays valid after removing the temporary file
+    retval = remove(local_handle->temporary_path.c_str());
+    assert(retval == 0);
+  }
+  info->content_md5 = content_md5;
+  // Uncertain filter hits are checked by a HEAD request that turns into a PUT
+  // if the object is missing; the checks run in parallel like the uploads
+  if (existence == kObjectProbable)
+    info->request = s3fanout::JobInfo::kReqHead;
+  RegisterObject(final_path);
 
   const bool retval2 = UploadJobInfo(info);
   assert(retval2);
 
   LogCvmfs(kLogUploadS3, kLogDebug,
            "Uploading from stream finished: %s",
-           local_handle->temporary_path.c_str());
-
-  // Remove the temporary file
-  retval = remove(local_handle->temporary_path.c_str());
-  assert(retval == 0);
+           mangled_filename.c_str());
   delete local_handle;
 }
 
@@ -571,6 +743,127 @@ bool S3Uploader::Remove(const std::string& file_to_delete) {
 }
 
 
+/**
+ * Deletes the objects with multi-object deletion requests, one per bucket.
+ * Objects that could not be deleted that way are deleted one by one.  All the
+ * requests are processed by the fan-out manager, so that the batches of all
+ * removal threads share its connection pool.
+ */
+unsigned S3Uploader::RemoveBatch(const std::vector<shash::Any> &hashes) {
+  std::vector<std::string> single_keys;
+  if (atomic_read32(&multi_delete_unsupported_) != 0) {
+    for (unsigned i = 0; i < hashes.size(); ++i)
+      single_keys.push_back(repository_alias_ + "/data/" +
+                            hashes[i].MakePath());
+  } else {
+    std::map<std::string, std::vector<std::string> > keys_per_bucket;
+    for (unsigned i = 0; i < hashes.size(); ++i) {
+      const std::string key =
+        repository_alias_ + "/data/" + hashes[i].MakePath();
+      keys_per_bucket[GetBucketName(SelectBucket(key))].push_back(key);
+    }
+
+    // The request bodies need to stay valid until the jobs are finished
+    std::vector<std::string> bodies;
+    std::vector<std::vector<std::string> *> job_keys;
+    bodies.reserve(keys_per_bucket.size());
+    std::vector<s3fanout::JobInfo *> jobs;
+    std::map<std::string, std::vector<std::string> >::iterator i =
+      keys_per_bucket.begin();
+    for (; i != keys_per_bucket.end(); ++i) {
+      std::string body = "<Delete>\n  <Quiet>true</Quiet>\n";
+      for (unsigned j = 0; j < i->second.size(); ++j)
+        body += "  <Object><Key>" + i->second[j] + "</Key></Object>\n";
+      body += "</Delete>\n";
+      bodies.push_back(body);
+
+      std::string access_key, secret_key, bucket_name;
+      GetKeysAndBucket(i->second[0], &access_key, &secret_key, &bucket_name);
+      s3fanout::JobInfo *info = new s3fanout::JobInfo(
+        access_key, secret_key, full_host_name_, bucket_name, "", NULL, NULL,
+        reinterpret_cast<const unsigned char *>(bodies.back().data()),
+        bodies.back().length());
+      info->request = s3fanout::JobInfo::kReqDeleteObjects;
+      jobs.push_back(info);
+      job_keys.push_back(&i->second);
+    }
+    RunRemoveJobs(jobs);
+
+    for (unsigned j = 0; j < jobs.size(); ++j) {
+      s3fanout::JobInfo *info = jobs[j];
+      if (info->error_code != s3fanout::kFailOk) {
+        LogCvmfs(kLogUploadS3, kLogStderr, "multi-object deletion in bucket "
+                 "%s failed (error code: %d - %s), deleting objects one by one",
+                 info->bucket.c_str(), info->error_code,
+                 s3fanout::Code2Ascii(info->error_code));
+        if (info->error_code == s3fanout::kFailNotImplemented)
+          atomic_write32(&multi_delete_unsupported_, 1);
+        single_keys.insert(single_keys.end(),
+                           job_keys[j]->begin(), job_keys[j]->end());
+        delete info;
+        continue;
+      }
+
+      // In quiet mode, the response lists only the failed deletions
+      const std::string kTagBegin = "<Key>";
+      const std::string kTagEnd = "</Key>";
+      size_t pos = info->response.find("<Error>");
+      while (pos != std::string::npos) {
+        const size_t begin = info->response.find(kTagBegin, pos);
+        const size_t end = info->response.find(kTagEnd, pos);
+        if ((begin == std::string::npos) || (end == std::string::npos) ||
+            (end < begin))
+        {
+          break;
+        }
+        single_keys.push_back(
+          info->response.substr(begin + kTagBegin.length(),
+                                end - begin - kTagBegin.length()));
+        pos = info->response.find("<Error>", end);
+      }
+      delete info;
+    }
+  }
+
+  if (single_keys.empty())
+    return 0;
+  std::vector<s3fanout::JobInfo *> jobs;
+  for (unsigned i = 0; i < single_keys.size(); ++i) {
+    s3fanout::JobInfo *info = CreateJobInfo(single_keys[i]);
+    info->request = s3fanout::JobInfo::kReqDelete;
+    jobs.push_back(info);
+  }
+  RunRemoveJobs(jobs);
+  unsigned num_failed = 0;
+  for (unsigned i = 0; i < jobs.size(); ++i) {
+    if (jobs[i]->error_code != s3fanout::kFailOk) {
+      LogCvmfs(kLogUploadS3, kLogStderr, "failed to delete %s (error code: "
+               "%d - %s)", jobs[i]->object_key.c_str(), jobs[i]->error_code,
+               s3fanout::Code2Ascii(jobs[i]->error_code));
+      num_failed++;
+    }
+    delete jobs[i];
+  }
+  return num_failed;
+}
+
+
+/**
+ * Hands the deletion jobs to the fan-out manager and waits until the worker
+ * thread collected all of them.  The jobs remain owned by the caller.
+ */
+void S3Uploader::RunRemoveJobs(const std::vector<s3fanout::JobInfo *> &jobs) {
+  SynchronizingCounter<int32_t> jobs_in_flight;
+  for (unsigned i = 0; i < jobs.size(); ++i) {
+    jobs[i]->callback = &jobs_in_flight;
+    ++jobs_in_flight;
+    const int retval = s3fanout_mgr_.PushNewJob(jobs[i]);
+    assert(retval == 0);
+  }
+  jobs_in_flight.WaitForZero();
+}
+
+
 bool S3Uploader::Peek(const std::string& path) const {
   const std::string mangled_path = repository_alias_ + "/" + path;
   s3fanout::JobInfo *info = CreateJobInfo(mangled_path);
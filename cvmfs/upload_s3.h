@@ -5,25 +5,42 @@
 #ifndef CVMFS_UPLOAD_S3_H_
 #define CVMFS_UPLOAD_S3_H_
 
+#include <inttypes.h>
+
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "hash.h"
 #include "s3fanout.h"
 #include "upload_facility.h"
 
 namespace upload {
 
+/**
+ * Streamed uploads are collected in memory until the content hash, i.e. the
+ * object name, is known.  The Content-MD5 of the object is computed on the fly.
+ * If the memory of all open streams exceeds the limit of the uploader, the
+ * stream continues in a temporary file.  The buffer that is still owned by the
+ * handle on destruction is subtracted from the uploader's in-memory counter.
+ */
 struct S3StreamHandle : public UploadStreamHandle {
-    S3StreamHandle(const CallbackTN   *commit_callback,
-                   const int           tmp_fd,
-                   const std::string  &tmp_path) :
-    UploadStreamHandle(commit_callback),
-    file_descriptor(tmp_fd),
-    temporary_path(tmp_path) {}
-
-  const int         file_descriptor;
-  const std::string temporary_path;
+  S3StreamHandle(const CallbackTN *commit_callback,
+                 uint64_t *stream_bytes_in_memory);
+  ~S3StreamHandle();
+
+  bool IsSpilled() const { return file_descriptor >= 0; }
+
+  unsigned char     *buffer;
+  size_t             size;
+  size_t             capacity;
+  shash::ContextPtr  md5_context;
+
+  int                file_descriptor;  ///< -1 unless spilled to disk
+  std::string        temporary_path;
+
+ private:
+  uint64_t          *stream_bytes_in_memory_;
 };
 
 
@@ -70,10 +87,31 @@ class S3Uploader : public AbstractUploader {
 
  protected:
   void WorkerThread();
+  unsigned RemoveBatch(const std::vector<shash::Any> &hashes);
 
   int CreateAndOpenTemporaryChunkFile(std::string *path) const;
+  bool SpillStreamToDisk(S3StreamHandle *handle);
+  void ReleaseStreamMemory(s3fanout::JobInfo *info);
 
  private:
+  /**
+   * Default for CVMFS_S3_STREAM_BUFFER_LIMIT_MB
+   */
+  static const uint64_t kDefaultMaxStreamBytesInMemory = 256 * 1024 * 1024;
+  /**
+   * Defaults for CVMFS_S3_MULTIPART_THRESHOLD_MB and
+   * CVMFS_S3_MULTIPART_PART_SIZE_MB.  Objects of at least the threshold size
+   * are uploaded in parts of the given size, a threshold of 0 disables
+   * multipart uploads.
+   */
+  static const uint64_t kDefaultMultipartThreshold = 64 * 1024 * 1024;
+  static const uint64_t kDefaultMultipartPartSize = 16 * 1024 * 1024;
+  /**
+   * S3 rejects the completion of multipart uploads with parts (but the last)
+   * smaller than 5 MB
+   */
+  static const uint64_t kMinMultipartPartSize = 5 * 1024 * 1024;
+
   bool ParseSpoolerDefinition(const SpoolerDefinition &spooler_definition);
   bool UploadJobInfo(s3fanout::JobInfo *info);
 
@@ -85,6 +123,7 @@ class S3Uploader : public AbstractUploader {
   int SelectBucket(const std::string &rem_filename) const;
   int GetKeyIndex(unsigned int use_bucket) const;
   s3fanout::JobInfo *CreateJobInfo(const std::string& path) const;
+  void RunRemoveJobs(const std::vector<s3fanout::JobInfo *> &jobs);
 
   s3fanout::S3FanoutManager s3fanout_mgr_;
   // state information
@@ -95,10 +134,24 @@ class S3Uploader : public AbstractUploader {
   int         number_of_buckets_;
   int         max_num_parallel_uploads_;
   std::vector<std::pair<std::string, std::string> > keys_;
+  /**
+   * Memory of streamed uploads that are kept in memory.  Only accessed by the
+   * worker thread.
+   */
+  uint64_t    max_stream_bytes_in_memory_;
+  uint64_t    stream_bytes_in_memory_;
+  uint64_t    multipart_threshold_;
+  uint64_t    multipart_part_size_;
 
   const std::string    temporary_path_;
   mutable atomic_int32 copy_errors_;   // counts the number of occured
                                        // errors in Upload()
+  /**
+   * Set once the storage answered a multi-object deletion request with "not
+   * implemented".  Objects are then deleted one by one.  Other failures of a
+   * multi-object deletion only affect the objects of that request.
+   */
+  atomic_int32         multi_delete_unsupported_;
 };
 
 }  // namespace upload
@@ -25,8 +25,13 @@ SpoolerDefinition::SpoolerDefinition(
   min_file_chunk_size(min_file_chunk_size),
   avg_file_chunk_size(avg_file_chunk_size),
   max_file_chunk_size(max_file_chunk_size),
+  generate_legacy_bulk_chunks(true),
   number_of_threads(tbb::task_scheduler_init::default_num_threads()),
   number_of_concurrent_uploads(number_of_threads * 100),
+  number_of_concurrent_removals(8),
+  number_of_read_threads(1),
+  max_read_bytes_in_flight(0),
+  verify_existence_filter_hits(true),
   valid_(false)
 {
   // check if given file chunking values are sane
@@ -57,9 +57,37 @@ struct SpoolerDefinition {
   size_t             min_file_chunk_size;
   size_t             avg_file_chunk_size;
   size_t             max_file_chunk_size;
+  /**
+   * Chunked files are additionally stored as a single bulk object for clients
+   * that cannot read chunked files.  If disabled, chunked files get a null
+   * bulk hash and only their chunks are compressed and uploaded.
+   */
+  bool               generate_legacy_bulk_chunks;
 
   const unsigned int number_of_threads;
   unsigned int       number_of_concurrent_uploads;
+  unsigned int       number_of_concurrent_removals;  ///< removal threads
+  unsigned int       number_of_read_threads;  ///< I/O threads of the Reader
+  /**
+   * Memory limit for data buffers in flight before the read-in is throttled,
+   * 0 selects a default based on number_of_threads
+   */
+  uint64_t           max_read_bytes_in_flight;
+  /**
+   * Location of the publish hash cache (see HashCache), empty if disabled
+   */
+  std::string        hash_cache_path;
+  /**
+   * Location of the filter of objects known to be stored in the backend (see
+   * ExistenceFilter), empty if disabled
+   */
+  std::string        existence_filter_path;
+  /**
+   * Whether hits in the existence filter are checked against the backend
+   * storage before an upload is skipped.  Only repositories that are never
+   * garbage collected can trust the filter.
+   */
+  bool               verify_existence_filter_hits;
 
   bool valid_;
 };
@@ -97,6 +97,7 @@ Failures Whitelist::Load(const std::string &base_url) {
   const string whitelist_url = base_url + string("/.cvmfswhitelist");
   download::JobInfo download_whitelist(&whitelist_url,
                                        false, probe_hosts, NULL);
+  download_whitelist.priority = download::kPriorityCatalog;
   retval_dl = download_manager_->Fetch(&download_whitelist);
   if (retval_dl != download::kFailOk)
     return kFailLoad;
@@ -124,6 +125,7 @@ Failures Whitelist::Load(const std::string &base_url) {
       base_url + string("cvmfswhitelist.pkcs7");
     download::JobInfo download_whitelist_pkcs7(&whitelist_pkcs7_url, false,
                                                probe_hosts, NULL);
+    download_whitelist_pkcs7.priority = download::kPriorityCatalog;
     retval_dl = download_manager_->Fetch(&download_whitelist_pkcs7);
     if (retval_dl != download::kFailOk)
       return kFailLoadPkcs7;
@@ -0,0 +1,250 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../../cvmfs/access_log.h"
+#include "../../cvmfs/access_log_replay.h"
+#include "../../cvmfs/compression.h"
+#include "../../cvmfs/download.h"
+#include "../../cvmfs/hash.h"
+#include "../../cvmfs/statistics.h"
+#include "../../cvmfs/util.h"
+
+using namespace std;  // NOLINT
+
+namespace access_log {
+
+class T_AccessLog : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    FILE *f = CreateTempFile("/tmp/cvmfs_test", 0600, "w", &log_path_);
+    ASSERT_TRUE(f != NULL);
+    fclose(f);
+    // Init() needs to create the file
+    unlink(log_path_.c_str());
+
+    catalog_hash_ = shash::Any(shash::kSha1, shash::kSuffixCatalog);
+    shash::HashString("catalog", &catalog_hash_);
+    object_hash_ = shash::Any(shash::kSha1);
+    shash::HashString("object", &object_hash_);
+    chunk_hash_ = shash::Any(shash::kRmd160, shash::kSuffixPartial);
+    shash::HashString("chunk", &chunk_hash_);
+  }
+
+  virtual void TearDown() {
+    Fini();
+    unlink(log_path_.c_str());
+  }
+
+  string log_path_;
+  shash::Any catalog_hash_;
+  shash::Any object_hash_;
+  shash::Any chunk_hash_;
+};
+
+
+TEST_F(T_AccessLog, InitNull) {
+  InitNull();
+  Log(kRecordObject, shash::Md5(shash::AsciiPtr("/file")), object_hash_, 0, 1);
+  Flush();
+  Fini();
+  EXPECT_FALSE(FileExists(log_path_));
+}
+
+
+TEST_F(T_AccessLog, WriteRead) {
+  ASSERT_TRUE(Init(log_path_));
+  Log(kRecordCatalog, shash::Md5(shash::AsciiPtr("/nested")),
+      catalog_hash_, 0, 0);
+  Log(kRecordObject, shash::Md5(shash::AsciiPtr("/nested/file")),
+      object_hash_, 0, 1024);
+  Log(kRecordChunk, shash::Md5(shash::AsciiPtr("/nested/large")),
+      chunk_hash_, 4096, 2048);
+  Fini();
+
+  vector<Record> records;
+  ASSERT_TRUE(ReadLog(log_path_, &records));
+  ASSERT_EQ(3U, records.size());
+  EXPECT_EQ(kRecordCatalog, records[0].type);
+  EXPECT_EQ(catalog_hash_, records[0].GetHash());
+  EXPECT_EQ(shash::Md5(shash::AsciiPtr("/nested")), records[0].GetPathHash());
+  EXPECT_EQ(kRecordObject, records[1].type);
+  EXPECT_EQ(object_hash_, records[1].GetHash());
+  EXPECT_EQ(1024U, records[1].size);
+  EXPECT_EQ(kRecordChunk, records[2].type);
+  EXPECT_EQ(chunk_hash_, records[2].GetHash());
+  EXPECT_EQ(shash::kSuffixPartial, records[2].GetHash().suffix);
+  EXPECT_EQ(4096U, records[2].offset);
+  EXPECT_EQ(2048U, records[2].size);
+  EXPECT_LE(records[0].timestamp, records[1].timestamp);
+  EXPECT_LE(records[1].timestamp, records[2].timestamp);
+}
+
+
+TEST_F(T_AccessLog, Append) {
+  ASSERT_TRUE(Init(log_path_));
+  Log(kRecordObject, shash::Md5(shash::AsciiPtr("/a")), object_hash_, 0, 1);
+  Fini();
+  ASSERT_TRUE(Init(log_path_));
+  Log(kRecordObject, shash::Md5(shash::AsciiPtr("/b")), object_hash_, 0, 1);
+  Flush();
+
+  vector<Record> records;
+  ASSERT_TRUE(ReadLog(log_path_, &records));
+  ASSERT_EQ(2U, records.size());
+  EXPECT_EQ(shash::Md5(shash::AsciiPtr("/b")), records[1].GetPathHash());
+}
+
+
+TEST_F(T_AccessLog, Corrupted) {
+  vector<Record> records;
+  EXPECT_FALSE(ReadLog(log_path_, &records));
+
+  const string garbage = "not an access log";
+  ASSERT_TRUE(CopyMem2Path(reinterpret_cast<const unsigned char *>(
+    garbage.data()), garbage.length(), log_path_));
+  EXPECT_FALSE(ReadLog(log_path_, &records));
+  EXPECT_FALSE(Init(log_path_));
+  unlink(log_path_.c_str());
+
+  ASSERT_TRUE(Init(log_path_));
+  Log(kRecordObject, shash::Md5(shash::AsciiPtr("/a")), object_hash_, 0, 1);
+  Fini();
+  ASSERT_EQ(0, truncate(log_path_.c_str(), GetFileSize(log_path_) - 1));
+  EXPECT_FALSE(ReadLog(log_path_, &records));
+}
+
+
+static void *MainLogThread(void *data) {
+  const shash::Any *hash = reinterpret_cast<shash::Any *>(data);
+  for (unsigned i = 0; i < 1000; ++i)
+    Log(kRecordObject, shash::Md5(shash::AsciiPtr("/t")), *hash, i, 1);
+  return NULL;
+}
+
+TEST_F(T_AccessLog, Concurrent) {
+  ASSERT_TRUE(Init(log_path_));
+  const unsigned kNumThreads = 4;
+  pthread_t threads[kNumThreads];
+  for (unsigned i = 0; i < kNumThreads; ++i) {
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, MainLogThread,
+                                &object_hash_));
+  }
+  // Records of running threads are still buffered
+  Log(kRecordCatalog, shash::Md5(shash::AsciiPtr("")), catalog_hash_, 0, 0);
+  Flush();
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    pthread_join(threads[i], NULL);
+  Log(kRecordCatalog, shash::Md5(shash::AsciiPtr("")), catalog_hash_, 0, 0);
+  Fini();
+
+  vector<Record> records;
+  ASSERT_TRUE(ReadLog(log_path_, &records));
+  ASSERT_EQ(kNumThreads * 1000 + 2, records.size());
+  for (unsigned i = 1; i < records.size(); ++i)
+    EXPECT_LE(records[i-1].timestamp, records[i].timestamp);
+  EXPECT_EQ(kRecordCatalog, records[records.size()-1].type);
+}
+
+
+class T_AccessLogReplay : public T_AccessLog {
+ protected:
+  virtual void SetUp() {
+    T_AccessLog::SetUp();
+    repository_dir_ = CreateTempDir("/tmp/cvmfs_test");
+    cache_dir_ = CreateTempDir("/tmp/cvmfs_test");
+    ASSERT_FALSE(repository_dir_.empty());
+    ASSERT_FALSE(cache_dir_.empty());
+    ASSERT_TRUE(MakeCacheDirectories(repository_dir_ + "/data", 0700));
+    download_mgr_.Init(4, false, &statistics_);
+  }
+
+  virtual void TearDown() {
+    download_mgr_.Fini();
+    RemoveTree(repository_dir_);
+    RemoveTree(cache_dir_);
+    T_AccessLog::TearDown();
+  }
+
+  /**
+   * Stores a compressed object in the repository directory.
+   */
+  shash::Any AddObject(const string &content, const shash::Suffix suffix) {
+    string tmp_path;
+    FILE *f = CreateTempFile(repository_dir_ + "/data/txn/obj", 0600, "w",
+                             &tmp_path);
+    assert(f != NULL);
+    shash::Any hash(shash::kSha1, suffix);
+    bool retval = zlib::CompressMem2File(
+      reinterpret_cast<const unsigned char *>(content.data()),
+      content.length(), f, &hash);
+    assert(retval);
+    fclose(f);
+    const string path = repository_dir_ + "/data/" + hash.MakePath();
+    retval = rename(tmp_path.c_str(), path.c_str()) == 0;
+    assert(retval);
+    return hash;
+  }
+
+  bool InCache(const shash::Any &hash) {
+    return FileExists(cache_dir_ + "/" + hash.MakePathWithoutSuffix());
+  }
+
+  perf::Statistics statistics_;
+  download::DownloadManager download_mgr_;
+  string repository_dir_;
+  string cache_dir_;
+};
+
+
+TEST_F(T_AccessLogReplay, Replay) {
+  const shash::Any hash_a = AddObject("a", shash::kSuffixNone);
+  const shash::Any hash_b = AddObject("b", shash::kSuffixPartial);
+  const shash::Any hash_c = AddObject("c", shash::kSuffixNone);
+  ASSERT_TRUE(Init(log_path_));
+  Log(kRecordObject, shash::Md5(shash::AsciiPtr("/b")), hash_b, 0, 1);
+  Log(kRecordObject, shash::Md5(shash::AsciiPtr("/a")), hash_a, 0, 1);
+  Log(kRecordObject, shash::Md5(shash::AsciiPtr("/b")), hash_b, 0, 1);
+  Fini();
+
+  vector<Record> records;
+  ASSERT_TRUE(ReadLog(log_path_, &records));
+  vector<shash::Any> objects;
+  Replayer::ListObjects(records, &objects);
+  ASSERT_EQ(2U, objects.size());
+  EXPECT_EQ(hash_b, objects[0]);
+  EXPECT_EQ(hash_a, objects[1]);
+
+  download_mgr_.Spawn();
+  Replayer replayer(&download_mgr_, "file://" + repository_dir_, cache_dir_);
+  EXPECT_TRUE(replayer.Run(objects, 2));
+  EXPECT_EQ(2, replayer.num_new());
+  EXPECT_EQ(0, replayer.num_failed());
+  EXPECT_TRUE(InCache(hash_a));
+  EXPECT_TRUE(InCache(hash_b));
+  EXPECT_FALSE(InCache(hash_c));
+
+  // Cached objects are skipped, missing objects count as failures
+  objects.push_back(hash_c);
+  shash::Any hash_missing(shash::kSha1);
+  shash::HashString("missing", &hash_missing);
+  objects.push_back(hash_missing);
+  Replayer replayer2(&download_mgr_, "file://" + repository_dir_, cache_dir_);
+  EXPECT_FALSE(replayer2.Run(objects, 2));
+  EXPECT_EQ(1, replayer2.num_new());
+  EXPECT_EQ(1, replayer2.num_failed());
+  EXPECT_TRUE(InCache(hash_c));
+  EXPECT_FALSE(InCache(hash_missing));
+}
+
+}  // namespace access_log
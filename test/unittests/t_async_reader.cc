@@ -9,6 +9,9 @@
 #include <unistd.h>
 
 #include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
 
 #include "../../cvmfs/file_processing/async_reader.h"
 #include "../../cvmfs/file_processing/char_buffer.h"
@@ -284,6 +287,79 @@ TEST_F(T_AsyncReader, ReadManyBigFilesSlow) {
 }
 
 
+TEST_F(T_AsyncReader, ReadWithMultipleThreads) {
+  std::vector<TestFile*> files;
+  for (int i = 0; i < 200; ++i) {
+    files.push_back(new TestFile(GetSmallFile(), GetSmallFileHash()));
+    if (i % 10 == 0)
+      files.push_back(new TestFile(GetBigFile(), GetBigFileHash()));
+    if (i % 50 == 0)
+      files.push_back(new TestFile(GetEmptyFile(), GetEmptyFileHash()));
+  }
+
+  const size_t        max_buffer_size = 65536;
+  const unsigned int  max_files_in_flight = 20;
+  const uint64_t      max_bytes_in_flight = 1024 * 1024;
+  const unsigned int  number_of_threads = 4;
+  MyReader reader(max_buffer_size, max_files_in_flight, max_bytes_in_flight,
+                  number_of_threads);
+  EXPECT_EQ(number_of_threads, reader.number_of_threads());
+  reader.Initialize();
+
+  for (unsigned i = 0; i < files.size(); ++i)
+    reader.ScheduleRead(files[i]);
+  reader.Wait();
+  reader.TearDown();
+
+  for (unsigned i = 0; i < files.size(); ++i) {
+    files[i]->CheckHash();
+    delete files[i];
+  }
+  EXPECT_EQ(0U, reader.buffer_pool()->bytes_in_flight());
+}
+
+
+TEST_F(T_AsyncReader, ReadThroughputSlow) {
+  const unsigned int file_count = 2000;
+  const size_t       max_buffer_size = 524288;
+  const std::string  small_file = GetSmallFile();
+  const std::string  big_file = GetBigFile();
+  const uint64_t     bytes_per_round =
+    uint64_t(file_count - file_count / 10) * GetFileSize(small_file) +
+    uint64_t(file_count / 10) * GetFileSize(big_file);
+
+  const unsigned int number_of_threads[] = {1, 2, 4, 8};
+  for (unsigned t = 0; t < sizeof(number_of_threads) / sizeof(unsigned); ++t)
+  {
+    std::vector<TestFile*> files;
+    for (unsigned i = 0; i < file_count; ++i) {
+      files.push_back((i % 10 == 0)
+        ? new TestFile(big_file, GetBigFileHash())
+        : new TestFile(small_file, GetSmallFileHash()));
+    }
+
+    MyReader reader(max_buffer_size, 80, 64 * 1024 * 1024,
+                    number_of_threads[t]);
+    reader.Initialize();
+    StopWatch stopwatch;
+    stopwatch.Start();
+    for (unsigned i = 0; i < files.size(); ++i)
+      reader.ScheduleRead(files[i]);
+    reader.Wait();
+    stopwatch.Stop();
+    reader.TearDown();
+
+    for (unsigned i = 0; i < files.size(); ++i) {
+      files[i]->CheckHash();
+      delete files[i];
+    }
+    printf("%u reader threads: %.0f files/s, %.1f MB/s\n",
+           number_of_threads[t], file_count / stopwatch.GetTime(),
+           bytes_per_round / stopwatch.GetTime() / (1024 * 1024));
+  }
+}
+
+
 void *deadlock_test(void *v_files) {
   std::vector<TestFile*> &files =
     *static_cast<std::vector<TestFile *> *>(v_files);
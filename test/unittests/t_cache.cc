@@ -10,7 +10,9 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
 #include <string>
 
@@ -591,6 +593,60 @@ TEST_F(T_CacheManager, GetSize) {
 }
 
 
+struct LockDownloadCb {
+  LockDownloadCb(PosixCacheManager *mgr, const shash::Any &id)
+    : mgr(mgr), id(id), lock(-1) { }
+  PosixCacheManager *mgr;
+  shash::Any id;
+  int lock;
+};
+
+static void *MainLockDownload(void *data) {
+  LockDownloadCb *cb = reinterpret_cast<LockDownloadCb *>(data);
+  cb->lock = cb->mgr->LockDownload(cb->id);
+  return NULL;
+}
+
+TEST_F(T_CacheManager, LockDownload) {
+  shash::Any hash_new(shash::kSha1);
+  hash_new.Randomize();
+
+  // Only cooperative alien caches coordinate downloads
+  EXPECT_EQ(-1, alien_cache_mgr_->LockDownload(hash_new));
+  cache_mgr_->set_cooperative_downloads(true);
+  EXPECT_EQ(-1, cache_mgr_->LockDownload(hash_new));
+
+  // A second cache manager on the same directory acts as another process
+  alien_cache_mgr_->set_cooperative_downloads(true);
+  UniquePtr<PosixCacheManager> other_mgr(
+    PosixCacheManager::Create(tmp_path_, true));
+  ASSERT_TRUE(other_mgr.IsValid());
+  other_mgr->set_cooperative_downloads(true);
+  other_mgr->set_download_lock_timeout_ms(50);
+
+  const int lock = alien_cache_mgr_->LockDownload(hash_new);
+  EXPECT_GE(lock, 0);
+  EXPECT_EQ(-1, other_mgr->LockDownload(hash_new));
+
+  // The waiting process gets the lock once the object is committed
+  other_mgr->set_download_lock_timeout_ms(60000);
+  LockDownloadCb cb(other_mgr.weak_ref(), hash_new);
+  pthread_t thread_lock;
+  ASSERT_EQ(0, pthread_create(&thread_lock, NULL, MainLockDownload, &cb));
+  SafeSleepMs(50);
+  unsigned char buf = 'A';
+  EXPECT_TRUE(alien_cache_mgr_->CommitFromMem(hash_new, &buf, 1, "new"));
+  alien_cache_mgr_->UnlockDownload(hash_new, lock);
+  pthread_join(thread_lock, NULL);
+  EXPECT_GE(cb.lock, 0);
+  int fd = other_mgr->Open(hash_new);
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(0, other_mgr->Close(fd));
+  other_mgr->UnlockDownload(hash_new, cb.lock);
+  // Lock files are removed, TearDown() checks for an empty txn directory
+}
+
+
 TEST_F(T_CacheManager, Open) {
   delete cache_mgr_->quota_mgr_;
   cache_mgr_->quota_mgr_ = new TestQuotaManager();
@@ -858,4 +914,85 @@ TEST_F(T_CacheManager, WriteCompare) {
   cache_mgr_->Close(fd);
 }
 
+
+/**
+ * Mixes writes that are collected in the transaction buffer with large writes
+ * that bypass it, with and without dropping written pages.
+ */
+TEST_F(T_CacheManager, WriteMixed) {
+  const unsigned N = 10 * 1024 * 1024 + 17;
+  const unsigned kWriteSizes[] = {1, 100, 4095, 4096, 4097, 16384, 1000000};
+  unsigned char *large_buf = static_cast<unsigned char *>(smalloc(N));
+  Prng prng;
+  prng.InitSeed(42);
+  for (unsigned i = 0; i < N; ++i)
+    large_buf[i] = prng.Next(256);
+  unsigned char *receive_buf = static_cast<unsigned char *>(smalloc(N));
+
+  for (unsigned drop = 0; drop < 2; ++drop) {
+    cache_mgr_->set_drop_written_pages(drop == 1);
+    shash::Any rnd_hash;
+    rnd_hash.Randomize();
+    void *txn = alloca(cache_mgr_->SizeOfTxn());
+    int fd = cache_mgr_->StartTxn(rnd_hash, N, txn);
+    EXPECT_GE(fd, 0);
+    // Preallocation keeps the file size
+    EXPECT_EQ(0, cache_mgr_->GetSize(fd));
+    unsigned pos = 0;
+    for (unsigned i = 0; pos < N; ++i) {
+      const unsigned size = std::min(
+        kWriteSizes[i % (sizeof(kWriteSizes) / sizeof(kWriteSizes[0]))],
+        N - pos);
+      EXPECT_EQ(static_cast<int64_t>(size),
+                cache_mgr_->Write(large_buf + pos, size, txn));
+      pos += size;
+    }
+    EXPECT_EQ(0, cache_mgr_->CommitTxn(txn));
+
+    fd = cache_mgr_->Open(rnd_hash);
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ(N, cache_mgr_->GetSize(fd));
+    EXPECT_EQ(N, cache_mgr_->Pread(fd, receive_buf, N, 0));
+    EXPECT_EQ(0, memcmp(large_buf, receive_buf, N));
+    cache_mgr_->Close(fd);
+  }
+  free(receive_buf);
+  free(large_buf);
+}
+
+
+TEST_F(T_CacheManager, WriteBenchmarkSlow) {
+  const unsigned kTotalSize = 256 * 1024 * 1024;
+  const unsigned kObjectSizes[] = {16 * 1024, 1024 * 1024, 64 * 1024 * 1024};
+  const unsigned kWriteSize = 16384;  // Decompression output during downloads
+  unsigned char *buf = static_cast<unsigned char *>(smalloc(kWriteSize));
+  memset(buf, 'x', kWriteSize);
+  void *txn = alloca(cache_mgr_->SizeOfTxn());
+
+  for (unsigned drop = 0; drop < 2; ++drop) {
+    cache_mgr_->set_drop_written_pages(drop == 1);
+    for (unsigned i = 0; i < sizeof(kObjectSizes) / sizeof(kObjectSizes[0]);
+         ++i)
+    {
+      const unsigned object_size = kObjectSizes[i];
+      const unsigned num_objects = kTotalSize / object_size;
+      StopWatch stop_watch;
+      stop_watch.Start();
+      for (unsigned j = 0; j < num_objects; ++j) {
+        shash::Any id(shash::kSha1);
+        id.Randomize();
+        ASSERT_GE(cache_mgr_->StartTxn(id, object_size, txn), 0);
+        for (unsigned pos = 0; pos < object_size; pos += kWriteSize)
+          cache_mgr_->Write(buf, kWriteSize, txn);
+        ASSERT_EQ(0, cache_mgr_->CommitTxn(txn));
+      }
+      stop_watch.Stop();
+      printf("object size %8u kB%s: %.0f MB/s\n", object_size / 1024,
+             (drop == 1) ? ", drop written pages" : "",
+             kTotalSize / stop_watch.GetTime() / (1024 * 1024));
+    }
+  }
+  free(buf);
+}
+
 }  // namespace cache
@@ -0,0 +1,378 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#define __STDC_FORMAT_MACROS
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../../cvmfs/catalog.h"
+#include "../../cvmfs/catalog_compiled.h"
+#include "../../cvmfs/catalog_sql.h"
+#include "../../cvmfs/hash.h"
+#include "../../cvmfs/prng.h"
+#include "../../cvmfs/sink.h"
+#include "../../cvmfs/util.h"
+#include "../../cvmfs/xattr.h"
+#include "testutil.h"
+
+using namespace std;  // NOLINT
+
+namespace catalog {
+
+class T_CatalogCompiled : public ::testing::Test {
+ protected:
+  class FileSink : public cvmfs::Sink {
+   public:
+    explicit FileSink(FILE *f) : f_(f) { }
+    virtual int64_t Write(const void *buf, uint64_t sz) {
+      return fwrite(buf, 1, sz, f_);
+    }
+    virtual int Reset() { return ftruncate(fileno(f_), 0); }
+
+   private:
+    FILE *f_;
+  };
+
+  static bool DirentLess(const DirectoryEntry &a, const DirectoryEntry &b) {
+    return a.name().ToString() < b.name().ToString();
+  }
+
+  static bool StatEntryLess(const StatEntry &a, const StatEntry &b) {
+    return a.name.ToString() < b.name.ToString();
+  }
+
+  static vector<StatEntry> SortedListing(const StatEntryList &listing) {
+    vector<StatEntry> result;
+    for (unsigned i = 0; i < listing.size(); ++i)
+      result.push_back(*listing.AtPtr(i));
+    sort(result.begin(), result.end(), StatEntryLess);
+    return result;
+  }
+
+  virtual void SetUp() {
+    tmp_path_ = CreateTempDir("/tmp/cvmfs-test");
+    ASSERT_NE("", tmp_path_);
+    catalog_path_ = tmp_path_ + "/catalog.db";
+    compiled_path_ = tmp_path_ + "/catalog.compiled";
+  }
+
+  virtual void TearDown() {
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+  }
+
+  void Insert(const string &path, const DirectoryEntry &dirent,
+              SqlDirentInsert *sql_insert)
+  {
+    EXPECT_TRUE(
+      sql_insert->BindPathHash(shash::Md5(shash::AsciiPtr(path))) &&
+      sql_insert->BindParentPathHash(
+        shash::Md5(shash::AsciiPtr(GetParentPath(path)))) &&
+      sql_insert->BindDirent(dirent) &&
+      sql_insert->Execute() &&
+      sql_insert->Reset());
+    paths_.push_back(path);
+  }
+
+  /**
+   * Creates num_dirs directories with num_files files each, plus a few
+   * special entries.
+   */
+  void CreateCatalog(const unsigned num_dirs, const unsigned num_files) {
+    UniquePtr<CatalogDatabase> db(CatalogDatabase::Create(catalog_path_));
+    ASSERT_TRUE(db.IsValid());
+    ASSERT_TRUE(db->InsertInitialValues(
+      "", false, DirectoryEntryTestFactory::Directory("")));
+    paths_.push_back("");
+    dirs_.push_back("");
+
+    ASSERT_TRUE(sqlite::Sql(db->sqlite_db(), "BEGIN;").Execute());
+    SqlDirentInsert sql_insert(*db);
+    for (unsigned i = 0; i < num_dirs; ++i) {
+      const string name = "dir" + StringifyInt(i);
+      Insert("/" + name, DirectoryEntryTestFactory::Directory(name),
+             &sql_insert);
+      dirs_.push_back("/" + name);
+      for (unsigned j = 0; j < num_files; ++j) {
+        const string file_name = "file" + StringifyInt(j);
+        shash::Any hash(shash::kSha1);
+        hash.Randomize(i * num_files + j);
+        Insert("/" + name + "/" + file_name,
+               DirectoryEntryTestFactory::RegularFile(file_name, j, hash),
+               &sql_insert);
+      }
+    }
+
+    DirectoryEntry link = DirectoryEntryTestFactory::Symlink("link",
+      "$(CVMFS_TEST_COMPILED_UNSET:-fallback)/target");
+    Insert("/link", link, &sql_insert);
+    DirectoryEntry mountpoint = DirectoryEntryTestFactory::Directory("nested");
+    mountpoint.set_is_nested_catalog_mountpoint(true);
+    Insert("/nested", mountpoint, &sql_insert);
+    DirectoryEntry chunked = DirectoryEntryTestFactory::ChunkedFile();
+    Insert("/chunked", chunked, &sql_insert);
+    shash::Any sha256(shash::kSha256);
+    sha256.Randomize(42);
+    Insert("/sha256",
+           DirectoryEntryTestFactory::RegularFile("sha256", 1, sha256),
+           &sql_insert);
+    for (unsigned i = 0; i < 2; ++i) {
+      const string name = "hardlink" + StringifyInt(i);
+      DirectoryEntry hardlink =
+        DirectoryEntryTestFactory::RegularFile(name, 10, sha256);
+      hardlink.set_hardlink_group(1);
+      hardlink.set_linkcount(2);
+      Insert("/" + name, hardlink, &sql_insert);
+    }
+
+    DirectoryEntry xattrs = DirectoryEntryTestFactory::RegularFile(
+      "xattrs", 1, sha256);
+    XattrList xattr_list;
+    xattr_list.Set("user.foo", "bar");
+    EXPECT_TRUE(
+      sql_insert.BindPathHash(shash::Md5(shash::AsciiPtr("/xattrs"))) &&
+      sql_insert.BindParentPathHash(shash::Md5(shash::AsciiPtr(""))) &&
+      sql_insert.BindDirent(xattrs) &&
+      sql_insert.BindXattr(xattr_list) &&
+      sql_insert.Execute() &&
+      sql_insert.Reset());
+    paths_.push_back("/xattrs");
+    ASSERT_TRUE(sqlite::Sql(db->sqlite_db(), "COMMIT;").Execute());
+  }
+
+  Catalog *AttachCatalog() {
+    shash::Any hash(shash::kSha1, shash::kSuffixCatalog);
+    hash.Randomize(1);
+    return Catalog::AttachFreely("", catalog_path_, hash);
+  }
+
+  CompiledCatalog *MapCompiled() {
+    const int fd = open(compiled_path_.c_str(), O_RDONLY);
+    EXPECT_GE(fd, 0);
+    CompiledCatalog *compiled = CompiledCatalog::Map(fd);
+    close(fd);
+    return compiled;
+  }
+
+  Catalog *AttachCompiledCatalog() {
+    Catalog *catalog = AttachCatalog();
+    EXPECT_TRUE(catalog != NULL);
+    FILE *f = fopen(compiled_path_.c_str(), "w");
+    EXPECT_TRUE(f != NULL);
+    FileSink sink(f);
+    EXPECT_TRUE(catalog->Compile(&sink));
+    fclose(f);
+    CompiledCatalog *compiled = MapCompiled();
+    EXPECT_TRUE(compiled != NULL);
+    catalog->AttachCompiled(compiled);
+    EXPECT_TRUE(catalog->HasCompiled());
+    return catalog;
+  }
+
+  string tmp_path_;
+  string catalog_path_;
+  string compiled_path_;
+  vector<string> paths_;
+  vector<string> dirs_;
+};
+
+
+TEST_F(T_CatalogCompiled, LookupAndListing) {
+  CreateCatalog(10, 20);
+  UniquePtr<Catalog> sqlite_catalog(AttachCatalog());
+  ASSERT_TRUE(sqlite_catalog.IsValid());
+  UniquePtr<Catalog> compiled_catalog(AttachCompiledCatalog());
+  ASSERT_TRUE(compiled_catalog.IsValid());
+  EXPECT_FALSE(sqlite_catalog->HasCompiled());
+
+  for (unsigned i = 0; i < paths_.size(); ++i) {
+    const PathString path(paths_[i]);
+    DirectoryEntry expected;
+    DirectoryEntry dirent;
+    ASSERT_TRUE(sqlite_catalog->LookupPath(path, &expected)) << paths_[i];
+    ASSERT_TRUE(compiled_catalog->LookupPath(path, &dirent)) << paths_[i];
+    EXPECT_EQ(expected, dirent) << paths_[i];
+    EXPECT_EQ(expected.checksum(), dirent.checksum()) << paths_[i];
+    EXPECT_EQ(expected.symlink(), dirent.symlink()) << paths_[i];
+
+    LinkString expected_raw;
+    LinkString raw;
+    ASSERT_TRUE(sqlite_catalog->LookupRawSymlink(path, &expected_raw));
+    ASSERT_TRUE(compiled_catalog->LookupRawSymlink(path, &raw));
+    EXPECT_EQ(expected_raw, raw);
+  }
+
+  DirectoryEntry dirent;
+  EXPECT_TRUE(compiled_catalog->LookupPath(PathString("/link"), &dirent));
+  EXPECT_EQ("fallback/target", dirent.symlink().ToString());
+  EXPECT_TRUE(compiled_catalog->LookupPath(PathString("/hardlink1"), &dirent));
+  EXPECT_EQ(1U, dirent.hardlink_group());
+  EXPECT_EQ(2U, dirent.linkcount());
+  EXPECT_TRUE(compiled_catalog->LookupPath(PathString("/xattrs"), &dirent));
+  EXPECT_TRUE(dirent.HasXattrs());
+  EXPECT_TRUE(compiled_catalog->LookupPath(PathString("/nested"), &dirent));
+  EXPECT_TRUE(dirent.IsNestedCatalogMountpoint());
+  EXPECT_FALSE(compiled_catalog->LookupPath(PathString("/nonexisting"), NULL));
+  EXPECT_FALSE(compiled_catalog->LookupPath(PathString("/dir0/nonexisting"),
+                                            &dirent));
+
+  for (unsigned i = 0; i < dirs_.size(); ++i) {
+    const PathString path(dirs_[i]);
+    DirectoryEntryList expected;
+    DirectoryEntryList listing;
+    EXPECT_TRUE(sqlite_catalog->ListingPath(path, &expected));
+    EXPECT_TRUE(compiled_catalog->ListingPath(path, &listing));
+    ASSERT_EQ(expected.size(), listing.size()) << dirs_[i];
+    sort(expected.begin(), expected.end(), DirentLess);
+    sort(listing.begin(), listing.end(), DirentLess);
+    for (unsigned j = 0; j < expected.size(); ++j)
+      EXPECT_EQ(expected[j], listing[j]) << dirs_[i];
+
+    StatEntryList expected_stat;
+    StatEntryList listing_stat;
+    EXPECT_TRUE(sqlite_catalog->ListingPathStat(path, &expected_stat));
+    EXPECT_TRUE(compiled_catalog->ListingPathStat(path, &listing_stat));
+    ASSERT_EQ(expected_stat.size(), listing_stat.size()) << dirs_[i];
+    const vector<StatEntry> expected_sorted = SortedListing(expected_stat);
+    const vector<StatEntry> listing_sorted = SortedListing(listing_stat);
+    for (unsigned j = 0; j < expected_sorted.size(); ++j) {
+      EXPECT_EQ(expected_sorted[j].name, listing_sorted[j].name);
+      EXPECT_EQ(expected_sorted[j].info.st_size,
+                listing_sorted[j].info.st_size);
+      EXPECT_EQ(expected_sorted[j].info.st_mode,
+                listing_sorted[j].info.st_mode);
+    }
+  }
+
+  DirectoryEntryList listing;
+  EXPECT_TRUE(compiled_catalog->ListingPath(PathString("/dir3"), &listing));
+  EXPECT_EQ(20U, listing.size());
+  listing.clear();
+  EXPECT_TRUE(compiled_catalog->ListingPath(PathString("/dir3/file1"),
+                                            &listing));
+  EXPECT_TRUE(listing.empty());
+}
+
+
+TEST_F(T_CatalogCompiled, EmptyCatalog) {
+  {
+    UniquePtr<CatalogDatabase> db(CatalogDatabase::Create(catalog_path_));
+    ASSERT_TRUE(db.IsValid());
+    ASSERT_TRUE(db->InsertInitialValues("", false));
+  }
+
+  UniquePtr<Catalog> catalog(AttachCompiledCatalog());
+  ASSERT_TRUE(catalog.IsValid());
+  EXPECT_FALSE(catalog->LookupPath(PathString(""), NULL));
+  DirectoryEntryList listing;
+  EXPECT_TRUE(catalog->ListingPath(PathString(""), &listing));
+  EXPECT_TRUE(listing.empty());
+}
+
+
+TEST_F(T_CatalogCompiled, MapCorrupted) {
+  CreateCatalog(2, 2);
+  UniquePtr<Catalog> catalog(AttachCompiledCatalog());
+  ASSERT_TRUE(catalog.IsValid());
+  const int64_t size = GetFileSize(compiled_path_);
+
+  ASSERT_EQ(0, truncate(compiled_path_.c_str(), size - 1));
+  EXPECT_EQ(static_cast<CompiledCatalog *>(NULL), MapCompiled());
+  ASSERT_EQ(0, truncate(compiled_path_.c_str(), 0));
+  EXPECT_EQ(static_cast<CompiledCatalog *>(NULL), MapCompiled());
+
+  FILE *f = fopen(compiled_path_.c_str(), "w");
+  ASSERT_TRUE(f != NULL);
+  for (int64_t i = 0; i < size; ++i)
+    fputc('x', f);
+  fclose(f);
+  EXPECT_EQ(static_cast<CompiledCatalog *>(NULL), MapCompiled());
+}
+
+
+TEST_F(T_CatalogCompiled, MapBitFlip) {
+  CreateCatalog(2, 2);
+  UniquePtr<Catalog> catalog(AttachCompiledCatalog());
+  ASSERT_TRUE(catalog.IsValid());
+  const int64_t size = GetFileSize(compiled_path_);
+
+  // A flipped bit in a record or in the string table passes the bounds checks
+  const int64_t offsets[] = {size / 2, size - 1};
+  for (unsigned i = 0; i < sizeof(offsets) / sizeof(offsets[0]); ++i) {
+    const int fd = open(compiled_path_.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    unsigned char byte;
+    ASSERT_EQ(1, pread(fd, &byte, 1, offsets[i]));
+    byte ^= 0x10;
+    ASSERT_EQ(1, pwrite(fd, &byte, 1, offsets[i]));
+    EXPECT_EQ(static_cast<CompiledCatalog *>(NULL), MapCompiled());
+    byte ^= 0x10;
+    ASSERT_EQ(1, pwrite(fd, &byte, 1, offsets[i]));
+    close(fd);
+    UniquePtr<CompiledCatalog> compiled(MapCompiled());
+    EXPECT_TRUE(compiled.IsValid());
+  }
+}
+
+
+/**
+ * Compares random lookups and listings of both backends on a catalog with
+ * a million entries
+ */
+TEST_F(T_CatalogCompiled, BenchmarkSlow) {
+  const unsigned kNumDirs = 1000;
+  const unsigned kNumFiles = 1000;
+  const unsigned kNumLookups = 1000000;
+  CreateCatalog(kNumDirs, kNumFiles);
+  UniquePtr<Catalog> sqlite_catalog(AttachCatalog());
+  ASSERT_TRUE(sqlite_catalog.IsValid());
+  StopWatch stopwatch;
+  stopwatch.Start();
+  UniquePtr<Catalog> compiled_catalog(AttachCompiledCatalog());
+  stopwatch.Stop();
+  ASSERT_TRUE(compiled_catalog.IsValid());
+  printf("compiled %u entries in %.2fs (%" PRId64 " bytes)\n",
+         unsigned(paths_.size()), stopwatch.GetTime(),
+         GetFileSize(compiled_path_));
+
+  Catalog *catalogs[] = {sqlite_catalog.weak_ref(),
+                         compiled_catalog.weak_ref()};
+  const char *names[] = {"sqlite", "compiled"};
+  for (unsigned c = 0; c < 2; ++c) {
+    Prng prng;
+    prng.InitSeed(42);
+    DirectoryEntry dirent;
+    stopwatch.Reset();
+    stopwatch.Start();
+    for (unsigned i = 0; i < kNumLookups; ++i) {
+      const PathString path(paths_[prng.Next(paths_.size())]);
+      ASSERT_TRUE(catalogs[c]->LookupPath(path, &dirent));
+    }
+    stopwatch.Stop();
+    printf("%s: %.0f lookups/s\n", names[c], kNumLookups / stopwatch.GetTime());
+
+    stopwatch.Reset();
+    stopwatch.Start();
+    uint64_t num_listed = 0;
+    for (unsigned i = 0; i < dirs_.size(); ++i) {
+      StatEntryList listing;
+      catalogs[c]->ListingPathStat(PathString(dirs_[i]), &listing);
+      num_listed += listing.size();
+    }
+    stopwatch.Stop();
+    printf("%s: %.0f listed entries/s\n", names[c],
+           num_listed / stopwatch.GetTime());
+  }
+}
+
+}  // namespace catalog
@@ -0,0 +1,281 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../../cvmfs/catalog_delta.h"
+#include "../../cvmfs/compression.h"
+#include "../../cvmfs/hash.h"
+#include "../../cvmfs/prng.h"
+#include "../../cvmfs/sink.h"
+#include "../../cvmfs/util.h"
+
+using namespace std;  // NOLINT
+
+namespace catalog {
+
+class T_CatalogDelta : public ::testing::Test {
+ protected:
+  typedef vector<unsigned char> Content;
+
+  class FileReader : public CatalogDelta::BaseReader {
+   public:
+    explicit FileReader(const string &path) {
+      fd_ = open(path.c_str(), O_RDONLY);
+      EXPECT_GE(fd_, 0);
+    }
+    ~FileReader() { close(fd_); }
+    virtual int64_t Pread(void *buf, uint64_t size, uint64_t offset) {
+      return pread(fd_, buf, size, offset);
+    }
+
+   private:
+    int fd_;
+  };
+
+  class MemorySink : public cvmfs::Sink {
+   public:
+    virtual int64_t Write(const void *buf, uint64_t sz) {
+      const unsigned char *data = static_cast<const unsigned char *>(buf);
+      content.insert(content.end(), data, data + sz);
+      return sz;
+    }
+    virtual int Reset() { content.clear(); return 0; }
+    Content content;
+  };
+
+  virtual void SetUp() {
+    tmp_path_ = CreateTempDir("/tmp/cvmfs-test");
+    ASSERT_NE("", tmp_path_);
+    prng_.InitSeed(42);
+  }
+
+  virtual void TearDown() {
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+  }
+
+  string WriteRevision(const Content &content, const unsigned revision) {
+    const string path = tmp_path_ + "/catalog." + StringifyInt(revision);
+    FILE *f = fopen(path.c_str(), "w");
+    EXPECT_TRUE(f != NULL);
+    if (!content.empty())
+      EXPECT_EQ(content.size(), fwrite(&content[0], 1, content.size(), f));
+    fclose(f);
+    return path;
+  }
+
+  shash::Any HashRevision(const string &path) {
+    shash::Any hash(shash::kSha1, shash::kSuffixCatalog);
+    EXPECT_TRUE(zlib::CompressPath2Path(path, path + ".compressed", &hash));
+    unlink((path + ".compressed").c_str());
+    return hash;
+  }
+
+  shash::Any ContentHash(const string &path) {
+    shash::Any hash(shash::kSha1);
+    EXPECT_TRUE(shash::HashFile(path, &hash));
+    return hash;
+  }
+
+  CatalogDelta *SaveAndParse(const CatalogDelta &delta) {
+    const string path = tmp_path_ + "/delta";
+    EXPECT_TRUE(delta.Save(path));
+    EXPECT_EQ(delta.size(), static_cast<uint64_t>(GetFileSize(path)));
+    unsigned char *buffer;
+    unsigned buffer_size;
+    EXPECT_TRUE(CopyPath2Mem(path, &buffer, &buffer_size));
+    CatalogDelta *result = CatalogDelta::Parse(buffer, buffer_size);
+    free(buffer);
+    return result;
+  }
+
+  void Scribble(const uint64_t offset, const unsigned length,
+                Content *content)
+  {
+    for (unsigned i = 0; i < length; ++i)
+      (*content)[offset + i] = prng_.Next(256);
+  }
+
+  string tmp_path_;
+  Prng prng_;
+};
+
+
+TEST_F(T_CatalogDelta, RoundTripRevisions) {
+  const unsigned kBlockSize = CatalogDelta::kBlockSize;
+  Content content(200 * kBlockSize);
+  Scribble(0, content.size(), &content);
+  string base_path = WriteRevision(content, 0);
+  shash::Any base_hash = HashRevision(base_path);
+
+  for (unsigned revision = 1; revision <= 6; ++revision) {
+    switch (revision) {
+      case 1:  // Change a single byte
+        content[3 * kBlockSize + 17]++;
+        break;
+      case 2:  // Append pages and a partial page
+        content.resize(content.size() + 5 * kBlockSize + 123);
+        Scribble(content.size() - 5 * kBlockSize - 123, 5 * kBlockSize + 123,
+                 &content);
+        break;
+      case 3:  // Changes spanning block boundaries
+        Scribble(10 * kBlockSize - 5, 10, &content);
+        Scribble(100 * kBlockSize + 4000, 3 * kBlockSize, &content);
+        break;
+      case 4:  // Shrink
+        content.resize(150 * kBlockSize + 7);
+        break;
+      case 5:  // No change
+        break;
+      case 6:  // Grow again with zeros
+        content.resize(160 * kBlockSize, 0);
+        break;
+    }
+    const string target_path = WriteRevision(content, revision);
+    const shash::Any target_hash = HashRevision(target_path);
+
+    UniquePtr<CatalogDelta> delta(
+      CatalogDelta::Create(base_path, base_hash, target_path));
+    ASSERT_TRUE(delta.IsValid());
+    EXPECT_LT(delta->size(), content.size() / 4);
+    UniquePtr<CatalogDelta> parsed(SaveAndParse(*delta));
+    ASSERT_TRUE(parsed.IsValid());
+    EXPECT_EQ(base_hash, parsed->base_hash());
+    EXPECT_EQ(static_cast<uint64_t>(GetFileSize(base_path)),
+              parsed->base_size());
+    EXPECT_EQ(content.size(), parsed->target_size());
+    EXPECT_EQ(delta->num_blocks(), parsed->num_blocks());
+
+    FileReader base(base_path);
+    MemorySink sink;
+    shash::Any reconstructed_hash(shash::kSha1);
+    ASSERT_TRUE(parsed->Apply(&base, &sink, &reconstructed_hash));
+    EXPECT_EQ(content, sink.content) << "revision " << revision;
+    EXPECT_EQ(ContentHash(target_path), reconstructed_hash)
+      << "revision " << revision;
+
+    base_path = target_path;
+    base_hash = target_hash;
+  }
+}
+
+
+TEST_F(T_CatalogDelta, ChangedBlocks) {
+  const unsigned kBlockSize = CatalogDelta::kBlockSize;
+  Content content(10 * kBlockSize);
+  Scribble(0, content.size(), &content);
+  const string base_path = WriteRevision(content, 0);
+  content[0]++;
+  content[5 * kBlockSize]++;
+  content[6 * kBlockSize - 1]++;
+  const string target_path = WriteRevision(content, 1);
+
+  UniquePtr<CatalogDelta> delta(
+    CatalogDelta::Create(base_path, HashRevision(base_path), target_path));
+  ASSERT_TRUE(delta.IsValid());
+  EXPECT_EQ(2U, delta->num_blocks());
+  EXPECT_FALSE(delta->IsPlaceholder());
+
+  UniquePtr<CatalogDelta> identical(
+    CatalogDelta::Create(target_path, HashRevision(target_path), target_path));
+  ASSERT_TRUE(identical.IsValid());
+  EXPECT_EQ(0U, identical->num_blocks());
+
+  EXPECT_EQ(static_cast<CatalogDelta *>(NULL), CatalogDelta::Create(
+    tmp_path_ + "/no_such_file", HashRevision(base_path), target_path));
+}
+
+
+TEST_F(T_CatalogDelta, WrongBase) {
+  Content content(20 * CatalogDelta::kBlockSize);
+  Scribble(0, content.size(), &content);
+  const string base_path = WriteRevision(content, 0);
+  content[42]++;
+  const string target_path = WriteRevision(content, 1);
+  Scribble(0, content.size(), &content);
+  const string other_path = WriteRevision(content, 2);
+
+  UniquePtr<CatalogDelta> delta(
+    CatalogDelta::Create(base_path, HashRevision(base_path), target_path));
+  ASSERT_TRUE(delta.IsValid());
+  FileReader other(other_path);
+  MemorySink sink;
+  shash::Any reconstructed_hash(shash::kSha1);
+  ASSERT_TRUE(delta->Apply(&other, &sink, &reconstructed_hash));
+  EXPECT_NE(ContentHash(target_path), reconstructed_hash);
+}
+
+
+TEST_F(T_CatalogDelta, Placeholder) {
+  UniquePtr<CatalogDelta> placeholder(CatalogDelta::CreatePlaceholder(1000));
+  EXPECT_TRUE(placeholder->IsPlaceholder());
+  UniquePtr<CatalogDelta> parsed(SaveAndParse(*placeholder));
+  ASSERT_TRUE(parsed.IsValid());
+  EXPECT_TRUE(parsed->IsPlaceholder());
+  EXPECT_EQ(1000U, parsed->target_size());
+  EXPECT_EQ(0U, parsed->num_blocks());
+}
+
+
+TEST_F(T_CatalogDelta, ParseCorrupted) {
+  Content content(4 * CatalogDelta::kBlockSize);
+  Scribble(0, content.size(), &content);
+  const string base_path = WriteRevision(content, 0);
+  content[0]++;
+  const string target_path = WriteRevision(content, 1);
+  UniquePtr<CatalogDelta> delta(
+    CatalogDelta::Create(base_path, HashRevision(base_path), target_path));
+  ASSERT_TRUE(delta.IsValid());
+
+  const string path = tmp_path_ + "/delta";
+  ASSERT_TRUE(delta->Save(path));
+  unsigned char *buffer;
+  unsigned buffer_size;
+  ASSERT_TRUE(CopyPath2Mem(path, &buffer, &buffer_size));
+  EXPECT_EQ(static_cast<CatalogDelta *>(NULL),
+            CatalogDelta::Parse(buffer, buffer_size - 1));
+  EXPECT_EQ(static_cast<CatalogDelta *>(NULL),
+            CatalogDelta::Parse(buffer, 10));
+  buffer[0]++;
+  EXPECT_EQ(static_cast<CatalogDelta *>(NULL),
+            CatalogDelta::Parse(buffer, buffer_size));
+  free(buffer);
+}
+
+
+TEST_F(T_CatalogDelta, Reference) {
+  Content content(2 * CatalogDelta::kBlockSize);
+  Scribble(0, content.size(), &content);
+  const string path = WriteRevision(content, 0);
+  const shash::Any base_hash = HashRevision(path);
+  const shash::Any content_hash = ContentHash(path);
+
+  const string reference = CatalogDelta::MakeReference(base_hash,
+                                                       content_hash);
+  shash::Any parsed_base;
+  shash::Any parsed_content;
+  ASSERT_TRUE(CatalogDelta::ParseReference(reference, &parsed_base,
+                                           &parsed_content));
+  EXPECT_EQ(base_hash, parsed_base);
+  EXPECT_EQ(shash::kSuffixCatalog, parsed_base.suffix);
+  EXPECT_EQ(content_hash, parsed_content);
+
+  EXPECT_FALSE(CatalogDelta::ParseReference("", &parsed_base,
+                                            &parsed_content));
+  EXPECT_FALSE(CatalogDelta::ParseReference(base_hash.ToString(),
+                                            &parsed_base, &parsed_content));
+  EXPECT_FALSE(CatalogDelta::ParseReference(
+    base_hash.ToString() + ":xyz", &parsed_base, &parsed_content));
+}
+
+}  // namespace catalog
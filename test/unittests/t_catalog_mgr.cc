@@ -0,0 +1,227 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "../../cvmfs/catalog.h"
+#include "../../cvmfs/catalog_mgr.h"
+#include "../../cvmfs/catalog_sql.h"
+#include "../../cvmfs/hash.h"
+#include "../../cvmfs/statistics.h"
+#include "../../cvmfs/util.h"
+#include "testutil.h"
+
+using namespace std;  // NOLINT
+
+namespace catalog {
+
+/**
+ * Serves catalogs from files in a directory, keyed by their (fake) hash.
+ */
+class TestCatalogManager : public AbstractCatalogManager {
+ public:
+  TestCatalogManager(const map<shash::Any, string> &files,
+                     const shash::Any &root_hash,
+                     perf::Statistics *statistics)
+    : AbstractCatalogManager(statistics)
+    , files_(files)
+    , root_hash_(root_hash)
+    , num_pinned_(0)
+  {
+    int retval = pthread_mutex_init(&lock_warmed_, NULL);
+    assert(retval == 0);
+  }
+  ~TestCatalogManager() { pthread_mutex_destroy(&lock_warmed_); }
+
+  set<string> warmed() { return warmed_; }
+  unsigned num_pinned() { return num_pinned_; }
+
+ protected:
+  LoadError LoadCatalog(const PathString &mountpoint,
+                        const shash::Any &hash,
+                        string *catalog_path,
+                        shash::Any *catalog_hash)
+  {
+    *catalog_hash = hash.IsNull() ? root_hash_ : hash;
+    return Lookup(*catalog_hash, catalog_path);
+  }
+
+  Catalog *CreateCatalog(const PathString &mountpoint,
+                         const shash::Any &catalog_hash,
+                         Catalog *parent_catalog)
+  {
+    return new Catalog(mountpoint, catalog_hash, parent_catalog);
+  }
+
+  LoadError WarmCatalog(const PathString &mountpoint,
+                        const shash::Any &hash,
+                        const bool pin,
+                        Catalog::NestedCatalogList *nested_catalogs)
+  {
+    pthread_mutex_lock(&lock_warmed_);
+    warmed_.insert(mountpoint.ToString());
+    if (pin)
+      num_pinned_++;
+    pthread_mutex_unlock(&lock_warmed_);
+    string catalog_path;
+    const LoadError retval = Lookup(hash, &catalog_path);
+    if (retval != kLoadNew)
+      return retval;
+    return ListNestedCatalogsFreely(mountpoint, hash, catalog_path,
+                                    nested_catalogs) ? kLoadNew : kLoadFail;
+  }
+
+ private:
+  LoadError Lookup(const shash::Any &hash, string *catalog_path) {
+    map<shash::Any, string>::const_iterator i = files_.find(hash);
+    if ((i == files_.end()) || !FileExists(i->second))
+      return kLoadFail;
+    *catalog_path = i->second;
+    return kLoadNew;
+  }
+
+  map<shash::Any, string> files_;
+  shash::Any root_hash_;
+  set<string> warmed_;
+  unsigned num_pinned_;
+  pthread_mutex_t lock_warmed_;
+};
+
+
+class T_CatalogMgr : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    tmp_path_ = CreateTempDir("/tmp/cvmfs_test");
+    ASSERT_NE("", tmp_path_);
+
+    // Created bottom-up because parents reference the hashes of their nested
+    // catalogs
+    CreateCatalog("/a/y/z");
+    CreateCatalog("/a/y", "/a/y/z");
+    CreateCatalog("/a/x");
+    CreateCatalog("/a", "/a/x", "/a/y");
+    CreateCatalog("/ab");
+    CreateCatalog("/b/w");
+    CreateCatalog("/b", "/b/w");
+    CreateCatalog("", "/a", "/ab", "/b");
+
+    catalog_mgr_ =
+      new TestCatalogManager(files_, hashes_[""], &statistics_);
+    ASSERT_TRUE(catalog_mgr_->Init());
+  }
+
+  virtual void TearDown() {
+    delete catalog_mgr_;
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+  }
+
+  void CreateCatalog(const string &mountpoint,
+                     const string &nested1 = "",
+                     const string &nested2 = "",
+                     const string &nested3 = "")
+  {
+    shash::Any hash(shash::kSha1, shash::kSuffixCatalog);
+    shash::HashString("catalog" + mountpoint, &hash);
+    const string path = tmp_path_ + "/" + hash.ToString();
+
+    CatalogDatabase *db = CatalogDatabase::Create(path);
+    ASSERT_TRUE(db != NULL);
+    ASSERT_TRUE(db->InsertInitialValues(
+      mountpoint, false, DirectoryEntryTestFactory::Directory()));
+    const string nested[] = {nested1, nested2, nested3};
+    for (unsigned i = 0; i < 3; ++i) {
+      if (nested[i].empty())
+        continue;
+      sqlite::Sql sql(db->sqlite_db(),
+        "INSERT INTO nested_catalogs (path, sha1, size) VALUES (:p, :h, 0);");
+      ASSERT_TRUE(sql.BindText(1, nested[i]) &&
+                  sql.BindTextTransient(2, hashes_[nested[i]].ToString()) &&
+                  sql.Execute());
+    }
+    delete db;
+
+    hashes_[mountpoint] = hash;
+    files_[hash] = path;
+  }
+
+  set<string> MakeSet(const string &s1, const string &s2 = "",
+                      const string &s3 = "")
+  {
+    set<string> result;
+    result.insert(s1);
+    if (!s2.empty()) result.insert(s2);
+    if (!s3.empty()) result.insert(s3);
+    return result;
+  }
+
+  perf::Statistics statistics_;
+  TestCatalogManager *catalog_mgr_;
+  string tmp_path_;
+  map<string, shash::Any> hashes_;
+  map<shash::Any, string> files_;
+};
+
+
+TEST_F(T_CatalogMgr, WarmSubtree) {
+  unsigned num_warmed;
+  EXPECT_TRUE(catalog_mgr_->WarmSubtree(PathString("/a"), false, 4,
+                                        &num_warmed));
+  EXPECT_EQ(3U, num_warmed);
+  EXPECT_EQ(MakeSet("/a/x", "/a/y", "/a/y/z"), catalog_mgr_->warmed());
+  EXPECT_EQ(0U, catalog_mgr_->num_pinned());
+  // Only the catalog serving the prefix is mounted
+  EXPECT_EQ(2, catalog_mgr_->GetNumCatalogs());
+  EXPECT_EQ(3, statistics_.Lookup("catalog_mgr.n_warmed")->Get());
+}
+
+
+TEST_F(T_CatalogMgr, WarmSubtreeRoot) {
+  unsigned num_warmed;
+  EXPECT_TRUE(catalog_mgr_->WarmSubtree(PathString(""), true, 2,
+                                        &num_warmed));
+  EXPECT_EQ(7U, num_warmed);
+  EXPECT_EQ(7U, catalog_mgr_->num_pinned());
+  EXPECT_EQ(1, catalog_mgr_->GetNumCatalogs());
+}
+
+
+TEST_F(T_CatalogMgr, WarmSubtreeNested) {
+  unsigned num_warmed;
+  EXPECT_TRUE(catalog_mgr_->WarmSubtree(PathString("/a/y/z/dir"), false, 1,
+                                        &num_warmed));
+  EXPECT_EQ(0U, num_warmed);
+  EXPECT_TRUE(catalog_mgr_->warmed().empty());
+  EXPECT_EQ(4, catalog_mgr_->GetNumCatalogs());
+
+  EXPECT_TRUE(catalog_mgr_->WarmSubtree(PathString("/b"), false, 1,
+                                        &num_warmed));
+  EXPECT_EQ(1U, num_warmed);
+  EXPECT_EQ(MakeSet("/b/w"), catalog_mgr_->warmed());
+}
+
+
+TEST_F(T_CatalogMgr, WarmSubtreeFailure) {
+  unlink(files_[hashes_["/a/y"]].c_str());
+  unsigned num_warmed;
+  EXPECT_FALSE(catalog_mgr_->WarmSubtree(PathString("/a"), false, 4,
+                                         &num_warmed));
+  EXPECT_EQ(1U, num_warmed);
+  EXPECT_EQ(MakeSet("/a/x", "/a/y"), catalog_mgr_->warmed());
+
+  // The prefix itself cannot be mounted
+  unlink(files_[hashes_["/b"]].c_str());
+  EXPECT_FALSE(catalog_mgr_->WarmSubtree(PathString("/b/w"), false, 4,
+                                         &num_warmed));
+  EXPECT_EQ(0U, num_warmed);
+}
+
+}  // namespace catalog
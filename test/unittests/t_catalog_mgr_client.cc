@@ -0,0 +1,528 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../../cvmfs/backoff.h"
+#include "../../cvmfs/cache.h"
+#include "../../cvmfs/catalog_delta.h"
+#include "../../cvmfs/catalog_mgr_client.h"
+#include "../../cvmfs/catalog_sql.h"
+#include "../../cvmfs/compression.h"
+#include "../../cvmfs/download.h"
+#include "../../cvmfs/fetch.h"
+#include "../../cvmfs/hash.h"
+#include "../../cvmfs/sqlitevfs.h"
+#include "../../cvmfs/statistics.h"
+#include "../../cvmfs/util.h"
+#include "testutil.h"
+
+using namespace std;  // NOLINT
+
+namespace catalog {
+
+/**
+ * Serves a root catalog with a nested catalog at /nested from a file:// host
+ * chain.  The nested catalog has two revisions, the second one can be
+ * reconstructed from the first one with a catalog delta.
+ */
+class T_CatalogMgrClient : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    tmp_path_ = CreateTempDir("/tmp/cvmfs_test");
+    ASSERT_NE("", tmp_path_);
+    server_path_ = tmp_path_ + "/server";
+    ASSERT_TRUE(MkdirDeep(server_path_ + "/data", 0700));
+    ASSERT_TRUE(MkdirDeep(tmp_path_ + "/cache", 0700));
+    vfs_registered_ = false;
+
+    cache_mgr_ = cache::PosixCacheManager::Create(tmp_path_ + "/cache", false);
+    ASSERT_TRUE(cache_mgr_ != NULL);
+    download_mgr_ = new download::DownloadManager();
+    download_mgr_->Init(8, false, &statistics_);
+    download_mgr_->SetHostChain("file://" + server_path_);
+    fetcher_ = new cvmfs::Fetcher(
+      cache_mgr_, download_mgr_, &backoff_throttle_, &statistics_);
+
+    nested1_path_ = CreateCatalog("nested.1", "/nested");
+    ASSERT_TRUE(CopyPath2Path(nested1_path_, tmp_path_ + "/nested.2"));
+    nested2_path_ = tmp_path_ + "/nested.2";
+    CatalogDatabase *db =
+      CatalogDatabase::Open(nested2_path_, CatalogDatabase::kOpenReadWrite);
+    ASSERT_TRUE(db != NULL);
+    EXPECT_TRUE(db->SetProperty("revision", 2));
+    delete db;
+  }
+
+  virtual void TearDown() {
+    if (vfs_registered_)
+      EXPECT_TRUE(sqlite::UnregisterVfsRdOnly());
+    delete fetcher_;
+    download_mgr_->Fini();
+    delete download_mgr_;
+    delete cache_mgr_;
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+  }
+
+  string CreateCatalog(const string &name, const string &root_path) {
+    const string path = tmp_path_ + "/" + name;
+    CatalogDatabase *db = CatalogDatabase::Create(path);
+    EXPECT_TRUE(db != NULL);
+    EXPECT_TRUE(db->InsertInitialValues(
+      root_path, false, DirectoryEntryTestFactory::Directory()));
+    delete db;
+    return path;
+  }
+
+  /**
+   * Creates a root catalog that refers to the given nested catalog and its
+   * delta reference.
+   */
+  shash::Any PublishRoot(const string &name,
+                         const shash::Any &nested_hash,
+                         const string &delta_reference,
+                         const shash::Any &previous_hash = shash::Any())
+  {
+    const string path = CreateCatalog(name, "");
+    CatalogDatabase *db =
+      CatalogDatabase::Open(path, CatalogDatabase::kOpenReadWrite);
+    EXPECT_TRUE(db != NULL);
+    sqlite::Sql sql(db->sqlite_db(),
+      "INSERT INTO nested_catalogs (path, sha1, size) VALUES (:p, :h, 0);");
+    EXPECT_TRUE(sql.BindText(1, "/nested") &&
+                sql.BindTextTransient(2, nested_hash.ToString()) &&
+                sql.Execute());
+    if (!delta_reference.empty())
+      EXPECT_TRUE(db->SetProperty("nested_delta:/nested", delta_reference));
+    if (!previous_hash.IsNull()) {
+      EXPECT_TRUE(
+        db->SetProperty("previous_revision", previous_hash.ToString()));
+    }
+    delete db;
+    return Publish(path, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  }
+
+  /**
+   * Compresses with the given zlib level and stores the result on the server
+   */
+  shash::Any Publish(const string &path, const int level,
+                     const shash::Suffix suffix)
+  {
+    unsigned char *buf;
+    unsigned buf_size;
+    EXPECT_TRUE(CopyPath2Mem(path, &buf, &buf_size));
+    uLongf compressed_size = compressBound(buf_size);
+    unsigned char *compressed =
+      reinterpret_cast<unsigned char *>(malloc(compressed_size));
+    EXPECT_EQ(Z_OK,
+              compress2(compressed, &compressed_size, buf, buf_size, level));
+    free(buf);
+    shash::Any hash(shash::kSha1, suffix);
+    shash::HashMem(compressed, compressed_size, &hash);
+    const string dest = server_path_ + "/data/" + hash.MakePath();
+    EXPECT_TRUE(MkdirDeep(GetParentPath(dest), 0700));
+    EXPECT_TRUE(CopyMem2Path(compressed, compressed_size, dest));
+    free(compressed);
+    return hash;
+  }
+
+  void PublishDelta(const shash::Any &base_hash, const shash::Any &hash) {
+    UniquePtr<CatalogDelta> delta(
+      CatalogDelta::Create(nested1_path_, base_hash, nested2_path_));
+    ASSERT_TRUE(delta.IsValid());
+    const string delta_path = tmp_path_ + "/nested.delta";
+    ASSERT_TRUE(delta->Save(delta_path));
+    shash::Any delta_hash(hash);
+    delta_hash.suffix = shash::kSuffixDelta;
+    const string dest = server_path_ + "/data/" + delta_hash.MakePath();
+    ASSERT_TRUE(zlib::CompressPath2Path(delta_path, dest));
+  }
+
+  shash::Any ContentHash(const string &path) {
+    shash::Any hash(shash::kSha1);
+    EXPECT_TRUE(shash::HashFile(path, &hash));
+    return hash;
+  }
+
+  /**
+   * Required for the "@<fd>" catalog paths; catalogs can't be created anymore
+   * afterwards.
+   */
+  void RegisterVfs() {
+    ASSERT_TRUE(sqlite::RegisterVfsRdOnly(
+      cache_mgr_, &statistics_, sqlite::kVfsOptDefault, 0));
+    vfs_registered_ = true;
+  }
+
+  /**
+   * Mounts the root catalog with a fresh catalog manager and looks up the
+   * nested catalog.
+   */
+  bool MountNested(const shash::Any &root_hash, perf::Statistics *statistics) {
+    ClientCatalogManager catalog_mgr("test", fetcher_, NULL, statistics);
+    catalog_mgr.EnableCatalogDeltas();
+    if (!catalog_mgr.InitFixed(root_hash))
+      return false;
+    DirectoryEntry dirent;
+    return catalog_mgr.LookupPath(PathString("/nested"), kLookupSole, &dirent)
+           && (catalog_mgr.GetNumCatalogs() == 2);
+  }
+
+  int64_t Counter(perf::Statistics *statistics, const string &name) {
+    return statistics->Lookup(name)->Get();
+  }
+
+  /**
+   * Publishes revision 1 and 2 of the nested catalog and mounts revision 1,
+   * so that it is in the cache.  Returns the root catalog of revision 2.
+   */
+  shash::Any PrepareUpdate(const int level,
+                           const bool correct_content_hash,
+                           shash::Any *nested2_hash)
+  {
+    const shash::Any nested1_hash =
+      Publish(nested1_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+    *nested2_hash = Publish(nested2_path_, level, shash::kSuffixCatalog);
+    PublishDelta(nested1_hash, *nested2_hash);
+    const shash::Any root1_hash = PublishRoot("root.1", nested1_hash, "");
+    const string reference = CatalogDelta::MakeReference(nested1_hash,
+      ContentHash(correct_content_hash ? nested2_path_ : nested1_path_));
+    const shash::Any root2_hash =
+      PublishRoot("root.2", *nested2_hash, reference);
+    RegisterVfs();
+
+    perf::Statistics statistics;
+    EXPECT_TRUE(MountNested(root1_hash, &statistics));
+    EXPECT_EQ(0, Counter(&statistics, "catalog_delta.n_applied"));
+    return root2_hash;
+  }
+
+  /**
+   * Waits for the compiler thread to update the counter
+   */
+  bool WaitForCounter(perf::Statistics *statistics,
+                      const string &name,
+                      const int64_t value)
+  {
+    for (unsigned i = 0; i < 1000; ++i) {
+      if (Counter(statistics, name) >= value)
+        return Counter(statistics, name) == value;
+      SafeSleepMs(10);
+    }
+    return false;
+  }
+
+  string CompiledPath(const shash::Any &hash) {
+    return tmp_path_ + "/cache/compiled/" + hash.ToString();
+  }
+
+  /**
+   * Mounts the root catalog with compiled catalogs and waits until the root
+   * catalog is compiled
+   */
+  void Compile(const shash::Any &root_hash) {
+    perf::Statistics statistics;
+    ClientCatalogManager catalog_mgr("test", fetcher_, NULL, &statistics);
+    catalog_mgr.EnableCompiledCatalogs();
+    catalog_mgr.Spawn();
+    ASSERT_TRUE(catalog_mgr.InitFixed(root_hash));
+    EXPECT_TRUE(WaitForCounter(&statistics, "catalog_compiled.n_mapped", 1));
+    EXPECT_EQ(1, Counter(&statistics, "catalog_compiled.n_compiled"));
+  }
+
+  void RemoveFromServer(const shash::Any &hash) {
+    EXPECT_EQ(0, unlink((server_path_ + "/data/" + hash.MakePath()).c_str()));
+  }
+
+  string tmp_path_;
+  string server_path_;
+  string nested1_path_;
+  string nested2_path_;
+  bool vfs_registered_;
+  perf::Statistics statistics_;
+  BackoffThrottle backoff_throttle_;
+  cache::PosixCacheManager *cache_mgr_;
+  download::DownloadManager *download_mgr_;
+  cvmfs::Fetcher *fetcher_;
+};
+
+
+TEST_F(T_CatalogMgrClient, DeltaApplied) {
+  shash::Any nested2_hash;
+  const shash::Any root2_hash =
+    PrepareUpdate(Z_DEFAULT_COMPRESSION, true, &nested2_hash);
+  // Only the catalog delta is left to get revision 2 of the nested catalog
+  RemoveFromServer(nested2_hash);
+
+  perf::Statistics statistics;
+  EXPECT_TRUE(MountNested(root2_hash, &statistics));
+  EXPECT_EQ(1, Counter(&statistics, "catalog_delta.n_applied"));
+  EXPECT_EQ(0, Counter(&statistics, "catalog_delta.n_fallbacks"));
+}
+
+
+TEST_F(T_CatalogMgrClient, DeltaOtherCompressionLevel) {
+  // The client compresses with its default level, the verification must not
+  // depend on the zlib of the server
+  shash::Any nested2_hash;
+  const shash::Any root2_hash =
+    PrepareUpdate(Z_BEST_SPEED, true, &nested2_hash);
+  RemoveFromServer(nested2_hash);
+
+  perf::Statistics statistics;
+  EXPECT_TRUE(MountNested(root2_hash, &statistics));
+  EXPECT_EQ(1, Counter(&statistics, "catalog_delta.n_applied"));
+}
+
+
+TEST_F(T_CatalogMgrClient, DeltaVerificationFails) {
+  shash::Any nested2_hash;
+  const shash::Any root2_hash =
+    PrepareUpdate(Z_DEFAULT_COMPRESSION, false, &nested2_hash);
+
+  perf::Statistics statistics;
+  EXPECT_TRUE(MountNested(root2_hash, &statistics));
+  EXPECT_EQ(0, Counter(&statistics, "catalog_delta.n_applied"));
+  EXPECT_EQ(1, Counter(&statistics, "catalog_delta.n_fallbacks"));
+}
+
+
+TEST_F(T_CatalogMgrClient, DeltaBaseNotCached) {
+  const shash::Any nested2_hash =
+    Publish(nested2_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  const shash::Any nested1_hash =
+    Publish(nested1_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  PublishDelta(nested1_hash, nested2_hash);
+  const shash::Any root2_hash = PublishRoot("root.2", nested2_hash,
+    CatalogDelta::MakeReference(nested1_hash, ContentHash(nested2_path_)));
+  RegisterVfs();
+
+  perf::Statistics statistics;
+  EXPECT_TRUE(MountNested(root2_hash, &statistics));
+  EXPECT_EQ(0, Counter(&statistics, "catalog_delta.n_applied"));
+  EXPECT_EQ(1, Counter(&statistics, "catalog_delta.n_fallbacks"));
+}
+
+
+TEST_F(T_CatalogMgrClient, NoDeltaReference) {
+  const shash::Any nested1_hash =
+    Publish(nested1_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  const shash::Any nested2_hash =
+    Publish(nested2_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  const shash::Any root1_hash = PublishRoot("root.1", nested1_hash, "");
+  const shash::Any root2_hash = PublishRoot("root.2", nested2_hash, "");
+  RegisterVfs();
+
+  perf::Statistics statistics1;
+  EXPECT_TRUE(MountNested(root1_hash, &statistics1));
+  perf::Statistics statistics2;
+  EXPECT_TRUE(MountNested(root2_hash, &statistics2));
+  EXPECT_EQ(0, Counter(&statistics2, "catalog_delta.n_applied"));
+  EXPECT_EQ(0, Counter(&statistics2, "catalog_delta.n_fallbacks"));
+}
+
+
+
+TEST_F(T_CatalogMgrClient, CompiledLoad) {
+  const shash::Any nested1_hash =
+    Publish(nested1_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  const shash::Any root1_hash = PublishRoot("root.1", nested1_hash, "");
+  RegisterVfs();
+
+  perf::Statistics statistics1;
+  ClientCatalogManager catalog_mgr1("test", fetcher_, NULL, &statistics1);
+  catalog_mgr1.EnableCompiledCatalogs();
+  catalog_mgr1.Spawn();
+  ASSERT_TRUE(catalog_mgr1.InitFixed(root1_hash));
+  DirectoryEntry dirent;
+  EXPECT_TRUE(
+    catalog_mgr1.LookupPath(PathString("/nested"), kLookupSole, &dirent));
+  EXPECT_TRUE(WaitForCounter(&statistics1, "catalog_compiled.n_mapped", 2));
+  EXPECT_EQ(2, Counter(&statistics1, "catalog_compiled.n_compiled"));
+  EXPECT_TRUE(
+    catalog_mgr1.LookupPath(PathString("/nested"), kLookupSole, &dirent));
+  EXPECT_TRUE(FileExists(CompiledPath(root1_hash)));
+  EXPECT_TRUE(FileExists(CompiledPath(nested1_hash)));
+
+  // Compiled catalogs are mapped right away on the next mount, no compiler
+  // thread required
+  perf::Statistics statistics2;
+  ClientCatalogManager catalog_mgr2("test", fetcher_, NULL, &statistics2);
+  catalog_mgr2.EnableCompiledCatalogs();
+  ASSERT_TRUE(catalog_mgr2.InitFixed(root1_hash));
+  EXPECT_TRUE(
+    catalog_mgr2.LookupPath(PathString("/nested"), kLookupSole, &dirent));
+  EXPECT_EQ(2, Counter(&statistics2, "catalog_compiled.n_mapped"));
+  EXPECT_EQ(0, Counter(&statistics2, "catalog_compiled.n_compiled"));
+}
+
+
+TEST_F(T_CatalogMgrClient, CompiledCorrupted) {
+  const shash::Any nested1_hash =
+    Publish(nested1_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  const shash::Any root1_hash = PublishRoot("root.1", nested1_hash, "");
+  RegisterVfs();
+  Compile(root1_hash);
+
+  const string path = CompiledPath(root1_hash);
+  const int64_t size = GetFileSize(path);
+  ASSERT_GT(size, 0);
+  FILE *f = fopen(path.c_str(), "r+");
+  ASSERT_TRUE(f != NULL);
+  ASSERT_EQ(0, fseek(f, size - 1, SEEK_SET));
+  const int byte = fgetc(f);
+  ASSERT_EQ(0, fseek(f, size - 1, SEEK_SET));
+  fputc(byte ^ 0x01, f);
+  fclose(f);
+
+  // Falls back to sqlite and removes the corrupted file
+  perf::Statistics statistics;
+  ClientCatalogManager catalog_mgr("test", fetcher_, NULL, &statistics);
+  catalog_mgr.EnableCompiledCatalogs();
+  ASSERT_TRUE(catalog_mgr.InitFixed(root1_hash));
+  EXPECT_EQ(0, Counter(&statistics, "catalog_compiled.n_mapped"));
+  EXPECT_FALSE(FileExists(path));
+  DirectoryEntry dirent;
+  EXPECT_TRUE(catalog_mgr.LookupPath(PathString(""), kLookupSole, &dirent));
+
+  // The compiler thread takes care of the queued catalog
+  catalog_mgr.Spawn();
+  EXPECT_TRUE(WaitForCounter(&statistics, "catalog_compiled.n_mapped", 1));
+  EXPECT_EQ(1, Counter(&statistics, "catalog_compiled.n_compiled"));
+  EXPECT_TRUE(FileExists(path));
+}
+
+
+TEST_F(T_CatalogMgrClient, CompiledPreviousRevision) {
+  const shash::Any nested1_hash =
+    Publish(nested1_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  const shash::Any root1_hash = PublishRoot("root.1", nested1_hash, "");
+  const shash::Any root2_hash =
+    PublishRoot("root.2", nested1_hash, "", root1_hash);
+  RegisterVfs();
+
+  Compile(root1_hash);
+  EXPECT_TRUE(FileExists(CompiledPath(root1_hash)));
+  Compile(root2_hash);
+  EXPECT_TRUE(FileExists(CompiledPath(root2_hash)));
+  EXPECT_FALSE(FileExists(CompiledPath(root1_hash)));
+}
+
+
+TEST_F(T_CatalogMgrClient, CompiledOutsideCas) {
+  const shash::Any nested1_hash =
+    Publish(nested1_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  const shash::Any root1_hash = PublishRoot("root.1", nested1_hash, "");
+  RegisterVfs();
+  Compile(root1_hash);
+
+  // Only the root catalog is in the content-addressed part of the cache
+  unsigned num_objects = 0;
+  for (unsigned i = 0; i <= 0xff; ++i) {
+    char hex[3];
+    snprintf(hex, sizeof(hex), "%02x", i);
+    const vector<string> entries = FindFiles(tmp_path_ + "/cache/" + hex, "");
+    ASSERT_GE(entries.size(), 2U);
+    num_objects += entries.size() - 2;  // "." and ".."
+  }
+  EXPECT_EQ(1U, num_objects);
+}
+
+
+TEST_F(T_CatalogMgrClient, CompiledVerifiedOnce) {
+  const shash::Any nested1_hash =
+    Publish(nested1_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  const shash::Any root1_hash = PublishRoot("root.1", nested1_hash, "");
+  RegisterVfs();
+  Compile(root1_hash);
+
+  perf::Statistics statistics;
+  ClientCatalogManager catalog_mgr("test", fetcher_, NULL, &statistics);
+  catalog_mgr.EnableCompiledCatalogs();
+  catalog_mgr.Spawn();
+  ASSERT_TRUE(catalog_mgr.InitFixed(root1_hash));
+  DirectoryEntry dirent;
+  EXPECT_TRUE(
+    catalog_mgr.LookupPath(PathString("/nested"), kLookupSole, &dirent));
+  EXPECT_TRUE(WaitForCounter(&statistics, "catalog_compiled.n_mapped", 2));
+  // The nested catalog was compiled by this catalog manager
+  EXPECT_EQ(1, Counter(&statistics, "catalog_compiled.n_verified"));
+
+  // Attaching the catalogs again does not checksum the files again
+  catalog_mgr.DetachNested();
+  EXPECT_TRUE(
+    catalog_mgr.LookupPath(PathString("/nested"), kLookupSole, &dirent));
+  EXPECT_EQ(3, Counter(&statistics, "catalog_compiled.n_mapped"));
+  EXPECT_EQ(1, Counter(&statistics, "catalog_compiled.n_verified"));
+}
+
+
+TEST_F(T_CatalogMgrClient, CompiledCatalogEvicted) {
+  const shash::Any nested1_hash =
+    Publish(nested1_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  const shash::Any root1_hash = PublishRoot("root.1", nested1_hash, "");
+  RegisterVfs();
+  {
+    perf::Statistics statistics;
+    ClientCatalogManager catalog_mgr("test", fetcher_, NULL, &statistics);
+    catalog_mgr.EnableCompiledCatalogs();
+    catalog_mgr.Spawn();
+    ASSERT_TRUE(catalog_mgr.InitFixed(root1_hash));
+    DirectoryEntry dirent;
+    EXPECT_TRUE(
+      catalog_mgr.LookupPath(PathString("/nested"), kLookupSole, &dirent));
+    EXPECT_TRUE(WaitForCounter(&statistics, "catalog_compiled.n_mapped", 2));
+  }
+  const string stale_tmp = CompiledPath(root1_hash) + ".tmp.abcdef";
+  ASSERT_TRUE(CopyPath2Path(CompiledPath(root1_hash), stale_tmp));
+
+  // The quota manager evicted the nested catalog
+  EXPECT_EQ(0, unlink(cache_mgr_->GetPathInCache(nested1_hash).c_str()));
+  perf::Statistics statistics;
+  ClientCatalogManager catalog_mgr("test", fetcher_, NULL, &statistics);
+  catalog_mgr.EnableCompiledCatalogs();
+  EXPECT_EQ(1, Counter(&statistics, "catalog_compiled.n_removed"));
+  EXPECT_FALSE(FileExists(CompiledPath(nested1_hash)));
+  EXPECT_FALSE(FileExists(stale_tmp));
+  EXPECT_TRUE(FileExists(CompiledPath(root1_hash)));
+}
+
+
+TEST_F(T_CatalogMgrClient, CompiledSizeLimit) {
+  const shash::Any nested1_hash =
+    Publish(nested1_path_, Z_DEFAULT_COMPRESSION, shash::kSuffixCatalog);
+  const shash::Any root1_hash = PublishRoot("root.1", nested1_hash, "");
+  RegisterVfs();
+
+  perf::Statistics statistics;
+  ClientCatalogManager catalog_mgr("test", fetcher_, NULL, &statistics);
+  catalog_mgr.EnableCompiledCatalogs();
+  // Room for a single compiled catalog
+  catalog_mgr.compiled_limit_ = 1;
+  catalog_mgr.Spawn();
+  ASSERT_TRUE(catalog_mgr.InitFixed(root1_hash));
+  EXPECT_TRUE(WaitForCounter(&statistics, "catalog_compiled.n_mapped", 1));
+  DirectoryEntry dirent;
+  EXPECT_TRUE(
+    catalog_mgr.LookupPath(PathString("/nested"), kLookupSole, &dirent));
+  EXPECT_TRUE(WaitForCounter(&statistics, "catalog_compiled.n_mapped", 2));
+
+  // The newly compiled catalog is kept, the older one is removed
+  EXPECT_EQ(1, Counter(&statistics, "catalog_compiled.n_removed"));
+  EXPECT_FALSE(FileExists(CompiledPath(root1_hash)));
+  EXPECT_TRUE(FileExists(CompiledPath(nested1_hash)));
+  // The attached root catalog keeps its mapping
+  EXPECT_TRUE(catalog_mgr.LookupPath(PathString(""), kLookupSole, &dirent));
+}
+
+}  // namespace catalog
@@ -0,0 +1,211 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+#include "../../cvmfs/atomic.h"
+#include "../../cvmfs/file_processing/char_buffer_pool.h"
+
+namespace upload {
+
+namespace {
+const uint64_t kMaxIdleBytes = 64 * 1024 * 1024;
+}
+
+class T_CharBufferPool : public ::testing::Test {
+ protected:
+  struct ThrottledAllocation {
+    explicit ThrottledAllocation(CharBufferPool *pool)
+      : pool(pool), buffer(NULL) { atomic_init32(&done); }
+    CharBufferPool *pool;
+    CharBuffer *buffer;
+    atomic_int32 done;
+  };
+
+  static void *MainAllocateThrottled(void *data) {
+    ThrottledAllocation *allocation =
+      reinterpret_cast<ThrottledAllocation *>(data);
+    allocation->buffer = allocation->pool->AllocateThrottled(4096);
+    atomic_inc32(&allocation->done);
+    return NULL;
+  }
+
+  static void *MainAllocateRelease(void *data) {
+    CharBufferPool *pool = reinterpret_cast<CharBufferPool *>(data);
+    std::vector<CharBuffer *> buffers;
+    for (unsigned i = 0; i < 1000; ++i) {
+      buffers.push_back(pool->Allocate(100 * (i % 50)));
+      if (buffers.size() == 16) {
+        for (unsigned j = 0; j < buffers.size(); ++j)
+          pool->Release(buffers[j]);
+        buffers.clear();
+      }
+    }
+    for (unsigned j = 0; j < buffers.size(); ++j)
+      pool->Release(buffers[j]);
+    return NULL;
+  }
+};
+
+
+TEST_F(T_CharBufferPool, Recycle) {
+  CharBufferPool pool(kMaxIdleBytes, 0);
+  CharBuffer *buffer = pool.Allocate(1000);
+  ASSERT_TRUE(buffer != NULL);
+  EXPECT_EQ(4096U, buffer->size());
+  EXPECT_EQ(0U, buffer->used_bytes());
+  EXPECT_EQ(4096U, pool.bytes_in_flight());
+  buffer->SetUsedBytes(100);
+  buffer->SetBaseOffset(42);
+
+  pool.Release(buffer);
+  EXPECT_EQ(0U, pool.bytes_in_flight());
+  EXPECT_EQ(4096U, pool.idle_bytes());
+
+  CharBuffer *recycled = pool.Allocate(2000);
+  EXPECT_EQ(buffer, recycled);
+  EXPECT_EQ(0U, recycled->used_bytes());
+  EXPECT_EQ(0, recycled->base_offset());
+  EXPECT_EQ(0U, pool.idle_bytes());
+  pool.Release(recycled);
+
+  CharBufferPool::Counters counters = pool.GetCounters();
+  EXPECT_EQ(1U, counters.num_allocated);
+  EXPECT_EQ(1U, counters.num_recycled);
+  EXPECT_EQ(0U, counters.num_unpooled);
+  EXPECT_EQ(0U, counters.num_freed);
+  EXPECT_EQ(4096U, counters.peak_bytes_in_flight);
+}
+
+
+TEST_F(T_CharBufferPool, SizeClasses) {
+  CharBufferPool pool(kMaxIdleBytes, 0);
+  CharBuffer *empty = pool.Allocate(0);
+  CharBuffer *medium = pool.Allocate(5000);
+  CharBuffer *large = pool.Allocate(1024 * 1024);
+  CharBuffer *huge = pool.Allocate(1024 * 1024 + 1);
+  EXPECT_EQ(4096U, empty->size());
+  EXPECT_EQ(8192U, medium->size());
+  EXPECT_EQ(1024U * 1024U, large->size());
+  EXPECT_EQ(1024U * 1024U + 1, huge->size());
+
+  pool.Release(empty);
+  pool.Release(medium);
+  pool.Release(large);
+  pool.Release(huge);
+  EXPECT_EQ(0U, pool.bytes_in_flight());
+  // The oversized buffer is not pooled
+  EXPECT_EQ(4096U + 8192U + 1024U * 1024U, pool.idle_bytes());
+
+  CharBufferPool::Counters counters = pool.GetCounters();
+  EXPECT_EQ(3U, counters.num_allocated);
+  EXPECT_EQ(1U, counters.num_unpooled);
+}
+
+
+TEST_F(T_CharBufferPool, IdleLimit) {
+  CharBufferPool pool(8192, 0);
+  CharBuffer *b1 = pool.Allocate(4096);
+  CharBuffer *b2 = pool.Allocate(4096);
+  CharBuffer *b3 = pool.Allocate(4096);
+  pool.Release(b1);
+  pool.Release(b2);
+  pool.Release(b3);
+  EXPECT_EQ(8192U, pool.idle_bytes());
+  EXPECT_EQ(1U, pool.GetCounters().num_freed);
+}
+
+
+TEST_F(T_CharBufferPool, Clone) {
+  CharBufferPool pool(kMaxIdleBytes, 0);
+  CharBuffer *buffer = pool.Allocate(100);
+  const char *str = "This is a simple test!";
+  const size_t str_length = strlen(str) + 1;
+  memcpy(buffer->ptr(), str, str_length);
+  buffer->SetUsedBytes(str_length);
+  buffer->SetBaseOffset(128);
+
+  CharBuffer *clone = pool.Clone(*buffer);
+  EXPECT_NE(buffer, clone);
+  EXPECT_EQ(buffer->size(), clone->size());
+  EXPECT_EQ(str_length, clone->used_bytes());
+  EXPECT_EQ(128, clone->base_offset());
+  EXPECT_STREQ(str, reinterpret_cast<const char *>(clone->ptr()));
+
+  pool.Release(buffer);
+  pool.Release(clone);
+  EXPECT_EQ(0U, pool.bytes_in_flight());
+}
+
+
+TEST_F(T_CharBufferPool, Throttle) {
+  CharBufferPool pool(kMaxIdleBytes, 8192);
+  CharBuffer *b1 = pool.AllocateThrottled(4096);
+  CharBuffer *b2 = pool.AllocateThrottled(4096);
+  pool.MarkPending();
+  pool.MarkPending();
+  EXPECT_EQ(8192U, pool.bytes_in_flight());
+
+  ThrottledAllocation allocation(&pool);
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, MainAllocateThrottled,
+                              &allocation));
+  usleep(50000);
+  EXPECT_EQ(0, atomic_read32(&allocation.done));
+
+  pool.ReleasePending(b1);
+  pthread_join(thread, NULL);
+  EXPECT_EQ(1, atomic_read32(&allocation.done));
+  EXPECT_EQ(8192U, pool.bytes_in_flight());
+
+  pool.MarkPending();
+  pool.ReleasePending(b2);
+  pool.ReleasePending(allocation.buffer);
+  EXPECT_EQ(0U, pool.bytes_in_flight());
+}
+
+
+TEST_F(T_CharBufferPool, ThrottleWithoutPendingBuffers) {
+  CharBufferPool pool(kMaxIdleBytes, 4096);
+  CharBuffer *deferred = pool.Allocate(8192);
+  CharBuffer *held_back = pool.AllocateThrottled(4096);
+  // Buffers that are not pending must not block the throttled allocation,
+  // they might only be released after more data has been read
+  CharBuffer *throttled = pool.AllocateThrottled(4096);
+  EXPECT_EQ(8192U + 4096U + 4096U, pool.bytes_in_flight());
+  pool.Release(deferred);
+  pool.MarkPending();
+  pool.ReleasePending(held_back);
+  pool.MarkPending();
+  pool.ReleasePending(throttled);
+  EXPECT_EQ(0U, pool.bytes_in_flight());
+}
+
+
+TEST_F(T_CharBufferPool, MultipleThreads) {
+  const unsigned kNumThreads = 8;
+  CharBufferPool pool(1024 * 1024, 0);
+  std::vector<pthread_t> threads(kNumThreads);
+  for (unsigned i = 0; i < kNumThreads; ++i) {
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, MainAllocateRelease,
+                                &pool));
+  }
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    pthread_join(threads[i], NULL);
+
+  EXPECT_EQ(0U, pool.bytes_in_flight());
+  EXPECT_LE(pool.idle_bytes(), 1024U * 1024U);
+  CharBufferPool::Counters counters = pool.GetCounters();
+  EXPECT_EQ(kNumThreads * 1000U,
+            counters.num_allocated + counters.num_recycled);
+  EXPECT_GT(counters.num_recycled, counters.num_allocated);
+}
+
+}  // namespace upload
@@ -4,9 +4,13 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
 #include <string>
+#include <vector>
 
 #include "../../cvmfs/dirtab.h"
+#include "../../cvmfs/prng.h"
+#include "../../cvmfs/util.h"
 
 class T_Dirtab : public ::testing::Test {
  protected:
@@ -269,3 +273,78 @@ TEST_F(T_Dirtab, MultiDirectoryWildcardsInNegativeRules) {
   EXPECT_FALSE(dirtab.IsOpposing("/usr/local/src/test.h"));
   EXPECT_FALSE(dirtab.IsOpposing("/usr/local/src/test.hpp"));
 }
+
+
+TEST_F(T_Dirtab, NewLineInPath) {
+  dirtab.Parse("/foo/*\n"
+               "! *.svn\n");
+
+  EXPECT_TRUE(dirtab.IsMatching("/foo/bar\nbaz"));
+  EXPECT_FALSE(dirtab.IsMatching("/foo/bar\n/foo/.svn"));
+  EXPECT_TRUE(dirtab.IsOpposing("/foo/bar.svn\n/baz"));
+}
+
+
+/**
+ * Compares the compiled dirtab with matching rule by rule through the regular
+ * expressions of the Pathspecs.
+ */
+TEST_F(T_Dirtab, MatchingBenchmarkSlow) {
+  const unsigned kNumRules = 300;
+  const unsigned kNumPaths = 20000;
+  Prng prng;
+  prng.InitSeed(42);
+
+  std::string content;
+  for (unsigned i = 0; i < kNumRules; ++i) {
+    content += "/experiment" + StringifyInt(i % 10) + "/sw/release_" +
+               StringifyInt(i) + "/*\n";
+    if (i % 10 == 0)
+      content += "! *.tmp" + StringifyInt(i) + "\n";
+  }
+  content += "! */.git\n";
+  ASSERT_TRUE(dirtab.Parse(content));
+
+  std::vector<std::string> paths;
+  for (unsigned i = 0; i < kNumPaths; ++i) {
+    paths.push_back("/experiment" + StringifyInt(prng.Next(12)) +
+                    "/sw/release_" + StringifyInt(prng.Next(kNumRules + 50)) +
+                    "/pkg" + StringifyInt(i) +
+                    ((i % 7 == 0) ? ".tmp10" : ""));
+  }
+
+  unsigned num_regex_matches = 0;
+  StopWatch stopwatch;
+  stopwatch.Start();
+  for (unsigned i = 0; i < kNumPaths; ++i) {
+    bool is_matching = false;
+    for (unsigned j = 0; j < dirtab.positive_rules().size(); ++j) {
+      if (dirtab.positive_rules()[j].pathspec.IsMatching(paths[i])) {
+        is_matching = true;
+        break;
+      }
+    }
+    for (unsigned j = 0;
+         is_matching && (j < dirtab.negative_rules().size()); ++j)
+    {
+      if (dirtab.negative_rules()[j].pathspec.IsMatchingRelaxed(paths[i]))
+        is_matching = false;
+    }
+    num_regex_matches += is_matching;
+  }
+  stopwatch.Stop();
+  printf("regular expressions: %.0f paths/s\n",
+         kNumPaths / stopwatch.GetTime());
+
+  unsigned num_matches = 0;
+  stopwatch.Reset();
+  stopwatch.Start();
+  for (unsigned i = 0; i < kNumPaths; ++i)
+    num_matches += dirtab.IsMatching(paths[i]);
+  stopwatch.Stop();
+  printf("compiled dirtab:     %.0f paths/s\n",
+         kNumPaths / stopwatch.GetTime());
+
+  EXPECT_EQ(num_regex_matches, num_matches);
+  EXPECT_GT(num_matches, 0U);
+}
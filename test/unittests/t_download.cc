@@ -233,4 +233,121 @@ TEST_F(T_Download, ValidateGeoReply) {
   EXPECT_EQ(geo_order[3], 1U);
 }
 
+
+
+TEST_F(T_Download, PriorityStatistics) {
+  download_mgr.Spawn();
+  JobInfo info(&foo_url, false /* compressed */, false /* probe hosts */,
+               NULL);
+  info.priority = kPriorityCatalog;
+  download_mgr.Fetch(&info);
+  EXPECT_EQ(kFailOk, info.error_code);
+  EXPECT_EQ(1, statistics.Lookup("download.n_jobs_catalog")->Get());
+  EXPECT_EQ(0, statistics.Lookup("download.n_jobs_interactive")->Get());
+
+  JobInfo info2(&foo_url, false /* compressed */, false /* probe hosts */,
+                NULL);
+  download_mgr.Fetch(&info2);
+  EXPECT_EQ(kFailOk, info2.error_code);
+  EXPECT_EQ(1, statistics.Lookup("download.n_jobs_interactive")->Get());
+  EXPECT_LE(statistics.Lookup("download.sz_wait_time_interactive")->Get(),
+            statistics.Lookup("download.sz_latency_interactive")->Get());
+}
+
+
+//------------------------------------------------------------------------------
+
+
+class T_JobScheduler : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    for (unsigned i = 0; i < kNumJobs; ++i)
+      jobs[i].priority = kPriorityInteractive;
+  }
+
+  static const unsigned kNumJobs = 32;
+  JobInfo jobs[kNumJobs];
+};
+
+
+TEST_F(T_JobScheduler, Order) {
+  JobScheduler scheduler(1);
+  jobs[0].priority = kPriorityBackground;
+  jobs[2].priority = kPriorityCatalog;
+  jobs[3].priority = kPriorityCatalog;
+  for (unsigned i = 0; i < 5; ++i)
+    scheduler.Submit(&jobs[i]);
+
+  // Catalogs first, FIFO within a class, one job at a time
+  JobInfo *expected[] = {&jobs[2], &jobs[3], &jobs[1], &jobs[4], &jobs[0]};
+  for (unsigned i = 0; i < 5; ++i) {
+    JobInfo *info = scheduler.Next();
+    EXPECT_EQ(expected[i], info);
+    EXPECT_EQ(NULL, scheduler.Next());
+    EXPECT_EQ(1U, scheduler.num_active());
+    scheduler.Finish(info);
+  }
+  EXPECT_EQ(NULL, scheduler.Next());
+  EXPECT_EQ(0U, scheduler.num_active());
+}
+
+
+TEST_F(T_JobScheduler, Limits) {
+  JobScheduler scheduler(8);
+  EXPECT_EQ(8U, scheduler.GetLimit(kPriorityCatalog));
+  EXPECT_EQ(7U, scheduler.GetLimit(kPriorityInteractive));
+  EXPECT_EQ(2U, scheduler.GetLimit(kPriorityBackground));
+
+  // Bulk background transfers don't take all the handles
+  for (unsigned i = 0; i < 8; ++i) {
+    jobs[i].priority = kPriorityBackground;
+    scheduler.Submit(&jobs[i]);
+  }
+  EXPECT_EQ(&jobs[0], scheduler.Next());
+  EXPECT_EQ(&jobs[1], scheduler.Next());
+  EXPECT_EQ(NULL, scheduler.Next());
+  EXPECT_EQ(6U, scheduler.num_waiting(kPriorityBackground));
+
+  // Interactive requests leave a handle for catalogs
+  for (unsigned i = 8; i < 16; ++i)
+    scheduler.Submit(&jobs[i]);
+  for (unsigned i = 8; i < 14; ++i)
+    EXPECT_EQ(&jobs[i], scheduler.Next());
+  EXPECT_EQ(NULL, scheduler.Next());
+  EXPECT_EQ(8U, scheduler.num_active());
+
+  // Freed handles go to catalogs first, then to interactive jobs
+  jobs[16].priority = kPriorityCatalog;
+  scheduler.Submit(&jobs[16]);
+  scheduler.Finish(&jobs[0]);
+  EXPECT_EQ(&jobs[16], scheduler.Next());
+  EXPECT_EQ(NULL, scheduler.Next());
+  scheduler.Finish(&jobs[1]);
+  EXPECT_EQ(&jobs[14], scheduler.Next());
+  EXPECT_EQ(NULL, scheduler.Next());
+  EXPECT_EQ(7U, scheduler.num_active(kPriorityInteractive));
+  EXPECT_EQ(0U, scheduler.num_active(kPriorityBackground));
+
+  // Interactive class is at its limit, the background class gets the handle
+  scheduler.Finish(&jobs[16]);
+  EXPECT_EQ(&jobs[2], scheduler.Next());
+  EXPECT_EQ(NULL, scheduler.Next());
+}
+
+
+TEST_F(T_JobScheduler, SetLimit) {
+  JobScheduler scheduler(4);
+  scheduler.SetLimit(kPriorityInteractive, 0);
+  EXPECT_EQ(1U, scheduler.GetLimit(kPriorityInteractive));
+  scheduler.SetLimit(kPriorityInteractive, 100);
+  EXPECT_EQ(4U, scheduler.GetLimit(kPriorityInteractive));
+  scheduler.SetLimit(kPriorityBackground, 3);
+  EXPECT_EQ(3U, scheduler.GetLimit(kPriorityBackground));
+
+  JobScheduler scheduler_single(1);
+  EXPECT_EQ(1U, scheduler_single.GetLimit(kPriorityCatalog));
+  EXPECT_EQ(1U, scheduler_single.GetLimit(kPriorityInteractive));
+  EXPECT_EQ(1U, scheduler_single.GetLimit(kPriorityBackground));
+}
+
 }  // namespace download
@@ -0,0 +1,109 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+#include "../../cvmfs/hash.h"
+#include "../../cvmfs/upload_existence_filter.h"
+#include "../../cvmfs/util.h"
+
+using namespace std;  // NOLINT
+
+namespace upload {
+
+class T_ExistenceFilter : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    tmp_path_ = CreateTempDir("/tmp/cvmfs-test");
+    EXPECT_NE("", tmp_path_);
+  }
+
+  virtual void TearDown() {
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+  }
+
+  static string MakeObjectPath(const unsigned seed) {
+    shash::Any hash(shash::kSha1);
+    hash.Randomize(seed);
+    return "data/" + hash.MakePath();
+  }
+
+ protected:
+  string tmp_path_;
+};
+
+
+TEST_F(T_ExistenceFilter, AddAndLookup) {
+  UniquePtr<ExistenceFilter> filter(ExistenceFilter::Create());
+  ASSERT_TRUE(filter.IsValid());
+  EXPECT_FALSE(filter->MayContain(MakeObjectPath(1)));
+
+  filter->Add(MakeObjectPath(1));
+  EXPECT_TRUE(filter->MayContain(MakeObjectPath(1)));
+  EXPECT_FALSE(filter->MayContain(MakeObjectPath(2)));
+  EXPECT_FALSE(filter->MayContain(MakeObjectPath(1) + "C"));
+  EXPECT_EQ(1U, filter->num_objects());
+}
+
+
+TEST_F(T_ExistenceFilter, FalsePositives) {
+  // About 10 bits per object, i.e. 1% false positives
+  const unsigned kNumObjects = 10000;
+  UniquePtr<ExistenceFilter> filter(ExistenceFilter::Create(10 * kNumObjects));
+  for (unsigned i = 0; i < kNumObjects; ++i)
+    filter->Add(MakeObjectPath(i));
+
+  for (unsigned i = 0; i < kNumObjects; ++i)
+    ASSERT_TRUE(filter->MayContain(MakeObjectPath(i)));
+
+  unsigned false_positives = 0;
+  for (unsigned i = kNumObjects; i < 2 * kNumObjects; ++i) {
+    if (filter->MayContain(MakeObjectPath(i)))
+      false_positives++;
+  }
+  EXPECT_LT(false_positives, kNumObjects / 50);
+}
+
+
+TEST_F(T_ExistenceFilter, SaveAndLoad) {
+  const string path = tmp_path_ + "/filter";
+  EXPECT_EQ(static_cast<ExistenceFilter *>(NULL), ExistenceFilter::Load(path));
+
+  UniquePtr<ExistenceFilter> filter(ExistenceFilter::Create(1000));
+  for (unsigned i = 0; i < 50; ++i)
+    filter->Add(MakeObjectPath(i));
+  ASSERT_TRUE(filter->Save(path));
+
+  UniquePtr<ExistenceFilter> loaded(ExistenceFilter::Load(path));
+  ASSERT_TRUE(loaded.IsValid());
+  EXPECT_EQ(1000U, loaded->num_bits());
+  EXPECT_EQ(50U, loaded->num_objects());
+  for (unsigned i = 0; i < 1000; ++i) {
+    EXPECT_EQ(filter->MayContain(MakeObjectPath(i)),
+              loaded->MayContain(MakeObjectPath(i)));
+  }
+}
+
+
+TEST_F(T_ExistenceFilter, LoadCorrupted) {
+  const string path = tmp_path_ + "/filter";
+  UniquePtr<ExistenceFilter> filter(ExistenceFilter::Create(1000));
+  ASSERT_TRUE(filter->Save(path));
+  ASSERT_EQ(0, truncate(path.c_str(), GetFileSize(path) - 1));
+  EXPECT_EQ(static_cast<ExistenceFilter *>(NULL), ExistenceFilter::Load(path));
+
+  FILE *f = fopen(path.c_str(), "w");
+  ASSERT_TRUE(f != NULL);
+  fprintf(f, "not a filter");
+  fclose(f);
+  EXPECT_EQ(static_cast<ExistenceFilter *>(NULL), ExistenceFilter::Load(path));
+}
+
+}  // namespace upload
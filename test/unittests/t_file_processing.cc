@@ -4,12 +4,15 @@
 
 #include <gtest/gtest.h>
 
+#include <inttypes.h>
 #include <openssl/sha.h>
+#include <sys/resource.h>
 
 #include <cerrno>
 #include <string>
 #include <vector>
 
+#include "../../cvmfs/compression.h"
 #include "../../cvmfs/file_processing/char_buffer.h"
 #include "../../cvmfs/file_processing/file_processor.h"
 #include "../../cvmfs/upload_spooler_result.h"
@@ -69,6 +72,7 @@ class FP_MockUploader : public AbstractMockUploader<FP_MockUploader> {
     Result(MockStreamHandle     *handle,
            const shash::Any     &computed_content_hash)
       : computed_content_hash(computed_content_hash)
+      , nbytes(handle->nbytes)
     {
       RecomputeContentHash(handle->data, handle->nbytes);
 
@@ -97,6 +101,7 @@ class FP_MockUploader : public AbstractMockUploader<FP_MockUploader> {
 
     shash::Any     computed_content_hash;
     shash::Any     recomputed_content_hash;
+    size_t         nbytes;
   };
   typedef std::vector<Result> Results;
 
@@ -126,6 +131,17 @@ class FP_MockUploader : public AbstractMockUploader<FP_MockUploader> {
     Respond(callback, upload::UploaderResults(0, buffer));
   }
 
+  /**
+   * Objects that were uploaded by this mock uploader are considered present
+   */
+  bool Peek(const std::string &path) const {
+    for (unsigned i = 0; i < results_.size(); ++i) {
+      if (path == "data/" + results_[i].computed_content_hash.MakePath())
+        return true;
+    }
+    return false;
+  }
+
   void FinalizeStreamedUpload(upload::UploadStreamHandle *handle,
                               const shash::Any            content_hash) {
     MockStreamHandle *local_handle = dynamic_cast<MockStreamHandle*>(handle);
@@ -354,6 +370,25 @@ class T_FileProcessing : public FileSandbox {
     CheckHashes(results, reference_hash_strings);
   }
 
+  uint64_t GetUploadedBytes() const {
+    uint64_t result = 0;
+    const FP_MockUploader::Results &results = uploader_->results();
+    for (unsigned i = 0; i < results.size(); ++i)
+      result += results[i].nbytes;
+    return result;
+  }
+
+  /**
+   * User and system CPU time of the process in seconds, including the
+   * processing threads
+   */
+  double GetCpuTime() const {
+    struct rusage usage;
+    EXPECT_EQ(0, getrusage(RUSAGE_SELF, &usage));
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+  }
+
   void CheckHash(const FP_MockUploader::Results &results,
                  const ExpectedHashString    &expected_hash) const {
     ExpectedHashStrings expected_hashes;
@@ -601,3 +636,151 @@ TEST_F(T_FileProcessing, ProcessingCallbackForBigFile) {
   EXPECT_EQ(GetBigFile(),          CallbackTest::result_local_path);
   EXPECT_EQ(number_of_chunks,      CallbackTest::result_chunk_list.size());
 }
+
+
+TEST_F(T_FileProcessing, ProcessingWithHashCache) {
+  upload::SpoolerDefinition spooler_definition = MockSpoolerDefinition();
+  spooler_definition.hash_cache_path =
+    std::string(FP_MockUploader::sandbox_tmp_dir) + "/hash_cache.db";
+  const size_t number_of_chunks = GetBigFileChunkHashes().size();
+  const std::string big_file = GetBigFile();
+
+  {
+    upload::FileProcessor processor(uploader_, spooler_definition);
+    processor.RegisterListener(&CallbackTest::CallbackFn);
+    processor.Process(big_file, true);
+    processor.WaitForProcessing();
+    EXPECT_EQ(0u, processor.GetNumSkippedBytes());
+  }
+  const size_t number_of_uploads = uploader_->results().size();
+  EXPECT_EQ(number_of_chunks + 1, number_of_uploads);
+
+  // Same content under a different name: served from the persistent cache
+  const std::string copied_file = big_file + ".copy";
+  ASSERT_TRUE(CopyPath2Path(big_file, copied_file));
+  CallbackTest::result_chunk_list.Clear();
+  {
+    upload::FileProcessor processor(uploader_, spooler_definition);
+    processor.RegisterListener(&CallbackTest::CallbackFn);
+    processor.Process(copied_file, true);
+    processor.WaitForProcessing();
+    EXPECT_EQ(static_cast<uint64_t>(GetFileSize(big_file)),
+              processor.GetNumSkippedBytes());
+  }
+  EXPECT_EQ(number_of_uploads, uploader_->results().size());
+  shash::Any expected_content_hash(
+    shash::kSha1,
+    shash::HexPtr(GetBigFileBulkHash().first));
+  EXPECT_EQ(expected_content_hash, CallbackTest::result_content_hash);
+  EXPECT_EQ(copied_file,           CallbackTest::result_local_path);
+  ASSERT_EQ(number_of_chunks,      CallbackTest::result_chunk_list.size());
+  EXPECT_EQ(shash::kSuffixPartial,
+            CallbackTest::result_chunk_list.AtPtr(0)->content_hash().suffix);
+
+  // Different processing parameters miss the cache
+  uploader_->ClearResults();
+  upload::SpoolerDefinition other_definition = spooler_definition;
+  other_definition.max_file_chunk_size *= 2;
+  {
+    upload::FileProcessor processor(uploader_, other_definition);
+    processor.Process(copied_file, true);
+    processor.WaitForProcessing();
+    EXPECT_EQ(0u, processor.GetNumSkippedBytes());
+  }
+  EXPECT_LT(0u, uploader_->results().size());
+}
+
+
+TEST_F(T_FileProcessing, HashCacheCommitPerPublish) {
+  upload::SpoolerDefinition spooler_definition = MockSpoolerDefinition();
+  spooler_definition.hash_cache_path =
+    std::string(FP_MockUploader::sandbox_tmp_dir) + "/hash_cache_commit.db";
+  const std::string small_file = GetSmallFile();
+  const std::string copied_file = small_file + ".copy";
+  ASSERT_TRUE(CopyPath2Path(small_file, copied_file));
+
+  // The entries are visible to other processes after the publish, while the
+  // processor is still alive
+  upload::FileProcessor processor(uploader_, spooler_definition);
+  processor.Process(small_file, true);
+  processor.Process(GetEmptyFile(), true);
+  processor.WaitForProcessing();
+  EXPECT_EQ(0u, processor.GetNumSkippedBytes());
+  {
+    upload::FileProcessor other_processor(uploader_, spooler_definition);
+    other_processor.Process(copied_file, true);
+    other_processor.WaitForProcessing();
+    EXPECT_EQ(static_cast<uint64_t>(GetFileSize(small_file)),
+              other_processor.GetNumSkippedBytes());
+  }
+}
+
+
+TEST_F(T_FileProcessing, ProcessBigFileWithoutBulkChunk) {
+  upload::SpoolerDefinition spooler_definition = MockSpoolerDefinition();
+  spooler_definition.generate_legacy_bulk_chunks = false;
+  spooler_definition.hash_cache_path =
+    std::string(FP_MockUploader::sandbox_tmp_dir) + "/hash_cache.db";
+  const std::string big_file = GetBigFile();
+  {
+    upload::FileProcessor processor(uploader_, spooler_definition);
+    processor.RegisterListener(&CallbackTest::CallbackFn);
+    processor.Process(GetSmallFile(), true);
+    processor.Process(big_file, true);
+    processor.WaitForProcessing();
+  }
+
+  // Files without chunks are still stored as a bulk object
+  ExpectedHashStrings hs = GetBigFileChunkHashes();
+  hs.push_back(GetSmallFileBulkHash());
+  CheckHashes(uploader_->results(), hs);
+
+  // Chunked files without bulk object are served from the hash cache as well
+  const std::string copied_file = big_file + ".copy";
+  ASSERT_TRUE(CopyPath2Path(big_file, copied_file));
+  CallbackTest::result_chunk_list.Clear();
+  {
+    upload::FileProcessor processor(uploader_, spooler_definition);
+    processor.RegisterListener(&CallbackTest::CallbackFn);
+    processor.Process(copied_file, true);
+    processor.WaitForProcessing();
+    EXPECT_EQ(static_cast<uint64_t>(GetFileSize(big_file)),
+              processor.GetNumSkippedBytes());
+  }
+  EXPECT_EQ(hs.size(), uploader_->results().size());
+  EXPECT_TRUE(CallbackTest::result_content_hash.IsNull());
+  EXPECT_EQ(copied_file, CallbackTest::result_local_path);
+  EXPECT_EQ(GetBigFileChunkHashes().size(),
+            CallbackTest::result_chunk_list.size());
+}
+
+
+TEST_F(T_FileProcessing, ProcessHugeFileWithAndWithoutBulkChunkSlow) {
+  const std::string huge_file = GetHugeFile();
+  for (unsigned i = 0; i < 2; ++i) {
+    const bool generate_bulk_chunks = (i == 0);
+    upload::SpoolerDefinition spooler_definition = MockSpoolerDefinition();
+    spooler_definition.generate_legacy_bulk_chunks = generate_bulk_chunks;
+    uploader_->ClearResults();
+
+    StopWatch stopwatch;
+    const double cpu_time_start = GetCpuTime();
+    stopwatch.Start();
+    {
+      upload::FileProcessor processor(uploader_, spooler_definition);
+      processor.Process(huge_file, true);
+      processor.WaitForProcessing();
+    }
+    stopwatch.Stop();
+    const double cpu_time = GetCpuTime() - cpu_time_start;
+
+    ExpectedHashStrings hs = GetHugeFileChunkHashes();
+    if (generate_bulk_chunks)
+      hs.push_back(GetHugeFileBulkHash());
+    CheckHashes(uploader_->results(), hs);
+    printf("%s bulk chunk: %.3fs CPU time, %.3fs wall clock time, "
+           "%" PRIu64 " bytes uploaded\n",
+           generate_bulk_chunks ? "with" : "without",
+           cpu_time, stopwatch.GetTime(), GetUploadedBytes());
+  }
+}
@@ -44,12 +44,16 @@ class GC_MockUploader : public AbstractMockUploader<GC_MockUploader> {
     assert(AbstractMockUploader<GC_MockUploader>::not_implemented);
   }
 
+  // Called concurrently by the removal threads, the lock is shared with the
+  // MockObjectFetcher that checks for deleted objects
   bool Remove(const shash::Any &hash_to_delete) {
+    MutexLockGuard guard(MockCatalog::s_deleted_objects_lock);
     deleted_hashes.insert(hash_to_delete);
     return true;
   }
 
   bool HasDeleted(const shash::Any &hash) const {
+    MutexLockGuard guard(MockCatalog::s_deleted_objects_lock);
     return deleted_hashes.find(hash) != deleted_hashes.end();
   }
 
@@ -4,8 +4,15 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <string>
+
+#include "../../cvmfs/directory_entry.h"
+#include "../../cvmfs/hash.h"
 #include "../../cvmfs/lru.h"
 #include "../../cvmfs/statistics.h"
+#include "../../cvmfs/util.h"
+#include "testutil.h"
 
 using lru::LruCache;
 
@@ -506,3 +513,176 @@ TEST(T_LruCache, PauseAndResume) {
   EXPECT_TRUE(cache.IsEmpty());
   EXPECT_FALSE(cache.IsFull());
 }
+
+
+static void ExpectSameDirent(const catalog::DirectoryEntry &expected,
+                             const catalog::DirectoryEntry &actual)
+{
+  EXPECT_TRUE(expected == actual);
+  EXPECT_EQ(expected.inode(), actual.inode());
+  EXPECT_EQ(expected.parent_inode(), actual.parent_inode());
+  EXPECT_EQ(expected.cached_mtime(), actual.cached_mtime());
+  EXPECT_EQ(expected.IsNegative(), actual.IsNegative());
+  EXPECT_EQ(expected.checksum().algorithm, actual.checksum().algorithm);
+  EXPECT_EQ(expected.checksum().suffix, actual.checksum().suffix);
+}
+
+
+static catalog::DirectoryEntry MakeFile(const unsigned i) {
+  shash::Any hash(shash::kSha1);
+  shash::HashString("content " + StringifyInt(i), &hash);
+  catalog::DirectoryEntry dirent =
+    catalog::DirectoryEntryTestFactory::RegularFile(
+      "file_" + StringifyInt(i) + ".root", 1000 + i, hash);
+  dirent.set_inode(256 + i);
+  dirent.set_parent_inode(256);
+  dirent.set_cached_mtime(1400000000);
+  return dirent;
+}
+
+
+TEST(T_LruCache, PackedDirent) {
+  catalog::DirectoryEntry dirents[6];
+  dirents[0] = MakeFile(1);
+  dirents[1] = catalog::DirectoryEntryTestFactory::Directory("dir");
+  dirents[1].set_is_nested_catalog_mountpoint(true);
+  dirents[1].set_has_xattrs(true);
+  dirents[2] = catalog::DirectoryEntryTestFactory::Symlink(
+    "link", "$(SOME_VARIABLE)/" + std::string(300, 'x'));
+  dirents[2].set_linkcount(3);
+  dirents[2].set_hardlink_group(42);
+  dirents[3] = catalog::DirectoryEntry(catalog::kDirentNegative);
+  dirents[4] = catalog::DirectoryEntryTestFactory::RegularFile(
+    "", uint32_t(-1), h("cb0ea27dd7cb2d8f3a52e2edb78a0dbf7d05b9d3",
+                        shash::kSuffixPartial));
+  dirents[4].set_is_chunked_file(true);
+  dirents[4].set_inode(uint64_t(-2));
+  dirents[4].set_cached_mtime(-1);
+  dirents[5] = catalog::DirectoryEntryTestFactory::Directory("");
+  dirents[5].set_is_nested_catalog_root(true);
+
+  for (unsigned i = 0; i < sizeof(dirents) / sizeof(dirents[0]); ++i) {
+    const lru::PackedDirent packed(dirents[i]);
+    EXPECT_LT(packed.size(), sizeof(catalog::DirectoryEntry) +
+                             dirents[i].symlink().GetLength());
+    catalog::DirectoryEntry unpacked;
+    packed.Unpack(&unpacked);
+    ExpectSameDirent(dirents[i], unpacked);
+
+    // Copies share the buffer
+    const uint64_t num_instances = lru::PackedDirent::num_instances();
+    lru::PackedDirent copy;
+    copy = packed;
+    EXPECT_EQ(num_instances, lru::PackedDirent::num_instances());
+    copy.Unpack(&unpacked);
+    ExpectSameDirent(dirents[i], unpacked);
+  }
+}
+
+
+TEST(T_LruCache, PackedCaches) {
+  perf::Statistics statistics;
+  const uint64_t num_dirents = lru::PackedDirent::num_instances();
+  const uint64_t num_paths = lru::PackedPath::num_instances();
+  {
+    lru::InodeCache inode_cache(128, &statistics);
+    lru::PathCache path_cache(128, &statistics);
+    lru::Md5PathCache md5path_cache(128, &statistics);
+    // The negative entry of the md5 path cache
+    EXPECT_EQ(num_dirents + 1, lru::PackedDirent::num_instances());
+
+    for (unsigned i = 0; i < 1000; ++i) {
+      const catalog::DirectoryEntry dirent = MakeFile(i);
+      const PathString path("/some/path/" + dirent.name().ToString());
+      const shash::Md5 md5path(path.GetChars(), path.GetLength());
+      EXPECT_TRUE(inode_cache.Insert(dirent.inode(), dirent));
+      EXPECT_TRUE(path_cache.Insert(dirent.inode(), path));
+      if (i % 2 == 0)
+        EXPECT_TRUE(md5path_cache.Insert(md5path, dirent));
+      else
+        EXPECT_TRUE(md5path_cache.InsertNegative(md5path));
+
+      catalog::DirectoryEntry result;
+      PathString result_path;
+      EXPECT_TRUE(inode_cache.Lookup(dirent.inode(), &result));
+      ExpectSameDirent(dirent, result);
+      EXPECT_TRUE(path_cache.Lookup(dirent.inode(), &result_path));
+      EXPECT_EQ(path, result_path);
+      EXPECT_TRUE(md5path_cache.Lookup(md5path, &result));
+      if (i % 2 == 0)
+        ExpectSameDirent(dirent, result);
+      else
+        EXPECT_TRUE(result.IsNegative());
+    }
+    EXPECT_EQ(128U, inode_cache.num_entries());
+    EXPECT_EQ(128U, md5path_cache.num_entries());
+
+    // Evicted entries release their buffers
+    EXPECT_EQ(num_dirents + 128 + 64 + 1, lru::PackedDirent::num_instances());
+    EXPECT_EQ(num_paths + 128, lru::PackedPath::num_instances());
+
+    const catalog::DirectoryEntry dirent = MakeFile(998);
+    const PathString path("/some/path/" + dirent.name().ToString());
+    EXPECT_TRUE(md5path_cache.Forget(shash::Md5(path.GetChars(),
+                                                path.GetLength())));
+    EXPECT_EQ(num_dirents + 128 + 64, lru::PackedDirent::num_instances());
+
+    inode_cache.Drop();
+    path_cache.Drop();
+    md5path_cache.Drop();
+    EXPECT_EQ(0U, inode_cache.num_entries());
+    EXPECT_EQ(num_dirents + 1, lru::PackedDirent::num_instances());
+    EXPECT_EQ(num_paths, lru::PackedPath::num_instances());
+  }
+  EXPECT_EQ(num_dirents, lru::PackedDirent::num_instances());
+}
+
+
+/**
+ * Compares memory per entry and lookup cost of the packed inode cache with a
+ * cache of plain DirectoryEntry objects.
+ */
+TEST(T_LruCache, PackedDirentBenchmarkSlow) {
+  const unsigned kNumEntries = 1024 * 1024;
+  perf::Statistics statistics;
+  LruCache<fuse_ino_t, catalog::DirectoryEntry> plain_cache(
+    kNumEntries, fuse_ino_t(-1), lru::hasher_inode, &statistics, "plain");
+  lru::InodeCache packed_cache(kNumEntries, &statistics);
+
+  const uint64_t packed_bytes_before = lru::PackedDirent::sz_bytes();
+  for (unsigned i = 0; i < kNumEntries; ++i) {
+    const catalog::DirectoryEntry dirent = MakeFile(i);
+    plain_cache.Insert(dirent.inode(), dirent);
+    packed_cache.Insert(dirent.inode(), dirent);
+  }
+  const double packed_size =
+    static_cast<double>(lru::PackedDirent::sz_bytes() - packed_bytes_before) /
+    kNumEntries;
+
+  const double plain_entry_size =
+    LruCache<fuse_ino_t, catalog::DirectoryEntry>::GetEntrySize();
+  const double packed_entry_size =
+    LruCache<fuse_ino_t, lru::PackedDirent>::GetEntrySize() + packed_size;
+  printf("plain:  %.0f bytes per entry, %.0f entries per MB\n",
+         plain_entry_size, 1024 * 1024 / plain_entry_size);
+  printf("packed: %.0f bytes per entry, %.0f entries per MB\n",
+         packed_entry_size, 1024 * 1024 / packed_entry_size);
+  EXPECT_LT(packed_entry_size, plain_entry_size);
+
+  catalog::DirectoryEntry result;
+  StopWatch stopwatch;
+  stopwatch.Start();
+  for (unsigned i = 0; i < kNumEntries; ++i)
+    EXPECT_TRUE(plain_cache.Lookup(256 + i, &result));
+  stopwatch.Stop();
+  printf("plain:  %.0f ns per lookup\n",
+         stopwatch.GetTime() * 1e9 / kNumEntries);
+
+  stopwatch.Reset();
+  stopwatch.Start();
+  for (unsigned i = 0; i < kNumEntries; ++i)
+    EXPECT_TRUE(packed_cache.Lookup(256 + i, &result));
+  stopwatch.Stop();
+  printf("packed: %.0f ns per lookup\n",
+         stopwatch.GetTime() * 1e9 / kNumEntries);
+}
@@ -68,4 +68,25 @@ TEST_F(T_Manifest, ReadChecksum) {
   fclose(f);
 }
 
+
+
+TEST_F(T_Manifest, CatalogDelta) {
+  shash::Any catalog_hash(shash::kSha1, shash::kSuffixCatalog);
+  catalog_hash.Randomize();
+  Manifest manifest(catalog_hash, 1024, "");
+  EXPECT_EQ("", manifest.catalog_delta());
+  manifest.set_catalog_delta("base:content");
+
+  const string exported = manifest.ExportString();
+  UniquePtr<Manifest> loaded(Manifest::LoadMem(
+    reinterpret_cast<const unsigned char *>(exported.data()),
+    exported.length()));
+  ASSERT_TRUE(loaded.IsValid());
+  EXPECT_EQ("base:content", loaded->catalog_delta());
+
+  // The delta reference belongs to the catalog revision
+  loaded->set_catalog_hash(catalog_hash);
+  EXPECT_EQ("", loaded->catalog_delta());
+}
+
 }  // namespace manifest
@@ -0,0 +1,139 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../../cvmfs/pathspec/pathspec.h"
+#include "../../cvmfs/pathspec/pathspec_matcher.h"
+#include "../../cvmfs/prng.h"
+
+
+class T_PathspecMatcher : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    prng_.InitSeed(42);
+  }
+
+  std::string RandomString(const std::string &alphabet,
+                           const unsigned max_length)
+  {
+    std::string result;
+    const unsigned length = prng_.Next(max_length + 1);
+    for (unsigned i = 0; i < length; ++i)
+      result.push_back(alphabet[prng_.Next(alphabet.length())]);
+    return result;
+  }
+
+  Prng prng_;
+};
+
+
+TEST_F(T_PathspecMatcher, Strict) {
+  PathspecMatcher matcher;
+  matcher.AddStrict(Pathspec("/usr/bin/*"));
+  matcher.AddStrict(Pathspec("/usr/lib?/*"));
+  matcher.AddStrict(Pathspec("/opt/releases/*-?"));
+  matcher.AddStrict(Pathspec("relative/path"));
+
+  EXPECT_TRUE(matcher.IsMatchingStrict("/usr/bin/bash"));
+  EXPECT_TRUE(matcher.IsMatchingStrict("/usr/bin/bash/"));
+  EXPECT_TRUE(matcher.IsMatchingStrict("/usr/bin/"));
+  EXPECT_TRUE(matcher.IsMatchingStrict("/usr/lib6/libc.so"));
+  EXPECT_TRUE(matcher.IsMatchingStrict("/opt/releases/1.0-1"));
+  EXPECT_TRUE(matcher.IsMatchingStrict("relative/path"));
+  EXPECT_TRUE(matcher.IsMatchingStrict("relative/path/"));
+  EXPECT_FALSE(matcher.IsMatchingStrict(""));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/usr/bin"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/usr/bin/bash//"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/usr/bin/bash/sh"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/usr/lib/libc.so"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/usr/lib64/libc.so"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/opt/releases/1.0-12"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/relative/path"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("usr/bin/bash"));
+  EXPECT_FALSE(matcher.IsMatchingRelaxed("/usr/bin/bash"));
+}
+
+
+TEST_F(T_PathspecMatcher, Relaxed) {
+  PathspecMatcher matcher;
+  matcher.AddRelaxed(Pathspec("*.svn"));
+  matcher.AddRelaxed(Pathspec("*/include/*.hpp"));
+  matcher.AddRelaxed(Pathspec("/usr/bi?"));
+
+  EXPECT_TRUE(matcher.IsMatchingRelaxed("/foo/.svn"));
+  EXPECT_TRUE(matcher.IsMatchingRelaxed("/foo/bar/.svn/"));
+  EXPECT_TRUE(matcher.IsMatchingRelaxed("/root/include/tr1/stdio.hpp"));
+  EXPECT_TRUE(matcher.IsMatchingRelaxed("/usr/bin"));
+  EXPECT_FALSE(matcher.IsMatchingRelaxed(""));
+  EXPECT_FALSE(matcher.IsMatchingRelaxed("/foo/.svn/trunk"));
+  EXPECT_FALSE(matcher.IsMatchingRelaxed("/usr/include/stdio.h"));
+  EXPECT_FALSE(matcher.IsMatchingRelaxed("/usr/binary"));
+  EXPECT_FALSE(matcher.IsMatchingRelaxed("/usr/bi/"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/usr/bin"));
+}
+
+
+TEST_F(T_PathspecMatcher, SharedPrefixes) {
+  PathspecMatcher matcher;
+  const unsigned num_roots = matcher.num_states();
+  matcher.AddStrict(Pathspec("/software/releases/*"));
+  matcher.AddStrict(Pathspec("/software/nightlies/*"));
+  matcher.AddStrict(Pathspec("/software/releases/*/*"));
+  matcher.AddStrict(Pathspec("/software/releases/*"));
+  EXPECT_EQ(num_roots + 6, matcher.num_states());
+  EXPECT_TRUE(matcher.IsMatchingStrict("/software/releases/1.0"));
+  EXPECT_TRUE(matcher.IsMatchingStrict("/software/releases/1.0/x86_64"));
+  EXPECT_TRUE(matcher.IsMatchingStrict("/software/nightlies/monday"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/software/nightlies/monday/x86_64"));
+  EXPECT_FALSE(matcher.IsMatchingStrict("/software"));
+}
+
+
+TEST_F(T_PathspecMatcher, CanMatch) {
+  EXPECT_TRUE(PathspecMatcher::CanMatch("/foo/bar"));
+  EXPECT_FALSE(PathspecMatcher::CanMatch("/foo\n/bar"));
+}
+
+
+/**
+ * Compares random Pathspecs and paths with the regular expression matching of
+ * the Pathspec class.
+ */
+TEST_F(T_PathspecMatcher, CompareWithPathspec) {
+  const std::string pattern_alphabet = "ab/*?.\\";
+  const std::string path_alphabet = "ab/.*";
+  const unsigned kNumPathspecs = 300;
+  const unsigned kNumPaths = 200;
+
+  unsigned num_matches = 0;
+  unsigned num_relaxed_matches = 0;
+  for (unsigned i = 0; i < kNumPathspecs; ++i) {
+    const std::string spec = RandomString(pattern_alphabet, 8);
+    const Pathspec pathspec(spec);
+    if (!pathspec.IsValid())
+      continue;
+    PathspecMatcher matcher;
+    matcher.AddStrict(pathspec);
+    matcher.AddRelaxed(pathspec);
+    for (unsigned j = 0; j < kNumPaths; ++j) {
+      const std::string path = RandomString(path_alphabet, 8);
+      const bool expected = !path.empty() && pathspec.IsMatching(path);
+      const bool expected_relaxed =
+        !path.empty() && pathspec.IsMatchingRelaxed(path);
+      EXPECT_EQ(expected, matcher.IsMatchingStrict(path))
+        << "pathspec '" << spec << "', path '" << path << "'";
+      EXPECT_EQ(expected_relaxed, matcher.IsMatchingRelaxed(path))
+        << "pathspec '" << spec << "', path '" << path << "' (relaxed)";
+      num_matches += expected;
+      num_relaxed_matches += expected_relaxed;
+    }
+  }
+  // Make sure the random input covers matches
+  EXPECT_GT(num_matches, 100U);
+  EXPECT_GT(num_relaxed_matches, num_matches);
+}
@@ -4,8 +4,13 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <string>
+#include <vector>
+
 #include "../../cvmfs/hash.h"
 #include "../../cvmfs/prng.h"
+#include "../../cvmfs/util.h"
 
 
 TEST(T_Shash, TestVectors) {
@@ -712,3 +717,112 @@ TEST(T_Shash, GreaterThan) {
     sha256("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"),
     sha256("0000000000000000000000000000000000000000000000000000000000000000"));
 }
+
+
+TEST(T_Shash, Md5Multi) {
+  // Covers the padding corner cases at 55, 56, 64, 119, and 120 bytes
+  const unsigned kMaxLength = 200;
+  std::string message;
+  for (unsigned i = 0; i < kMaxLength; ++i)
+    message.push_back('a' + (i * 7) % 26);
+
+  for (unsigned num_paths = 0; num_paths <= 9; ++num_paths) {
+    for (unsigned offset = 0; offset + num_paths <= kMaxLength; ++offset) {
+      std::vector<const char *> chars;
+      std::vector<unsigned> lengths;
+      for (unsigned i = 0; i < num_paths; ++i) {
+        // Different lengths in the lanes
+        const unsigned length = (offset + i * 37) % (kMaxLength + 1);
+        chars.push_back(message.data());
+        lengths.push_back(length);
+      }
+      std::vector<shash::Md5> digests(num_paths);
+      shash::Md5Multi(num_paths, &chars[0], &lengths[0], &digests[0]);
+      for (unsigned i = 0; i < num_paths; ++i) {
+        EXPECT_EQ(shash::Md5(chars[i], lengths[i]), digests[i])
+          << "length " << lengths[i] << ", lane " << i;
+      }
+    }
+  }
+}
+
+
+TEST(T_Shash, HashMemMulti) {
+  const shash::Algorithms algorithms[] =
+    {shash::kMd5, shash::kMd5, shash::kSha1, shash::kMd5, shash::kMd5,
+     shash::kMd5, shash::kRmd160, shash::kSha256, shash::kMd5, shash::kMd5,
+     shash::kMd5, shash::kMd5, shash::kMd5};
+  const unsigned num_buffers = sizeof(algorithms) / sizeof(algorithms[0]);
+  std::vector<unsigned char> buffer(1000);
+  Prng prng;
+  prng.InitSeed(42);
+  for (unsigned i = 0; i < buffer.size(); ++i)
+    buffer[i] = prng.Next(256);
+
+  const unsigned char *buffers[num_buffers];
+  unsigned sizes[num_buffers];
+  shash::Any digests[num_buffers];
+  for (unsigned i = 0; i < num_buffers; ++i) {
+    buffers[i] = &buffer[i];
+    sizes[i] = (i * 131) % (buffer.size() - num_buffers);
+    digests[i] = shash::Any(algorithms[i], shash::kSuffixCatalog);
+  }
+  shash::HashMemMulti(num_buffers, buffers, sizes, digests);
+  for (unsigned i = 0; i < num_buffers; ++i) {
+    shash::Any expected(algorithms[i], shash::kSuffixCatalog);
+    shash::HashMem(buffers[i], sizes[i], &expected);
+    EXPECT_EQ(expected, digests[i]) << "buffer " << i;
+    EXPECT_EQ(shash::kSuffixCatalog, digests[i].suffix);
+  }
+}
+
+
+TEST(T_Shash, ThroughputBenchmarkSlow) {
+  const unsigned kBufferSize = 64 * 1024 * 1024;
+  std::vector<unsigned char> buffer(kBufferSize);
+  for (unsigned i = 0; i < kBufferSize; ++i)
+    buffer[i] = i % 251;
+
+  const shash::Algorithms algorithms[] =
+    {shash::kMd5, shash::kSha1, shash::kRmd160, shash::kSha256};
+  const char *names[] = {"md5", "sha1", "rmd160", "sha256"};
+  for (unsigned i = 0; i < sizeof(algorithms) / sizeof(algorithms[0]); ++i) {
+    shash::Any digest(algorithms[i]);
+    StopWatch stop_watch;
+    stop_watch.Start();
+    shash::HashMem(&buffer[0], kBufferSize, &digest);
+    stop_watch.Stop();
+    printf("%-8s %.2f GB/s\n", names[i],
+           kBufferSize / stop_watch.GetTime() / (1024 * 1024 * 1024));
+  }
+
+  const unsigned kNumPaths = 1000000;
+  std::vector<std::string> paths;
+  for (unsigned i = 0; i < 1000; ++i)
+    paths.push_back("/cvmfs/repo.cern.ch/sw/release/x86_64/lib/" +
+                    StringifyInt(i) + "/libfoo.so");
+  std::vector<const char *> chars;
+  std::vector<unsigned> lengths;
+  for (unsigned i = 0; i < kNumPaths; ++i) {
+    chars.push_back(paths[i % paths.size()].data());
+    lengths.push_back(paths[i % paths.size()].length());
+  }
+  std::vector<shash::Md5> digests(kNumPaths);
+
+  StopWatch stop_watch;
+  stop_watch.Start();
+  for (unsigned i = 0; i < kNumPaths; ++i)
+    digests[i] = shash::Md5(chars[i], lengths[i]);
+  stop_watch.Stop();
+  printf("md5 paths, one at a time: %.0f paths/s\n",
+         kNumPaths / stop_watch.GetTime());
+  const shash::Md5 check = digests[kNumPaths - 1];
+
+  stop_watch.Reset();
+  stop_watch.Start();
+  shash::Md5Multi(kNumPaths, &chars[0], &lengths[0], &digests[0]);
+  stop_watch.Stop();
+  printf("md5 paths, multi-buffer: %.0f paths/s\n",
+         kNumPaths / stop_watch.GetTime());
+  EXPECT_EQ(check, digests[kNumPaths - 1]);
+}
@@ -0,0 +1,237 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#define __STDC_FORMAT_MACROS
+
+#include <gtest/gtest.h>
+
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "../../cvmfs/cache.h"
+#include "../../cvmfs/compression.h"
+#include "../../cvmfs/duplex_sqlite3.h"
+#include "../../cvmfs/hash.h"
+#include "../../cvmfs/sqlitevfs.h"
+#include "../../cvmfs/statistics.h"
+#include "../../cvmfs/util.h"
+#include "testutil.h"
+
+using namespace std;  // NOLINT
+
+namespace sqlite {
+
+class T_SqliteVfs : public ::testing::Test {
+ protected:
+  static const unsigned kNumRows = 20000;
+  static const uint64_t kMmapBudget = 512 * 1024 * 1024;
+
+  virtual void SetUp() {
+    used_fds_ = GetNoUsedFds();
+    tmp_path_ = CreateTempDir("/tmp/cvmfs_test");
+    ASSERT_NE("", tmp_path_);
+    cache_mgr_ = cache::PosixCacheManager::Create(tmp_path_, false);
+    ASSERT_TRUE(cache_mgr_ != NULL);
+    statistics_ = NULL;
+    vfs_registered_ = false;
+  }
+
+  virtual void TearDown() {
+    if (vfs_registered_)
+      EXPECT_TRUE(UnregisterVfsRdOnly());
+    delete statistics_;
+    delete cache_mgr_;
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+    EXPECT_EQ(used_fds_, GetNoUsedFds());
+  }
+
+  void RegisterVfs(const uint64_t mmap_budget) {
+    if (vfs_registered_)
+      ASSERT_TRUE(UnregisterVfsRdOnly());
+    delete statistics_;
+    statistics_ = new perf::Statistics();
+    ASSERT_TRUE(
+      RegisterVfsRdOnly(cache_mgr_, statistics_, kVfsOptNone, mmap_budget));
+    vfs_registered_ = true;
+  }
+
+  /**
+   * Creates a table keyed by the row number, similar to the md5path index of
+   * file catalogs, and commits the database file into the cache.
+   */
+  void CreateDatabase(const unsigned num_rows) {
+    const string db_path = tmp_path_ + "/test.db";
+    sqlite3 *db;
+    ASSERT_EQ(SQLITE_OK, sqlite3_open_v2(db_path.c_str(), &db,
+      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "unix"));
+    ASSERT_EQ(SQLITE_OK, sqlite3_exec(db,
+      "CREATE TABLE catalog (md5path INTEGER PRIMARY KEY, name TEXT);"
+      "BEGIN;", NULL, NULL, NULL));
+    sqlite3_stmt *stmt;
+    ASSERT_EQ(SQLITE_OK, sqlite3_prepare_v2(db,
+      "INSERT INTO catalog (md5path, name) VALUES (:p, :n);", -1, &stmt,
+      NULL));
+    for (unsigned i = 0; i < num_rows; ++i) {
+      const string name = "entry_" + StringifyInt(i);
+      sqlite3_bind_int64(stmt, 1, i);
+      sqlite3_bind_text(stmt, 2, name.data(), name.length(), SQLITE_STATIC);
+      ASSERT_EQ(SQLITE_DONE, sqlite3_step(stmt));
+      sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    ASSERT_EQ(SQLITE_OK, sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL));
+    ASSERT_EQ(SQLITE_OK, sqlite3_close(db));
+
+    db_id_ = shash::Any(shash::kSha1);
+    ASSERT_TRUE(shash::HashFile(db_path, &db_id_));
+    unsigned char *buffer;
+    unsigned buffer_size;
+    ASSERT_TRUE(CopyPath2Mem(db_path, &buffer, &buffer_size));
+    ASSERT_TRUE(cache_mgr_->CommitFromMem(db_id_, buffer, buffer_size, "db"));
+    free(buffer);
+    db_size_ = buffer_size;
+    unlink(db_path.c_str());
+  }
+
+  /**
+   * The small page cache mimics the scarce SQlite page cache of the client.
+   */
+  sqlite3 *OpenDatabase(const uint64_t mmap_size) {
+    const int fd = cache_mgr_->Open(db_id_);
+    EXPECT_GE(fd, 0);
+    sqlite3 *db;
+    const string name = "@" + StringifyInt(fd);
+    EXPECT_EQ(SQLITE_OK, sqlite3_open_v2(name.c_str(), &db,
+      SQLITE_OPEN_READONLY, "cvmfs-readonly"));
+    const string pragma = "PRAGMA cache_size=16; "
+                          "PRAGMA mmap_size=" + StringifyInt(mmap_size) + ";";
+    EXPECT_EQ(SQLITE_OK, sqlite3_exec(db, pragma.c_str(), NULL, NULL, NULL));
+    return db;
+  }
+
+  /**
+   * Looks up num_lookups rows and returns the number of rows found.
+   */
+  unsigned Lookup(sqlite3 *db, const unsigned num_lookups) {
+    sqlite3_stmt *stmt;
+    EXPECT_EQ(SQLITE_OK, sqlite3_prepare_v2(db,
+      "SELECT name FROM catalog WHERE md5path = :p;", -1, &stmt, NULL));
+    unsigned found = 0;
+    for (unsigned i = 0; i < num_lookups; ++i) {
+      sqlite3_bind_int64(stmt, 1, (i * 7919) % kNumRows);
+      if (sqlite3_step(stmt) == SQLITE_ROW)
+        ++found;
+      sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return found;
+  }
+
+  int64_t GetCounter(const string &name) {
+    return statistics_->Lookup(name)->Get();
+  }
+
+  cache::PosixCacheManager *cache_mgr_;
+  perf::Statistics *statistics_;
+  bool vfs_registered_;
+  string tmp_path_;
+  shash::Any db_id_;
+  uint64_t db_size_;
+  unsigned used_fds_;
+};
+
+
+TEST_F(T_SqliteVfs, ReadWithoutMmap) {
+  RegisterVfs(0);
+  CreateDatabase(kNumRows);
+  sqlite3 *db = OpenDatabase(kMmapBudget);
+  EXPECT_EQ(1000U, Lookup(db, 1000));
+  EXPECT_EQ(0, GetCounter("sqlite.sz_mmap"));
+  EXPECT_EQ(0, GetCounter("sqlite.n_fetch"));
+  EXPECT_GT(GetCounter("sqlite.n_read"), 0);
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db));
+}
+
+
+TEST_F(T_SqliteVfs, ReadWithMmap) {
+  RegisterVfs(kMmapBudget);
+  CreateDatabase(kNumRows);
+  sqlite3 *db = OpenDatabase(kMmapBudget);
+  EXPECT_EQ(1000U, Lookup(db, 1000));
+  EXPECT_EQ(static_cast<int64_t>(db_size_), GetCounter("sqlite.sz_mmap"));
+  EXPECT_GT(GetCounter("sqlite.n_fetch"), 0);
+
+  sqlite3 *db2 = OpenDatabase(kMmapBudget);
+  EXPECT_EQ(1000U, Lookup(db2, 1000));
+  EXPECT_EQ(static_cast<int64_t>(2 * db_size_),
+            GetCounter("sqlite.sz_mmap"));
+
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db));
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db2));
+  EXPECT_EQ(0, GetCounter("sqlite.sz_mmap"));
+}
+
+
+TEST_F(T_SqliteVfs, MmapBudgetExhausted) {
+  CreateDatabase(kNumRows);
+  RegisterVfs(db_size_ + db_size_ / 2);
+  sqlite3 *db = OpenDatabase(kMmapBudget);
+  EXPECT_EQ(static_cast<int64_t>(db_size_), GetCounter("sqlite.sz_mmap"));
+
+  // Served by pread()
+  sqlite3 *db2 = OpenDatabase(kMmapBudget);
+  EXPECT_EQ(static_cast<int64_t>(db_size_), GetCounter("sqlite.sz_mmap"));
+  const int64_t n_read = GetCounter("sqlite.n_read");
+  EXPECT_EQ(1000U, Lookup(db2, 1000));
+  EXPECT_GT(GetCounter("sqlite.n_read"), n_read);
+
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db));
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db2));
+  EXPECT_EQ(0, GetCounter("sqlite.sz_mmap"));
+}
+
+
+TEST_F(T_SqliteVfs, MmapDisabledBySqlite) {
+  RegisterVfs(kMmapBudget);
+  CreateDatabase(kNumRows);
+  sqlite3 *db = OpenDatabase(0);
+  EXPECT_EQ(1000U, Lookup(db, 1000));
+  EXPECT_EQ(0, GetCounter("sqlite.n_fetch"));
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db));
+}
+
+
+TEST_F(T_SqliteVfs, LookupSpeedSlow) {
+  const unsigned kNumLookups = 1000000;
+  CreateDatabase(kNumRows);
+
+  RegisterVfs(0);
+  sqlite3 *db = OpenDatabase(0);
+  StopWatch stopwatch_pread;
+  stopwatch_pread.Start();
+  EXPECT_EQ(kNumLookups, Lookup(db, kNumLookups));
+  stopwatch_pread.Stop();
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db));
+
+  RegisterVfs(kMmapBudget);
+  db = OpenDatabase(kMmapBudget);
+  StopWatch stopwatch_mmap;
+  stopwatch_mmap.Start();
+  EXPECT_EQ(kNumLookups, Lookup(db, kNumLookups));
+  stopwatch_mmap.Stop();
+  EXPECT_GT(GetCounter("sqlite.n_fetch"), 0);
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db));
+
+  printf("%u lookups in a %"PRIu64" bytes database: "
+         "pread %.3fs, mmap %.3fs\n",
+         kNumLookups, db_size_,
+         stopwatch_pread.GetTime(), stopwatch_mmap.GetTime());
+}
+
+}  // namespace sqlite
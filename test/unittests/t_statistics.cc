@@ -4,7 +4,13 @@
 
 #include "gtest/gtest.h"
 
+#include <pthread.h>
+
+#include <cstdio>
+#include <vector>
+
 #include "../../cvmfs/statistics.h"
+#include "../../cvmfs/util.h"
 
 using namespace std;  // NOLINT
 
@@ -38,6 +44,84 @@ TEST(T_Statistics, Counter) {
 }
 
 
+TEST(T_Statistics, ShardedCounter) {
+  ShardedCounter *counter = new ShardedCounter();
+  // Shards must not straddle cache lines
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(counter) % 64);
+  EXPECT_EQ(0, counter->Get());
+  counter->Inc();
+  counter->Inc();
+  EXPECT_EQ(2, counter->Get());
+  counter->Dec();
+  EXPECT_EQ(1, counter->Get());
+  counter->Add(-3);
+  EXPECT_EQ(-2, counter->Get());
+  counter->Set(42);
+  EXPECT_EQ(42, counter->Get());
+  EXPECT_EQ("42", counter->ToString());
+  delete counter;
+}
+
+
+namespace {
+
+const unsigned kIncrementsPerThread = 1000000;
+
+template <class CounterT>
+void *MainIncrement(void *data) {
+  CounterT *counter = reinterpret_cast<CounterT *>(data);
+  for (unsigned i = 0; i < kIncrementsPerThread; ++i)
+    perf::Inc(counter);
+  return NULL;
+}
+
+template <class CounterT>
+double RunIncrements(CounterT *counter, const unsigned num_threads) {
+  std::vector<pthread_t> threads(num_threads);
+  StopWatch stopwatch;
+  stopwatch.Start();
+  for (unsigned i = 0; i < num_threads; ++i) {
+    int retval = pthread_create(&threads[i], NULL, MainIncrement<CounterT>,
+                                counter);
+    EXPECT_EQ(0, retval);
+  }
+  for (unsigned i = 0; i < num_threads; ++i)
+    pthread_join(threads[i], NULL);
+  stopwatch.Stop();
+  EXPECT_EQ(static_cast<int64_t>(num_threads) * kIncrementsPerThread,
+            counter->Get());
+  return stopwatch.GetTime();
+}
+
+}  // anonymous namespace
+
+
+TEST(T_Statistics, ShardedCounterConcurrent) {
+  ShardedCounter *counter = new ShardedCounter();
+  RunIncrements(counter, 8);
+  delete counter;
+}
+
+
+TEST(T_Statistics, ShardedCounterScalingSlow) {
+  const unsigned number_of_threads[] = {1, 2, 4, 8, 16};
+  for (unsigned t = 0; t < sizeof(number_of_threads) / sizeof(unsigned); ++t)
+  {
+    Counter counter;
+    ShardedCounter *sharded_counter = new ShardedCounter();
+    const double time_plain = RunIncrements(&counter, number_of_threads[t]);
+    const double time_sharded =
+      RunIncrements(sharded_counter, number_of_threads[t]);
+    delete sharded_counter;
+    const double increments =
+      static_cast<double>(number_of_threads[t]) * kIncrementsPerThread;
+    printf("%u threads: Counter %.1f M/s, ShardedCounter %.1f M/s\n",
+           number_of_threads[t], increments / time_plain / 1e6,
+           increments / time_sharded / 1e6);
+  }
+}
+
+
 TEST(T_Statistics, Statistics) {
   Statistics statistics;
 
@@ -53,6 +137,19 @@ TEST(T_Statistics, Statistics) {
 
   EXPECT_EQ("test.counter|0|a test counter\n",
             statistics.PrintList(Statistics::kPrintSimple));
+
+  ShardedCounter *sharded =
+    statistics.RegisterSharded("test.sharded", "a sharded counter");
+  ASSERT_TRUE(sharded != NULL);
+  ASSERT_DEATH(statistics.RegisterSharded("test.counter", "Name Clash"), ".*");
+  sharded->Inc();
+  EXPECT_EQ(sharded, statistics.LookupSharded("test.sharded"));
+  EXPECT_EQ(NULL, statistics.Lookup("test.sharded"));
+  EXPECT_EQ(NULL, statistics.LookupSharded("test.counter"));
+  EXPECT_EQ("a sharded counter", statistics.LookupDesc("test.sharded"));
+  EXPECT_EQ("test.counter|0|a test counter\n"
+            "test.sharded|1|a sharded counter\n",
+            statistics.PrintList(Statistics::kPrintSimple));
 }
 
 }  // namespace perf
@@ -0,0 +1,52 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../../cvmfs/hash.h"
+#include "../../cvmfs/swissknife_check.h"
+#include "../../cvmfs/util.h"
+
+using namespace std;  // NOLINT
+
+namespace swissknife {
+
+TEST(T_SwissknifeCheck, ObjectSet) {
+  ObjectSet objects;
+  EXPECT_EQ(0U, objects.size());
+
+  shash::Any hash_sha1(shash::kSha1);
+  shash::HashString("sha1", &hash_sha1);
+  shash::Any hash_md5(shash::kMd5);
+  shash::HashString("md5", &hash_md5);
+  EXPECT_TRUE(objects.Insert(hash_sha1, shash::kSuffixNone));
+  EXPECT_FALSE(objects.Insert(hash_sha1, shash::kSuffixNone));
+  EXPECT_TRUE(objects.Insert(hash_md5, shash::kSuffixNone));
+  EXPECT_FALSE(objects.Insert(hash_md5, shash::kSuffixNone));
+  EXPECT_EQ(2U, objects.size());
+
+  // The same content as a different kind of object is stored separately
+  EXPECT_TRUE(objects.Insert(hash_sha1, shash::kSuffixPartial));
+  EXPECT_TRUE(objects.Insert(hash_sha1, shash::kSuffixCatalog));
+  EXPECT_FALSE(objects.Insert(hash_sha1, shash::kSuffixPartial));
+  EXPECT_EQ(4U, objects.size());
+
+  // Grows beyond the initial capacity
+  const unsigned kNumObjects = 100000;
+  for (unsigned i = 0; i < kNumObjects; ++i) {
+    shash::Any hash(shash::kSha1);
+    shash::HashString(StringifyInt(i), &hash);
+    EXPECT_TRUE(objects.Insert(hash, shash::kSuffixNone));
+  }
+  EXPECT_EQ(kNumObjects + 4, objects.size());
+  for (unsigned i = 0; i < kNumObjects; ++i) {
+    shash::Any hash(shash::kSha1);
+    shash::HashString(StringifyInt(i), &hash);
+    EXPECT_FALSE(objects.Insert(hash, shash::kSuffixNone));
+  }
+}
+
+}  // namespace swissknife
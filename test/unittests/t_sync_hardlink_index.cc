@@ -0,0 +1,129 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <set>
+#include <string>
+
+#include "../../cvmfs/platform.h"
+#include "../../cvmfs/sync_hardlink_index.h"
+#include "../../cvmfs/util.h"
+
+using namespace std;  // NOLINT
+
+namespace publish {
+
+class T_HardlinkIndex : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    tmp_path_ = CreateTempDir("/tmp/cvmfs_test");
+    ASSERT_FALSE(tmp_path_.empty());
+  }
+
+  virtual void TearDown() {
+    if (!tmp_path_.empty())
+      RemoveTree(tmp_path_);
+  }
+
+  void CreateFile(const string &name) {
+    FILE *f = fopen((tmp_path_ + "/" + name).c_str(), "w");
+    ASSERT_TRUE(f != NULL);
+    fclose(f);
+  }
+
+  void CreateHardlink(const string &target, const string &name) {
+    ASSERT_EQ(0, link((tmp_path_ + "/" + target).c_str(),
+                      (tmp_path_ + "/" + name).c_str()));
+  }
+
+  uint64_t GetInode(const string &name) {
+    platform_stat64 info;
+    EXPECT_EQ(0, platform_lstat((tmp_path_ + "/" + name).c_str(), &info));
+    return info.st_ino;
+  }
+
+  string tmp_path_;
+};
+
+
+TEST_F(T_HardlinkIndex, Groups) {
+  CreateFile("a");
+  CreateHardlink("a", "b");
+  CreateHardlink("a", "c");
+  CreateFile("d");
+  CreateHardlink("d", "e");
+  CreateFile("single");
+  ASSERT_TRUE(MkdirDeep(tmp_path_ + "/dir", 0700));
+  CreateHardlink("a", "dir/x");
+
+  HardlinkIndex index;
+  EXPECT_FALSE(index.built());
+  index.Build(tmp_path_);
+  EXPECT_TRUE(index.built());
+  EXPECT_EQ(2U, index.size());
+
+  const set<string> *group = index.GetGroup(GetInode("a"));
+  ASSERT_TRUE(group != NULL);
+  // The link in the sub directory is not part of the group
+  EXPECT_EQ(3U, group->size());
+  EXPECT_EQ(1U, group->count("a"));
+  EXPECT_EQ(1U, group->count("b"));
+  EXPECT_EQ(1U, group->count("c"));
+
+  group = index.GetGroup(GetInode("e"));
+  ASSERT_TRUE(group != NULL);
+  EXPECT_EQ(2U, group->size());
+  EXPECT_EQ(1U, group->count("d"));
+  EXPECT_EQ(1U, group->count("e"));
+
+  EXPECT_EQ(NULL, index.GetGroup(GetInode("single")));
+  EXPECT_EQ(NULL, index.GetGroup(GetInode("dir")));
+
+  EXPECT_FALSE(index.IsVerified(GetInode("a")));
+  index.MarkVerified(GetInode("a"));
+  EXPECT_TRUE(index.IsVerified(GetInode("a")));
+  EXPECT_FALSE(index.IsVerified(GetInode("d")));
+}
+
+
+TEST_F(T_HardlinkIndex, ManyHardlinksSlow) {
+  const unsigned kNumGroups = 1000;
+  const unsigned kGroupSize = 4;
+  for (unsigned i = 0; i < kNumGroups; ++i) {
+    const string target = "f" + StringifyInt(i) + "-0";
+    CreateFile(target);
+    for (unsigned j = 1; j < kGroupSize; ++j)
+      CreateHardlink(target, "f" + StringifyInt(i) + "-" + StringifyInt(j));
+  }
+
+  // Every hardlinked file asks for its group, like the overlayfs
+  // synchronization does for copied-up hardlinks
+  StopWatch stopwatch;
+  stopwatch.Start();
+  HardlinkIndex index;
+  index.Build(tmp_path_);
+  unsigned num_found = 0;
+  for (unsigned i = 0; i < kNumGroups; ++i) {
+    for (unsigned j = 0; j < kGroupSize; ++j) {
+      const string name = "f" + StringifyInt(i) + "-" + StringifyInt(j);
+      const set<string> *group = index.GetGroup(GetInode(name));
+      ASSERT_TRUE(group != NULL);
+      EXPECT_EQ(kGroupSize, group->size());
+      num_found += group->count(name);
+    }
+  }
+  stopwatch.Stop();
+
+  EXPECT_EQ(kNumGroups, index.size());
+  EXPECT_EQ(kNumGroups * kGroupSize, num_found);
+  printf("%u hardlink group lookups in a directory of %u files: %.3fs\n",
+         kNumGroups * kGroupSize, kNumGroups * kGroupSize,
+         stopwatch.GetTime());
+}
+
+}  // namespace publish
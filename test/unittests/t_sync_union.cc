@@ -0,0 +1,285 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../../cvmfs/sync_item.h"
+#include "../../cvmfs/sync_mediator.h"
+#include "../../cvmfs/sync_union.h"
+#include "../../cvmfs/util.h"
+
+using namespace std;  // NOLINT
+
+namespace publish {
+
+/**
+ * Records the calls of the union file system traversal.
+ */
+class MockSyncMediator : public AbstractSyncMediator {
+ public:
+  MockSyncMediator() : union_engine_(NULL) { }
+
+  void RegisterUnionEngine(SyncUnion *engine) { union_engine_ = engine; }
+
+  void Add(const SyncItem &entry) { Record("add", entry); }
+  void Touch(const SyncItem &entry) { Record("touch", entry); }
+  void Remove(const SyncItem &entry) { Record("remove", entry); }
+  void Replace(const SyncItem &entry) { Record("replace", entry); }
+  void EnterDirectory(const SyncItem &entry) { Record("enter", entry); }
+  void LeaveDirectory(const SyncItem &entry) { Record("leave", entry); }
+
+  vector<string> calls;
+
+ private:
+  void Record(const string &action, const SyncItem &entry) {
+    calls.push_back(action + " /" + entry.GetRelativePath());
+  }
+
+  SyncUnion *union_engine_;
+};
+
+
+static bool IsFileTouch(const string &call) {
+  return HasPrefix(call, "touch /dir/f", false);
+}
+
+
+class T_SyncUnion : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    base_path_ = CreateTempDir("/tmp/cvmfs_test");
+    ASSERT_FALSE(base_path_.empty());
+    rdonly_path_ = base_path_ + "/rdonly";
+    union_path_ = base_path_ + "/union";
+    scratch_path_ = base_path_ + "/scratch";
+    ASSERT_TRUE(MkdirDeep(rdonly_path_, 0700));
+    ASSERT_TRUE(MkdirDeep(union_path_, 0700));
+    ASSERT_TRUE(MkdirDeep(scratch_path_, 0700));
+  }
+
+  virtual void TearDown() {
+    if (!base_path_.empty())
+      RemoveTree(base_path_);
+  }
+
+  /**
+   * A directory that exists in the read-only branch and was changed
+   */
+  void ChangedDir(const string &path) {
+    ASSERT_TRUE(MkdirDeep(rdonly_path_ + "/" + path, 0700));
+    ASSERT_TRUE(MkdirDeep(union_path_ + "/" + path, 0700));
+    ASSERT_TRUE(MkdirDeep(scratch_path_ + "/" + path, 0700));
+  }
+
+  void NewDir(const string &path) {
+    ASSERT_TRUE(MkdirDeep(union_path_ + "/" + path, 0700));
+    ASSERT_TRUE(MkdirDeep(scratch_path_ + "/" + path, 0700));
+  }
+
+  void CreateFile(const string &path) {
+    FILE *f = fopen(path.c_str(), "w");
+    ASSERT_TRUE(f != NULL);
+    fclose(f);
+  }
+
+  void NewFile(const string &path) {
+    CreateFile(union_path_ + "/" + path);
+    CreateFile(scratch_path_ + "/" + path);
+  }
+
+  /**
+   * A file that exists in the read-only branch and was copied up
+   */
+  void ChangedFile(const string &path) {
+    NewFile(path);
+  }
+
+  void RdOnlyHardlink(const string &target, const string &name) {
+    ASSERT_EQ(0, link((rdonly_path_ + "/" + target).c_str(),
+                      (rdonly_path_ + "/" + name).c_str()));
+  }
+
+  vector<string> Traverse(const unsigned num_threads) {
+    MockSyncMediator mediator;
+    SyncUnionAufs sync(&mediator, rdonly_path_, union_path_, scratch_path_);
+    sync.set_num_traversal_threads(num_threads);
+    sync.Traverse();
+    return mediator.calls;
+  }
+
+  vector<string> TraverseOverlayfs(const unsigned num_threads) {
+    MockSyncMediator mediator;
+    SyncUnionOverlayfs sync(&mediator, rdonly_path_, union_path_,
+                            scratch_path_);
+    sync.set_num_traversal_threads(num_threads);
+    sync.Traverse();
+    return mediator.calls;
+  }
+
+  /**
+   * The parallel traversal needs to result in the same calls, in the same
+   * order, as the serial one.
+   */
+  void ExpectSameAsSerial(const unsigned num_threads) {
+    const vector<string> serial = Traverse(1);
+    const vector<string> parallel = Traverse(num_threads);
+    ASSERT_EQ(serial.size(), parallel.size());
+    for (unsigned i = 0; i < serial.size(); ++i)
+      EXPECT_EQ(serial[i], parallel[i]) << "at call " << i;
+  }
+
+  string base_path_;
+  string rdonly_path_;
+  string union_path_;
+  string scratch_path_;
+};
+
+
+TEST_F(T_SyncUnion, EmptyTree) {
+  const vector<string> calls = Traverse(4);
+  ASSERT_EQ(2U, calls.size());
+  EXPECT_EQ("enter /", calls[0]);
+  EXPECT_EQ("leave /", calls[1]);
+  ExpectSameAsSerial(4);
+}
+
+
+TEST_F(T_SyncUnion, Ordering) {
+  for (unsigned i = 0; i < 5; ++i) {
+    const string dir = "dir" + StringifyInt(i);
+    ChangedDir(dir);
+    NewFile(dir + "/file");
+    for (unsigned j = 0; j < 5; ++j) {
+      const string subdir = dir + "/sub" + StringifyInt(j);
+      ChangedDir(subdir);
+      NewFile(subdir + "/a");
+      NewFile(subdir + "/b");
+    }
+  }
+  // New directories are added as a whole and not descended into
+  NewDir("new/nested");
+  NewFile("new/nested/file");
+  // Opaque directories are replaced, their speculatively scanned content
+  // is dropped
+  ChangedDir("opaque/sub");
+  NewFile("opaque/.wh..wh..opq");
+  NewFile("opaque/sub/file");
+  // Whiteouts are removals
+  CreateFile(rdonly_path_ + "/dir0/gone");
+  NewFile("dir0/.wh.gone");
+
+  const vector<string> calls = Traverse(4);
+  EXPECT_NE(calls.end(), find(calls.begin(), calls.end(), "add /new"));
+  EXPECT_EQ(calls.end(),
+            find(calls.begin(), calls.end(), "add /new/nested/file"));
+  EXPECT_NE(calls.end(), find(calls.begin(), calls.end(), "replace /opaque"));
+  EXPECT_EQ(calls.end(),
+            find(calls.begin(), calls.end(), "enter /opaque/sub"));
+  EXPECT_NE(calls.end(), find(calls.begin(), calls.end(), "remove /dir0/gone"));
+  for (unsigned num_threads = 2; num_threads <= 8; num_threads *= 2)
+    ExpectSameAsSerial(num_threads);
+}
+
+
+TEST_F(T_SyncUnion, DeepNesting) {
+  string path = "d";
+  for (unsigned i = 0; i < 100; ++i) {
+    ChangedDir(path);
+    NewFile(path + "/f");
+    path += "/d";
+  }
+  const vector<string> calls = Traverse(4);
+  // enter, touch, add file, leave per level plus the root
+  EXPECT_EQ(100U * 4 + 2, calls.size());
+  ExpectSameAsSerial(4);
+}
+
+
+TEST_F(T_SyncUnion, WideTree) {
+  // More directories than two scanner threads may read ahead of the replay
+  const unsigned kNumDirs = 300;
+  for (unsigned i = 0; i < kNumDirs; ++i) {
+    const string dir = "dir" + StringifyInt(i);
+    ChangedDir(dir);
+    ChangedDir(dir + "/sub");
+    NewFile(dir + "/sub/file");
+  }
+  ExpectSameAsSerial(2);
+}
+
+
+TEST_F(T_SyncUnion, OverlayfsCopiedUpHardlinks) {
+  ChangedDir("dir");
+  CreateFile(rdonly_path_ + "/dir/a");
+  RdOnlyHardlink("dir/a", "dir/b");
+  RdOnlyHardlink("dir/a", "dir/c");
+  CreateFile(rdonly_path_ + "/dir/d");
+  RdOnlyHardlink("dir/d", "dir/e");
+  // The entire group is part of the transaction
+  ChangedFile("dir/a");
+  ChangedFile("dir/b");
+  ChangedFile("dir/c");
+  // A singly linked file does not need the hardlink index
+  CreateFile(rdonly_path_ + "/dir/single");
+  ChangedFile("dir/single");
+
+  for (unsigned num_threads = 1; num_threads <= 4; num_threads *= 4) {
+    const vector<string> calls = TraverseOverlayfs(num_threads);
+    EXPECT_NE(calls.end(), find(calls.begin(), calls.end(), "touch /dir/a"));
+    EXPECT_NE(calls.end(), find(calls.begin(), calls.end(), "touch /dir/b"));
+    EXPECT_NE(calls.end(), find(calls.begin(), calls.end(), "touch /dir/c"));
+    EXPECT_NE(calls.end(),
+              find(calls.begin(), calls.end(), "touch /dir/single"));
+    EXPECT_EQ(calls.end(), find(calls.begin(), calls.end(), "touch /dir/d"));
+  }
+}
+
+
+TEST_F(T_SyncUnion, OverlayfsBrokenHardlinkGroup) {
+  ChangedDir("dir");
+  CreateFile(rdonly_path_ + "/dir/a");
+  RdOnlyHardlink("dir/a", "dir/b");
+  // Only one member of the group has been copied up
+  ChangedFile("dir/a");
+  EXPECT_DEATH(TraverseOverlayfs(1), ".*");
+}
+
+
+TEST_F(T_SyncUnion, OverlayfsManyHardlinksSlow) {
+  const unsigned kNumGroups = 1000;
+  const unsigned kGroupSize = 4;
+  ChangedDir("dir");
+  for (unsigned i = 0; i < kNumGroups; ++i) {
+    const string target = "dir/f" + StringifyInt(i) + "-0";
+    CreateFile(rdonly_path_ + "/" + target);
+    ChangedFile(target);
+    for (unsigned j = 1; j < kGroupSize; ++j) {
+      const string name = "dir/f" + StringifyInt(i) + "-" + StringifyInt(j);
+      RdOnlyHardlink(target, name);
+      ChangedFile(name);
+    }
+  }
+
+  // Every copied-up file of the directory looks up its hardlink group
+  StopWatch stopwatch;
+  stopwatch.Start();
+  const vector<string> calls = TraverseOverlayfs(1);
+  stopwatch.Stop();
+
+  EXPECT_EQ(kNumGroups * kGroupSize,
+            static_cast<unsigned>(count_if(calls.begin(), calls.end(),
+                                           IsFileTouch)));
+  printf("overlayfs traversal of %u copied-up hardlinks: %.3fs\n",
+         kNumGroups * kGroupSize, stopwatch.GetTime());
+}
+
+}  // namespace publish
@@ -0,0 +1,162 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../../cvmfs/shortstring.h"
+#include "../../cvmfs/tracer.h"
+#include "../../cvmfs/util.h"
+
+using namespace std;  // NOLINT
+
+namespace tracer {
+
+const int kNumRecordsPerThread = 100;
+
+class T_Tracer : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    FILE *f = CreateTempFile("/tmp/cvmfs_test", 0600, "w", &trace_path_);
+    ASSERT_TRUE(f != NULL);
+    fclose(f);
+    csv_path_ = trace_path_ + ".csv";
+  }
+
+  virtual void TearDown() {
+    Fini();
+    unlink(trace_path_.c_str());
+    unlink(csv_path_.c_str());
+  }
+
+  vector<Record> ReadRecords() {
+    vector<Record> records;
+    FILE *f = fopen(trace_path_.c_str(), "r");
+    if (f == NULL)
+      return records;
+    Record record;
+    while (fread(&record, sizeof(record), 1, f) == 1)
+      records.push_back(record);
+    fclose(f);
+    return records;
+  }
+
+  static void *MainTraceThread(void *data) {
+    const int id = *reinterpret_cast<int *>(data);
+    for (int i = 0; i < kNumRecordsPerThread; ++i)
+      Trace(kFuseOpen, PathString("/thread"), StringifyInt(id));
+    return NULL;
+  }
+
+  string trace_path_;
+  string csv_path_;
+};
+
+
+TEST_F(T_Tracer, InitNull) {
+  InitNull();
+  Trace(kFuseOpen, PathString("/file"), "open");
+  Flush();
+  EXPECT_EQ(0, GetNumDropped());
+  EXPECT_EQ(0, GetFileSize(trace_path_));
+}
+
+
+TEST_F(T_Tracer, WriteConvert) {
+  Init(8, 4, trace_path_);
+  Trace(kFuseOpen, PathString("/file"), "open");
+  const string long_path(kMaxPathLength + 10, 'x');
+  Trace(kFuseLs, PathString(long_path), "with \"quotes\"");
+  Flush();
+
+  vector<Record> records = ReadRecords();
+  // Init, two messages, flush
+  ASSERT_EQ(4U, records.size());
+  EXPECT_EQ(-1, records[0].code);
+  EXPECT_EQ(kFuseOpen, records[1].code);
+  EXPECT_EQ("/file", string(records[1].path, records[1].path_length));
+  EXPECT_EQ("open", string(records[1].msg, records[1].msg_length));
+  EXPECT_EQ(kFuseLs, records[2].code);
+  EXPECT_EQ(kMaxPathLength, records[2].path_length);
+  EXPECT_EQ(-3, records[3].code);
+
+  ASSERT_TRUE(ConvertToCsv(trace_path_, csv_path_));
+  FILE *f = fopen(csv_path_.c_str(), "r");
+  ASSERT_TRUE(f != NULL);
+  vector<string> lines;
+  string line;
+  while (GetLineFile(f, &line))
+    lines.push_back(line);
+  fclose(f);
+  ASSERT_EQ(4U, lines.size());
+  EXPECT_NE(string::npos, lines[1].find(",\"1\",\"/file\",\"open\"\r"));
+  EXPECT_NE(string::npos, lines[2].find(",\"with \"\"quotes\"\"\"\r"));
+}
+
+
+TEST_F(T_Tracer, DropOnOverflow) {
+  Init(4, 3, trace_path_);
+  // The flush thread drains concurrently, but tracing never waits for it
+  unsigned num_accepted = 1;  // Init record
+  for (unsigned i = 0; i < 1000; ++i) {
+    if (TraceInternal(kFuseRead, PathString("/file"), "read"))
+      num_accepted++;
+  }
+  const int64_t num_dropped = GetNumDropped();
+  EXPECT_EQ(1000 + 1 - num_accepted, num_dropped);
+  Flush();
+  Fini();
+
+  vector<Record> records = ReadRecords();
+  // Accepted records and at least one record announcing the dropped messages;
+  // the flush marker might have been dropped itself
+  EXPECT_LE(num_accepted + 1, records.size());
+  unsigned num_traced = 0;
+  unsigned num_drop_notes = 0;
+  for (unsigned i = 0; i < records.size(); ++i) {
+    if (records[i].code == kFuseRead)
+      num_traced++;
+    if (records[i].code == -4)
+      num_drop_notes++;
+  }
+  EXPECT_EQ(num_accepted - 1, num_traced);
+  if (num_dropped > 0)
+    EXPECT_LE(1U, num_drop_notes);
+}
+
+
+TEST_F(T_Tracer, MultipleThreads) {
+  const int kNumThreads = 8;
+  Init(kNumRecordsPerThread + 1, kNumRecordsPerThread / 2, trace_path_);
+  pthread_t threads[kNumThreads];
+  int ids[kNumThreads];
+  for (int i = 0; i < kNumThreads; ++i) {
+    ids[i] = i;
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, MainTraceThread, &ids[i]));
+  }
+  for (int i = 0; i < kNumThreads; ++i)
+    ASSERT_EQ(0, pthread_join(threads[i], NULL));
+  EXPECT_EQ(0, GetNumDropped());
+  Fini();
+
+  vector<Record> records = ReadRecords();
+  vector<int> per_thread(kNumThreads, 0);
+  for (unsigned i = 0; i < records.size(); ++i) {
+    EXPECT_NE(-4, records[i].code);
+    if (records[i].code == kFuseOpen) {
+      per_thread[String2Uint64(string(records[i].msg,
+                                      records[i].msg_length))]++;
+    }
+  }
+  for (int i = 0; i < kNumThreads; ++i)
+    EXPECT_EQ(kNumRecordsPerThread, per_thread[i]);
+}
+
+}  // namespace tracer
@@ -26,6 +26,10 @@
  * Port of S3 mockup server
  */
 #define CVMFS_S3_TEST_MOCKUP_SERVER_PORT 8082
+/**
+ * Upload id that the S3 mockup server assigns to multipart uploads
+ */
+#define CVMFS_S3_TEST_MOCKUP_UPLOAD_ID "VXBsb2FkSWQ-mockup"
 
 namespace upload {
 
@@ -95,11 +99,14 @@ class T_Uploaders : public FileSandbox {
   typedef std::vector<CharBuffer*>                       Buffers;
   typedef std::vector<std::pair<Buffers, StreamHandle> > BufferStreams;
 
-  T_Uploaders() : FileSandbox(T_Uploaders::sandbox_path), uploader_(NULL) {}
+  T_Uploaders() : FileSandbox(T_Uploaders::sandbox_path), uploader_(NULL),
+                  verify_existence_filter_hits_(true) {}
 
  protected:
   AbstractUploader *uploader_;
   UploadCallbacks   delegate_;
+  std::string       existence_filter_path_;
+  bool              verify_existence_filter_hits_;
 
   virtual void SetUp() {
     CreateSandbox(T_Uploaders::tmp_dir);
@@ -127,6 +134,32 @@ class T_Uploaders : public FileSandbox {
   }
 
 
+  /**
+   * Replaces the uploader by one that uses additional S3 configuration
+   * parameters.  The local uploader ignores them.
+   */
+  void ReconstructUploader(const std::string &s3_options) {
+    uploader_->TearDown();
+    delete uploader_;
+    uploader_ = NULL;
+    ConfigureUploader(type<UploadersT>(), s3_options);
+    uploader_ = AbstractUploader::Construct(GetSpoolerDefinition());
+    ASSERT_NE(static_cast<AbstractUploader*>(NULL), uploader_);
+  }
+
+
+  void ConfigureUploader(const type<upload::LocalUploader> type_specifier,
+                         const std::string &s3_options) {
+    // Empty, no specific needs
+  }
+
+
+  void ConfigureUploader(const type<upload::S3Uploader> type_specifier,
+                         const std::string &s3_options) {
+    CreateTempS3ConfigFile(10, 10, s3_options);
+  }
+
+
   virtual void TearDown() {
     TearDown(type<UploadersT>());
 
@@ -177,12 +210,47 @@ class T_Uploaders : public FileSandbox {
     const size_t avg_chunk_size  = 1;   // only testing the upload module.
     const size_t max_chunk_size  = 2;
 
-    return SpoolerDefinition(definition,
-                             shash::kSha1,
-                             use_file_chunking,
-                             min_chunk_size,
-                             avg_chunk_size,
-                             max_chunk_size);
+    SpoolerDefinition spooler_definition(definition,
+                                         shash::kSha1,
+                                         use_file_chunking,
+                                         min_chunk_size,
+                                         avg_chunk_size,
+                                         max_chunk_size);
+    spooler_definition.existence_filter_path = existence_filter_path_;
+    spooler_definition.verify_existence_filter_hits =
+      verify_existence_filter_hits_;
+    return spooler_definition;
+  }
+
+
+  /**
+   * Replaces the uploader by one that uses an existence filter.  The filter of
+   * the previous uploader, if any, is saved and loaded again.
+   */
+  void EnableExistenceFilter(const bool verify_hits) {
+    existence_filter_path_ = T_Uploaders::tmp_dir + "/existence_filter";
+    verify_existence_filter_hits_ = verify_hits;
+    ReconstructUploader("");
+  }
+
+
+  void StreamedUpload(const Buffers &buffers, const shash::Any &content_hash) {
+    UploadStreamHandle *handle = uploader_->InitStreamedUpload(
+        AbstractUploader::MakeClosure(&UploadCallbacks::StreamedUploadComplete,
+                                      &delegate_,
+                                      0));
+    ASSERT_NE(static_cast<UploadStreamHandle*>(NULL), handle);
+    typename Buffers::const_iterator i    = buffers.begin();
+    typename Buffers::const_iterator iend = buffers.end();
+    for (; i != iend; ++i) {
+      uploader_->ScheduleUpload(handle, *i,
+                                AbstractUploader::MakeClosure(
+                                    &UploadCallbacks::BufferUploadComplete,
+                                    &delegate_,
+                                    UploaderResults(0, *i)));
+    }
+    uploader_->ScheduleCommit(handle, content_hash);
+    uploader_->WaitForUpload();
   }
 
 
@@ -275,6 +343,18 @@ class T_Uploaders : public FileSandbox {
     return FileExists(absolute_path);
   }
 
+  /**
+   * The S3 mockup server counts multi-object deletions in the log file and
+   * fails them with the HTTP status written to the failure file
+   */
+  static std::string MultiDeleteLogPath() {
+    return T_Uploaders::dest_dir + "/multi_delete.log";
+  }
+
+  static std::string MultiDeleteFailurePath() {
+    return T_Uploaders::dest_dir + "/multi_delete.fail";
+  }
+
 
   void CompareFileContents(const std::string &testee_path,
                            const std::string &reference_path) const {
@@ -305,6 +385,15 @@ class T_Uploaders : public FileSandbox {
   }
 
 
+  bool IsS3() const { return IsS3(type<UploadersT>()); }
+  bool IsS3(const type<upload::LocalUploader> type_specifier) const {
+    return false;
+  }
+  bool IsS3(const type<upload::S3Uploader> type_specifier) const {
+    return true;
+  }
+
+
   std::string AbsoluteDestinationPath(const std::string &remote_path) const {
     std::string retme = T_Uploaders::dest_dir;
     if (repo_alias.size() > 0)
@@ -446,15 +535,36 @@ class T_Uploaders : public FileSandbox {
       req_type = GetField(req_header, ' ', 0);
       req_file = GetField(req_header, ' ', 1);
       req_file = req_file.substr(req_file.find("/", 1) + 1);  // no bucket
-      if (req_type.compare("PUT") == 0) {
+      // Multipart uploads use the query string
+      std::string req_query = "";
+      if (req_file.find('?') != std::string::npos) {
+        req_query = req_file.substr(req_file.find('?') + 1);
+        req_file = req_file.substr(0, req_file.find('?'));
+      }
+      const std::string upload_path = T_Uploaders::dest_dir + "/" + req_file;
+      int part_number = 0;
+      if (HasPrefix(req_query, "partNumber=", false))
+        part_number = atoi(req_query.substr(11).c_str());
+      if ((req_type.compare("PUT") == 0) || (req_type.compare("POST") == 0)) {
         content_length = GetValue(req_header, "Content-Length");
         ASSERT_GE(content_length, 0);
       }
 
       // Get content
       FILE *file = NULL;
-      if (req_type.compare("PUT") == 0) {
-        std::string path = T_Uploaders::dest_dir + "/" + req_file;
+      std::string req_body = "";
+      if (req_type.compare("POST") == 0) {
+        int left_to_read = content_length;
+        while (left_to_read > 0) {
+          int n = read(accept_sockfd, buffer, kReadBufferSize-1);
+          ASSERT_GT(n, 0);
+          req_body += std::string(buffer, n);
+          left_to_read -= n;
+        }
+      } else if (req_type.compare("PUT") == 0) {
+        std::string path = upload_path;
+        if (part_number > 0)
+          path += ".part" + StringifyInt(part_number);
         file = fopen(path.c_str(), "w");
         ASSERT_TRUE(file != NULL);
         int fid = fileno(file);
@@ -473,7 +583,87 @@ class T_Uploaders : public FileSandbox {
 
       // Reply to client
       std::string reply = "HTTP/1.1 200 OK\r\n";
-      if (req_type.compare("HEAD") == 0) {
+      std::string reply_body = "";
+      if (part_number > 0) {
+        reply += "ETag: \"" + StringifyInt(part_number) + "\"\r\n";
+        // Lets the second part of a multipart upload fail
+        if (HasSuffix(req_file, "failing_parts", false) && (part_number == 2))
+          reply = "HTTP/1.1 403 Forbidden\r\n";
+      } else if (req_type.compare("POST") == 0) {
+        if (req_query == "uploads") {
+          reply_body = "<InitiateMultipartUploadResult><UploadId>"
+                       CVMFS_S3_TEST_MOCKUP_UPLOAD_ID
+                       "</UploadId></InitiateMultipartUploadResult>";
+        } else if (req_query == "delete") {
+          // Multi-object deletion
+          FILE *log = fopen(MultiDeleteLogPath().c_str(), "a");
+          ASSERT_TRUE(log != NULL);
+          fputc('.', log);
+          fclose(log);
+          std::string failure;
+          FILE *marker = fopen(MultiDeleteFailurePath().c_str(), "r");
+          if (marker != NULL) {
+            GetLineFile(marker, &failure);
+            fclose(marker);
+          }
+          size_t pos = failure.empty() ? 0 : std::string::npos;
+          if (failure == "400") {
+            reply = "HTTP/1.1 400 Bad Request\r\n";
+            reply_body = "<Error><Code>NotImplemented</Code></Error>";
+          } else if (!failure.empty()) {
+            reply = "HTTP/1.1 " + failure + " Failure\r\n";
+          }
+          while ((pos = req_body.find("<Key>", pos)) != std::string::npos) {
+            pos += 5;
+            const size_t end = req_body.find("</Key>", pos);
+            ASSERT_NE(std::string::npos, end);
+            const std::string path =
+              T_Uploaders::dest_dir + "/" + req_body.substr(pos, end - pos);
+            if (FileExists(path))
+              ASSERT_EQ(0, unlink(path.c_str()));
+          }
+          if (failure.empty())
+            reply_body = "<DeleteResult></DeleteResult>";
+        } else if (HasSuffix(req_file, "retried_completion", false) &&
+                   !FileExists(upload_path + ".failed"))
+        {
+          // Transient failure reported in the body of a successful response,
+          // only the first time
+          FILE *marker = fopen((upload_path + ".failed").c_str(), "w");
+          ASSERT_TRUE(marker != NULL);
+          fclose(marker);
+          reply_body = "<Error><Code>InternalError</Code></Error>";
+        } else {
+          // Complete the multipart upload by concatenating the parts
+          EXPECT_EQ("uploadId=" CVMFS_S3_TEST_MOCKUP_UPLOAD_ID, req_query);
+          FILE *object = fopen(upload_path.c_str(), "w");
+          ASSERT_TRUE(object != NULL);
+          for (int i = 1; FileExists(upload_path + ".part" + StringifyInt(i));
+               ++i)
+          {
+            const std::string part = upload_path + ".part" + StringifyInt(i);
+            FILE *part_file = fopen(part.c_str(), "r");
+            ASSERT_TRUE(part_file != NULL);
+            size_t nbytes;
+            while ((nbytes = fread(buffer, 1, kReadBufferSize, part_file)) > 0)
+              ASSERT_EQ(nbytes, fwrite(buffer, 1, nbytes, object));
+            fclose(part_file);
+            ASSERT_EQ(0, unlink(part.c_str()));
+          }
+          ASSERT_EQ(0, fclose(object));
+          reply_body = "<CompleteMultipartUploadResult>"
+                       "</CompleteMultipartUploadResult>";
+        }
+      } else if (req_type.compare("DELETE") == 0 && !req_query.empty()) {
+        // Abort the multipart upload
+        for (int i = 1; FileExists(upload_path + ".part" + StringifyInt(i));
+             ++i)
+        {
+          const std::string part = upload_path + ".part" + StringifyInt(i);
+          ASSERT_EQ(0, unlink(part.c_str()));
+        }
+        reply = "HTTP/1.1 204 No Content\r\n";
+      } else if (req_type.compare("HEAD") == 0) {
         if (req_file.size() >= 4 &&
             req_file.compare(req_file.size() - 4, 4, "EXIT") == 0) {
           close(listen_sockfd);
@@ -490,7 +680,8 @@ class T_Uploaders : public FileSandbox {
         // "No Content"-reply even if file did not exist
         reply = "HTTP/1.1 204 No Content\r\n";
       }
-      reply += "Connection: close\r\n\r\n";
+      reply += "Content-Length: " + StringifyInt(reply_body.length()) + "\r\n";
+      reply += "Connection: close\r\n\r\n" + reply_body;
 
       int n = write(accept_sockfd, reply.c_str(), reply.length());
       ASSERT_GE(n, 0);
@@ -500,7 +691,8 @@ class T_Uploaders : public FileSandbox {
   }
 
 
-  void CreateTempS3ConfigFile(int accounts, int parallel_connections) {
+  void CreateTempS3ConfigFile(int accounts, int parallel_connections,
+                              const std::string &extra_options = "") {
     ASSERT_GE(accounts, 1);
     ASSERT_GE(parallel_connections, 1);
     FILE *s3_conf = CreateTempFile(T_Uploaders::tmp_dir + "/s3.conf",
@@ -525,6 +717,8 @@ class T_Uploaders : public FileSandbox {
         StringifyInt(parallel_connections) + "\n"
         "CVMFS_S3_HOST=localhost\n"
         "CVMFS_S3_PORT=" + StringifyInt(CVMFS_S3_TEST_MOCKUP_SERVER_PORT);
+    if (!extra_options.empty())
+      conf_str += "\n" + extra_options;
 
     fprintf(s3_conf, "%s\n", conf_str.c_str());
     fclose(s3_conf);
@@ -915,4 +1109,399 @@ TYPED_TEST(T_Uploaders, MultipleStreamedUploadSlow) {
   TestFixture::FreeBufferStreams(&streams);
 }
 
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, StreamedUploadSpilledToDisk) {
+  // A limit of 1 MB makes the stream spill over at some point
+  for (unsigned limit = 0; limit < 2; ++limit) {
+    this->ReconstructUploader("CVMFS_S3_STREAM_BUFFER_LIMIT_MB=" +
+                              StringifyInt(limit));
+    const unsigned int number_of_buffers = 10;
+    typename TestFixture::Buffers buffers =
+        TestFixture::MakeRandomizedBuffers(number_of_buffers, 4711 + limit);
+
+    UploadStreamHandle *handle = this->uploader_->InitStreamedUpload(
+        AbstractUploader::MakeClosure(&UploadCallbacks::StreamedUploadComplete,
+                                      &this->delegate_,
+                                      0));
+    ASSERT_NE(static_cast<UploadStreamHandle*>(NULL), handle);
+
+    typename TestFixture::Buffers::const_iterator i    = buffers.begin();
+    typename TestFixture::Buffers::const_iterator iend = buffers.end();
+    for (; i != iend; ++i) {
+      this->uploader_->ScheduleUpload(handle, *i,
+                                      AbstractUploader::MakeClosure(
+                                        &UploadCallbacks::BufferUploadComplete,
+                                        &this->delegate_,
+                                        UploaderResults(0, *i)));
+    }
+    shash::Any content_hash(shash::kSha1, 'A');
+    content_hash.Randomize(limit);
+    this->uploader_->ScheduleCommit(handle, content_hash);
+    this->uploader_->WaitForUpload();
+
+    EXPECT_EQ((limit + 1) * number_of_buffers,
+              this->delegate_.buffer_upload_complete_invocations);
+    EXPECT_EQ(limit + 1, this->delegate_.streamed_upload_complete_invocations);
+    EXPECT_EQ(0u, this->uploader_->GetNumberOfErrors());
+
+    const std::string dest = "data/" + content_hash.MakePath();
+    EXPECT_TRUE(TestFixture::CheckFile(dest));
+    TestFixture::CompareBuffersAndFileContents(
+        buffers,
+        TestFixture::AbsoluteDestinationPath(dest));
+
+    TestFixture::FreeBuffers(&buffers);
+  }
+}
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, StreamedUploadThroughputSlow) {
+  const unsigned int number_of_streams  = 64;
+  const unsigned int buffers_per_stream = 4;
+  const size_t       buffer_size        = 512 * 1024;
+  typename TestFixture::Buffers buffers;
+  Prng rng;
+  rng.InitSeed(42);
+  for (unsigned i = 0; i < buffers_per_stream; ++i) {
+    CharBuffer *buffer = new CharBuffer(buffer_size);
+    for (unsigned j = 0; j < buffer_size; ++j)
+      *(buffer->ptr() + j) = rng.Next(256);
+    buffer->SetUsedBytes(buffer_size);
+    buffers.push_back(buffer);
+  }
+  const double megabytes =
+    static_cast<double>(number_of_streams * buffers_per_stream * buffer_size) /
+    (1024 * 1024);
+
+  // First round uses the default in-memory buffering, the second round writes
+  // every stream to a temporary file
+  for (unsigned round = 0; round < 2; ++round) {
+    if (round == 1)
+      this->ReconstructUploader("CVMFS_S3_STREAM_BUFFER_LIMIT_MB=0");
+
+    std::vector<typename TestFixture::StreamHandle> handles(number_of_streams);
+    StopWatch stopwatch;
+    stopwatch.Start();
+    for (unsigned i = 0; i < number_of_streams; ++i) {
+      handles[i].handle = this->uploader_->InitStreamedUpload(
+        AbstractUploader::MakeClosure(&UploadCallbacks::StreamedUploadComplete,
+                                      &this->delegate_,
+                                      0));
+      ASSERT_NE(static_cast<UploadStreamHandle*>(NULL), handles[i].handle);
+      for (unsigned j = 0; j < buffers_per_stream; ++j) {
+        this->uploader_->ScheduleUpload(
+          handles[i].handle, buffers[j],
+          AbstractUploader::MakeClosure(&UploadCallbacks::BufferUploadComplete,
+                                        &this->delegate_,
+                                        UploaderResults(0, buffers[j])));
+      }
+      this->uploader_->ScheduleCommit(handles[i].handle,
+                                      handles[i].content_hash);
+    }
+    this->uploader_->WaitForUpload();
+    stopwatch.Stop();
+
+    EXPECT_EQ((round + 1) * number_of_streams,
+              this->delegate_.streamed_upload_complete_invocations);
+    EXPECT_EQ(0u, this->uploader_->GetNumberOfErrors());
+    for (unsigned i = 0; i < number_of_streams; ++i) {
+      const std::string dest = "data/" + handles[i].content_hash.MakePath();
+      TestFixture::CompareBuffersAndFileContents(
+        buffers, TestFixture::AbsoluteDestinationPath(dest));
+    }
+    printf("streamed upload %s: %.1f MB/s\n",
+           (round == 0) ? "buffered in memory" : "through temporary files",
+           megabytes / stopwatch.GetTime());
+  }
+
+  TestFixture::FreeBuffers(&buffers);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, MultipartUpload) {
+  this->ReconstructUploader("CVMFS_S3_MULTIPART_THRESHOLD_MB=1\n"
+                            "CVMFS_S3_MULTIPART_PART_SIZE_MB=5");
+
+  // 12 MB file upload, the catalog is uploaded with a HEAD request first
+  std::string big_file_path;
+  this->LazilyCreateDummyFile(this->sandbox_path_, 12 * 1024, &big_file_path,
+                              4711);
+  this->uploader_->Upload(big_file_path, "big_file",
+                          AbstractUploader::MakeClosure(
+                              &UploadCallbacks::SimpleUploadClosure,
+                              &this->delegate_,
+                              UploaderResults(0, big_file_path)));
+  this->uploader_->Upload(big_file_path, ".cvmfspublished",
+                          AbstractUploader::MakeClosure(
+                              &UploadCallbacks::SimpleUploadClosure,
+                              &this->delegate_,
+                              UploaderResults(0, big_file_path)));
+
+  // Streamed upload of a few MB that does not align with the part size
+  typename TestFixture::Buffers buffers =
+      TestFixture::MakeRandomizedBuffers(48, 99);
+  UploadStreamHandle *handle = this->uploader_->InitStreamedUpload(
+      AbstractUploader::MakeClosure(&UploadCallbacks::StreamedUploadComplete,
+                                    &this->delegate_,
+                                    0));
+  ASSERT_NE(static_cast<UploadStreamHandle*>(NULL), handle);
+  typename TestFixture::Buffers::const_iterator i    = buffers.begin();
+  typename TestFixture::Buffers::const_iterator iend = buffers.end();
+  for (; i != iend; ++i) {
+    this->uploader_->ScheduleUpload(handle, *i,
+                                    AbstractUploader::MakeClosure(
+                                        &UploadCallbacks::BufferUploadComplete,
+                                        &this->delegate_,
+                                        UploaderResults(0, *i)));
+  }
+  shash::Any content_hash(shash::kSha1, 'A');
+  content_hash.Randomize(7);
+  this->uploader_->ScheduleCommit(handle, content_hash);
+  this->uploader_->WaitForUpload();
+
+  EXPECT_EQ(2u, this->delegate_.simple_upload_invocations);
+  EXPECT_EQ(1u, this->delegate_.streamed_upload_complete_invocations);
+  EXPECT_EQ(0u, this->uploader_->GetNumberOfErrors());
+  TestFixture::CompareFileContents(big_file_path,
+                                   TestFixture::AbsoluteDestinationPath(
+                                       "big_file"));
+  TestFixture::CompareFileContents(big_file_path,
+                                   TestFixture::AbsoluteDestinationPath(
+                                       ".cvmfspublished"));
+  const std::string dest = "data/" + content_hash.MakePath();
+  TestFixture::CompareBuffersAndFileContents(
+      buffers,
+      TestFixture::AbsoluteDestinationPath(dest));
+  TestFixture::FreeBuffers(&buffers);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, MultipartUploadMany) {
+  this->ReconstructUploader("CVMFS_S3_MULTIPART_THRESHOLD_MB=1\n"
+                            "CVMFS_S3_MULTIPART_PART_SIZE_MB=5");
+
+  // More parts in total than parallel connections, uploads wait for part slots
+  const unsigned kNumFiles = 5;
+  std::string big_file_path;
+  this->LazilyCreateDummyFile(this->sandbox_path_, 12 * 1024, &big_file_path,
+                              4711);
+  for (unsigned i = 0; i < kNumFiles; ++i) {
+    this->uploader_->Upload(big_file_path, "big_file" + StringifyInt(i),
+                            AbstractUploader::MakeClosure(
+                                &UploadCallbacks::SimpleUploadClosure,
+                                &this->delegate_,
+                                UploaderResults(0, big_file_path)));
+  }
+  this->uploader_->WaitForUpload();
+
+  EXPECT_EQ(kNumFiles, this->delegate_.simple_upload_invocations);
+  EXPECT_EQ(0u, this->uploader_->GetNumberOfErrors());
+  for (unsigned i = 0; i < kNumFiles; ++i) {
+    TestFixture::CompareFileContents(big_file_path,
+                                     TestFixture::AbsoluteDestinationPath(
+                                         "big_file" + StringifyInt(i)));
+  }
+}
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, MultipartUploadFailure) {
+  if (!TestFixture::IsS3())
+    return;
+  this->ReconstructUploader("CVMFS_S3_MULTIPART_THRESHOLD_MB=1\n"
+                            "CVMFS_S3_MULTIPART_PART_SIZE_MB=5");
+
+  // The mockup server refuses the second part of this object
+  std::string big_file_path;
+  this->LazilyCreateDummyFile(this->sandbox_path_, 12 * 1024, &big_file_path,
+                              4711);
+  const std::string dest_name     = "failing_parts";
+  this->uploader_->Upload(big_file_path, dest_name,
+                          AbstractUploader::MakeClosure(
+                              &UploadCallbacks::SimpleUploadClosure,
+                              &this->delegate_,
+                              UploaderResults(99, big_file_path)));
+  this->uploader_->WaitForUpload();
+
+  EXPECT_EQ(1u, this->delegate_.simple_upload_invocations);
+  EXPECT_FALSE(TestFixture::CheckFile(dest_name));
+  // Aborting the upload discards the uploaded parts
+  EXPECT_FALSE(TestFixture::CheckFile(dest_name + ".part1"));
+  EXPECT_FALSE(TestFixture::CheckFile(dest_name + ".part2"));
+}
+
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, MultipartCompletionRetry) {
+  if (!TestFixture::IsS3())
+    return;
+  this->ReconstructUploader("CVMFS_S3_MULTIPART_THRESHOLD_MB=1\n"
+                            "CVMFS_S3_MULTIPART_PART_SIZE_MB=5");
+
+  // The mockup server reports an internal error for the first completion
+  std::string big_file_path;
+  this->LazilyCreateDummyFile(this->sandbox_path_, 12 * 1024, &big_file_path,
+                              4711);
+  const std::string dest_name = "retried_completion";
+  this->uploader_->Upload(big_file_path, dest_name,
+                          AbstractUploader::MakeClosure(
+                              &UploadCallbacks::SimpleUploadClosure,
+                              &this->delegate_,
+                              UploaderResults(0, big_file_path)));
+  this->uploader_->WaitForUpload();
+
+  EXPECT_TRUE(TestFixture::CheckFile(dest_name + ".failed"));
+  EXPECT_EQ(1u, this->delegate_.simple_upload_invocations);
+  EXPECT_EQ(0u, this->uploader_->GetNumberOfErrors());
+  TestFixture::CompareFileContents(big_file_path,
+                                   TestFixture::AbsoluteDestinationPath(
+                                       dest_name));
+}
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, ExistenceFilter) {
+  this->EnableExistenceFilter(true);
+  typename TestFixture::Buffers buffers =
+      TestFixture::MakeRandomizedBuffers(5, 17);
+  uint64_t size = 0;
+  for (unsigned i = 0; i < buffers.size(); ++i)
+    size += buffers[i]->used_bytes();
+  shash::Any content_hash(shash::kSha1, 'A');
+  content_hash.Randomize(11);
+  const std::string dest = "data/" + content_hash.MakePath();
+
+  this->StreamedUpload(buffers, content_hash);
+  EXPECT_TRUE(TestFixture::CheckFile(dest));
+  EXPECT_EQ(0u, this->uploader_->GetNumAvoidedUploads());
+
+  // Filter hit, verified in the backend
+  this->StreamedUpload(buffers, content_hash);
+  EXPECT_EQ(1u, this->uploader_->GetNumAvoidedUploads());
+  EXPECT_EQ(size, this->uploader_->GetNumAvoidedBytes());
+
+  // Filter hit of a garbage collected object, uploaded again
+  EXPECT_TRUE(this->uploader_->Remove(content_hash));
+  this->StreamedUpload(buffers, content_hash);
+  EXPECT_TRUE(TestFixture::CheckFile(dest));
+  TestFixture::CompareBuffersAndFileContents(
+      buffers,
+      TestFixture::AbsoluteDestinationPath(dest));
+  EXPECT_EQ(1u, this->uploader_->GetNumAvoidedUploads());
+
+  // The filter is persistent; trusted hits are not verified
+  this->EnableExistenceFilter(false);
+  EXPECT_TRUE(this->uploader_->Remove(content_hash));
+  this->StreamedUpload(buffers, content_hash);
+  EXPECT_FALSE(TestFixture::CheckFile(dest));
+  EXPECT_EQ(1u, this->uploader_->GetNumAvoidedUploads());
+  EXPECT_EQ(size, this->uploader_->GetNumAvoidedBytes());
+
+  EXPECT_EQ(4u, this->delegate_.streamed_upload_complete_invocations);
+  EXPECT_EQ(0u, this->uploader_->GetNumberOfErrors());
+  TestFixture::FreeBuffers(&buffers);
+}
+
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, ScheduleRemove) {
+  const unsigned kNumObjects = 20;
+  typename TestFixture::Buffers buffers =
+      TestFixture::MakeRandomizedBuffers(1, 23);
+  std::vector<shash::Any> content_hashes;
+  for (unsigned i = 0; i < kNumObjects; ++i) {
+    shash::Any content_hash(shash::kSha1);
+    content_hash.Randomize(100 + i);
+    this->StreamedUpload(buffers, content_hash);
+    EXPECT_TRUE(TestFixture::CheckFile("data/" + content_hash.MakePath()));
+    content_hashes.push_back(content_hash);
+  }
+
+  // Removes all but the last object
+  for (unsigned i = 0; i < kNumObjects - 1; ++i)
+    this->uploader_->ScheduleRemove(content_hashes[i]);
+  this->uploader_->WaitForRemove();
+
+  for (unsigned i = 0; i < kNumObjects - 1; ++i) {
+    EXPECT_FALSE(
+      TestFixture::CheckFile("data/" + content_hashes[i].MakePath()));
+  }
+  EXPECT_TRUE(TestFixture::CheckFile(
+    "data/" + content_hashes[kNumObjects - 1].MakePath()));
+  EXPECT_EQ(kNumObjects - 1, this->uploader_->GetNumRemovedObjects());
+  EXPECT_EQ(0u, this->uploader_->GetNumFailedRemovals());
+  TestFixture::FreeBuffers(&buffers);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, MultiDeleteFallback) {
+  if (!TestFixture::IsS3())
+    return;
+  typename TestFixture::Buffers buffers =
+      TestFixture::MakeRandomizedBuffers(1, 29);
+  // Transient failures fall back to single deletions for the affected batch
+  // only, "not implemented" answers for all further batches
+  const char *failures[] = {"503", "501", "400"};
+  const bool expect_multi_delete[] = {true, false, false};
+  for (unsigned f = 0; f < 3; ++f) {
+    this->ReconstructUploader("");
+    std::vector<shash::Any> content_hashes;
+    for (unsigned i = 0; i < 2; ++i) {
+      shash::Any content_hash(shash::kSha1);
+      content_hash.Randomize(200 + 2 * f + i);
+      this->StreamedUpload(buffers, content_hash);
+      content_hashes.push_back(content_hash);
+    }
+
+    FILE *marker = fopen(TestFixture::MultiDeleteFailurePath().c_str(), "w");
+    ASSERT_TRUE(marker != NULL);
+    fprintf(marker, "%s\n", failures[f]);
+    fclose(marker);
+    this->uploader_->ScheduleRemove(content_hashes[0]);
+    this->uploader_->WaitForRemove();
+    EXPECT_FALSE(
+      TestFixture::CheckFile("data/" + content_hashes[0].MakePath()));
+
+    ASSERT_EQ(0, unlink(TestFixture::MultiDeleteFailurePath().c_str()));
+    const int64_t num_requests =
+      GetFileSize(TestFixture::MultiDeleteLogPath());
+    EXPECT_GT(num_requests, 0);
+    this->uploader_->ScheduleRemove(content_hashes[1]);
+    this->uploader_->WaitForRemove();
+    EXPECT_FALSE(
+      TestFixture::CheckFile("data/" + content_hashes[1].MakePath()));
+    EXPECT_EQ(expect_multi_delete[f],
+              GetFileSize(TestFixture::MultiDeleteLogPath()) > num_requests)
+      << "failure " << failures[f];
+    EXPECT_EQ(2u, this->uploader_->GetNumRemovedObjects());
+    EXPECT_EQ(0u, this->uploader_->GetNumFailedRemovals());
+  }
+  TestFixture::FreeBuffers(&buffers);
+}
+
 }  // namespace upload
@@ -194,6 +194,40 @@ DirectoryEntry DirectoryEntryTestFactory::ChunkedFile() {
   return dirent;
 }
 
+
+DirectoryEntry DirectoryEntryTestFactory::RegularFile(
+  const std::string &name,
+  const unsigned size,
+  const shash::Any &hash)
+{
+  DirectoryEntry dirent = RegularFile();
+  dirent.name_.Assign(name.data(), name.length());
+  dirent.size_ = size;
+  dirent.mtime_ = size;
+  dirent.checksum_ = hash;
+  return dirent;
+}
+
+
+DirectoryEntry DirectoryEntryTestFactory::Directory(const std::string &name) {
+  DirectoryEntry dirent = Directory();
+  dirent.name_.Assign(name.data(), name.length());
+  dirent.size_ = 4096;
+  return dirent;
+}
+
+
+DirectoryEntry DirectoryEntryTestFactory::Symlink(
+  const std::string &name,
+  const std::string &target)
+{
+  DirectoryEntry dirent = Symlink();
+  dirent.name_.Assign(name.data(), name.length());
+  dirent.symlink_.Assign(target.data(), target.length());
+  dirent.size_ = target.length();
+  return dirent;
+}
+
 }  // namespace catalog
 
 
@@ -7,6 +7,7 @@
 
 #include <gtest/gtest.h>
 
+#include <pthread.h>
 #include <sys/types.h>
 
 #include <ctime>
@@ -39,6 +40,12 @@ class DirectoryEntryTestFactory {
   static catalog::DirectoryEntry Directory();
   static catalog::DirectoryEntry Symlink();
   static catalog::DirectoryEntry ChunkedFile();
+  static catalog::DirectoryEntry RegularFile(const std::string &name,
+                                             const unsigned size,
+                                             const shash::Any &hash);
+  static catalog::DirectoryEntry Directory(const std::string &name);
+  static catalog::DirectoryEntry Symlink(const std::string &name,
+                                         const std::string &target);
 };
 
 }  // namespace catalog
@@ -201,6 +208,7 @@ class MockObjectStorage {
 
  public:
   static std::set<shash::Any> *s_deleted_objects;
+  static pthread_mutex_t        s_deleted_objects_lock;
 
  public:
   static void Reset() {
@@ -234,6 +242,7 @@ class MockObjectStorage {
 
  protected:
   static bool IsDeleted(const shash::Any &hash) {
+    MutexLockGuard guard(s_deleted_objects_lock);
     return s_deleted_objects != NULL &&
            s_deleted_objects->find(hash) != s_deleted_objects->end();
   }
@@ -250,6 +259,10 @@ typename MockObjectStorage<ObjectT>::AvailableObjects
 template <class ObjectT>
 std::set<shash::Any>* MockObjectStorage<ObjectT>::s_deleted_objects;
 
+template <class ObjectT>
+pthread_mutex_t MockObjectStorage<ObjectT>::s_deleted_objects_lock =
+  PTHREAD_MUTEX_INITIALIZER;
+
 
 //------------------------------------------------------------------------------
 